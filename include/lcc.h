@@ -34,7 +34,31 @@ typedef enum {
   RESULT_INFO_ROW_COUNT,
   RESULT_INFO_COLUMNS,
   RESULT_INFO_PROTOCOL,
-  RESULT_INFO_ROW
+  RESULT_INFO_ROW,
+  RESULT_INFO_COLUMN_COUNT,
+  BACKEND_INFO_LIMIT,
+  BACKEND_INFO_IN_FLIGHT,
+  BACKEND_INFO_CIRCUIT_STATE,
+  POOL_INFO_SIZE,
+  POOL_INFO_IDLE,
+  SESSION_INFO_PINNED,
+  GROUP_COMMIT_INFO_BATCHES,
+  GROUP_COMMIT_INFO_STATEMENTS,
+  SINGLE_FLIGHT_INFO_EXECUTED,
+  SINGLE_FLIGHT_INFO_COALESCED,
+  ROUTER_INFO_SHARDS,
+  SCATTER_INFO_ROW,
+  SCATTER_INFO_COLUMNS,
+  SCATTER_INFO_SHARD,
+  SCATTER_INFO_ROW_COUNT,
+  BINLOG_INFO_EVENT,
+  CONNECTION_INFO_SOCKET,
+  CONNECTION_INFO_WAIT_EVENTS,
+  CONNECTION_INFO_WAIT_TIMEOUT,
+  PIPELINE_INFO_FLUSHES,
+  PIPELINE_INFO_COMMANDS,
+  CONNECTION_INFO_NUMA_NODE,
+  RESULT_INFO_EXPECTED_ROWS
 } LCC_INFO;
 
 typedef enum {
@@ -57,15 +81,55 @@ typedef enum {
   LCC_OPT_PROGRESS_REPORT_CALLBACK,
   LCC_OPT_STMT_PARAM_CALLBACK,
   LCC_OPT_STMT_RESULT_CALLBACK,
+  LCC_OPT_HEDGE_PERCENTILE,
+  LCC_OPT_HEDGE_MIN_DELAY,
+  LCC_OPT_BACKEND_LIMITS,
+  LCC_OPT_CIRCUIT_BREAKER,
+  LCC_OPT_GROUP_COMMIT,
+  LCC_OPT_POOL_CLASS,
+  LCC_OPT_POOL_MAINTENANCE,
+  LCC_OPT_READ_TIMEOUT,
+  LCC_OPT_WRITE_TIMEOUT,
+  LCC_OPT_DEADLINE,
+  LCC_OPT_KILL_POOL,
+  LCC_OPT_LOCAL_INFILE_CALLBACK,
+  LCC_OPT_LOCAL_INFILE_DIR,
+  LCC_OPT_BINLOG_WORKERS,
+  LCC_OPT_BINLOG_SEMI_SYNC,
+  LCC_OPT_BINLOG_HEARTBEAT,
+  LCC_OPT_LOOP_THREADS,
+  LCC_OPT_WAIT_CALLBACK,
+  LCC_OPT_ASYNC_STACK_SIZE,
+  LCC_OPT_PIPELINE_DEPTH,
+  LCC_OPT_READ_AHEAD,
+  LCC_OPT_NUMA_NODE,
+  LCC_OPT_EXEC_HISTORY,
+  LCC_OPT_HEDGE_READS,
   LCC_OPT_INVALID_OPTION= 0xFFFF
 } LCC_OPTION;
 
 typedef enum {
   LCC_CONNECTION= 0,
   LCC_STATEMENT,
-  LCC_RESULT
+  LCC_RESULT,
+  LCC_BACKEND,
+  LCC_POOL,
+  LCC_SESSION,
+  LCC_GROUP_COMMIT,
+  LCC_SINGLE_FLIGHT,
+  LCC_ROUTER,
+  LCC_SCATTER,
+  LCC_BINLOG,
+  LCC_LOOP,
+  LCC_PIPELINE
 } LCC_HANDLE_TYPE;
 
+typedef enum {
+  LCC_CIRCUIT_CLOSED= 0,
+  LCC_CIRCUIT_OPEN,
+  LCC_CIRCUIT_HALF_OPEN
+} LCC_CIRCUIT_STATE;
+
 typedef enum {
   LCC_COLTYPE_DECIMAL_UNUSED= 0,
   LCC_COLTYPE_INT8= 1,
@@ -84,6 +148,9 @@ typedef enum {
   LCC_COLTYPE_NEWDATE_UNUSED= 14,
   LCC_COLTYPE_VARCHAR= 15,
   LCC_COLTYPE_BIT=16,
+  LCC_COLTYPE_TIMESTAMP2= 17,
+  LCC_COLTYPE_DATETIME2= 18,
+  LCC_COLTYPE_TIME2= 19,
   LCC_COLTYPE_JSON= 245,
   LCC_COLTYPE_NEWDECIMAL= 246,
   LCC_COLTYPE_ENUM= 247,
@@ -208,6 +275,16 @@ typedef struct {
   LCC_ERROR_INFO info;
 } LCC_ERROR;
 
+/* statistics of a priority class of a pool (times in usec) */
+typedef struct {
+  uint64_t requests;          /* number of checkouts */
+  uint64_t queue_time;        /* time spent waiting for a connection */
+  uint64_t commands;
+  uint64_t server_time;       /* response time of commands */
+  uint32_t active;
+  uint32_t waiting;
+} LCC_POOL_CLASS_STATS;
+
 typedef struct lcc_list {
   struct lcc_list *next;
   void *data;
@@ -260,6 +337,137 @@ typedef struct {
   uint8_t type;
 } LCC_COLUMN;
 
+/* fills buffer with data of a LOAD DATA LOCAL INFILE statement,
+   returns number of bytes, 0 at end of data or -1 on error */
+typedef int64_t (*LCC_INFILE_CALLBACK)(void *user_data, const char *filename,
+                                       char *buffer, size_t size);
+
+/* called by an event loop or pipeline thread when a command of a
+   connection completed (rc is the result of the command) or a posted
+   function runs (rc is ER_OK) */
+typedef void (*LCC_LOOP_CALLBACK)(LCC_HANDLE *connection, LCC_ERRNO rc, void *data);
+
+/* events a connection waits for */
+#define LCC_WAIT_READ     1
+#define LCC_WAIT_WRITE    2
+#define LCC_WAIT_TIMEOUT  4
+
+/* waits until the socket is ready for events (LCC_WAIT_READ or
+   LCC_WAIT_WRITE) or timeout ms (-1 = infinite) elapsed. Returns a
+   positive value if the socket is ready, 0 on timeout or -1 on error
+   (errno is set) */
+typedef int (*LCC_WAIT_CALLBACK)(LCC_HANDLE *connection, int fd, uint8_t events,
+                                 int32_t timeout, void *data);
+
+/* operation of LCC_async_start(), which may call any blocking
+   function of the connection */
+typedef LCC_ERRNO (*LCC_ASYNC_FUNC)(LCC_HANDLE *connection, void *data);
+
+/* processes a batch of LCC_result_process() on a worker thread: rows
+   contains row_count * column_count values (not zero terminated, str is
+   NULL for NULL values) which are valid until the batch was retired.
+   output is passed to the ordered callback */
+typedef LCC_ERRNO (*LCC_BATCH_CALLBACK)(void *data, uint64_t batch_nr,
+                                        const LCC_STRING *rows, uint32_t row_count,
+                                        uint32_t column_count, void **output);
+
+/* retires the batches of LCC_result_process() one by one in the order
+   of the result set */
+typedef LCC_ERRNO (*LCC_ORDERED_CALLBACK)(void *data, uint64_t batch_nr,
+                                          const LCC_STRING *rows, uint32_t row_count,
+                                          void *output);
+
+/* sort column for merging results of several shards */
+typedef struct {
+  uint32_t column;
+  uint8_t descending;
+} LCC_MERGE_KEY;
+
+/* binlog event types */
+typedef enum {
+  LCC_BINLOG_QUERY= 2,
+  LCC_BINLOG_STOP= 3,
+  LCC_BINLOG_ROTATE= 4,
+  LCC_BINLOG_FORMAT_DESCRIPTION= 15,
+  LCC_BINLOG_XID= 16,
+  LCC_BINLOG_TABLE_MAP= 19,
+  LCC_BINLOG_WRITE_ROWS_V1= 23,
+  LCC_BINLOG_UPDATE_ROWS_V1= 24,
+  LCC_BINLOG_DELETE_ROWS_V1= 25,
+  LCC_BINLOG_HEARTBEAT= 27,
+  LCC_BINLOG_WRITE_ROWS= 30,
+  LCC_BINLOG_UPDATE_ROWS= 31,
+  LCC_BINLOG_DELETE_ROWS= 32,
+  LCC_BINLOG_ANNOTATE_ROWS= 160,
+  LCC_BINLOG_GTID= 162,
+  LCC_BINLOG_GTID_LIST= 163
+} LCC_BINLOG_EVENT_TYPE;
+
+/* column of a table map event */
+typedef struct {
+  uint8_t type;               /* LCC_COLTYPE, real type of ENUM/SET */
+  uint8_t nullable;
+  uint8_t precision;          /* DECIMAL */
+  uint8_t decimals;           /* DECIMAL scale, fractional seconds */
+  uint32_t length;            /* maximum length of strings, number of
+                                 length bytes of BLOB, JSON, GEOMETRY,
+                                 storage size of FLOAT, DOUBLE, ENUM, SET
+                                 and number of bits of BIT */
+} LCC_BINLOG_COLUMN;
+
+typedef struct {
+  uint64_t table_id;
+  const char *database;
+  const char *name;
+  uint32_t column_count;
+  const LCC_BINLOG_COLUMN *columns;
+} LCC_BINLOG_TABLE;
+
+/* value of a row image, string data points into the event */
+typedef struct {
+  uint8_t present;            /* column is part of the row image */
+  uint8_t is_null;
+  int64_t i;                  /* integers, YEAR, ENUM, SET, BIT,
+                                 seconds of TIMESTAMP */
+  uint64_t u;                 /* integers without sign extension */
+  double d;                   /* FLOAT, DOUBLE */
+  struct {
+    uint16_t year;
+    uint8_t month, day;
+    uint16_t hour;            /* TIME: up to 838 */
+    uint8_t minute, second;
+    uint8_t negative;
+    uint32_t microseconds;
+  } time;                     /* DATE, TIME, DATETIME, TIMESTAMP (microseconds) */
+  LCC_STRING str;             /* strings, BLOB, JSON, GEOMETRY, BIT and
+                                 binary DECIMAL (see LCC_binlog_decimal) */
+} LCC_BINLOG_VALUE;
+
+typedef struct {
+  LCC_BINLOG_VALUE *before;   /* NULL for WRITE_ROWS */
+  LCC_BINLOG_VALUE *after;    /* NULL for DELETE_ROWS */
+} LCC_BINLOG_ROW;
+
+typedef struct {
+  uint32_t timestamp;
+  uint8_t type;               /* LCC_BINLOG_EVENT_TYPE */
+  uint32_t server_id;
+  uint32_t next_position;
+  uint16_t flags;
+  const char *data;           /* event without header and checksum */
+  size_t length;
+  /* GTID */
+  uint32_t gtid_domain;
+  uint64_t gtid_sequence;
+  /* QUERY */
+  LCC_STRING database;
+  LCC_STRING query;
+  /* TABLE_MAP and row events */
+  const LCC_BINLOG_TABLE *table;
+  LCC_BINLOG_ROW *rows;
+  uint32_t row_count;
+} LCC_BINLOG_EVENT;
+
 typedef struct {
   LCC_BUFFER buffer;
   LCC_COLTYPE buffer_type;
@@ -306,6 +514,26 @@ LCC_configuration_set(LCC_HANDLE *handle,
 const LCC_COLUMN API_FUNC
 *LCC_result_columns(LCC_HANDLE *handle);
 
+LCC_ERRNO API_FUNC
+LCC_connect(LCC_HANDLE *handle, const char *host, uint16_t port);
+
+LCC_ERRNO API_FUNC
+LCC_execute(LCC_HANDLE *handle, const char *statement, size_t length);
+
+LCC_ERROR * API_FUNC
+LCC_get_error(LCC_HANDLE *handle);
+
+LCC_ERRNO API_FUNC
+LCC_result_fetch(LCC_HANDLE *handle, uint8_t *eof);
+
+LCC_ERRNO API_FUNC
+LCC_result_process(LCC_HANDLE *handle,
+                   uint32_t threads,
+                   uint32_t batch_rows,
+                   LCC_BATCH_CALLBACK process,
+                   LCC_ORDERED_CALLBACK ordered,
+                   void *data);
+
 LCC_ERRNO 
 LCC_set_option(LCC_HANDLE *hdl, LCC_OPTION option, ...);
 
@@ -326,6 +554,131 @@ LCC_ERRNO API_FUNC
 LCC_stmt_set_param(LCC_HANDLE *handle, LCC_BIND *bind);
 LCC_ERRNO API_FUNC
 LCC_stmt_fill_exec_buffer(LCC_HANDLE *handle);
+LCC_ERRNO API_FUNC
+LCC_stmt_reserve_exec_buffer(LCC_HANDLE *handle, uint32_t param_count,
+                             size_t size, uint8_t **buffer);
+LCC_ERRNO API_FUNC
+LCC_stmt_set_exec_length(LCC_HANDLE *handle, size_t length);
+LCC_ERRNO API_FUNC
+LCC_stmt_read_execute_response(LCC_HANDLE *handle);
+
+LCC_ERRNO API_FUNC
+LCC_hedged_execute(LCC_HANDLE **handles,
+                   uint32_t count,
+                   const char *statement,
+                   size_t length,
+                   LCC_HANDLE **winner);
+
+LCC_ERRNO API_FUNC
+LCC_pool_add(LCC_HANDLE *pool, LCC_HANDLE *connection);
+
+LCC_ERRNO API_FUNC
+LCC_pool_checkout(LCC_HANDLE *pool, LCC_HANDLE **connection);
+
+LCC_ERRNO API_FUNC
+LCC_pool_checkin(LCC_HANDLE *pool, LCC_HANDLE *connection);
+
+LCC_ERRNO API_FUNC
+LCC_pool_checkout_class(LCC_HANDLE *pool, uint8_t priority_class, LCC_HANDLE **connection);
+
+LCC_ERRNO API_FUNC
+LCC_pool_class_stats(LCC_HANDLE *pool, uint8_t priority_class, LCC_POOL_CLASS_STATS *stats);
+
+LCC_ERRNO API_FUNC
+LCC_pool_maintenance(LCC_HANDLE *pool, uint32_t *timeout);
+
+LCC_ERRNO API_FUNC
+LCC_pool_start_maintenance(LCC_HANDLE *pool);
+
+LCC_ERRNO API_FUNC
+LCC_session_attach(LCC_HANDLE *session, LCC_HANDLE **connection);
+
+LCC_ERRNO API_FUNC
+LCC_session_detach(LCC_HANDLE *session);
+
+LCC_ERRNO API_FUNC
+LCC_group_commit_execute(LCC_HANDLE *group,
+                         const char *statement,
+                         size_t length,
+                         uint64_t *affected_rows,
+                         uint64_t *last_insert_id,
+                         LCC_ERROR *error);
+
+LCC_ERRNO API_FUNC
+LCC_single_flight_execute(LCC_HANDLE *group,
+                          LCC_HANDLE *connection,
+                          const char *statement,
+                          size_t length,
+                          LCC_HANDLE **result);
+
+LCC_ERRNO API_FUNC
+LCC_router_add(LCC_HANDLE *router, LCC_HANDLE *shard);
+
+LCC_ERRNO API_FUNC
+LCC_router_remove(LCC_HANDLE *router, LCC_HANDLE **shard);
+
+LCC_ERRNO API_FUNC
+LCC_router_route(LCC_HANDLE *router, const char *key, size_t length, LCC_HANDLE **shard);
+
+LCC_ERRNO API_FUNC
+LCC_scatter_execute(LCC_HANDLE *scatter,
+                    LCC_HANDLE **connections,
+                    uint32_t count,
+                    const char *statement,
+                    size_t length,
+                    const LCC_MERGE_KEY *keys,
+                    uint32_t key_count,
+                    uint64_t limit);
+
+LCC_ERRNO API_FUNC
+LCC_scatter_fetch(LCC_HANDLE *scatter, uint8_t *eof);
+
+LCC_ERRNO API_FUNC
+LCC_binlog_start(LCC_HANDLE *binlog,
+                 LCC_HANDLE *connection,
+                 uint32_t server_id,
+                 const char *gtid_position);
+
+LCC_ERRNO API_FUNC
+LCC_binlog_fetch(LCC_HANDLE *binlog, uint8_t *eof);
+
+size_t API_FUNC
+LCC_binlog_decimal(const LCC_BINLOG_COLUMN *column,
+                   const LCC_BINLOG_VALUE *value,
+                   char *buffer,
+                   size_t size);
+
+LCC_ERRNO API_FUNC
+LCC_loop_start(LCC_HANDLE *loop);
+
+LCC_ERRNO API_FUNC
+LCC_loop_add(LCC_HANDLE *loop, LCC_HANDLE *connection);
+
+LCC_ERRNO API_FUNC
+LCC_loop_remove(LCC_HANDLE *connection, LCC_LOOP_CALLBACK callback, void *data);
+
+LCC_ERRNO API_FUNC
+LCC_loop_execute(LCC_HANDLE *connection,
+                 const char *statement,
+                 size_t length,
+                 LCC_LOOP_CALLBACK callback,
+                 void *data);
+
+LCC_ERRNO API_FUNC
+LCC_loop_post(LCC_HANDLE *connection, LCC_LOOP_CALLBACK callback, void *data);
+
+LCC_ERRNO API_FUNC
+LCC_async_start(LCC_HANDLE *connection, LCC_ASYNC_FUNC func, void *data, uint8_t *wait);
+
+LCC_ERRNO API_FUNC
+LCC_async_continue(LCC_HANDLE *connection, uint8_t ready, uint8_t *wait);
+
+LCC_ERRNO API_FUNC
+LCC_pipeline_submit(LCC_HANDLE *pipeline,
+                    const char *statement,
+                    size_t length,
+                    LCC_LOOP_CALLBACK callback,
+                    void *data);
 
 #ifdef __cplusplus
 }
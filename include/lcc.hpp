@@ -0,0 +1,1410 @@
+/* C++20 interface of lcc
+
+   Connections, statements and results own their LCC handles, errors
+   are thrown as lcc::error.
+
+   Coroutines: an operation which would wait for the socket suspends
+   the awaiting coroutine instead (see LCC_async_start). The socket is
+   watched by a scheduler, which plugs lcc into any event loop or
+   executor:
+
+     lcc::task<uint64_t> count(lcc::connection &conn)
+     {
+       lcc::result res= co_await conn.query("SELECT id FROM t");
+       uint64_t rows= 0;
+
+       while (co_await res.next())
+         rows++;
+       co_return rows;
+     }
+
+   Without a scheduler, operations block. get() runs an operation
+   blocking outside of a coroutine, try_get() returns the error as
+   std::expected instead of throwing (C++23):
+
+     lcc::result res= conn.query("SELECT id, name FROM t").get();
+     for (const lcc::row &row : res)
+       std::cout << row[0] << ' ' << row[1] << '\n';
+
+   Rows are views into the buffers of the result, they are valid until
+   the next row was fetched.
+
+   Typed parameters: execute(args...) encodes the arguments of a
+   prepared statement straight into the execute buffer, their wire
+   types are derived from the C++ types at compile time:
+
+     lcc::result res= co_await stmt.execute(int64_t(42), "name"sv, std::optional<double>());
+
+   Typed rows: as<Row>() checks the columns once against a tuple or an
+   aggregate and decodes the rows into it without looking at the
+   column types again:
+
+     struct item { int64_t id; std::string_view name; std::optional<double> price; };
+
+     for (const item &it : res.as<item>())
+       ...
+*/
+#pragma once
+
+#include <lcc.h>
+extern "C" {
+#include <lcc_error.h>
+}
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#if __has_include(<expected>)
+#include <expected>
+#endif
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <poll.h>
+
+namespace lcc {
+
+class error : public std::runtime_error
+{
+public:
+  error(LCC_ERRNO code, const LCC_ERROR *info)
+    : std::runtime_error(info && info->error_number == code ?
+                         std::string(info->error) :
+                         "lcc error " + std::to_string(code)),
+      code_(code)
+  {
+    std::string_view state= info && info->error_number == code ? info->sqlstate : "HY000";
+    state.copy(sqlstate_, 5);
+  }
+
+  LCC_ERRNO code() const noexcept { return code_; }
+  const char *sqlstate() const noexcept { return sqlstate_; }
+
+private:
+  LCC_ERRNO code_;
+  char sqlstate_[6]= {};
+};
+
+namespace detail {
+
+/* throws if rc is an error, the error information is taken from the
+   first handle which has the error */
+inline void check(LCC_ERRNO rc, LCC_HANDLE *handle, LCC_HANDLE *connection= nullptr)
+{
+  const LCC_ERROR *info= handle ? LCC_get_error(handle) : nullptr;
+
+  if (!rc)
+    return;
+  if ((!info || info->error_number != rc) && connection)
+    info= LCC_get_error(connection);
+  throw error(rc, info);
+}
+
+/* throws a client error, args are the arguments of its message */
+template <typename... Args>
+[[noreturn]] void raise(LCC_ERRNO rc, Args... args)
+{
+  LCC_ERROR info;
+
+  lcc_set_error(&info, LCC_ERROR_INFO, rc, "HY000", NULL, args...);
+  throw error(rc, &info);
+}
+
+} // namespace detail
+
+/* receives the events of a watched socket */
+class waiter
+{
+public:
+  virtual void ready(uint8_t events)= 0;
+
+protected:
+  ~waiter()= default;
+};
+
+class scheduler
+{
+public:
+  virtual ~scheduler()= default;
+
+  /**
+   * @brief: calls w.ready() once, when the socket is ready for one of
+   *         events (LCC_WAIT_READ, LCC_WAIT_WRITE) or with
+   *         LCC_WAIT_TIMEOUT after timeout ms (-1 = infinite)
+   *
+   * ready() resumes the coroutine which waited for the socket, it
+   * should be called on the thread of the event loop.
+   */
+  virtual void watch(int fd, uint8_t events, int32_t timeout, waiter &w)= 0;
+};
+
+/* scheduler for a thread which only runs coroutines of lcc */
+class poll_scheduler : public scheduler
+{
+public:
+  void watch(int fd, uint8_t events, int32_t timeout, waiter &w) override
+  {
+    watches_.push_back({fd, events,
+                        timeout < 0 ? clock::time_point::max() :
+                                      clock::now() + std::chrono::milliseconds(timeout),
+                        &w});
+  }
+
+  /* runs until no socket is watched */
+  void run()
+  {
+    std::vector<watch_entry> pending;
+    std::vector<pollfd> fds;
+
+    while (!watches_.empty())
+    {
+      clock::time_point now= clock::now(), next= clock::time_point::max();
+      int timeout= -1;
+
+      fds.clear();
+      for (const watch_entry &entry : watches_)
+      {
+        short events= (entry.events & LCC_WAIT_READ ? POLLIN : 0) |
+                      (entry.events & LCC_WAIT_WRITE ? POLLOUT : 0);
+        fds.push_back({entry.fd, events, 0});
+        next= std::min(next, entry.expires);
+      }
+      if (next != clock::time_point::max())
+        timeout= next <= now ? 0 :
+                 (int)std::chrono::ceil<std::chrono::milliseconds>(next - now).count();
+      if (::poll(fds.data(), fds.size(), timeout) < 0)
+        continue;
+
+      /* ready() may watch sockets again */
+      pending.swap(watches_);
+      now= clock::now();
+      for (size_t i= 0; i < pending.size(); i++)
+      {
+        uint8_t events= (fds[i].revents & (POLLIN | POLLHUP | POLLERR) ? LCC_WAIT_READ : 0) |
+                        (fds[i].revents & (POLLOUT | POLLHUP | POLLERR) ? LCC_WAIT_WRITE : 0);
+
+        events&= pending[i].events;
+        if (!events && pending[i].expires <= now)
+          events= LCC_WAIT_TIMEOUT;
+        if (events)
+          pending[i].w->ready(events);
+        else
+          watches_.push_back(pending[i]);
+      }
+      pending.clear();
+    }
+  }
+
+private:
+  using clock= std::chrono::steady_clock;
+
+  struct watch_entry {
+    int fd;
+    uint8_t events;
+    clock::time_point expires;
+    waiter *w;
+  };
+  std::vector<watch_entry> watches_;
+};
+
+template <typename T= void> class task;
+
+namespace detail {
+
+struct promise_base
+{
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+
+  struct final_awaiter
+  {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> coroutine) noexcept
+    {
+      std::coroutine_handle<> continuation= coroutine.promise().continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  final_awaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { exception= std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base
+{
+  std::optional<T> value;
+
+  task<T> get_return_object() noexcept;
+  void return_value(T v) { value.emplace(std::move(v)); }
+};
+
+template <>
+struct promise<void> : promise_base
+{
+  task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+/**
+ * @brief: coroutine which runs when it is awaited or started
+ *
+ * A task which isn't awaited by another coroutine is started with
+ * start(), its result is available by get() when done() returns true.
+ */
+template <typename T>
+class task
+{
+public:
+  using promise_type= detail::promise<T>;
+
+  task(task &&other) noexcept : coroutine_(std::exchange(other.coroutine_, {})) {}
+  task &operator=(task &&other) noexcept
+  {
+    if (this != &other)
+    {
+      if (coroutine_)
+        coroutine_.destroy();
+      coroutine_= std::exchange(other.coroutine_, {});
+    }
+    return *this;
+  }
+  task(const task &)= delete;
+  task &operator=(const task &)= delete;
+  ~task()
+  {
+    if (coroutine_)
+      coroutine_.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+  {
+    coroutine_.promise().continuation= caller;
+    return coroutine_;
+  }
+  T await_resume() { return result(); }
+
+  void start() { coroutine_.resume(); }
+  bool done() const noexcept { return coroutine_.done(); }
+  T get() { return result(); }
+
+private:
+  friend promise_type;
+  explicit task(std::coroutine_handle<promise_type> coroutine) noexcept : coroutine_(coroutine) {}
+
+  T result()
+  {
+    promise_type &promise= coroutine_.promise();
+
+    if (promise.exception)
+      std::rethrow_exception(promise.exception);
+    if constexpr (!std::is_void_v<T>)
+      return std::move(*promise.value);
+  }
+
+  std::coroutine_handle<promise_type> coroutine_;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> promise<T>::get_return_object() noexcept
+{
+  return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object() noexcept
+{
+  return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+/**
+ * @brief: awaitable of an operation on a connection
+ *
+ * run(connection) is called by LCC_async_start() and must not throw.
+ * The awaiting coroutine is suspended while the operation waits for
+ * the socket, finish(rc) returns the result of co_await.
+ */
+template <typename Run, typename Finish>
+class operation : private waiter
+{
+public:
+  operation(LCC_HANDLE *connection, scheduler *sched, Run run, Finish finish)
+    : connection_(connection), scheduler_(sched), run_(std::move(run)), finish_(std::move(finish))
+  {}
+
+  bool await_ready()
+  {
+    if (!scheduler_)
+    {
+      rc_= run_(connection_);
+      return true;
+    }
+    rc_= LCC_async_start(connection_, &operation::call, this, &wait_);
+    return !wait_;
+  }
+
+  void await_suspend(std::coroutine_handle<> coroutine)
+  {
+    coroutine_= coroutine;
+    watch();
+  }
+
+  decltype(auto) await_resume() { return finish_(rc_); }
+
+  /* runs the operation blocking */
+  decltype(auto) get()
+  {
+    rc_= run_(connection_);
+    return finish_(rc_);
+  }
+
+#ifdef __cpp_lib_expected
+  using value_type= std::invoke_result_t<Finish &, LCC_ERRNO>;
+
+  /* runs the operation blocking, returns the error instead of throwing */
+  std::expected<value_type, error> try_get()
+  {
+    try {
+      if constexpr (std::is_void_v<value_type>)
+      {
+        get();
+        return {};
+      }
+      else
+        return get();
+    } catch (const error &e) {
+      return std::unexpected(e);
+    }
+  }
+#endif
+
+private:
+  static LCC_ERRNO call(LCC_HANDLE *connection, void *data)
+  {
+    return static_cast<operation *>(data)->run_(connection);
+  }
+
+  void watch()
+  {
+    int fd= -1;
+    int32_t timeout= -1;
+
+    LCC_get_info(connection_, CONNECTION_INFO_SOCKET, &fd);
+    if (wait_ & LCC_WAIT_TIMEOUT)
+      LCC_get_info(connection_, CONNECTION_INFO_WAIT_TIMEOUT, &timeout);
+    scheduler_->watch(fd, wait_ & (LCC_WAIT_READ | LCC_WAIT_WRITE), timeout, *this);
+  }
+
+  void ready(uint8_t events) override
+  {
+    rc_= LCC_async_continue(connection_, events, &wait_);
+    if (wait_)
+      watch();
+    else
+      coroutine_.resume();
+  }
+
+  LCC_HANDLE *connection_;
+  scheduler *scheduler_;
+  Run run_;
+  Finish finish_;
+  LCC_ERRNO rc_= 0;
+  uint8_t wait_= 0;
+  std::coroutine_handle<> coroutine_;
+};
+
+template <typename Run, typename Finish>
+operation<Run, Finish> make_operation(LCC_HANDLE *connection, scheduler *sched,
+                                      Run run, Finish finish)
+{
+  return operation<Run, Finish>(connection, sched, std::move(run), std::move(finish));
+}
+
+} // namespace detail
+
+class connection;
+class statement;
+template <typename Row> class typed_result;
+
+/**
+ * @brief: view of the column values of a row
+ *
+ * The values point into the buffers of the result, a row is valid
+ * until the next row was fetched or the result was closed.
+ * NULL values have no data: is_null(i) is true and row[i].data()
+ * is nullptr.
+ */
+class row
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category= std::random_access_iterator_tag;
+    using value_type= std::string_view;
+    using difference_type= std::ptrdiff_t;
+    using reference= std::string_view;
+
+    iterator() noexcept= default;
+    explicit iterator(const LCC_STRING *value) noexcept : value_(value) {}
+
+    std::string_view operator*() const noexcept { return row::view(*value_); }
+    std::string_view operator[](difference_type n) const noexcept { return row::view(value_[n]); }
+    iterator &operator++() noexcept { ++value_; return *this; }
+    iterator operator++(int) noexcept { return iterator(value_++); }
+    iterator &operator--() noexcept { --value_; return *this; }
+    iterator operator--(int) noexcept { return iterator(value_--); }
+    iterator &operator+=(difference_type n) noexcept { value_+= n; return *this; }
+    iterator &operator-=(difference_type n) noexcept { value_-= n; return *this; }
+    friend iterator operator+(iterator it, difference_type n) noexcept { return it+= n; }
+    friend iterator operator+(difference_type n, iterator it) noexcept { return it+= n; }
+    friend iterator operator-(iterator it, difference_type n) noexcept { return it-= n; }
+    friend difference_type operator-(iterator a, iterator b) noexcept { return a.value_ - b.value_; }
+    friend auto operator<=>(iterator a, iterator b) noexcept= default;
+
+  private:
+    const LCC_STRING *value_= nullptr;
+  };
+
+  row() noexcept= default;
+  row(const LCC_STRING *values, uint32_t count) noexcept
+    : values_(values), count_(values ? count : 0)
+  {}
+
+  /* false after the last row */
+  explicit operator bool() const noexcept { return values_ != nullptr; }
+
+  uint32_t size() const noexcept { return count_; }
+  bool is_null(uint32_t i) const noexcept { return values_[i].str == nullptr; }
+  std::string_view operator[](uint32_t i) const noexcept { return view(values_[i]); }
+
+  /* raw value, binary rows return the wire format of the column type */
+  std::span<const std::byte> bytes(uint32_t i) const noexcept
+  {
+    return {reinterpret_cast<const std::byte *>(values_[i].str), values_[i].len};
+  }
+  const LCC_STRING *data() const noexcept { return values_; }
+
+  iterator begin() const noexcept { return iterator(values_); }
+  iterator end() const noexcept { return iterator(values_ + count_); }
+
+private:
+  static std::string_view view(const LCC_STRING &value) noexcept
+  {
+    return value.str ? std::string_view(value.str, value.len) : std::string_view();
+  }
+
+  const LCC_STRING *values_= nullptr;
+  uint32_t count_= 0;
+};
+
+/* result set of a query or an executed statement */
+class result
+{
+public:
+  result() noexcept= default;
+  result(result &&other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)),
+      connection_(other.connection_), scheduler_(other.scheduler_),
+      column_count_(other.column_count_), binary_(other.binary_), eof_(other.eof_)
+  {}
+  result &operator=(result &&other) noexcept
+  {
+    if (this != &other)
+    {
+      close();
+      handle_= std::exchange(other.handle_, nullptr);
+      connection_= other.connection_;
+      scheduler_= other.scheduler_;
+      column_count_= other.column_count_;
+      binary_= other.binary_;
+      eof_= other.eof_;
+    }
+    return *this;
+  }
+  result(const result &)= delete;
+  result &operator=(const result &)= delete;
+  ~result() { close(); }
+
+  /* false if the statement didn't return a result set */
+  explicit operator bool() const noexcept { return handle_ != nullptr; }
+  LCC_HANDLE *handle() const noexcept { return handle_; }
+
+  uint32_t column_count() const noexcept { return column_count_; }
+  const LCC_COLUMN *columns() const noexcept { return handle_ ? LCC_result_columns(handle_) : nullptr; }
+  /* true for rows of a prepared statement (binary protocol) */
+  bool binary() const noexcept { return binary_; }
+
+private:
+  /* fetches the next row, co_await returns convert(row) */
+  template <typename Convert>
+  auto fetch(Convert convert)
+  {
+    return detail::make_operation(connection_, scheduler_,
+      [this](LCC_HANDLE *) noexcept -> LCC_ERRNO {
+        if (!handle_ || eof_)
+        {
+          eof_= 1;
+          return ER_OK;
+        }
+        return LCC_result_fetch(handle_, &eof_);
+      },
+      [this, convert](LCC_ERRNO rc) {
+        LCC_STRING *values= nullptr;
+
+        detail::check(rc, handle_, connection_);
+        if (eof_)
+          return convert(row());
+        LCC_get_info(handle_, RESULT_INFO_ROW, &values);
+        return convert(row(values, column_count_));
+      });
+  }
+
+public:
+  /* fetches the next row, returns an empty row after the last row */
+  auto next() { return fetch([](const row &r) noexcept { return r; }); }
+
+  /**
+   * @brief: typed view of the remaining rows
+   *
+   * Throws lcc::error if the columns don't match the fields of Row.
+   */
+  template <typename Row>
+  typed_result<Row> as() { return typed_result<Row>(*this); }
+
+  /**
+   * @brief: iterator over the remaining rows
+   *
+   * A result is read from the socket while it is iterated, so the
+   * iteration is single pass. Rows are fetched blocking, coroutines
+   * use co_await next() instead.
+   */
+  class iterator
+  {
+  public:
+    using iterator_category= std::input_iterator_tag;
+    using value_type= row;
+    using difference_type= std::ptrdiff_t;
+
+    iterator() noexcept= default;
+    explicit iterator(result *res) : result_(res) { ++*this; }
+
+    const row &operator*() const noexcept { return row_; }
+    const row *operator->() const noexcept { return &row_; }
+    iterator &operator++()
+    {
+      row_= result_->next().get();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const noexcept { return !row_; }
+
+  private:
+    result *result_= nullptr;
+    row row_;
+  };
+
+  iterator begin() { return iterator(this); }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+  void close() noexcept
+  {
+    if (handle_)
+      LCC_close_handle(std::exchange(handle_, nullptr));
+  }
+
+private:
+  friend class connection;
+  friend class statement;
+  template <typename Row> friend class typed_result;
+
+  result(LCC_HANDLE *handle, LCC_HANDLE *connection, scheduler *sched) noexcept
+    : handle_(handle), connection_(connection), scheduler_(sched)
+  {
+    if (handle_)
+    {
+      LCC_get_info(handle_, RESULT_INFO_COLUMN_COUNT, &column_count_);
+      LCC_get_info(handle_, RESULT_INFO_PROTOCOL, &binary_);
+    }
+  }
+
+  LCC_HANDLE *handle_= nullptr;
+  LCC_HANDLE *connection_= nullptr;
+  scheduler *scheduler_= nullptr;
+  uint32_t column_count_= 0;
+  uint8_t binary_= 0;
+  uint8_t eof_= 0;
+};
+
+/**
+ * @brief: decoder of column values into fields of type T
+ *
+ * accepts() is called once per result and column, decode() converts
+ * a value of an accepted column without looking at its type. It
+ * returns false if the value can't be converted (NULL or not a
+ * number). Specialize field<T> to decode other types.
+ */
+template <typename T> struct field;
+
+namespace detail {
+
+constexpr bool is_integer(uint8_t type) noexcept
+{
+  switch (type) {
+  case LCC_COLTYPE_INT8:
+  case LCC_COLTYPE_INT16:
+  case LCC_COLTYPE_INT24:
+  case LCC_COLTYPE_INT32:
+  case LCC_COLTYPE_INT64:
+  case LCC_COLTYPE_YEAR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* size of a value in binary protocol, 0 if it has a length */
+constexpr size_t binary_size(uint8_t type) noexcept
+{
+  switch (type) {
+  case LCC_COLTYPE_INT8:
+    return 1;
+  case LCC_COLTYPE_INT16:
+  case LCC_COLTYPE_YEAR:
+    return 2;
+  case LCC_COLTYPE_INT24:
+  case LCC_COLTYPE_INT32:
+  case LCC_COLTYPE_FLOAT:
+    return 4;
+  case LCC_COLTYPE_INT64:
+  case LCC_COLTYPE_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+/* date and time values are sent as structures in binary protocol */
+constexpr bool is_temporal(uint8_t type) noexcept
+{
+  return type == LCC_COLTYPE_DATE || type == LCC_COLTYPE_TIME ||
+         type == LCC_COLTYPE_DATETIME || type == LCC_COLTYPE_TIMESTAMP;
+}
+
+template <typename T>
+bool parse_number(const LCC_STRING &value, T &out) noexcept
+{
+  const char *end= value.str + value.len;
+
+  if (!value.str)
+    return false;
+  auto [pos, ec]= std::from_chars(value.str, end, out);
+  return ec == std::errc() && pos == end;
+}
+
+} // namespace detail
+
+template <typename T>
+  requires std::integral<T> && (!std::same_as<T, bool>)
+struct field<T>
+{
+  static bool accepts(const LCC_COLUMN &column, bool binary) noexcept
+  {
+    return detail::is_integer(column.type) &&
+           (!binary || detail::binary_size(column.type) == sizeof(T));
+  }
+
+  template <bool Binary>
+  static bool decode(const LCC_STRING &value, T &out) noexcept
+  {
+    if constexpr (Binary)
+    {
+      if (!value.str)
+        return false;
+      memcpy(&out, value.str, sizeof(T));
+      return true;
+    }
+    else
+      return detail::parse_number(value, out);
+  }
+};
+
+template <>
+struct field<bool>
+{
+  static bool accepts(const LCC_COLUMN &column, bool binary) noexcept
+  {
+    return detail::is_integer(column.type) &&
+           (!binary || column.type == LCC_COLTYPE_INT8);
+  }
+
+  template <bool Binary>
+  static bool decode(const LCC_STRING &value, bool &out) noexcept
+  {
+    int64_t number;
+
+    if constexpr (Binary)
+      number= value.str ? *value.str : 0;
+    else if (!detail::parse_number(value, number))
+      return false;
+    out= number != 0;
+    return value.str != nullptr;
+  }
+};
+
+template <std::floating_point T>
+struct field<T>
+{
+  static bool accepts(const LCC_COLUMN &column, bool binary) noexcept
+  {
+    if (binary)
+      return column.type == (sizeof(T) == 4 ? LCC_COLTYPE_FLOAT : LCC_COLTYPE_DOUBLE);
+    return column.type == LCC_COLTYPE_FLOAT || column.type == LCC_COLTYPE_DOUBLE ||
+           column.type == LCC_COLTYPE_NEWDECIMAL || detail::is_integer(column.type);
+  }
+
+  template <bool Binary>
+  static bool decode(const LCC_STRING &value, T &out) noexcept
+  {
+    if constexpr (Binary)
+    {
+      if (!value.str)
+        return false;
+      memcpy(&out, value.str, sizeof(T));
+      return true;
+    }
+    else
+      return detail::parse_number(value, out);
+  }
+};
+
+/* string_view points into the buffers of the result like lcc::row */
+template <typename T>
+  requires std::same_as<T, std::string_view> || std::same_as<T, std::string>
+struct field<T>
+{
+  static bool accepts(const LCC_COLUMN &column, bool binary) noexcept
+  {
+    return column.type != LCC_COLTYPE_NULL &&
+           (!binary || (!detail::binary_size(column.type) && !detail::is_temporal(column.type)));
+  }
+
+  template <bool Binary>
+  static bool decode(const LCC_STRING &value, T &out)
+  {
+    if (!value.str)
+      return false;
+    out= T(value.str, value.len);
+    return true;
+  }
+};
+
+/* NULL values are decoded as std::nullopt */
+template <typename T>
+struct field<std::optional<T>>
+{
+  static bool accepts(const LCC_COLUMN &column, bool binary) noexcept
+  {
+    return column.type == LCC_COLTYPE_NULL || field<T>::accepts(column, binary);
+  }
+
+  template <bool Binary>
+  static bool decode(const LCC_STRING &value, std::optional<T> &out)
+  {
+    if (!value.str)
+    {
+      out.reset();
+      return true;
+    }
+    return field<T>::template decode<Binary>(value, out ? *out : out.emplace());
+  }
+};
+
+namespace detail {
+
+template <typename T> struct is_tuple : std::false_type {};
+template <typename... T> struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+/* converts to any field type, counts the fields of an aggregate */
+struct any_field
+{
+  template <typename T> operator T() const;
+};
+
+template <typename T, typename... Fields>
+constexpr size_t field_count()
+{
+  if constexpr (requires { T{Fields{}..., any_field{}}; })
+    return field_count<T, Fields..., any_field>();
+  else
+    return sizeof...(Fields);
+}
+
+/* tuple of references to the fields of a tuple or an aggregate */
+template <typename Row>
+auto tie_fields(Row &r)
+{
+  if constexpr (is_tuple<Row>::value)
+    return std::apply([](auto &...f) { return std::tie(f...); }, r);
+  else
+  {
+    constexpr size_t count= field_count<Row>();
+
+    static_assert(std::is_aggregate_v<Row>, "row type must be a std::tuple or an aggregate");
+    static_assert(count > 0 && count <= 16, "row type must have 1 to 16 fields");
+    if constexpr (count == 1) { auto &[a]= r; return std::tie(a); }
+    else if constexpr (count == 2) { auto &[a, b]= r; return std::tie(a, b); }
+    else if constexpr (count == 3) { auto &[a, b, c]= r; return std::tie(a, b, c); }
+    else if constexpr (count == 4) { auto &[a, b, c, d]= r; return std::tie(a, b, c, d); }
+    else if constexpr (count == 5) { auto &[a, b, c, d, e]= r; return std::tie(a, b, c, d, e); }
+    else if constexpr (count == 6) { auto &[a, b, c, d, e, f]= r; return std::tie(a, b, c, d, e, f); }
+    else if constexpr (count == 7) { auto &[a, b, c, d, e, f, g]= r; return std::tie(a, b, c, d, e, f, g); }
+    else if constexpr (count == 8) { auto &[a, b, c, d, e, f, g, h]= r; return std::tie(a, b, c, d, e, f, g, h); }
+    else if constexpr (count == 9) { auto &[a, b, c, d, e, f, g, h, i]= r; return std::tie(a, b, c, d, e, f, g, h, i); }
+    else if constexpr (count == 10) { auto &[a, b, c, d, e, f, g, h, i, j]= r; return std::tie(a, b, c, d, e, f, g, h, i, j); }
+    else if constexpr (count == 11) { auto &[a, b, c, d, e, f, g, h, i, j, k]= r; return std::tie(a, b, c, d, e, f, g, h, i, j, k); }
+    else if constexpr (count == 12) { auto &[a, b, c, d, e, f, g, h, i, j, k, l]= r; return std::tie(a, b, c, d, e, f, g, h, i, j, k, l); }
+    else if constexpr (count == 13) { auto &[a, b, c, d, e, f, g, h, i, j, k, l, m]= r; return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m); }
+    else if constexpr (count == 14) { auto &[a, b, c, d, e, f, g, h, i, j, k, l, m, n]= r; return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m, n); }
+    else if constexpr (count == 15) { auto &[a, b, c, d, e, f, g, h, i, j, k, l, m, n, o]= r; return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o); }
+    else { auto &[a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p]= r; return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p); }
+  }
+}
+
+} // namespace detail
+
+/**
+ * @brief: decodes rows into a std::tuple or an aggregate
+ *
+ * Field i is decoded from column i by field<T>. The constructor checks
+ * the columns of the result, decode() only converts the values.
+ */
+template <typename Row>
+class row_decoder
+{
+  using fields= decltype(detail::tie_fields(std::declval<Row &>()));
+  static constexpr uint32_t size= std::tuple_size_v<fields>;
+
+  template <size_t I>
+  using field_type= field<std::remove_reference_t<std::tuple_element_t<I, fields>>>;
+
+public:
+  /* throws lcc::error if the columns of res don't match Row */
+  explicit row_decoder(const result &res)
+    : columns_(res.columns()), binary_(res.binary())
+  {
+    if (res.column_count() != size)
+      detail::raise(ER_ROW_TYPE_MISMATCH, size, res.column_count());
+    check(std::make_index_sequence<size>());
+  }
+
+  /* throws lcc::error if a value can't be converted */
+  void decode(const row &r, Row &out) const
+  {
+    fields f= detail::tie_fields(out);
+
+    if (binary_)
+      decode<true>(r.data(), f, std::make_index_sequence<size>());
+    else
+      decode<false>(r.data(), f, std::make_index_sequence<size>());
+  }
+
+  Row operator()(const row &r) const
+  {
+    Row out{};
+
+    decode(r, out);
+    return out;
+  }
+
+private:
+  template <size_t... I>
+  void check(std::index_sequence<I...>) const
+  {
+    uint32_t failed= size;
+
+    ((field_type<I>::accepts(columns_[I], binary_) || (failed= I, false)) && ...);
+    if (failed < size)
+      detail::raise(ER_COLUMN_TYPE_MISMATCH, failed, column_name(failed));
+  }
+
+  template <bool Binary, size_t... I>
+  void decode(const LCC_STRING *values, fields &f, std::index_sequence<I...>) const
+  {
+    uint32_t failed= size;
+
+    ((field_type<I>::template decode<Binary>(values[I], std::get<I>(f)) || (failed= I, false)) && ...);
+    if (failed < size)
+      detail::raise(ER_COLUMN_CONVERSION, failed, column_name(failed));
+  }
+
+  const char *column_name(uint32_t i) const noexcept
+  {
+    return columns_[i].column_alias ? columns_[i].column_alias : "";
+  }
+
+  const LCC_COLUMN *columns_;
+  bool binary_;
+};
+
+/**
+ * @brief: rows of a result decoded into Row
+ *
+ * The result must outlive the typed_result.
+ */
+template <typename Row>
+class typed_result
+{
+public:
+  explicit typed_result(result &res) : result_(&res), decoder_(res) {}
+
+  /* fetches the next row, returns std::nullopt after the last row */
+  auto next()
+  {
+    return result_->fetch([this](const row &r) -> std::optional<Row> {
+      if (!r)
+        return std::nullopt;
+      return decoder_(r);
+    });
+  }
+
+  /* single pass iteration like result::iterator */
+  class iterator
+  {
+  public:
+    using iterator_category= std::input_iterator_tag;
+    using value_type= Row;
+    using difference_type= std::ptrdiff_t;
+
+    iterator() noexcept= default;
+    explicit iterator(typed_result *res) : result_(res) { ++*this; }
+
+    const Row &operator*() const noexcept { return *row_; }
+    const Row *operator->() const noexcept { return &*row_; }
+    iterator &operator++()
+    {
+      row_= result_->next().get();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const noexcept { return !row_; }
+
+  private:
+    typed_result *result_= nullptr;
+    std::optional<Row> row_;
+  };
+
+  iterator begin() { return iterator(this); }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  result *result_;
+  row_decoder<Row> decoder_;
+};
+
+class connection
+{
+public:
+  /* operations suspend on sched if it is not nullptr */
+  explicit connection(scheduler *sched= nullptr) : scheduler_(sched)
+  {
+    detail::check(LCC_init_handle(&handle_, LCC_CONNECTION, nullptr), nullptr);
+  }
+  connection(connection &&other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)), scheduler_(other.scheduler_)
+  {}
+  connection &operator=(connection &&other) noexcept
+  {
+    if (this != &other)
+    {
+      close();
+      handle_= std::exchange(other.handle_, nullptr);
+      scheduler_= other.scheduler_;
+    }
+    return *this;
+  }
+  connection(const connection &)= delete;
+  connection &operator=(const connection &)= delete;
+  ~connection() { close(); }
+
+  LCC_HANDLE *handle() const noexcept { return handle_; }
+  scheduler *get_scheduler() const noexcept { return scheduler_; }
+
+  /**
+   * @brief: connects and authenticates
+   *
+   * Only the authentication suspends, the TCP connect blocks.
+   */
+  auto connect(std::string_view host, uint16_t port= 0)
+  {
+    return detail::make_operation(handle_, scheduler_,
+      [host= std::string(host), port](LCC_HANDLE *conn) noexcept {
+        return LCC_connect(conn, host.c_str(), port);
+      },
+      [this](LCC_ERRNO rc) { detail::check(rc, handle_); });
+  }
+
+  /**
+   * @brief: executes a statement in text protocol
+   *
+   * sql must stay valid until the query completed. The result is
+   * empty if the statement didn't return a result set.
+   */
+  auto query(std::string_view sql)
+  {
+    return detail::make_operation(handle_, scheduler_,
+      [this, sql](LCC_HANDLE *conn) noexcept {
+        LCC_ERRNO rc;
+
+        pending_= nullptr;
+        if ((rc= LCC_execute(conn, sql.data(), sql.size())))
+          return rc;
+        /* reads the column definitions */
+        rc= LCC_init_handle(&pending_, LCC_RESULT, conn);
+        return rc == ER_NO_RESULT_AVAILABLE ? (LCC_ERRNO)ER_OK : rc;
+      },
+      [this](LCC_ERRNO rc) {
+        detail::check(rc, handle_);
+        return result(std::exchange(pending_, nullptr), handle_, scheduler_);
+      });
+  }
+
+  /* affected rows of the last statement */
+  uint64_t affected_rows() const noexcept
+  {
+    uint64_t rows= 0;
+
+    LCC_get_info(handle_, SERVER_INFO_AFFECTED_ROWS, &rows);
+    return rows;
+  }
+
+  uint64_t last_insert_id() const noexcept
+  {
+    uint64_t id= 0;
+
+    LCC_get_info(handle_, SERVER_INFO_LAST_INSERT_ID, &id);
+    return id;
+  }
+
+  void close() noexcept
+  {
+    if (handle_)
+      LCC_close_handle(std::exchange(handle_, nullptr));
+  }
+
+private:
+  LCC_HANDLE *handle_= nullptr;
+  scheduler *scheduler_= nullptr;
+  LCC_HANDLE *pending_= nullptr;
+};
+
+/**
+ * @brief: encoder of a parameter of type T
+ *
+ * type and flags are sent as parameter type, size is the size of a
+ * value if it is fixed, otherwise length() returns the max. size of
+ * a value. store() encodes a value which isn't null() and returns
+ * the position after it. Specialize param<T> to encode other types.
+ */
+template <typename T> struct param;
+
+template <typename T>
+  requires std::integral<T> && (!std::same_as<T, bool>)
+struct param<T>
+{
+  static constexpr uint8_t type= sizeof(T) == 1 ? LCC_COLTYPE_INT8 :
+                                 sizeof(T) == 2 ? LCC_COLTYPE_INT16 :
+                                 sizeof(T) == 4 ? LCC_COLTYPE_INT32 : LCC_COLTYPE_INT64;
+  static constexpr uint8_t flags= std::is_unsigned_v<T> ? 128 : 0;
+  static constexpr size_t size= sizeof(T);
+
+  static constexpr bool null(const T &) noexcept { return false; }
+  static constexpr size_t length(const T &) noexcept { return 0; }
+  static uint8_t *store(uint8_t *pos, const T &value) noexcept
+  {
+    memcpy(pos, &value, sizeof(T));
+    return pos + sizeof(T);
+  }
+};
+
+template <>
+struct param<bool> : param<uint8_t>
+{
+  static uint8_t *store(uint8_t *pos, bool value) noexcept
+  {
+    *pos= value;
+    return pos + 1;
+  }
+};
+
+template <std::floating_point T>
+  requires (sizeof(T) == 4 || sizeof(T) == 8)
+struct param<T>
+{
+  static constexpr uint8_t type= sizeof(T) == 4 ? LCC_COLTYPE_FLOAT : LCC_COLTYPE_DOUBLE;
+  static constexpr uint8_t flags= 0;
+  static constexpr size_t size= sizeof(T);
+
+  static constexpr bool null(const T &) noexcept { return false; }
+  static constexpr size_t length(const T &) noexcept { return 0; }
+  static uint8_t *store(uint8_t *pos, const T &value) noexcept
+  {
+    memcpy(pos, &value, sizeof(T));
+    return pos + sizeof(T);
+  }
+};
+
+template <>
+struct param<std::string_view>
+{
+  static constexpr uint8_t type= LCC_COLTYPE_STR;
+  static constexpr uint8_t flags= 0;
+  static constexpr size_t size= 0;
+
+  static constexpr bool null(std::string_view) noexcept { return false; }
+  /* length encoded size and data */
+  static constexpr size_t length(std::string_view value) noexcept { return 9 + value.size(); }
+  static uint8_t *store(uint8_t *pos, std::string_view value) noexcept
+  {
+    uint64_t len= value.size();
+
+    if (len < 251)
+      *pos++= (uint8_t)len;
+    else
+    {
+      size_t bytes= len < 0x10000 ? 2 : len < 0x1000000 ? 3 : 8;
+
+      *pos++= bytes == 2 ? 0xFC : bytes == 3 ? 0xFD : 0xFE;
+      memcpy(pos, &len, bytes);
+      pos+= bytes;
+    }
+    memcpy(pos, value.data(), value.size());
+    return pos + value.size();
+  }
+};
+
+template <> struct param<std::string> : param<std::string_view> {};
+template <> struct param<const char *> : param<std::string_view> {};
+template <> struct param<char *> : param<std::string_view> {};
+template <size_t N> struct param<char[N]> : param<std::string_view> {};
+
+template <typename T>
+  requires std::same_as<T, std::nullptr_t> || std::same_as<T, std::nullopt_t>
+struct param<T>
+{
+  static constexpr uint8_t type= LCC_COLTYPE_NULL;
+  static constexpr uint8_t flags= 0;
+  static constexpr size_t size= 0;
+
+  static constexpr bool null(T) noexcept { return true; }
+  static constexpr size_t length(T) noexcept { return 0; }
+  static uint8_t *store(uint8_t *pos, T) noexcept { return pos; }
+};
+
+/* std::nullopt is sent as NULL with the type of T */
+template <typename T>
+struct param<std::optional<T>>
+{
+  static constexpr uint8_t type= param<T>::type;
+  static constexpr uint8_t flags= param<T>::flags;
+  static constexpr size_t size= param<T>::size;
+
+  static constexpr bool null(const std::optional<T> &value) noexcept { return !value; }
+  static constexpr size_t length(const std::optional<T> &value) noexcept
+  {
+    return value ? param<T>::length(*value) : 0;
+  }
+  static uint8_t *store(uint8_t *pos, const std::optional<T> &value) noexcept
+  {
+    return param<T>::store(pos, *value);
+  }
+};
+
+namespace detail {
+
+template <typename T>
+concept parameter= requires { param<std::remove_cvref_t<T>>::type; };
+
+/**
+ * @brief: encodes the parameters of an execute packet
+ *
+ * The null bitmap, types and fixed sizes are constants, only values of
+ * variable length are measured before they are stored.
+ */
+template <typename... Args>
+LCC_ERRNO encode_params(LCC_HANDLE *stmt, const Args &...args) noexcept
+{
+  constexpr uint32_t count= sizeof...(Args);
+  constexpr size_t null_size= (count + 7) / 8;
+  /* null bitmap, send types flag, types and fixed values */
+  constexpr size_t fixed_size= null_size + 1 + 2 * count + (param<Args>::size + ... + 0);
+  static constexpr auto types= [] {
+    std::array<uint8_t, 2 * count> t{};
+    size_t i= 0;
+
+    ((t[i++]= param<Args>::type, t[i++]= param<Args>::flags), ...);
+    return t;
+  }();
+  uint8_t *start, *pos, *null_bits;
+  uint32_t i= 0;
+  LCC_ERRNO rc;
+
+  if ((rc= LCC_stmt_reserve_exec_buffer(stmt, count,
+                                        fixed_size + (param<Args>::length(args) + ... + 0),
+                                        &start)))
+    return rc;
+
+  null_bits= start;
+  memset(null_bits, 0, null_size);
+  pos= start + null_size;
+  *pos++= 1;
+  memcpy(pos, types.data(), types.size());
+  pos+= types.size();
+  ((param<Args>::null(args) ? (void)(null_bits[i / 8]|= (uint8_t)(1 << (i & 7)))
+                            : (void)(pos= param<Args>::store(pos, args)), i++), ...);
+  return LCC_stmt_set_exec_length(stmt, pos - start);
+}
+
+} // namespace detail
+
+/* prepared statement of a connection */
+class statement
+{
+public:
+  explicit statement(connection &conn)
+    : connection_(conn.handle()), scheduler_(conn.get_scheduler())
+  {
+    detail::check(LCC_init_handle(&handle_, LCC_STATEMENT, connection_), connection_);
+  }
+  statement(statement &&other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)),
+      connection_(other.connection_), scheduler_(other.scheduler_)
+  {}
+  statement &operator=(statement &&other) noexcept
+  {
+    if (this != &other)
+    {
+      close();
+      handle_= std::exchange(other.handle_, nullptr);
+      connection_= other.connection_;
+      scheduler_= other.scheduler_;
+    }
+    return *this;
+  }
+  statement(const statement &)= delete;
+  statement &operator=(const statement &)= delete;
+  ~statement() { close(); }
+
+  LCC_HANDLE *handle() const noexcept { return handle_; }
+
+  /* sql must stay valid until the statement was prepared */
+  auto prepare(std::string_view sql)
+  {
+    return detail::make_operation(connection_, scheduler_,
+      [this, sql](LCC_HANDLE *) noexcept {
+        LCC_ERRNO rc;
+
+        if ((rc= LCC_statement_prepare(handle_, sql.data(), sql.size())))
+          return rc;
+        return LCC_statement_read_prepare_response(handle_);
+      },
+      [this](LCC_ERRNO rc) { detail::check(rc, handle_, connection_); });
+  }
+
+  /**
+   * @brief: executes the statement
+   *
+   * @param: params - one bind per parameter, must stay valid until the
+   *                  statement was executed
+   *
+   * The result is empty if the statement didn't return a result set.
+   */
+  auto execute(LCC_BIND *params= nullptr)
+  {
+    return detail::make_operation(connection_, scheduler_,
+      [this, params](LCC_HANDLE *) noexcept {
+        LCC_ERRNO rc;
+
+        pending_= nullptr;
+        if ((params && (rc= LCC_stmt_set_param(handle_, params))) ||
+            (rc= LCC_stmt_fill_exec_buffer(handle_)))
+          return rc;
+        return send();
+      },
+      [this](LCC_ERRNO rc) { return finish(rc); });
+  }
+
+  /**
+   * @brief: executes the statement with typed parameters
+   *
+   * The arguments are encoded immediately, they don't need to stay
+   * valid until the statement was executed. Throws lcc::error when
+   * awaited if the number of arguments doesn't match the statement.
+   */
+  template <typename... Args>
+    requires (sizeof...(Args) > 0) && (detail::parameter<Args> && ...)
+  auto execute(const Args &...args)
+  {
+    LCC_ERRNO encoded= detail::encode_params(handle_, args...);
+
+    return detail::make_operation(connection_, scheduler_,
+      [this, encoded](LCC_HANDLE *) noexcept {
+        pending_= nullptr;
+        return encoded ? encoded : send();
+      },
+      [this](LCC_ERRNO rc) { return finish(rc); });
+  }
+
+  void close() noexcept
+  {
+    if (handle_)
+      LCC_close_handle(std::exchange(handle_, nullptr));
+  }
+
+private:
+  /* sends the execute buffer and reads the response */
+  LCC_ERRNO send() noexcept
+  {
+    LCC_ERRNO rc;
+
+    if ((rc= LCC_stmt_execute(handle_)) ||
+        (rc= LCC_stmt_read_execute_response(handle_)))
+      return rc;
+    rc= LCC_init_handle(&pending_, LCC_RESULT, handle_);
+    return rc == ER_NO_RESULT_AVAILABLE ? (LCC_ERRNO)ER_OK : rc;
+  }
+
+  result finish(LCC_ERRNO rc)
+  {
+    detail::check(rc, handle_, connection_);
+    return result(std::exchange(pending_, nullptr), connection_, scheduler_);
+  }
+
+  LCC_HANDLE *handle_= nullptr;
+  LCC_HANDLE *connection_= nullptr;
+  scheduler *scheduler_= nullptr;
+  LCC_HANDLE *pending_= nullptr;
+};
+
+} // namespace lcc
@@ -53,4 +53,23 @@ lcc_set_error(LCC_ERROR *error,
 #define ER_NO_RESULT_AVAILABLE              2017
 #define ER_STMT_WITHOUT_PARAMETERS          2018
 #define ER_STMT_NOT_READY                   2019
+#define ER_CONNECT                          2020
+#define ER_NOT_READ_ONLY                    2021
+#define ER_CIRCUIT_OPEN                     2022
+#define ER_CONCURRENCY_LIMIT                2023
+#define ER_SESSION_BUSY                     2024
+#define ER_POOL_EMPTY                       2025
+#define ER_GROUP_COMMIT_ABORTED             2026
+#define ER_DEADLINE_EXCEEDED                2027
+#define ER_SHARD_RESULT_MISMATCH            2028
+#define ER_LOCAL_INFILE                     2029
+#define ER_LOOP_STOPPED                     2030
+#define ER_ASYNC_PENDING                    2031
+#define ER_ROW_TYPE_MISMATCH                2032
+#define ER_COLUMN_TYPE_MISMATCH             2033
+#define ER_COLUMN_CONVERSION                2034
+#define ER_PARAM_COUNT_MISMATCH             2035
+#define ER_NUMA_NODE                        2036
+#define ER_MERGE_KEY_COLLATION              2037
+#define ER_NUMA_NODE_BUSY                   2038
 
@@ -3,6 +3,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <ucontext.h>
 #include <lcc_error.h>
 /* Helper macros */
 
@@ -21,6 +24,7 @@
 #define SQLSTATE_LEN 5
 #define SCRAMBLE_LEN 20
 
+#define LCC_CACHE_LINE 64
 #define MIN_COM_BUFFER_SIZE 0x1000
 #define COMM_CACHE_BUFFER_SIZE 16384
 #define LCC_MEM_ALIGN_SIZE 2 * sizeof(void *)
@@ -69,9 +73,23 @@ typedef enum
 typedef enum {
   CONN_STATUS_READY=0,
   CONN_STATUS_RESULT,
-  CONN_STATUS_FETCH
+  CONN_STATUS_FETCH   /* result set header was read, column definitions not yet */
 } lcc_conn_status;
 
+typedef enum {
+  CMD_RESULT_OK= 0,
+  CMD_RESULT_SERVER_ERROR,     /* error of a healthy server, e.g. syntax error */
+  CMD_RESULT_SERVER_OVERLOAD,  /* server is overloaded or unavailable */
+  CMD_RESULT_COMM_ERROR,
+  CMD_RESULT_CANCELED
+} lcc_cmd_result;
+
+/* number of response times kept per connection */
+#define LCC_LATENCY_SAMPLES 64
+
+/* default number of statements in the execution history of a connection */
+#define LCC_HISTORY_SIZE 64
+
 extern char** lcc_configuration_dirs;
 
 typedef struct st_memory_block {
@@ -84,6 +102,7 @@ typedef struct st_memory_block {
 typedef struct {
   size_t prealloc_size;
   uint8_t in_use;
+  int32_t node;               /* NUMA node of blocks, -1 = any */
   lcc_mem_block *block;
 } lcc_mem;
 
@@ -98,6 +117,12 @@ typedef struct {
   uint32_t status_flags;
   void (*report_progress)(LCC_HANDLE *handle, uint8_t stage, uint8_t max_stage,
                          double progress, char *info, size_t length);
+  /* data source of LOAD DATA LOCAL INFILE */
+  LCC_INFILE_CALLBACK local_infile;
+  void *local_infile_data;
+  /* replaces poll() when waiting for the socket */
+  LCC_WAIT_CALLBACK wait;
+  void *wait_data;
 } lcc_callbacks;
 
 /**
@@ -127,6 +152,7 @@ typedef struct {
   uint32_t server_version;
   uint32_t field_count;
   char *current_db;
+  char *charset;              /* character_set_client, NULL = utf8mb4 */
   char *info;
   uint16_t port;
   char *user;
@@ -135,8 +161,9 @@ typedef struct {
   uint8_t is_mariadb;
   uint32_t capabilities;
   uint32_t mariadb_capabilities;
-  LCC_LIST *session_state;
+  LCC_LIST *session_state;    /* all results of the last command */
   LCC_LIST *current_session_state;
+  uint8_t session_state_changed;  /* by any result of the last command */
 } lcc_server;
 
 typedef struct {
@@ -184,8 +211,14 @@ typedef struct {
   char *user;
   char *password;
   uint8_t tls_verify_peer;
-  int read_timeout;
+  int read_timeout;    /* ms, 0 = infinite */
   int write_timeout;
+  uint32_t deadline;   /* time limit of a command in ms, 0 = none */
+  char *local_infile_dir;  /* files which can be sent by LOAD DATA LOCAL INFILE */
+  uint8_t hedge_reads;  /* read-only statements may be sent to several replicas */
+  uint8_t hedge_percentile;
+  uint32_t hedge_min_delay;
+  size_t async_stack_size;  /* 0 = default */
   lcc_connect_attr *conn_attr;
   lcc_callbacks callbacks;
 } lcc_configuration;
@@ -202,9 +235,98 @@ typedef struct {
 } lcc_io;
 
 typedef struct {
+  uint64_t cmd_start;      /* time (usec) the pending command was sent, 0 if none */
+  uint32_t samples[LCC_LATENCY_SAMPLES]; /* recent response times in usec */
+  uint32_t sample_count;
+  uint32_t sample_pos;
+} lcc_latency;
+
+/* result set sizes of a statement, averages of the last executions */
+typedef struct {
+  uint64_t key;               /* hash of statement, 0 = unused */
+  uint32_t executions;
+  uint64_t rows;
+  uint64_t bytes;             /* size of row packets */
+  uint32_t max_packet;        /* largest row */
+} lcc_history_entry;
+
+typedef struct {
+  lcc_history_entry *entries; /* allocated by first result set */
+  uint32_t size;              /* power of 2, 0 = disabled */
+  uint32_t read_ahead_rows;   /* start read-ahead for larger results, 0 = never */
+  uint64_t key;               /* statement of pending command, 0 = none */
+  uint64_t rows;              /* current result set */
+  uint64_t bytes;
+  uint32_t max_packet;
+} lcc_history;
+
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  pthread_mutex_t lock;
+  /* concurrency limiter */
+  double limit;             /* current limit of in-flight commands */
+  uint32_t min_limit;
+  uint32_t max_limit;
+  uint32_t in_flight;
+  double short_rtt;         /* response times in usec */
+  double long_rtt;
+  /* circuit breaker */
+  LCC_CIRCUIT_STATE circuit;
+  uint8_t probe;            /* half open: a test command is running */
+  uint32_t error_threshold; /* error rate in percent */
+  uint32_t min_requests;    /* minimum number of commands per window */
+  uint32_t window;          /* in ms */
+  uint32_t open_time;       /* in ms */
+  uint32_t requests;
+  uint32_t errors;
+  uint64_t window_start;
+  uint64_t open_until;
+  LCC_LIST *connections;
+} lcc_backend;
+
+/* hierarchical timer wheel: LCC_WHEEL_LEVELS levels with
+   2^LCC_WHEEL_BITS slots each */
+#define LCC_WHEEL_BITS 6
+#define LCC_WHEEL_SLOTS (1 << LCC_WHEEL_BITS)
+#define LCC_WHEEL_LEVELS 4
+
+typedef struct st_lcc_timer {
+  uint64_t expires;           /* tick */
+  void (*callback)(struct st_lcc_timer *timer);
+  void *data;
+  struct st_lcc_timer *next;
+  struct st_lcc_timer **prev; /* pointer to previous next pointer */
+} lcc_timer;
+
+typedef struct {
+  uint64_t start;             /* usec of tick 0 */
+  uint32_t resolution;        /* usec per tick */
+  uint64_t now;               /* current tick */
+  uint32_t count;             /* number of pending timers */
+  lcc_timer *slots[LCC_WHEEL_LEVELS][LCC_WHEEL_SLOTS];
+} lcc_timer_wheel;
+
+/* bounded single-producer single-consumer ring: the producer fills
+   slot head % size, the consumer reads slot tail % size */
+typedef struct {
+  uint32_t size;
+  uint32_t head;
+  uint32_t tail __attribute__((aligned(LCC_CACHE_LINE)));
+} lcc_spsc_ring;
+
+typedef enum {
+  POOL_CONN_IDLE= 0,
+  POOL_CONN_ACTIVE,           /* checked out */
+  POOL_CONN_MAINTENANCE       /* ping, reset or close in progress */
+} lcc_pool_conn_state;
+
+typedef struct st_lcc_connection {
   LCC_HANDLE_TYPE type;
   int socket;
+  uint8_t socket_owner; /* socket was opened by LCC_connect() */
   lcc_conn_status status;
+  uint8_t abandoned;  /* response of last command will be discarded */
+  uint8_t broken;     /* stream is out of sync, socket was shut down */
   LCC_ERROR error;
   lcc_server server;
   lcc_client client;
@@ -212,10 +334,135 @@ typedef struct {
   lcc_client_options options;
   lcc_configuration configuration;
   lcc_io io;
+  lcc_latency latency;
+  lcc_history history;
+  lcc_backend *backend;
+  uint8_t backend_slot; /* connection holds an in-flight slot of backend */
+  struct st_lcc_pool *pool;
+  struct st_lcc_pool *kill_pool;  /* for killing statements after deadline */
+  uint64_t deadline;    /* usec, 0 = none */
+  uint8_t killed;       /* statement was killed after deadline */
+  uint8_t sched_class;  /* priority class of checkout */
+  lcc_pool_conn_state pool_state;
+  uint8_t reset_pending;  /* session state needs to be reset */
+  uint64_t pool_added;  /* usec */
+  uint64_t idle_since;
+  uint64_t last_ping;
+  lcc_timer timer;      /* maintenance of idle connection */
+  struct st_lcc_loop_conn *loop;  /* event loop which drives the connection */
+  struct st_lcc_async *async;     /* state of LCC_async_start() operation */
+  struct st_lcc_connection *next_idle;
+  struct st_lcc_connection *prev_idle;
   uint32_t column_count;
+  int32_t numa_node;  /* node of buffers and threads, -1 = any */
+  int wakeup_fd;      /* a blocked read of a helper thread returns if
+                         readable, -1 = none */
   LCC_LIST *handles;  /* list of handles which depend on connection */
 } lcc_connection;
 
+/* number of priority classes of pool scheduler */
+#define LCC_SCHED_CLASSES 8
+
+/* a caller waiting for a connection */
+typedef struct st_lcc_sched_waiter {
+  pthread_cond_t cond;
+  lcc_connection *conn;       /* assigned connection */
+  uint64_t finish;            /* virtual finish time */
+  struct st_lcc_sched_waiter *next;
+} lcc_sched_waiter;
+
+typedef struct {
+  uint32_t weight;
+  uint32_t max_active;        /* 0: unlimited */
+  uint32_t active;            /* checked out connections */
+  uint32_t waiting;
+  uint64_t last_finish;       /* virtual finish time of last request */
+  lcc_sched_waiter *head;
+  lcc_sched_waiter *tail;
+  /* statistics (usec) */
+  uint64_t requests;
+  uint64_t queue_time;
+  uint64_t commands;
+  uint64_t server_time;
+} lcc_sched_class;
+
+typedef struct st_lcc_pool {
+  LCC_HANDLE_TYPE type;
+  pthread_mutex_t lock;
+  LCC_LIST *connections;      /* all physical connections */
+  lcc_connection *idle;       /* idle connections, most recently used first */
+  uint32_t size;
+  uint32_t idle_count;
+  uint64_t virtual_time;
+  lcc_sched_class classes[LCC_SCHED_CLASSES];
+  /* maintenance of idle connections (usec, 0 = disabled) */
+  uint64_t ping_interval;
+  uint64_t idle_timeout;
+  uint64_t max_lifetime;
+  lcc_timer_wheel wheel;
+  lcc_connection *due;        /* connections which need maintenance */
+  pthread_t maintenance_thread;
+  pthread_cond_t maintenance_cond;
+  uint8_t maintenance_running;
+  int32_t numa_node;          /* node of added connections, -1 = any */
+} lcc_pool;
+
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  lcc_pool *pool;
+  lcc_connection *conn;       /* attached physical connection */
+  uint8_t pinned;             /* connection carries session state */
+  char *current_db;
+} lcc_session;
+
+/* a statement waiting for group commit */
+typedef struct st_lcc_group_commit_entry {
+  const char *statement;
+  size_t length;
+  uint64_t enqueued;          /* usec */
+  uint64_t affected_rows;
+  uint64_t last_insert_id;
+  LCC_ERRNO rc;
+  LCC_ERROR error;
+  uint8_t done;
+  struct st_lcc_group_commit_entry *next;
+} lcc_group_commit_entry;
+
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  lcc_connection *conn;
+  lcc_group_commit_entry *head;   /* queued statements */
+  lcc_group_commit_entry *tail;
+  uint32_t queued;
+  uint8_t leader;             /* a batch is being collected or executed */
+  uint32_t max_count;         /* maximum number of statements per batch */
+  uint32_t window;            /* maximum wait time in usec */
+  uint64_t batches;
+  uint64_t statements;
+} lcc_group_commit;
+
+/* shards of consistent hash routing */
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  pthread_rwlock_t lock;
+  LCC_HANDLE **shards;
+  uint32_t count;
+  uint32_t size;              /* allocated entries */
+} lcc_router;
+
+/* result set which was read completely, it might be shared
+   (read-only) by several result handles */
+typedef struct {
+  uint32_t refcount;
+  lcc_mem memory;
+  LCC_COLUMN *columns;
+  uint32_t column_count;
+  LCC_STRING *rows;           /* row_count * column_count values */
+  uint64_t row_count;
+} lcc_stored_result;
+
 typedef struct {
   LCC_HANDLE_TYPE type;
   /* internal */
@@ -224,8 +471,338 @@ typedef struct {
   LCC_COLUMN  *columns;
   LCC_STRING  *data;
   uint64_t    row_count;
+  lcc_stored_result *stored;  /* NULL if rows are read from connection */
+  uint64_t    current_row;
+  struct st_lcc_read_ahead *read_ahead;  /* rows are read by a helper thread */
+  uint8_t     binary;         /* rows of a prepared statement */
+  uint64_t    expected_rows;  /* from execution history, 0 = unknown */
 } lcc_result;
 
+/* rows which were read ahead, the values are copied into memory */
+typedef struct {
+  lcc_mem memory;
+  LCC_STRING *values;         /* rows * column_count */
+  uint32_t rows;
+  uint8_t last;               /* end of result set or error */
+  LCC_ERRNO rc;
+} lcc_read_ahead_batch;
+
+typedef struct st_lcc_read_ahead {
+  lcc_spsc_ring ring;         /* filled batches */
+  lcc_read_ahead_batch *batches;
+  uint32_t batch_rows;
+  lcc_result reader;          /* used by helper thread only */
+  pthread_t thread;
+  pthread_mutex_t lock;       /* wakeup of a waiting thread */
+  pthread_cond_t cond;
+  uint8_t producer_waiting;
+  uint8_t consumer_waiting;
+  uint8_t stop;
+  int wakeup_fd;              /* eventfd, interrupts a blocked read */
+  lcc_read_ahead_batch *current;  /* batch which is read by the consumer */
+  uint32_t pos;
+} lcc_read_ahead;
+
+/* part of a result set which is processed in parallel: rows are parsed
+   in place and the block is released by the last batch using it */
+typedef struct st_lcc_process_block {
+  uint32_t refcount;
+  size_t size;
+  char data[];
+} lcc_process_block;
+
+typedef struct {
+  uint64_t nr;
+  lcc_process_block **blocks; /* blocks with rows of the batch, each
+                                 holds a reference of the batch */
+  uint32_t block_count;
+  uint32_t block_size;        /* allocated entries of blocks */
+  uint32_t rows;
+  LCC_STRING *values;         /* rows * column_count, views into the blocks */
+  void *output;
+  uint8_t done;
+} lcc_process_batch;
+
+/* batches of a worker, the reader appends and workers take the oldest */
+typedef struct {
+  pthread_mutex_t lock;
+  lcc_process_batch **batches;
+  uint32_t head;
+  uint32_t count;
+} __attribute__((aligned(LCC_CACHE_LINE))) lcc_process_deque;
+
+typedef struct {
+  lcc_result *result;
+  LCC_BATCH_CALLBACK process;
+  LCC_ORDERED_CALLBACK ordered;
+  void *data;
+  uint32_t column_count;
+  uint32_t batch_rows;
+  uint32_t threads;
+  pthread_t *workers;
+  lcc_process_deque *deques;  /* one per worker */
+  uint32_t window;            /* batches in flight, slot is nr % window */
+  lcc_process_batch *batches;
+  uint32_t queued;            /* batches in deques */
+  pthread_mutex_t lock;
+  pthread_cond_t work;        /* a batch was queued or reading finished */
+  pthread_cond_t space;       /* a batch was retired */
+  uint32_t in_flight;
+  uint64_t dispatched;
+  uint64_t retired;           /* batches are retired in order */
+  uint8_t retiring;
+  uint8_t finished;
+  uint8_t failed;
+  LCC_ERRNO rc;               /* first error of a callback */
+  lcc_process_block *block;   /* block which is read by the reader */
+  char *read_pos;
+  char *read_end;
+} lcc_process;
+
+/* number of hash slots for in-flight statements */
+#define LCC_FLIGHT_SLOTS 64
+
+/* a statement which is executed on behalf of several callers */
+typedef struct st_lcc_flight {
+  char *statement;
+  size_t length;
+  char *user;                 /* session context of the statement */
+  char *current_db;
+  char *charset;
+  uint64_t hash;
+  uint32_t refcount;          /* leader and waiting callers */
+  uint8_t done;
+  LCC_ERRNO rc;
+  LCC_ERROR error;
+  lcc_stored_result *result;
+  struct st_lcc_flight *next;
+} lcc_flight;
+
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  lcc_flight *flights[LCC_FLIGHT_SLOTS];
+  uint64_t executed;
+  uint64_t coalesced;
+} lcc_single_flight;
+
+/* result stream of one shard */
+typedef struct {
+  lcc_result result;
+  uint32_t column_count;
+  uint8_t state;              /* LCC_SHARD_xxx */
+} lcc_scatter_shard;
+
+/* merged result of a statement which was sent to several shards */
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  LCC_ERROR error;
+  lcc_scatter_shard *shards;
+  uint32_t shard_count;
+  uint32_t *heap;             /* shards with a current row, ordered by keys */
+  uint32_t heap_size;
+  LCC_MERGE_KEY *keys;        /* NULL: results are concatenated */
+  uint32_t key_count;
+  uint64_t limit;             /* 0 = unlimited */
+  uint64_t row_count;
+  uint32_t current;           /* shard of current row */
+  uint8_t advance;            /* current shard needs to read its next row */
+  LCC_STRING *data;
+} lcc_scatter;
+
+#define LCC_BINLOG_BLOCK_SIZE 0x100000
+#define LCC_BINLOG_SLOTS 4096
+#define LCC_BINLOG_TABLE_SLOTS 64
+
+/* part of the binlog stream, events are decoded in place and the
+   block is released when the last event was consumed */
+typedef struct {
+  uint32_t refcount;
+  size_t size;
+  char data[];
+} lcc_binlog_block;
+
+typedef struct st_lcc_binlog_table {
+  uint32_t refcount;
+  LCC_BINLOG_TABLE table;
+  struct st_lcc_binlog_table *next;
+} lcc_binlog_table;
+
+/* event in the queue between reader, decoders and consumer */
+typedef struct {
+  lcc_binlog_block *block;
+  char *data;                 /* event header */
+  size_t length;              /* without checksum */
+  lcc_binlog_table *table;
+  uint8_t decoded;
+  LCC_ERRNO rc;
+  LCC_BINLOG_EVENT event;
+  LCC_BINLOG_ROW *rows;       /* decoded rows, reused by later events */
+  uint32_t rows_size;
+  LCC_BINLOG_VALUE *values;
+  size_t values_size;
+} lcc_binlog_slot;
+
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  LCC_ERROR error;
+  lcc_connection *conn;
+  uint32_t worker_count;
+  uint32_t slot_count;
+  uint8_t semi_sync;
+  uint32_t heartbeat;         /* ms */
+  pthread_t reader;
+  pthread_t *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t readable;    /* next event was decoded or stream ended */
+  pthread_cond_t decodable;   /* event was queued */
+  pthread_cond_t writable;    /* slot was released */
+  lcc_binlog_slot *slots;
+  uint64_t written;           /* events queued by the reader */
+  uint64_t dispatched;        /* events taken by decoders */
+  uint64_t consumed;          /* events released by the consumer */
+  uint8_t pending;            /* consumer holds event consumed */
+  uint8_t started;
+  uint8_t stop;
+  uint8_t done;               /* reader finished */
+  LCC_ERRNO rc;               /* error of reader */
+  /* reader */
+  lcc_binlog_block *block;
+  char *read_pos;
+  char *read_end;
+  lcc_binlog_table *tables[LCC_BINLOG_TABLE_SLOTS];
+  uint8_t checksum;
+  uint8_t post_header[256];   /* post header length by event type */
+  char filename[512];
+  uint64_t position;
+} lcc_binlog;
+
+typedef enum {
+  LCC_LOOP_EXECUTE= 0,
+  LCC_LOOP_POST,
+  LCC_LOOP_REMOVE
+} lcc_loop_task_type;
+
+/* command or function submitted to an event loop */
+typedef struct st_lcc_loop_task {
+  struct st_lcc_loop_task *next;
+  lcc_loop_task_type type;
+  lcc_connection *conn;
+  LCC_LOOP_CALLBACK callback;
+  void *data;
+  size_t length;              /* length of packet */
+  char packet[];              /* command packet(s) */
+} lcc_loop_task;
+
+typedef enum {
+  LCC_LOOP_IDLE= 0,
+  LCC_LOOP_WRITING,
+  LCC_LOOP_READING
+} lcc_loop_conn_state;
+
+/* state of a connection driven by an event loop, owned by the
+   loop thread */
+typedef struct st_lcc_loop_conn {
+  struct st_lcc_loop_shard *shard;
+  lcc_connection *conn;
+  lcc_loop_task *head;        /* active command */
+  lcc_loop_task *tail;
+  lcc_loop_conn_state state;
+  size_t write_offset;        /* bytes of active command sent */
+  size_t scan_offset;         /* bytes of response scanned (from read_pos) */
+  uint8_t scan_phase;
+  uint64_t scan_columns;      /* column definitions left */
+  uint8_t expired;            /* deadline exceeded, response is discarded */
+  LCC_ERRNO rc;               /* connection is broken */
+  lcc_timer timer;            /* deadline of active command */
+  struct st_lcc_loop_conn *next;
+  struct st_lcc_loop_conn *prev;
+} lcc_loop_conn;
+
+/* one event loop thread and the connections it owns */
+typedef struct st_lcc_loop_shard {
+  struct st_lcc_loop *loop;
+  uint32_t index;
+  int epoll_fd;
+  int event_fd;               /* wakeup for submissions of other threads */
+  pthread_t thread;
+  pthread_mutex_t lock;
+  lcc_loop_task *submitted;   /* submissions of other threads */
+  lcc_loop_task *submitted_tail;
+  uint8_t stop;
+  lcc_loop_task *run_head;    /* run queue, loop thread only */
+  lcc_loop_task *run_tail;
+  lcc_timer_wheel wheel;
+  lcc_loop_conn *conns;       /* protected by lock */
+  uint32_t conn_count;
+} lcc_loop_shard;
+
+typedef struct st_lcc_loop {
+  LCC_HANDLE_TYPE type;
+  LCC_ERROR error;
+  uint32_t shard_count;
+  uint8_t pin;                /* pin loop threads to CPUs */
+  int32_t numa_node;          /* threads and added connections, -1 = any */
+  uint8_t started;
+  lcc_loop_shard *shards;
+} lcc_loop;
+
+/* operation of LCC_async_start(), which runs on its own stack and
+   returns to the caller whenever it would have to wait for the socket */
+typedef struct st_lcc_async {
+  ucontext_t caller;
+  ucontext_t context;
+  char *stack;                /* includes a guard page */
+  size_t stack_size;
+  LCC_ASYNC_FUNC func;
+  void *data;
+  LCC_ERRNO rc;
+  uint8_t active;             /* operation was started and didn't finish */
+  uint8_t running;            /* operation runs on its stack */
+  uint8_t wait_events;        /* LCC_WAIT_xxx */
+  uint8_t ready;              /* events passed to LCC_async_continue() */
+  int32_t timeout;            /* ms, -1 = infinite */
+} lcc_async;
+
+/* intrusive multi-producer single-consumer queue (Vyukov): push is one
+   atomic exchange, pop is done by the consumer thread only */
+typedef struct st_lcc_mpsc_node {
+  struct st_lcc_mpsc_node *next;
+} lcc_mpsc_node;
+
+typedef struct {
+  lcc_mpsc_node *head;        /* most recently pushed node */
+  lcc_mpsc_node *tail __attribute__((aligned(LCC_CACHE_LINE)));  /* next node to pop */
+  lcc_mpsc_node stub;
+} lcc_mpsc_queue;
+
+/* command submitted to a pipeline */
+typedef struct st_lcc_pipeline_task {
+  lcc_mpsc_node node;
+  struct st_lcc_pipeline_task *next;  /* commands in flight */
+  LCC_LOOP_CALLBACK callback;
+  void *data;
+  size_t length;
+  char statement[];
+} lcc_pipeline_task;
+
+typedef struct {
+  LCC_HANDLE_TYPE type;
+  lcc_connection *conn;
+  lcc_mpsc_queue queue;
+  pthread_t thread;           /* owner of the connection */
+  pthread_mutex_t lock;       /* wakeup of the idle owner thread */
+  pthread_cond_t cond;
+  uint8_t sleeping;
+  uint8_t stop;
+  uint8_t running;
+  uint32_t submitting;        /* submitters between stop check and push */
+  uint32_t depth;             /* max. number of commands in flight */
+  uint64_t flushes;
+  uint64_t commands;
+} lcc_pipeline;
+
 typedef struct {
   LCC_HANDLE_TYPE type;
   /* internal */
@@ -244,6 +821,7 @@ typedef struct {
   /* execbuf.len has aligned size, so we need to store the
      exact length for io.write() */
   size_t         exec_len;
+  uint64_t       history_key; /* execution history of statement */
 } lcc_stmt;
 
 typedef struct {
@@ -282,6 +860,53 @@ static inline size_t lcc_align_size(size_t align_size, size_t size) {
   return (size + (align_size - 1)) & ~(align_size - 1);
 }
 
+/* monotonic clock in microseconds */
+static inline uint64_t lcc_now_usec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* FNV-1a hash */
+static inline uint64_t lcc_hash(const char *key, size_t len)
+{
+  uint64_t hash= 0xcbf29ce484222325ULL;
+  size_t i;
+
+  for (i=0; i < len; i++)
+  {
+    hash^= (uint8_t)key[i];
+    hash*= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/* classifies a server error: only errors which indicate an overloaded
+   or unavailable server count as failures of a backend */
+static inline lcc_cmd_result lcc_server_error_result(uint16_t error_no)
+{
+  switch (error_no) {
+  case 1037:  /* ER_OUTOFMEMORY */
+  case 1040:  /* ER_CON_COUNT_ERROR */
+  case 1053:  /* ER_SERVER_SHUTDOWN */
+  case 1203:  /* ER_TOO_MANY_USER_CONNECTIONS */
+  case 1205:  /* ER_LOCK_WAIT_TIMEOUT */
+  case 1927:  /* ER_CONNECTION_KILLED */
+  case 1969:  /* ER_STATEMENT_TIMEOUT */
+    return CMD_RESULT_SERVER_OVERLOAD;
+  default:
+    return CMD_RESULT_SERVER_ERROR;
+  }
+}
+
+/* errors >= 2000 and < 3000 are client errors (e.g. communication
+   errors): the connection can't be used for further commands */
+static inline uint8_t lcc_is_client_error(LCC_ERRNO rc)
+{
+  return rc >= 2000 && rc < 3000;
+}
+
 static inline uint8_t lcc_validate_handle(LCC_HANDLE *handle, LCC_HANDLE_TYPE type)
 {
   return (handle && handle->type == type) ? ER_OK : ER_INVALID_HANDLE;
@@ -296,6 +921,8 @@ lcc_auth(lcc_connection *conn,
 
 LCC_ERRNO
 lcc_io_init(lcc_connection *conn);
+LCC_ERRNO
+lcc_io_set_node(lcc_connection *conn, int32_t node);
 
 void
 lcc_io_close(lcc_connection *conn);
@@ -303,6 +930,36 @@ lcc_io_close(lcc_connection *conn);
 LCC_ERRNO
 lcc_io_write(lcc_connection *conn, lcc_io_cmd command, char *buffer, size_t len);
 
+LCC_ERRNO
+lcc_io_queue(lcc_connection *conn, lcc_io_cmd command, char *buffer, size_t len);
+
+LCC_ERRNO
+lcc_io_flush(lcc_connection *conn);
+
+LCC_ERRNO
+lcc_io_realloc(lcc_connection *conn, size_t size);
+
+LCC_ERRNO
+lcc_io_shrink(lcc_connection *conn, size_t size);
+
+LCC_ERRNO
+lcc_io_read_socket(lcc_connection *conn, char *buffer, size_t size, ssize_t *bytes_read);
+
+LCC_ERRNO
+lcc_io_write_socket(lcc_connection *conn, char *buffer, size_t len);
+
+LCC_ERRNO
+lcc_io_send_file(lcc_connection *conn, int fd, size_t length);
+
+int32_t
+lcc_io_timeout(lcc_connection *conn, int timeout);
+
+LCC_ERRNO
+lcc_io_cancel(lcc_connection *conn);
+
+LCC_ERRNO
+lcc_local_infile(lcc_connection *conn, const char *filename, size_t length);
+
 void 
 lcc_io_close(lcc_connection *conn);
 
@@ -324,15 +981,109 @@ lcc_read_server_hello(lcc_connection *conn);
 LCC_ERRNO
 lcc_read_response(lcc_connection *conn);
 
+LCC_ERRNO
+lcc_read_command_error(lcc_connection *conn, char *buffer, size_t buffer_length);
+
 LCC_ERRNO
 lcc_read_result_metadata(lcc_result *result);
 
 LCC_ERRNO
 lcc_result_fetch_one(lcc_result *result, uint8_t *eof);
 
+LCC_ERRNO
+lcc_result_store(lcc_connection *conn, lcc_stored_result **stored);
+
+LCC_ERRNO
+lcc_result_from_stored(lcc_stored_result *stored, LCC_HANDLE **handle);
+
+void
+lcc_stored_result_release(lcc_stored_result *stored);
+
+LCC_ERRNO
+lcc_read_ahead_start(lcc_result *result, uint32_t batch_rows, uint32_t batches);
+
+void
+lcc_read_ahead_stop(lcc_result *result);
+
 LCC_ERRNO
 lcc_read_prepare_response(lcc_stmt *stmt);
 
+LCC_ERRNO
+lcc_skip_result(lcc_connection *conn);
+
+LCC_ERRNO
+lcc_drain_connection(lcc_connection *conn);
+
+void lcc_latency_add(lcc_connection *conn, uint64_t usec);
+uint32_t lcc_latency_percentile(lcc_connection *conn, uint8_t percentile);
+uint8_t lcc_is_read_only(const char *statement, size_t length);
+uint8_t lcc_statement_starts_with(const char *statement, size_t length,
+                                  const char **keywords);
+LCC_ERRNO lcc_conn_cmd_start(lcc_connection *conn);
+void lcc_conn_cmd_done(lcc_connection *conn, lcc_cmd_result result);
+
+LCC_ERRNO lcc_backend_init(lcc_backend *backend);
+void lcc_backend_close(lcc_backend *backend);
+LCC_ERRNO lcc_backend_attach(lcc_backend *backend, lcc_connection *conn);
+void lcc_backend_detach(lcc_connection *conn);
+LCC_ERRNO lcc_backend_acquire(lcc_backend *backend);
+void lcc_backend_release(lcc_backend *backend, lcc_cmd_result result, uint64_t rtt);
+
+LCC_ERRNO lcc_pool_init(lcc_pool *pool);
+void lcc_pool_close(lcc_pool *pool);
+void lcc_pool_detach(lcc_connection *conn);
+void lcc_pool_account(lcc_connection *conn, uint64_t server_time);
+lcc_connection *lcc_pool_borrow(lcc_pool *pool);
+void lcc_pool_set_maintenance(lcc_pool *pool, uint32_t ping_interval,
+                              uint32_t idle_timeout, uint32_t max_lifetime);
+
+void lcc_timer_wheel_init(lcc_timer_wheel *wheel, uint32_t resolution, uint64_t now);
+void lcc_timer_add(lcc_timer_wheel *wheel, lcc_timer *timer, uint64_t expires);
+void lcc_timer_cancel(lcc_timer_wheel *wheel, lcc_timer *timer);
+uint32_t lcc_timer_wheel_advance(lcc_timer_wheel *wheel, uint64_t now);
+uint64_t lcc_timer_wheel_next(lcc_timer_wheel *wheel);
+
+void lcc_mpsc_init(lcc_mpsc_queue *queue);
+void lcc_mpsc_push(lcc_mpsc_queue *queue, lcc_mpsc_node *node);
+lcc_mpsc_node *lcc_mpsc_pop(lcc_mpsc_queue *queue);
+void lcc_spsc_init(lcc_spsc_ring *ring, uint32_t size);
+uint8_t lcc_spsc_full(lcc_spsc_ring *ring);
+void lcc_spsc_publish(lcc_spsc_ring *ring);
+uint8_t lcc_spsc_empty(lcc_spsc_ring *ring);
+void lcc_spsc_release(lcc_spsc_ring *ring);
+void lcc_session_close(lcc_session *session);
+
+LCC_ERRNO lcc_group_commit_init(lcc_group_commit *group, lcc_connection *conn);
+void lcc_group_commit_close(lcc_group_commit *group);
+
+LCC_ERRNO lcc_single_flight_init(lcc_single_flight *group);
+void lcc_single_flight_close(lcc_single_flight *group);
+
+LCC_ERRNO lcc_router_init(lcc_router *router);
+void lcc_router_close(lcc_router *router);
+
+void lcc_scatter_close(lcc_scatter *scatter);
+int lcc_scatter_compare_value(const LCC_COLUMN *column, const LCC_STRING *a, const LCC_STRING *b);
+
+LCC_ERRNO lcc_binlog_init(lcc_binlog *binlog);
+void lcc_binlog_close(lcc_binlog *binlog);
+uint8_t lcc_binlog_value(const LCC_BINLOG_COLUMN *column, u_char **pos, u_char *end,
+                         LCC_BINLOG_VALUE *value);
+
+LCC_ERRNO lcc_loop_init(lcc_loop *loop);
+LCC_ERRNO lcc_loop_set_node(lcc_loop *loop, int32_t node);
+void lcc_loop_close(lcc_loop *loop);
+uint8_t lcc_loop_scan(lcc_loop_conn *lc);
+
+int lcc_async_wait(lcc_connection *conn, uint8_t events, int32_t timeout);
+void lcc_async_close(lcc_connection *conn);
+
+LCC_ERRNO lcc_pipeline_init(lcc_pipeline *pipeline, lcc_connection *conn);
+void lcc_pipeline_stop(lcc_pipeline *pipeline);
+void lcc_pipeline_close(lcc_pipeline *pipeline);
+
+LCC_ERRNO lcc_process_read_packet(lcc_process *process, char **packet, size_t *length);
+
 typedef void (*lcc_delete_callback)(void *);
 typedef uint8_t (*lcc_find_callback)(void *data, void *search);
 
@@ -351,7 +1102,31 @@ void *lcc_mem_alloc(lcc_mem *mem,
                     size_t size);
 LCC_ERRNO
 lcc_mem_init(lcc_mem *mem, size_t prealloc);
+LCC_ERRNO
+lcc_mem_init_node(lcc_mem *mem, size_t prealloc, int32_t node);
 
 void lcc_mem_reset(lcc_mem *mem);
+LCC_ERRNO
+lcc_mem_reserve(lcc_mem *mem, size_t size);
 
 void lcc_stmt_init_bin_types();
+
+void lcc_stmt_close(lcc_stmt *stmt);
+
+uint8_t lcc_numa_valid(int32_t node);
+void *lcc_numa_alloc(int32_t node, size_t size);
+void *lcc_numa_realloc(void *ptr, size_t size);
+void lcc_numa_free(void *ptr);
+void lcc_numa_prefer(int32_t node);
+void lcc_numa_bind_thread(int32_t node);
+#ifdef CPU_SETSIZE
+void lcc_numa_node_cpus(int32_t node, cpu_set_t *cpus);
+#endif
+
+uint64_t lcc_history_key(const char *statement, size_t length, uint8_t binary);
+void lcc_history_begin(lcc_connection *conn, uint64_t key);
+const lcc_history_entry *lcc_history_find(lcc_connection *conn);
+LCC_ERRNO lcc_history_apply(lcc_result *result);
+void lcc_history_end(lcc_connection *conn);
+LCC_ERRNO lcc_history_set(lcc_connection *conn, uint32_t size, uint32_t read_ahead_rows);
+void lcc_history_close(lcc_connection *conn);
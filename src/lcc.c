@@ -17,11 +17,14 @@ uint8_t lcc_initialized= 0;
  * @brief: allocates and initializes a LCC handle
  * @param: handle  A pointer of a LCC_HANDLE * structure
  * @param: type    Type of handle
- * @param: base    For LCC_STATEMENT type the connection object, otherwise NULL.
+ * @param: base    For LCC_STATEMENT type the connection object, for LCC_CONNECTION
+ *                 type an optional backend handle, for LCC_SESSION type the pool,
+ *                 for LCC_GROUP_COMMIT the connection, for LCC_RESULT the
+ *                 connection or the executed statement, otherwise NULL.
  * @return LCC_ERRNO ER_OK on success, in case the initialozation failed an error code.
 */
 LCC_ERRNO API_FUNC
-LCC_init_handle(LCC_HANDLE **handle,  LCC_HANDLE_TYPE type, LCC_HANDLE *connection __attribute__((unused)))
+LCC_init_handle(LCC_HANDLE **handle,  LCC_HANDLE_TYPE type, LCC_HANDLE *connection)
 {
   uint16_t rc;
 
@@ -33,27 +36,188 @@ LCC_init_handle(LCC_HANDLE **handle,  LCC_HANDLE_TYPE type, LCC_HANDLE *connecti
   switch(type) {
     case LCC_CONNECTION:
     {
+      if (connection && lcc_validate_handle(connection, LCC_BACKEND))
+        return ER_INVALID_HANDLE;
       if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_connection))))
         return ER_OUT_OF_MEMORY;
       (*handle)->type= LCC_CONNECTION;
+      ((lcc_connection *)*handle)->numa_node= -1;
+      ((lcc_connection *)*handle)->wakeup_fd= -1;
+      ((lcc_connection *)*handle)->history.size= LCC_HISTORY_SIZE;
       if ((rc= lcc_io_init((lcc_connection *)*handle)))
       {
-        free(handle);
+        free(*handle);
+        return rc;
+      }
+      /* connection belongs to a backend */
+      if (connection &&
+          (rc= lcc_backend_attach((lcc_backend *)connection, (lcc_connection *)*handle)))
+      {
+        lcc_numa_free(((lcc_connection *)*handle)->io.readbuf);
+        lcc_numa_free(((lcc_connection *)*handle)->io.writebuf);
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_BACKEND:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_backend))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_BACKEND;
+      if ((rc= lcc_backend_init((lcc_backend *)*handle)))
+      {
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_POOL:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_pool))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_POOL;
+      if ((rc= lcc_pool_init((lcc_pool *)*handle)))
+      {
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_SESSION:
+    {
+      if (lcc_validate_handle(connection, LCC_POOL))
+        return ER_INVALID_HANDLE;
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_session))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_SESSION;
+      ((lcc_session *)(*handle))->pool= (lcc_pool *)connection;
+      break;
+    }
+    case LCC_GROUP_COMMIT:
+    {
+      if (lcc_validate_handle(connection, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_group_commit))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_GROUP_COMMIT;
+      if ((rc= lcc_group_commit_init((lcc_group_commit *)*handle, (lcc_connection *)connection)) ||
+          (rc= lcc_list_add(&((lcc_connection *)connection)->handles, *handle)))
+      {
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_SINGLE_FLIGHT:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_single_flight))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_SINGLE_FLIGHT;
+      if ((rc= lcc_single_flight_init((lcc_single_flight *)*handle)))
+      {
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_ROUTER:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_router))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_ROUTER;
+      if ((rc= lcc_router_init((lcc_router *)*handle)))
+      {
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_SCATTER:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_scatter))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_SCATTER;
+      lcc_clear_error(&((lcc_scatter *)*handle)->error);
+      break;
+    }
+    case LCC_BINLOG:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_binlog))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_BINLOG;
+      if ((rc= lcc_binlog_init((lcc_binlog *)*handle)))
+      {
+        free(*handle);
+        return rc;
+      }
+      break;
+    }
+    case LCC_LOOP:
+    {
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_loop))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_LOOP;
+      lcc_loop_init((lcc_loop *)*handle);
+      break;
+    }
+    case LCC_PIPELINE:
+    {
+      if (lcc_validate_handle(connection, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_pipeline))))
+        return ER_OUT_OF_MEMORY;
+      (*handle)->type= LCC_PIPELINE;
+      if ((rc= lcc_pipeline_init((lcc_pipeline *)*handle, (lcc_connection *)connection)))
+      {
+        free(*handle);
+        return rc;
+      }
+      if ((rc= lcc_list_add(&((lcc_connection *)connection)->handles, *handle)))
+      {
+        ((lcc_pipeline *)*handle)->conn= NULL;
+        lcc_pipeline_close((lcc_pipeline *)*handle);
+        free(*handle);
         return rc;
       }
       break;
     }
     case LCC_RESULT:
     {
+      uint8_t binary= 0;
+
       if (!connection)
         return ER_INVALID_HANDLE;
+      /* result set of an executed prepared statement */
+      if (connection->type == LCC_STATEMENT)
+      {
+        connection= (LCC_HANDLE *)((lcc_stmt *)connection)->conn;
+        binary= 1;
+      }
       if (!((lcc_connection *)connection)->column_count)
         return ER_NO_RESULT_AVAILABLE;
-      if (!(*handle= (LCC_HANDLE *)calloc(1, sizeof(lcc_result))))
+      if (!(*handle= (LCC_HANDLE *)lcc_numa_alloc(((lcc_connection *)connection)->numa_node,
+                                                  sizeof(lcc_result))))
         return ER_OUT_OF_MEMORY;
       (*handle)->type= LCC_RESULT;
       ((lcc_result *)(*handle))->conn= (lcc_connection *)connection;
+      ((lcc_result *)(*handle))->binary= binary;
+      /* column definitions of a pending result set */
+      if (((lcc_connection *)connection)->status != CONN_STATUS_RESULT &&
+          (rc= lcc_read_result_metadata((lcc_result *)*handle)))
+      {
+        if (((lcc_result *)*handle)->memory.in_use)
+          lcc_mem_close(&((lcc_result *)*handle)->memory);
+        lcc_numa_free(*handle);
+        return rc;
+      }
       lcc_list_add(&((lcc_connection *)connection)->handles, *handle);
+      /* large result sets are read ahead, if this fails the rows are
+         read from the connection */
+      if (((lcc_connection *)connection)->history.read_ahead_rows &&
+          ((lcc_result *)*handle)->expected_rows >=
+          ((lcc_connection *)connection)->history.read_ahead_rows)
+        lcc_read_ahead_start((lcc_result *)*handle, 0, 0);
       break;
     }
     case LCC_STATEMENT:
@@ -64,6 +228,8 @@ LCC_init_handle(LCC_HANDLE **handle,  LCC_HANDLE_TYPE type, LCC_HANDLE *connecti
         return ER_OUT_OF_MEMORY;
       (*handle)->type= LCC_STATEMENT;
       ((lcc_stmt*)(*handle))->conn= (lcc_connection *)connection;
+      /* storage sizes of parameters */
+      lcc_stmt_init_bin_types();
       lcc_list_add(&((lcc_connection *)connection)->handles, *handle);
       break;
     }
@@ -85,6 +251,7 @@ LCC_reset_handle(LCC_HANDLE *handle)
     {
       lcc_result *result= (lcc_result *)handle;
 
+      lcc_read_ahead_stop(result);
       lcc_mem_reset(&result->memory);
       result->row_count= 0;
       result->columns= NULL;
@@ -97,6 +264,25 @@ LCC_reset_handle(LCC_HANDLE *handle)
   return ER_OK;
 }
 
+/* pipelines and read-ahead results use the connection until their
+   threads were stopped */
+static void
+lcc_stop_connection_threads(LCC_HANDLE *handle)
+{
+  if (!handle)
+    return;
+  switch (handle->type) {
+  case LCC_RESULT:
+    lcc_read_ahead_stop((lcc_result *)handle);
+    break;
+  case LCC_PIPELINE:
+    lcc_pipeline_stop((lcc_pipeline *)handle);
+    break;
+  default:
+    break;
+  }
+}
+
 static void
 lcc_invalidate_connection(LCC_HANDLE *handle)
 {
@@ -106,6 +292,20 @@ lcc_invalidate_connection(LCC_HANDLE *handle)
   case LCC_RESULT:
     ((lcc_result *)handle)->conn= NULL;
     break;
+  case LCC_GROUP_COMMIT:
+  {
+    lcc_group_commit *group= (lcc_group_commit *)handle;
+    pthread_mutex_lock(&group->lock);
+    group->conn= NULL;
+    pthread_mutex_unlock(&group->lock);
+    break;
+  }
+  case LCC_PIPELINE:
+    ((lcc_pipeline *)handle)->conn= NULL;
+    break;
+  case LCC_STATEMENT:
+    ((lcc_stmt *)handle)->conn= NULL;
+    break;
   default:
     break;
   }
@@ -119,9 +319,12 @@ lcc_free_connection_mem(lcc_connection *conn)
     return;
 
   lcc_configuration_close(conn);
+  lcc_history_close(conn);
   lcc_list_delete(conn->server.session_state, lcc_clear_session_state);
   free(conn->server.version);
   free(conn->server.info);
+  free(conn->server.current_db);
+  free(conn->server.charset);
 }
 
 /**
@@ -139,8 +342,18 @@ LCC_close_handle(LCC_HANDLE *handle)
     case LCC_CONNECTION:
     {
       lcc_connection *conn= (lcc_connection *)handle;
-      LCC_LIST *list= conn->handles;
+      LCC_LIST *list;
+
+      /* stop threads of handles which use the connection */
+      for (list= conn->handles; list; list= list->next)
+        lcc_stop_connection_threads((LCC_HANDLE *)list->data);
+      list= conn->handles;
+      lcc_pool_detach(conn);
+      lcc_backend_detach(conn);
+      lcc_async_close(conn);
       lcc_io_close(conn);
+      if (conn->socket_owner)
+        destroy_inet_socket(conn->socket);
       lcc_free_connection_mem(conn);
 
       /* notify handles which rely on this connection */
@@ -155,18 +368,83 @@ LCC_close_handle(LCC_HANDLE *handle)
     case LCC_RESULT:
     {
       lcc_result *result = (lcc_result *)handle;
+      lcc_read_ahead_stop(result);
       if (result->memory.in_use)
         lcc_mem_close(&result->memory);
-      lcc_list_clear_element(result->conn->handles, result);
+      if (result->stored)
+        lcc_stored_result_release(result->stored);
+      if (result->conn)
+        lcc_list_clear_element(result->conn->handles, result);
+#ifdef LCC_DEBUG
       printf("free %p\n", result);
-      free(result);
+#endif
+      lcc_numa_free(result);
     }
     break;
     case LCC_STATEMENT:
     {
-      lcc_stmt *stmt= (lcc_stmt *)handle;
-      if (stmt->execbuf.buf)
-        free(stmt->execbuf.buf);
+      lcc_stmt_close((lcc_stmt *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_BACKEND:
+    {
+      lcc_backend_close((lcc_backend *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_POOL:
+    {
+      lcc_pool_close((lcc_pool *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_SESSION:
+    {
+      lcc_session_close((lcc_session *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_GROUP_COMMIT:
+    {
+      lcc_group_commit_close((lcc_group_commit *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_SINGLE_FLIGHT:
+    {
+      lcc_single_flight_close((lcc_single_flight *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_ROUTER:
+    {
+      lcc_router_close((lcc_router *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_SCATTER:
+    {
+      lcc_scatter_close((lcc_scatter *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_BINLOG:
+    {
+      lcc_binlog_close((lcc_binlog *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_LOOP:
+    {
+      lcc_loop_close((lcc_loop *)handle);
+      free(handle);
+    }
+    break;
+    case LCC_PIPELINE:
+    {
+      lcc_pipeline_close((lcc_pipeline *)handle);
+      free(handle);
     }
     break;
     default:
@@ -176,17 +454,68 @@ LCC_close_handle(LCC_HANDLE *handle)
 }
 
 /**
- * @brief:
+ * @brief: connects to a server and authenticates
+ *
+ * @param: handle - connection handle, user and password need to be
+ *                  configured before
+ * @param: host - host name or IP address
+ * @param: port - TCP port or 0 for default port
+ *
+ * The socket will be closed by LCC_close_handle().
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_connect(LCC_HANDLE *handle, const char *host, uint16_t port)
+{
+  lcc_connection *conn= (lcc_connection *)handle;
+  char service[8];
+  int sock;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+  if (!host)
+    return ER_INVALID_POINTER;
+
+  lcc_clear_error(&conn->error);
+  snprintf(service, sizeof(service), "%u", port ? port : LCC_PORT);
+  if ((sock= create_inet_stream_socket(host, service, LIBSOCKET_BOTH, 0)) < 0)
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_CONNECT, "08001", NULL, host, errno);
+
+  conn->socket= sock;
+  conn->socket_owner= 1;
+  if (!conn->configuration.auth_plugin)
+    conn->configuration.auth_plugin= strdup("mysql_native_password");
+
+  if ((rc= lcc_read_server_hello(conn)) ||
+      (rc= lcc_send_client_hello(conn)) ||
+      (rc= lcc_read_response(conn)))
+    return rc;
+  return ER_OK;
+}
+
+/**
+ * @brief: executes a statement in text protocol
  *
+ * @param: handle - connection handle
+ * @param: statement - SQL statement
+ * @param: length - length of statement or LCC_NTS
  *
+ * If the statement returned a result set, the rows can be read by
+ * a result handle (LCC_init_handle(LCC_RESULT)).
  *
+ * @return: ER_OK or error code
  */
 LCC_ERRNO API_FUNC
 LCC_execute(LCC_HANDLE *handle,
             const char *statement,
             size_t length)
 {
-  if (!lcc_validate_handle(handle, LCC_CONNECTION))
+  lcc_connection *conn= (lcc_connection *)handle;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_CONNECTION))
     return ER_INVALID_HANDLE;
 
   if (!statement || !length)
@@ -196,13 +525,12 @@ LCC_execute(LCC_HANDLE *handle,
     length= strlen(statement);
 
   /* Text protocol */
-  if (handle->type == LCC_CONNECTION)
-  {
-    lcc_connection *conn= (lcc_connection *)handle;
-    lcc_clear_error(&conn->error);
-    return lcc_io_write(conn, CMD_QUERY, (char *)statement, length);
-  }
-  return ER_OK;
+  lcc_clear_error(&conn->error);
+  conn->column_count= 0;
+  if ((rc= lcc_io_write(conn, CMD_QUERY, (char *)statement, length)))
+    return rc;
+  lcc_history_begin(conn, lcc_history_key(statement, length, 0));
+  return lcc_read_response(conn);
 }
 
 /**
@@ -220,6 +548,14 @@ LCC_get_error(LCC_HANDLE *handle)
     case LCC_CONNECTION:
       return &((lcc_connection *)handle)->error;
       break;
+    case LCC_STATEMENT:
+      return &((lcc_stmt *)handle)->error;
+    case LCC_SCATTER:
+      return &((lcc_scatter *)handle)->error;
+    case LCC_BINLOG:
+      return &((lcc_binlog *)handle)->error;
+    case LCC_LOOP:
+      return &((lcc_loop *)handle)->error;
     default:
       return NULL;
   }
@@ -239,6 +575,18 @@ LCC_ERRNO API_FUNC
 LCC_get_info(LCC_HANDLE *handle, LCC_INFO info, void *buffer)
 {
   switch(info) {
+    case SERVER_INFO_AFFECTED_ROWS:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((uint64_t *)buffer)= ((lcc_connection *)handle)->server.affected_rows;
+      break;
+    case SERVER_INFO_LAST_INSERT_ID:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((uint64_t *)buffer)= ((lcc_connection *)handle)->server.last_insert_id;
+      break;
+    case SERVER_INFO_WARNING_COUNT:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((uint32_t *)buffer)= ((lcc_connection *)handle)->server.warning_count;
+      break;
     case RESULT_INFO_ROW_COUNT:
       CHECK_HANDLE_TYPE(handle, LCC_RESULT);
       *((uint64_t *)buffer)= ((lcc_result *)handle)->row_count;
@@ -247,10 +595,135 @@ LCC_get_info(LCC_HANDLE *handle, LCC_INFO info, void *buffer)
       CHECK_HANDLE_TYPE(handle, LCC_RESULT);
       *((LCC_STRING **)buffer)= ((lcc_result *)handle)->data;
       break;
+    case CONNECTION_INFO_NUMA_NODE:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((int32_t *)buffer)= ((lcc_connection *)handle)->numa_node;
+      break;
+    case RESULT_INFO_EXPECTED_ROWS:
+      CHECK_HANDLE_TYPE(handle, LCC_RESULT);
+      /* 0 if the statement wasn't executed before */
+      *((uint64_t *)buffer)= ((lcc_result *)handle)->expected_rows;
+      break;
+    case RESULT_INFO_PROTOCOL:
+      CHECK_HANDLE_TYPE(handle, LCC_RESULT);
+      /* 1 if rows are in binary format */
+      *((uint8_t *)buffer)= ((lcc_result *)handle)->binary;
+      break;
     case RESULT_INFO_COLUMNS:
       CHECK_HANDLE_TYPE(handle, LCC_RESULT);
       *((LCC_COLUMN **)buffer)= ((lcc_result *)handle)->columns;
       break;
+    case RESULT_INFO_COLUMN_COUNT:
+      CHECK_HANDLE_TYPE(handle, LCC_RESULT);
+      if (((lcc_result *)handle)->stored)
+        *((uint32_t *)buffer)= ((lcc_result *)handle)->stored->column_count;
+      else
+        *((uint32_t *)buffer)= ((lcc_result *)handle)->conn ?
+                               ((lcc_result *)handle)->conn->column_count : 0;
+      break;
+    case BACKEND_INFO_LIMIT:
+      CHECK_HANDLE_TYPE(handle, LCC_BACKEND);
+      *((uint32_t *)buffer)= (uint32_t)((lcc_backend *)handle)->limit;
+      break;
+    case BACKEND_INFO_IN_FLIGHT:
+      CHECK_HANDLE_TYPE(handle, LCC_BACKEND);
+      *((uint32_t *)buffer)= ((lcc_backend *)handle)->in_flight;
+      break;
+    case BACKEND_INFO_CIRCUIT_STATE:
+      CHECK_HANDLE_TYPE(handle, LCC_BACKEND);
+      *((LCC_CIRCUIT_STATE *)buffer)= ((lcc_backend *)handle)->circuit;
+      break;
+    case POOL_INFO_SIZE:
+      CHECK_HANDLE_TYPE(handle, LCC_POOL);
+      *((uint32_t *)buffer)= ((lcc_pool *)handle)->size;
+      break;
+    case POOL_INFO_IDLE:
+      CHECK_HANDLE_TYPE(handle, LCC_POOL);
+      *((uint32_t *)buffer)= ((lcc_pool *)handle)->idle_count;
+      break;
+    case SESSION_INFO_PINNED:
+      CHECK_HANDLE_TYPE(handle, LCC_SESSION);
+      *((uint8_t *)buffer)= ((lcc_session *)handle)->pinned;
+      break;
+    case GROUP_COMMIT_INFO_BATCHES:
+      CHECK_HANDLE_TYPE(handle, LCC_GROUP_COMMIT);
+      pthread_mutex_lock(&((lcc_group_commit *)handle)->lock);
+      *((uint64_t *)buffer)= ((lcc_group_commit *)handle)->batches;
+      pthread_mutex_unlock(&((lcc_group_commit *)handle)->lock);
+      break;
+    case GROUP_COMMIT_INFO_STATEMENTS:
+      CHECK_HANDLE_TYPE(handle, LCC_GROUP_COMMIT);
+      pthread_mutex_lock(&((lcc_group_commit *)handle)->lock);
+      *((uint64_t *)buffer)= ((lcc_group_commit *)handle)->statements;
+      pthread_mutex_unlock(&((lcc_group_commit *)handle)->lock);
+      break;
+    case SINGLE_FLIGHT_INFO_EXECUTED:
+      CHECK_HANDLE_TYPE(handle, LCC_SINGLE_FLIGHT);
+      pthread_mutex_lock(&((lcc_single_flight *)handle)->lock);
+      *((uint64_t *)buffer)= ((lcc_single_flight *)handle)->executed;
+      pthread_mutex_unlock(&((lcc_single_flight *)handle)->lock);
+      break;
+    case SINGLE_FLIGHT_INFO_COALESCED:
+      CHECK_HANDLE_TYPE(handle, LCC_SINGLE_FLIGHT);
+      pthread_mutex_lock(&((lcc_single_flight *)handle)->lock);
+      *((uint64_t *)buffer)= ((lcc_single_flight *)handle)->coalesced;
+      pthread_mutex_unlock(&((lcc_single_flight *)handle)->lock);
+      break;
+    case ROUTER_INFO_SHARDS:
+      CHECK_HANDLE_TYPE(handle, LCC_ROUTER);
+      pthread_rwlock_rdlock(&((lcc_router *)handle)->lock);
+      *((uint32_t *)buffer)= ((lcc_router *)handle)->count;
+      pthread_rwlock_unlock(&((lcc_router *)handle)->lock);
+      break;
+    case SCATTER_INFO_ROW:
+      CHECK_HANDLE_TYPE(handle, LCC_SCATTER);
+      *((LCC_STRING **)buffer)= ((lcc_scatter *)handle)->data;
+      break;
+    case SCATTER_INFO_COLUMNS:
+      CHECK_HANDLE_TYPE(handle, LCC_SCATTER);
+      *((LCC_COLUMN **)buffer)= ((lcc_scatter *)handle)->shard_count ?
+                                ((lcc_scatter *)handle)->shards[0].result.columns : NULL;
+      break;
+    case SCATTER_INFO_SHARD:
+      CHECK_HANDLE_TYPE(handle, LCC_SCATTER);
+      *((uint32_t *)buffer)= ((lcc_scatter *)handle)->current;
+      break;
+    case SCATTER_INFO_ROW_COUNT:
+      CHECK_HANDLE_TYPE(handle, LCC_SCATTER);
+      *((uint64_t *)buffer)= ((lcc_scatter *)handle)->row_count;
+      break;
+    case BINLOG_INFO_EVENT:
+    {
+      lcc_binlog *binlog= (lcc_binlog *)handle;
+
+      CHECK_HANDLE_TYPE(handle, LCC_BINLOG);
+      *((LCC_BINLOG_EVENT **)buffer)= binlog->pending ?
+                                      &binlog->slots[binlog->consumed % binlog->slot_count].event : NULL;
+      break;
+    }
+    case PIPELINE_INFO_FLUSHES:
+      CHECK_HANDLE_TYPE(handle, LCC_PIPELINE);
+      *((uint64_t *)buffer)= __atomic_load_n(&((lcc_pipeline *)handle)->flushes, __ATOMIC_RELAXED);
+      break;
+    case PIPELINE_INFO_COMMANDS:
+      CHECK_HANDLE_TYPE(handle, LCC_PIPELINE);
+      *((uint64_t *)buffer)= __atomic_load_n(&((lcc_pipeline *)handle)->commands, __ATOMIC_RELAXED);
+      break;
+    case CONNECTION_INFO_SOCKET:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((int *)buffer)= ((lcc_connection *)handle)->socket;
+      break;
+    case CONNECTION_INFO_WAIT_EVENTS:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((uint8_t *)buffer)= ((lcc_connection *)handle)->async ?
+                            ((lcc_connection *)handle)->async->wait_events : 0;
+      break;
+    case CONNECTION_INFO_WAIT_TIMEOUT:
+      CHECK_HANDLE_TYPE(handle, LCC_CONNECTION);
+      *((int32_t *)buffer)= ((lcc_connection *)handle)->async &&
+                            (((lcc_connection *)handle)->async->wait_events & LCC_WAIT_TIMEOUT) ?
+                            ((lcc_connection *)handle)->async->timeout : -1;
+      break;
  
     default:
       return ER_INVALID_OPTION;
@@ -295,89 +768,3 @@ LCC_get_session_track_info(LCC_HANDLE *hdl,
   }
   return NULL;
 }
-
-int main()
-{
-  LCC_HANDLE *conn, *stmt;
-  LCC_ERRNO rc;
-  LCC_BIND bind;
-  uint8_t eof= 0;
-  int sock, ret;
-  const char *filenames[]= {"/etc/my.cnf","/home/georg/.my.cnf", NULL};
-
-  LCC_init_handle(&conn, LCC_CONNECTION, NULL);
-
-  LCC_configuration_load_file(conn, filenames, NULL);
-
-  ret= sock= create_inet_stream_socket("localhost", "3306", LIBSOCKET_IPv4, 0);
-
-  if (ret < 0) {
-      printf("ret= %d\n", ret);
-      exit(1);
-  }
-
-  LCC_configuration_set(conn, NULL, LCC_OPT_SOCKET_NO, &sock);
-  LCC_configuration_set(conn, NULL, LCC_OPT_AUTH_PLUGIN, (void *)"mysql_native_password");
-  ((lcc_connection *)conn)->socket= sock;
-
-  rc= lcc_read_server_hello((lcc_connection *)conn);
-  printf("rc=%d\n", rc);
-
-  rc= lcc_send_client_hello((lcc_connection *)conn);
-  printf("rc=%d\n", rc);
-  rc= lcc_read_response((lcc_connection *)conn);
-  printf("rc=%d\n", rc);
-
-  LCC_init_handle(&stmt, LCC_STATEMENT, conn);
-  printf("----------------------------------------------\n");
-  rc= LCC_statement_prepare(stmt, "SELECT 1,2,3,?", -1);
-  printf("prepare rc=%d\n", rc);
-  rc= LCC_statement_read_prepare_response(stmt);
-  printf("prepare response rc=%d\n", rc);
-  printf("%s\n", ((lcc_stmt *)stmt)->error.error);
-
-  memset(&bind, 0, sizeof(LCC_BIND));
-  eof= 1;
-  bind.buffer.buf= &eof;
-  bind.buffer_type= LCC_COLTYPE_INT8;
-
-  rc= LCC_stmt_set_param((LCC_HANDLE *)stmt, &bind);
-  printf("rc=%d\n", rc);
-
-  rc= LCC_stmt_fill_exec_buffer((LCC_HANDLE *)stmt);
-  printf("fill exec buffer rc=%d\n", rc);
-
-  rc= LCC_stmt_execute((LCC_HANDLE *)stmt);
-  printf("stmt_execute rc=%d\n", rc);
-
-  rc= lcc_read_response(((lcc_stmt *)stmt)->conn);
-  printf("read_response rc=%d\n", rc);
-/*
-  rc= LCC_execute(conn, "SELECT 1,2,'foo' UNION SELECT 2,3,'bar' UNION SELECT 3,4,'foobar'", -1);
-  printf("rc=%d\n", rc);
-  rc= lcc_read_response((lcc_connection *)conn);
-  printf("rc=%d\n", rc);
-  LCC_init_handle(&result, LCC_RESULT, conn);
-  rc= lcc_read_result_metadata(stmt->result);
-
-  rc= LCC_get_info(result, RESULT_INFO_COLUMNS, &columns);
-  printf("rc=%d\n", rc);
-
-  while (!eof && rc == ER_OK) {
-    rc= lcc_result_fetch_one((lcc_result *)result, &eof);
-    if (!eof && !rc) {
-      int i;
-      for (i= 0; i < 3; i++)
-        printf("%.*s ", (int)((lcc_result *)result)->data[i].len, ((lcc_result *)result)->data[i].str);
-      printf("\n");
-    }
-  }
-  printf("max_length: %d  length: %d \n", columns[1].max_column_size, columns[1].column_size);
-  printf("num_rwos: %lu\n", ((lcc_result *)result)->row_count);
-
-  LCC_close_handle(result);
-*/
-  LCC_close_handle(conn);
-
-  destroy_inet_socket(sock);
-}
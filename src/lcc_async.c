@@ -0,0 +1,210 @@
+/* readiness API for external event loops (libuv, libevent, asio, ...)
+
+   LCC_async_start() runs an operation, which may call any blocking
+   function of a connection, on a separate stack. Whenever the operation
+   would wait for the socket, it returns to the caller with the events it
+   waits for (LCC_WAIT_xxx). The application watches the socket
+   (CONNECTION_INFO_SOCKET) in its own loop, arms a timer if
+   LCC_WAIT_TIMEOUT was requested (CONNECTION_INFO_WAIT_TIMEOUT) and
+   calls LCC_async_continue() with the events which occurred.
+*/
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LCC_ASYNC_STACK_SIZE 0x40000
+
+static void
+lcc_async_stack_free(lcc_async *async)
+{
+  if (async->stack)
+    munmap(async->stack, async->stack_size);
+  async->stack= NULL;
+  async->stack_size= 0;
+}
+
+/* allocates the stack of the operation with a guard page below it */
+static LCC_ERRNO
+lcc_async_stack_alloc(lcc_async *async, size_t size)
+{
+  size_t page= (size_t)sysconf(_SC_PAGESIZE);
+  char *stack;
+
+  size= lcc_align_size(page, size) + page;
+  if (async->stack && async->stack_size == size)
+    return ER_OK;
+  lcc_async_stack_free(async);
+
+  if ((stack= mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0)) == MAP_FAILED)
+    return ER_OUT_OF_MEMORY;
+  if (mprotect(stack, page, PROT_NONE))
+  {
+    munmap(stack, size);
+    return ER_OUT_OF_MEMORY;
+  }
+  async->stack= stack;
+  async->stack_size= size;
+  return ER_OK;
+}
+
+/* entry point of the operation, makecontext only passes int arguments */
+static void
+lcc_async_entry(unsigned int low, unsigned int high)
+{
+  lcc_connection *conn= (lcc_connection *)(uintptr_t)(((uint64_t)high << 32) | low);
+  lcc_async *async= conn->async;
+
+  async->rc= async->func((LCC_HANDLE *)conn, async->data);
+  async->wait_events= 0;
+  async->active= 0;
+  /* returns to the caller via uc_link */
+}
+
+/* runs the operation until it finishes or waits for the socket */
+static LCC_ERRNO
+lcc_async_resume(lcc_connection *conn, uint8_t *wait)
+{
+  lcc_async *async= conn->async;
+
+  async->running= 1;
+  swapcontext(&async->caller, &async->context);
+  async->running= 0;
+
+  *wait= async->wait_events;
+  return async->active ? ER_OK : async->rc;
+}
+
+/**
+ * @brief: suspends the operation until LCC_async_continue() is called
+ *
+ * @return: 1 if the socket is ready, 0 on timeout
+ */
+int
+lcc_async_wait(lcc_connection *conn, uint8_t events, int32_t timeout)
+{
+  lcc_async *async= conn->async;
+
+  if (!timeout)
+  {
+    errno= ETIMEDOUT;
+    return 0;
+  }
+
+  async->wait_events= events | (timeout > 0 ? LCC_WAIT_TIMEOUT : 0);
+  async->timeout= timeout;
+  async->ready= 0;
+  swapcontext(&async->context, &async->caller);
+  async->wait_events= 0;
+
+  /* without any event the socket is checked again */
+  if (!(async->ready & events) && (async->ready & LCC_WAIT_TIMEOUT))
+  {
+    errno= ETIMEDOUT;
+    return 0;
+  }
+  return 1;
+}
+
+void
+lcc_async_close(lcc_connection *conn)
+{
+  if (!conn->async)
+    return;
+  /* a pending operation is abandoned, its stack is discarded */
+  lcc_async_stack_free(conn->async);
+  free(conn->async);
+  conn->async= NULL;
+}
+
+/**
+ * @brief: starts an operation which doesn't block
+ *
+ * The operation func is called with connection and data and runs
+ * until it finishes or has to wait for the socket. In the latter case
+ * wait contains the events it waits for, the socket
+ * (CONNECTION_INFO_SOCKET) should be watched by the application which
+ * calls LCC_async_continue() when one of the events occurred.
+ * If wait is 0 the operation finished and its result is returned.
+ *
+ * Only one operation per connection can be pending, a pending operation
+ * must not be interrupted by other calls for the connection.
+ *
+ * @return: result of the finished operation, ER_OK if it is pending
+ *          or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_async_start(LCC_HANDLE *connection, LCC_ASYNC_FUNC func, void *data, uint8_t *wait)
+{
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_async *async;
+  uintptr_t ptr= (uintptr_t)conn;
+  size_t stack_size;
+
+  if (lcc_validate_handle(connection, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+  if (!func || !wait)
+    return ER_INVALID_POINTER;
+
+  /* wait of the pending operation remains valid */
+  if (conn->async && conn->async->active)
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_ASYNC_PENDING, "HY000", NULL);
+
+  *wait= 0;
+  if (!conn->async &&
+      !(conn->async= (lcc_async *)calloc(1, sizeof(lcc_async))))
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         sizeof(lcc_async));
+  async= conn->async;
+
+  stack_size= conn->configuration.async_stack_size ?
+              conn->configuration.async_stack_size : LCC_ASYNC_STACK_SIZE;
+  if (lcc_async_stack_alloc(async, stack_size))
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         stack_size);
+
+  getcontext(&async->context);
+  async->context.uc_stack.ss_sp= async->stack;
+  async->context.uc_stack.ss_size= async->stack_size;
+  async->context.uc_link= &async->caller;
+  makecontext(&async->context, (void (*)(void))lcc_async_entry, 2,
+              (unsigned int)(ptr & 0xFFFFFFFF), (unsigned int)((uint64_t)ptr >> 32));
+
+  async->func= func;
+  async->data= data;
+  async->rc= ER_OK;
+  async->active= 1;
+  return lcc_async_resume(conn, wait);
+}
+
+/**
+ * @brief: continues a pending operation of LCC_async_start()
+ *
+ * @param: ready - events which occurred: LCC_WAIT_READ, LCC_WAIT_WRITE
+ *                 or LCC_WAIT_TIMEOUT if the timeout expired
+ * @param: wait - events the operation waits for, 0 if it finished
+ *
+ * @return: result of the finished operation, ER_OK if it is still
+ *          pending or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_async_continue(LCC_HANDLE *connection, uint8_t ready, uint8_t *wait)
+{
+  lcc_connection *conn= (lcc_connection *)connection;
+
+  if (lcc_validate_handle(connection, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+  if (!wait)
+    return ER_INVALID_POINTER;
+  *wait= 0;
+  if (!conn->async || !conn->async->active || conn->async->running)
+    return ER_INVALID_VALUE;
+
+  conn->async->ready= ready;
+  return lcc_async_resume(conn, wait);
+}
@@ -0,0 +1,253 @@
+/* per backend concurrency limiter and circuit breaker */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* default limits */
+#define LCC_LIMIT_INITIAL 20
+#define LCC_LIMIT_MIN 1
+#define LCC_LIMIT_MAX 1000
+
+/* default circuit breaker settings */
+#define LCC_CIRCUIT_ERROR_THRESHOLD 50
+#define LCC_CIRCUIT_MIN_REQUESTS 20
+#define LCC_CIRCUIT_WINDOW 10000
+#define LCC_CIRCUIT_OPEN_TIME 5000
+
+/* weight of new limit */
+#define LCC_LIMIT_SMOOTHING 0.2
+/* multiplicative decrease on errors and timeouts */
+#define LCC_LIMIT_BACKOFF 0.9
+/* a response time up to tolerance * long_rtt is not considered as queueing */
+#define LCC_RTT_TOLERANCE 1.5
+/* weights of a new sample for short and long term response time */
+#define LCC_SHORT_RTT_ALPHA 0.5
+#define LCC_LONG_RTT_ALPHA 0.01
+
+LCC_ERRNO
+lcc_backend_init(lcc_backend *backend)
+{
+  if (pthread_mutex_init(&backend->lock, NULL))
+    return ER_UNKNOWN;
+  backend->limit= LCC_LIMIT_INITIAL;
+  backend->min_limit= LCC_LIMIT_MIN;
+  backend->max_limit= LCC_LIMIT_MAX;
+  backend->error_threshold= LCC_CIRCUIT_ERROR_THRESHOLD;
+  backend->min_requests= LCC_CIRCUIT_MIN_REQUESTS;
+  backend->window= LCC_CIRCUIT_WINDOW;
+  backend->open_time= LCC_CIRCUIT_OPEN_TIME;
+  backend->circuit= LCC_CIRCUIT_CLOSED;
+  backend->window_start= lcc_now_usec();
+  return ER_OK;
+}
+
+/**
+ * @brief: releases backend, attached connections will be detached
+ */
+void
+lcc_backend_close(lcc_backend *backend)
+{
+  LCC_LIST *list;
+
+  pthread_mutex_lock(&backend->lock);
+  for (list= backend->connections; list; list= list->next)
+  {
+    if (list->data)
+    {
+      ((lcc_connection *)list->data)->backend= NULL;
+      ((lcc_connection *)list->data)->backend_slot= 0;
+    }
+  }
+  lcc_list_delete(backend->connections, NULL);
+  backend->connections= NULL;
+  pthread_mutex_unlock(&backend->lock);
+  pthread_mutex_destroy(&backend->lock);
+}
+
+LCC_ERRNO
+lcc_backend_attach(lcc_backend *backend, lcc_connection *conn)
+{
+  LCC_ERRNO rc;
+
+  pthread_mutex_lock(&backend->lock);
+  if (!(rc= lcc_list_add(&backend->connections, conn)))
+    conn->backend= backend;
+  pthread_mutex_unlock(&backend->lock);
+  return rc;
+}
+
+void
+lcc_backend_detach(lcc_connection *conn)
+{
+  lcc_backend *backend= conn->backend;
+
+  if (!backend)
+    return;
+
+  if (conn->backend_slot)
+    lcc_backend_release(backend, CMD_RESULT_CANCELED, 0);
+  conn->backend_slot= 0;
+
+  pthread_mutex_lock(&backend->lock);
+  lcc_list_clear_element(backend->connections, conn);
+  conn->backend= NULL;
+  pthread_mutex_unlock(&backend->lock);
+}
+
+static void
+lcc_backend_open_circuit(lcc_backend *backend, uint64_t now)
+{
+  backend->circuit= LCC_CIRCUIT_OPEN;
+  backend->open_until= now + (uint64_t)backend->open_time * 1000;
+  backend->probe= 0;
+}
+
+static void
+lcc_backend_reset_window(lcc_backend *backend, uint64_t now)
+{
+  backend->requests= backend->errors= 0;
+  backend->window_start= now;
+}
+
+/**
+ * @brief: acquires an in-flight slot
+ *
+ * @return: ER_OK, ER_CIRCUIT_OPEN if the backend is considered as
+ *          unavailable or ER_CONCURRENCY_LIMIT if the current limit
+ *          of in-flight commands was reached.
+ */
+LCC_ERRNO
+lcc_backend_acquire(lcc_backend *backend)
+{
+  LCC_ERRNO rc= ER_OK;
+  uint64_t now= lcc_now_usec();
+
+  pthread_mutex_lock(&backend->lock);
+
+  if (backend->circuit == LCC_CIRCUIT_OPEN)
+  {
+    if (now < backend->open_until)
+    {
+      rc= ER_CIRCUIT_OPEN;
+      goto end;
+    }
+    backend->circuit= LCC_CIRCUIT_HALF_OPEN;
+    backend->probe= 0;
+  }
+
+  /* only one test command is allowed while circuit is half open */
+  if (backend->circuit == LCC_CIRCUIT_HALF_OPEN)
+  {
+    if (backend->probe)
+    {
+      rc= ER_CIRCUIT_OPEN;
+      goto end;
+    }
+    backend->probe= 1;
+  }
+  else if (backend->in_flight >= (uint32_t)backend->limit)
+  {
+    rc= ER_CONCURRENCY_LIMIT;
+    goto end;
+  }
+  backend->in_flight++;
+end:
+  pthread_mutex_unlock(&backend->lock);
+  return rc;
+}
+
+/* gradient algorithm: the limit shrinks if the short term response time
+   grows compared to the long term response time */
+static void
+lcc_backend_adjust_limit(lcc_backend *backend, uint64_t rtt)
+{
+  double gradient, new_limit;
+
+  if (!backend->long_rtt)
+    backend->short_rtt= backend->long_rtt= (double)rtt;
+
+  backend->short_rtt+= LCC_SHORT_RTT_ALPHA * ((double)rtt - backend->short_rtt);
+  backend->long_rtt+= LCC_LONG_RTT_ALPHA * ((double)rtt - backend->long_rtt);
+
+  /* long term response time drifted (e.g. server load changed
+     permanently), let it converge faster */
+  if (backend->long_rtt / backend->short_rtt > 2)
+    backend->long_rtt*= 0.95;
+
+  /* don't grow the limit if the application doesn't use it */
+  if (backend->in_flight + 1 < backend->limit / 2)
+    return;
+
+  gradient= lcc_MAX(0.5, lcc_MIN(1.0, LCC_RTT_TOLERANCE * backend->long_rtt / backend->short_rtt));
+  new_limit= backend->limit * gradient + sqrt(backend->limit);
+  backend->limit= backend->limit * (1 - LCC_LIMIT_SMOOTHING) + new_limit * LCC_LIMIT_SMOOTHING;
+}
+
+/**
+ * @brief: releases an in-flight slot
+ *
+ * @param: backend - backend
+ * @param: result - result of the command, timeouts, communication
+ *                  errors and overload errors of the server are failures
+ * @param: rtt - response time in usec or 0 if not available
+ */
+void
+lcc_backend_release(lcc_backend *backend, lcc_cmd_result result, uint64_t rtt)
+{
+  uint64_t now= lcc_now_usec();
+  /* other server errors are a successful round trip */
+  uint8_t failed= (result == CMD_RESULT_SERVER_OVERLOAD || result == CMD_RESULT_COMM_ERROR);
+
+  pthread_mutex_lock(&backend->lock);
+
+  if (backend->in_flight)
+    backend->in_flight--;
+
+  if (result == CMD_RESULT_CANCELED)
+  {
+    if (backend->circuit == LCC_CIRCUIT_HALF_OPEN)
+      backend->probe= 0;
+    goto end;
+  }
+
+  if (now - backend->window_start > (uint64_t)backend->window * 1000)
+    lcc_backend_reset_window(backend, now);
+
+  backend->requests++;
+  if (failed)
+    backend->errors++;
+
+  switch (backend->circuit) {
+  case LCC_CIRCUIT_HALF_OPEN:
+    if (failed)
+      lcc_backend_open_circuit(backend, now);
+    else
+    {
+      backend->circuit= LCC_CIRCUIT_CLOSED;
+      backend->probe= 0;
+      lcc_backend_reset_window(backend, now);
+    }
+    break;
+  case LCC_CIRCUIT_CLOSED:
+    if (failed)
+    {
+      backend->limit*= LCC_LIMIT_BACKOFF;
+      if (backend->requests >= backend->min_requests &&
+          backend->errors * 100 >= backend->error_threshold * backend->requests)
+        lcc_backend_open_circuit(backend, now);
+    }
+    else if (rtt)
+      lcc_backend_adjust_limit(backend, rtt);
+    break;
+  default:
+    break;
+  }
+
+  backend->limit= lcc_MAX(backend->limit, (double)backend->min_limit);
+  backend->limit= lcc_MIN(backend->limit, (double)backend->max_limit);
+end:
+  pthread_mutex_unlock(&backend->lock);
+}
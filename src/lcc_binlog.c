@@ -0,0 +1,1377 @@
+/* binlog client: streams and decodes replication events
+
+   A reader thread receives the event stream into reference counted
+   blocks and queues the events in arrival order. Decoder threads
+   decode queued events in place, the consumer receives them in the
+   order of the stream (LCC_binlog_fetch).
+   Table map events are processed by the reader, so a row event can
+   be decoded by any decoder once it was queued.
+*/
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <lcc_pack.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#define COMM_HEADER_SIZE 4
+#define MAX_COMM_PACKET_SIZE 0xFFFFFF
+
+#define LCC_BINLOG_HEADER_SIZE 19
+#define LCC_BINLOG_CHECKSUM_SIZE 4
+#define LCC_BINLOG_CHECKSUM_CRC32 1
+/* binlog version, server version and timestamp of a format
+   description event */
+#define LCC_BINLOG_FDE_HEADER_SIZE 57
+#define LCC_BINLOG_SEMI_SYNC_MAGIC 0xEF
+/* capability of a MariaDB replica which uses GTID */
+#define LCC_BINLOG_MARIADB_GTID_CAPABILITY 4
+
+static const uint8_t lcc_dig2bytes[10]= {0, 1, 1, 2, 2, 3, 3, 4, 4, 4};
+
+/* little endian integer of n bytes */
+static inline uint64_t
+lcc_binlog_le(const u_char *p, uint8_t n)
+{
+  uint64_t value= 0;
+
+  while (n--)
+    value= (value << 8) | p[n];
+  return value;
+}
+
+/* big endian integer of n bytes */
+static inline uint64_t
+lcc_binlog_be(const u_char *p, uint8_t n)
+{
+  uint64_t value= 0;
+  uint8_t i;
+
+  for (i=0; i < n; i++)
+    value= (value << 8) | p[i];
+  return value;
+}
+
+static void
+lcc_binlog_block_release(lcc_binlog_block *block)
+{
+  if (block && !__atomic_sub_fetch(&block->refcount, 1, __ATOMIC_ACQ_REL))
+    free(block);
+}
+
+static void
+lcc_binlog_table_release(lcc_binlog_table *table)
+{
+  if (table && !__atomic_sub_fetch(&table->refcount, 1, __ATOMIC_ACQ_REL))
+    free(table);
+}
+
+LCC_ERRNO
+lcc_binlog_init(lcc_binlog *binlog)
+{
+  lcc_clear_error(&binlog->error);
+  binlog->worker_count= 2;
+  binlog->slot_count= LCC_BINLOG_SLOTS;
+  if (pthread_mutex_init(&binlog->lock, NULL))
+    return ER_UNKNOWN;
+  pthread_cond_init(&binlog->readable, NULL);
+  pthread_cond_init(&binlog->decodable, NULL);
+  pthread_cond_init(&binlog->writable, NULL);
+  return ER_OK;
+}
+
+/* releases the block and table of an event */
+static void
+lcc_binlog_slot_release(lcc_binlog_slot *slot)
+{
+  lcc_binlog_block_release(slot->block);
+  lcc_binlog_table_release(slot->table);
+  slot->block= NULL;
+  slot->table= NULL;
+  slot->decoded= 0;
+}
+
+/**
+ * @brief: stops the stream and releases binlog handle
+ *
+ * The socket of the connection is shut down to stop the reader,
+ * the connection can only be closed afterwards.
+ */
+void
+lcc_binlog_close(lcc_binlog *binlog)
+{
+  uint32_t i;
+  uint64_t seq;
+
+  if (binlog->started)
+  {
+    pthread_mutex_lock(&binlog->lock);
+    binlog->stop= 1;
+    pthread_cond_broadcast(&binlog->decodable);
+    pthread_cond_broadcast(&binlog->writable);
+    pthread_mutex_unlock(&binlog->lock);
+
+    shutdown(binlog->conn->socket, SHUT_RDWR);
+    pthread_join(binlog->reader, NULL);
+    for (i=0; i < binlog->worker_count; i++)
+      pthread_join(binlog->workers[i], NULL);
+
+    for (seq= binlog->consumed; seq < binlog->written; seq++)
+      lcc_binlog_slot_release(&binlog->slots[seq % binlog->slot_count]);
+    lcc_binlog_block_release(binlog->block);
+    for (i=0; i < LCC_BINLOG_TABLE_SLOTS; i++)
+    {
+      while (binlog->tables[i])
+      {
+        lcc_binlog_table *table= binlog->tables[i];
+
+        binlog->tables[i]= table->next;
+        lcc_binlog_table_release(table);
+      }
+    }
+  }
+  if (binlog->slots)
+  {
+    for (i=0; i < binlog->slot_count; i++)
+    {
+      free(binlog->slots[i].rows);
+      free(binlog->slots[i].values);
+    }
+    free(binlog->slots);
+  }
+  free(binlog->workers);
+  pthread_cond_destroy(&binlog->writable);
+  pthread_cond_destroy(&binlog->decodable);
+  pthread_cond_destroy(&binlog->readable);
+  pthread_mutex_destroy(&binlog->lock);
+}
+
+/**
+ * @brief: reads the next packet into the current block
+ *
+ * Packets are not copied: a packet stays where it was received, only
+ * an incomplete packet at the end of a block is moved into the next
+ * block. Packets of 16 MB or more are joined in place.
+ */
+static LCC_ERRNO
+lcc_binlog_read_packet(lcc_binlog *binlog, char **packet, size_t *length)
+{
+  lcc_connection *conn= binlog->conn;
+  ssize_t bytes_read;
+  LCC_ERRNO rc;
+
+  for (;;)
+  {
+    char *pos= binlog->read_pos;
+    size_t need= 0;
+
+    /* find the end of the packet (or the end of the last part) */
+    for (;;)
+    {
+      size_t len;
+
+      if (binlog->read_end - pos < COMM_HEADER_SIZE)
+      {
+        need= pos + COMM_HEADER_SIZE - binlog->read_pos;
+        break;
+      }
+      len= (size_t)lcc_binlog_le((u_char *)pos, 3);
+      if ((size_t)(binlog->read_end - pos) < COMM_HEADER_SIZE + len)
+      {
+        need= pos + COMM_HEADER_SIZE + len - binlog->read_pos;
+        break;
+      }
+      pos+= COMM_HEADER_SIZE + len;
+      if (len < MAX_COMM_PACKET_SIZE)
+        break;
+    }
+
+    if (!need)
+    {
+      char *dst= binlog->read_pos + COMM_HEADER_SIZE;
+      char *src= dst;
+
+      /* join the parts of a large packet */
+      for (;;)
+      {
+        size_t len= (size_t)lcc_binlog_le((u_char *)src - COMM_HEADER_SIZE, 3);
+
+        if (dst != src)
+          memmove(dst, src, len);
+        dst+= len;
+        src+= len + COMM_HEADER_SIZE;
+        if (len < MAX_COMM_PACKET_SIZE)
+          break;
+      }
+      *packet= binlog->read_pos + COMM_HEADER_SIZE;
+      *length= dst - *packet;
+      binlog->read_pos= pos;
+      return ER_OK;
+    }
+
+    /* not enough space left: continue in a new block */
+    if (binlog->read_pos + need > binlog->block->data + binlog->block->size)
+    {
+      size_t cached= binlog->read_end - binlog->read_pos;
+      size_t size= lcc_MAX(need, (size_t)LCC_BINLOG_BLOCK_SIZE);
+      lcc_binlog_block *block;
+
+      if (!(block= (lcc_binlog_block *)malloc(sizeof(lcc_binlog_block) + size)))
+        return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, size);
+      block->refcount= 1;
+      block->size= size;
+      memcpy(block->data, binlog->read_pos, cached);
+      lcc_binlog_block_release(binlog->block);
+      binlog->block= block;
+      binlog->read_pos= block->data;
+      binlog->read_end= block->data + cached;
+    }
+
+    if ((rc= lcc_io_read_socket(conn, binlog->read_end,
+                                binlog->block->data + binlog->block->size - binlog->read_end,
+                                &bytes_read)))
+      return rc;
+    binlog->read_end+= bytes_read;
+  }
+}
+
+/* hash slot of a table id */
+static inline uint32_t
+lcc_binlog_table_slot(uint64_t table_id)
+{
+  return (uint32_t)(table_id % LCC_BINLOG_TABLE_SLOTS);
+}
+
+static lcc_binlog_table *
+lcc_binlog_find_table(lcc_binlog *binlog, uint64_t table_id)
+{
+  lcc_binlog_table *table;
+
+  for (table= binlog->tables[lcc_binlog_table_slot(table_id)]; table; table= table->next)
+    if (table->table.table_id == table_id)
+      return table;
+  return NULL;
+}
+
+/* table id of a table map or row event */
+static uint64_t
+lcc_binlog_table_id(lcc_binlog *binlog, const char *event)
+{
+  uint8_t type= (uint8_t)event[4];
+
+  return lcc_binlog_le((u_char *)event + LCC_BINLOG_HEADER_SIZE,
+                       binlog->post_header[type] == 6 ? 4 : 6);
+}
+
+/* reads the metadata of a table map column */
+static uint8_t
+lcc_binlog_column_metadata(LCC_BINLOG_COLUMN *column, u_char **pos, u_char *end)
+{
+  u_char *p= *pos;
+
+  switch (column->type) {
+  case LCC_COLTYPE_FLOAT:
+  case LCC_COLTYPE_DOUBLE:
+  case LCC_COLTYPE_BLOB8:
+  case LCC_COLTYPE_BLOB24:
+  case LCC_COLTYPE_BLOB32:
+  case LCC_COLTYPE_BLOB64:
+  case LCC_COLTYPE_GEOMETRY:
+  case LCC_COLTYPE_JSON:
+    if (end - p < 1)
+      return 1;
+    column->length= p[0];
+    p++;
+    break;
+  case LCC_COLTYPE_TIMESTAMP2:
+  case LCC_COLTYPE_DATETIME2:
+  case LCC_COLTYPE_TIME2:
+    if (end - p < 1)
+      return 1;
+    column->decimals= p[0];
+    p++;
+    break;
+  case LCC_COLTYPE_VARCHAR:
+  case LCC_COLTYPE_VARSTR:
+    if (end - p < 2)
+      return 1;
+    column->length= (uint32_t)lcc_binlog_le(p, 2);
+    p+= 2;
+    break;
+  case LCC_COLTYPE_BIT:
+    if (end - p < 2)
+      return 1;
+    column->length= p[1] * 8 + p[0];
+    p+= 2;
+    break;
+  case LCC_COLTYPE_NEWDECIMAL:
+    if (end - p < 2)
+      return 1;
+    column->precision= p[0];
+    column->decimals= p[1];
+    p+= 2;
+    break;
+  case LCC_COLTYPE_STR:
+  case LCC_COLTYPE_ENUM:
+  case LCC_COLTYPE_SET:
+    if (end - p < 2)
+      return 1;
+    /* real type and length, bits 8 and 9 of the length are stored
+       inverted in the real type */
+    if ((p[0] & 0x30) != 0x30)
+    {
+      column->type= p[0] | 0x30;
+      column->length= p[1] | (((p[0] & 0x30) ^ 0x30) << 4);
+    }
+    else
+    {
+      column->type= p[0];
+      column->length= p[1];
+    }
+    p+= 2;
+    break;
+  default:
+    break;
+  }
+  *pos= p;
+  return 0;
+}
+
+/**
+ * @brief: creates the table of a table map event
+ *
+ * The table replaces a previous table with the same id, events which
+ * refer to the previous table keep their reference.
+ */
+static LCC_ERRNO
+lcc_binlog_table_map(lcc_binlog *binlog, const char *event, size_t length)
+{
+  u_char *pos= (u_char *)event + LCC_BINLOG_HEADER_SIZE + binlog->post_header[LCC_BINLOG_TABLE_MAP];
+  u_char *end= (u_char *)event + length;
+  u_char *db, *name, *types, *nulls;
+  uint8_t db_len, name_len, error= 0;
+  uint64_t column_count, i;
+  lcc_binlog_table *table, **slot;
+  LCC_BINLOG_COLUMN *columns;
+  char *strings;
+
+  if (end - pos < 1 || end - pos < 3 + pos[0] ||
+      end - (pos + pos[0] + 2) < 2 + pos[pos[0] + 2])
+    goto malformed;
+  db_len= pos[0];
+  db= pos + 1;
+  pos+= db_len + 2;
+  name_len= pos[0];
+  name= pos + 1;
+  pos+= name_len + 2;
+
+  column_count= p_to_lenc(&pos, end, &error);
+  if (error || (uint64_t)(end - pos) < column_count)
+    goto malformed;
+  types= pos;
+  pos+= column_count;
+  i= p_to_lenc(&pos, end, &error);
+  if (error || (uint64_t)(end - pos) < i + (column_count + 7) / 8)
+    goto malformed;
+  nulls= pos + i;
+
+  if (!(table= (lcc_binlog_table *)calloc(1, sizeof(lcc_binlog_table) +
+                                          column_count * sizeof(LCC_BINLOG_COLUMN) +
+                                          db_len + name_len + 2)))
+    return lcc_set_error(&binlog->conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         sizeof(lcc_binlog_table) + column_count * sizeof(LCC_BINLOG_COLUMN));
+  columns= (LCC_BINLOG_COLUMN *)(table + 1);
+  strings= (char *)(columns + column_count);
+
+  for (i=0; i < column_count; i++)
+  {
+    columns[i].type= types[i];
+    columns[i].nullable= (nulls[i / 8] >> (i % 8)) & 1;
+    if (lcc_binlog_column_metadata(&columns[i], &pos, nulls))
+    {
+      free(table);
+      goto malformed;
+    }
+  }
+
+  table->refcount= 1;
+  table->table.table_id= lcc_binlog_table_id(binlog, event);
+  table->table.database= strings;
+  memcpy(strings, db, db_len);
+  strings+= db_len + 1;
+  table->table.name= strings;
+  memcpy(strings, name, name_len);
+  table->table.column_count= (uint32_t)column_count;
+  table->table.columns= columns;
+
+  for (slot= &binlog->tables[lcc_binlog_table_slot(table->table.table_id)]; *slot; slot= &(*slot)->next)
+  {
+    if ((*slot)->table.table_id == table->table.table_id)
+    {
+      lcc_binlog_table *old= *slot;
+
+      *slot= old->next;
+      lcc_binlog_table_release(old);
+      break;
+    }
+  }
+  table->next= binlog->tables[lcc_binlog_table_slot(table->table.table_id)];
+  binlog->tables[lcc_binlog_table_slot(table->table.table_id)]= table;
+  return ER_OK;
+
+malformed:
+  return lcc_set_error(&binlog->conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL,
+                       (long)(pos - (u_char *)event));
+}
+
+static inline uint8_t
+lcc_binlog_is_row_event(uint8_t type)
+{
+  return (type >= LCC_BINLOG_WRITE_ROWS_V1 && type <= LCC_BINLOG_DELETE_ROWS_V1) ||
+         (type >= LCC_BINLOG_WRITE_ROWS && type <= LCC_BINLOG_DELETE_ROWS);
+}
+
+/**
+ * @brief: processes the stream state of an event and queues it
+ *
+ * Format description, rotate and table map events are processed here,
+ * in the order of the stream. Waits if the queue is full.
+ */
+static LCC_ERRNO
+lcc_binlog_queue(lcc_binlog *binlog, char *event, size_t length)
+{
+  uint8_t type= (uint8_t)event[4];
+  uint32_t next_position= (uint32_t)lcc_binlog_le((u_char *)event + 13, 4);
+  lcc_binlog_table *table= NULL;
+  lcc_binlog_slot *slot;
+  LCC_ERRNO rc;
+
+  if (type == LCC_BINLOG_FORMAT_DESCRIPTION)
+  {
+    size_t count;
+
+    /* checksum algorithm and checksum follow the post header lengths */
+    if (length < LCC_BINLOG_HEADER_SIZE + LCC_BINLOG_FDE_HEADER_SIZE + 1 + LCC_BINLOG_CHECKSUM_SIZE)
+      return lcc_set_error(&binlog->conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL,
+                           (long)length);
+    length-= LCC_BINLOG_CHECKSUM_SIZE;
+    binlog->checksum= (uint8_t)event[length - 1] == LCC_BINLOG_CHECKSUM_CRC32;
+    count= length - 1 - LCC_BINLOG_HEADER_SIZE - LCC_BINLOG_FDE_HEADER_SIZE;
+    memset(binlog->post_header, 0, sizeof(binlog->post_header));
+    memcpy(binlog->post_header + 1, event + LCC_BINLOG_HEADER_SIZE + LCC_BINLOG_FDE_HEADER_SIZE,
+           lcc_MIN(count, sizeof(binlog->post_header) - 1));
+  }
+  else if (binlog->checksum)
+  {
+    if (length < LCC_BINLOG_HEADER_SIZE + LCC_BINLOG_CHECKSUM_SIZE)
+      return lcc_set_error(&binlog->conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL,
+                           (long)length);
+    length-= LCC_BINLOG_CHECKSUM_SIZE;
+  }
+
+  if (next_position)
+    binlog->position= next_position;
+
+  switch (type) {
+  case LCC_BINLOG_HEARTBEAT:
+    return ER_OK;
+  case LCC_BINLOG_ROTATE:
+    if (length >= LCC_BINLOG_HEADER_SIZE + 8)
+    {
+      size_t len= lcc_MIN(length - LCC_BINLOG_HEADER_SIZE - 8, sizeof(binlog->filename) - 1);
+
+      binlog->position= lcc_binlog_le((u_char *)event + LCC_BINLOG_HEADER_SIZE, 8);
+      memcpy(binlog->filename, event + LCC_BINLOG_HEADER_SIZE + 8, len);
+      binlog->filename[len]= 0;
+    }
+    break;
+  case LCC_BINLOG_TABLE_MAP:
+    if ((rc= lcc_binlog_table_map(binlog, event, length)))
+      return rc;
+    table= lcc_binlog_find_table(binlog, lcc_binlog_table_id(binlog, event));
+    break;
+  default:
+    if (lcc_binlog_is_row_event(type) &&
+        length >= LCC_BINLOG_HEADER_SIZE + 8)
+      table= lcc_binlog_find_table(binlog, lcc_binlog_table_id(binlog, event));
+    break;
+  }
+
+  pthread_mutex_lock(&binlog->lock);
+  while (binlog->written - binlog->consumed >= binlog->slot_count && !binlog->stop)
+    pthread_cond_wait(&binlog->writable, &binlog->lock);
+  if (binlog->stop)
+  {
+    pthread_mutex_unlock(&binlog->lock);
+    return ER_OK;
+  }
+  slot= &binlog->slots[binlog->written % binlog->slot_count];
+  slot->block= binlog->block;
+  __atomic_add_fetch(&binlog->block->refcount, 1, __ATOMIC_RELAXED);
+  if ((slot->table= table))
+    __atomic_add_fetch(&table->refcount, 1, __ATOMIC_RELAXED);
+  slot->data= event;
+  slot->length= length;
+  slot->decoded= 0;
+  binlog->written++;
+  pthread_cond_signal(&binlog->decodable);
+  pthread_mutex_unlock(&binlog->lock);
+  return ER_OK;
+}
+
+/* semi-sync acknowledgement: position and file name of the event */
+static LCC_ERRNO
+lcc_binlog_ack(lcc_binlog *binlog)
+{
+  char buffer[COMM_HEADER_SIZE + 9 + sizeof(binlog->filename)];
+  size_t len= strlen(binlog->filename);
+  size_t payload= 9 + len;
+
+  buffer[0]= (char)payload;
+  buffer[1]= (char)(payload >> 8);
+  buffer[2]= 0;
+  buffer[3]= 0;
+  buffer[4]= (char)LCC_BINLOG_SEMI_SYNC_MAGIC;
+  ui64_to_p(buffer + 5, binlog->position);
+  memcpy(buffer + 13, binlog->filename, len);
+  return lcc_io_write_socket(binlog->conn, buffer, COMM_HEADER_SIZE + payload);
+}
+
+static void *
+lcc_binlog_reader(void *arg)
+{
+  lcc_binlog *binlog= (lcc_binlog *)arg;
+  lcc_connection *conn= binlog->conn;
+  uint8_t first= 1;
+  LCC_ERRNO rc;
+
+  for (;;)
+  {
+    char *packet;
+    size_t length;
+    uint8_t ack= 0;
+
+    if ((rc= lcc_binlog_read_packet(binlog, &packet, &length)))
+      break;
+    if (first)
+    {
+      lcc_conn_cmd_done(conn, CMD_RESULT_OK);
+      first= 0;
+    }
+    if (!length)
+      goto malformed;
+    if ((u_char)packet[0] == 0xFF)
+    {
+      rc= lcc_read_command_error(conn, packet + 1, length - 1);
+      break;
+    }
+    /* end of a non blocking stream */
+    if ((u_char)packet[0] == 0xFE && length < 9)
+      break;
+    if (packet[0])
+      goto malformed;
+    packet++;
+    length--;
+
+    if (binlog->semi_sync)
+    {
+      if (length < 2 || (u_char)packet[0] != LCC_BINLOG_SEMI_SYNC_MAGIC)
+        goto malformed;
+      ack= packet[1] & 1;
+      packet+= 2;
+      length-= 2;
+    }
+    if (length < LCC_BINLOG_HEADER_SIZE)
+      goto malformed;
+    if ((rc= lcc_binlog_queue(binlog, packet, length)) ||
+        (ack && (rc= lcc_binlog_ack(binlog))))
+      break;
+    continue;
+malformed:
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL, (long)length);
+    break;
+  }
+
+  pthread_mutex_lock(&binlog->lock);
+  if (!binlog->stop && rc)
+  {
+    binlog->rc= rc;
+    memcpy(&binlog->error, &conn->error, sizeof(LCC_ERROR));
+  }
+  binlog->done= 1;
+  pthread_cond_broadcast(&binlog->readable);
+  pthread_cond_broadcast(&binlog->decodable);
+  pthread_mutex_unlock(&binlog->lock);
+  return NULL;
+}
+
+/* storage size of a binary DECIMAL */
+static size_t
+lcc_binlog_decimal_size(const LCC_BINLOG_COLUMN *column)
+{
+  uint32_t intg= column->precision - column->decimals;
+
+  return (intg / 9) * 4 + lcc_dig2bytes[intg % 9] +
+         (column->decimals / 9) * 4 + lcc_dig2bytes[column->decimals % 9];
+}
+
+/* fractional seconds of temporal types in microseconds */
+static uint32_t
+lcc_binlog_frac(const u_char *p, uint8_t decimals)
+{
+  switch ((decimals + 1) / 2) {
+  case 1:
+    return p[0] * 10000;
+  case 2:
+    return (uint32_t)lcc_binlog_be(p, 2) * 100;
+  case 3:
+    return (uint32_t)lcc_binlog_be(p, 3);
+  default:
+    return 0;
+  }
+}
+
+static void
+lcc_binlog_time2(LCC_BINLOG_VALUE *value, const u_char *p, uint8_t decimals)
+{
+  int64_t packed, intpart, frac;
+
+  switch ((decimals + 1) / 2) {
+  case 1:
+    intpart= (int64_t)lcc_binlog_be(p, 3) - 0x800000;
+    frac= p[3];
+    if (intpart < 0 && frac)
+    {
+      intpart++;
+      frac-= 0x100;
+    }
+    packed= intpart * (1LL << 24) + frac * 10000;
+    break;
+  case 2:
+    intpart= (int64_t)lcc_binlog_be(p, 3) - 0x800000;
+    frac= (int64_t)lcc_binlog_be(p + 3, 2);
+    if (intpart < 0 && frac)
+    {
+      intpart++;
+      frac-= 0x10000;
+    }
+    packed= intpart * (1LL << 24) + frac * 100;
+    break;
+  case 3:
+    packed= (int64_t)lcc_binlog_be(p, 6) - 0x800000000000LL;
+    break;
+  default:
+    packed= ((int64_t)lcc_binlog_be(p, 3) - 0x800000) * (1LL << 24);
+    break;
+  }
+  if ((value->time.negative= packed < 0))
+    packed= -packed;
+  value->time.microseconds= (uint32_t)(packed % (1LL << 24));
+  packed>>= 24;
+  value->time.hour= (uint16_t)((packed >> 12) % (1 << 10));
+  value->time.minute= (uint8_t)((packed >> 6) % (1 << 6));
+  value->time.second= (uint8_t)(packed % (1 << 6));
+}
+
+/**
+ * @brief: decodes a value of a row image
+ *
+ * Numeric and temporal values are converted, strings point into
+ * the event.
+ *
+ * @return: 0 on success, 1 if the event is too short
+ */
+uint8_t
+lcc_binlog_value(const LCC_BINLOG_COLUMN *column, u_char **pos, u_char *end,
+                 LCC_BINLOG_VALUE *value)
+{
+  u_char *p= *pos;
+  size_t size= 0, prefix= 0;
+  uint64_t v;
+
+  switch (column->type) {
+  case LCC_COLTYPE_INT8: size= 1; break;
+  case LCC_COLTYPE_INT16: size= 2; break;
+  case LCC_COLTYPE_INT24: size= 3; break;
+  case LCC_COLTYPE_INT32: size= 4; break;
+  case LCC_COLTYPE_INT64: size= 8; break;
+  case LCC_COLTYPE_FLOAT: size= 4; break;
+  case LCC_COLTYPE_DOUBLE: size= 8; break;
+  case LCC_COLTYPE_YEAR: size= 1; break;
+  case LCC_COLTYPE_DATE: size= 3; break;
+  case LCC_COLTYPE_TIME: size= 3; break;
+  case LCC_COLTYPE_DATETIME: size= 8; break;
+  case LCC_COLTYPE_TIMESTAMP: size= 4; break;
+  case LCC_COLTYPE_TIMESTAMP2: size= 4 + (column->decimals + 1) / 2; break;
+  case LCC_COLTYPE_DATETIME2: size= 5 + (column->decimals + 1) / 2; break;
+  case LCC_COLTYPE_TIME2: size= 3 + (column->decimals + 1) / 2; break;
+  case LCC_COLTYPE_NEWDECIMAL: size= lcc_binlog_decimal_size(column); break;
+  case LCC_COLTYPE_ENUM:
+  case LCC_COLTYPE_SET: size= column->length; break;
+  case LCC_COLTYPE_BIT: size= (column->length + 7) / 8; break;
+  case LCC_COLTYPE_VARCHAR:
+  case LCC_COLTYPE_VARSTR:
+  case LCC_COLTYPE_STR:
+    prefix= column->length < 256 ? 1 : 2;
+    break;
+  case LCC_COLTYPE_BLOB8:
+  case LCC_COLTYPE_BLOB24:
+  case LCC_COLTYPE_BLOB32:
+  case LCC_COLTYPE_BLOB64:
+  case LCC_COLTYPE_GEOMETRY:
+  case LCC_COLTYPE_JSON:
+    prefix= column->length;
+    break;
+  case LCC_COLTYPE_NULL:
+    break;
+  default:
+    /* unknown storage size */
+    return 1;
+  }
+
+  if (prefix)
+  {
+    if (prefix > 4 || (size_t)(end - p) < prefix)
+      return 1;
+    size= (size_t)lcc_binlog_le(p, (uint8_t)prefix);
+    p+= prefix;
+  }
+  if ((size_t)(end - p) < size)
+    return 1;
+
+  value->str.str= (char *)p;
+  value->str.len= size;
+  if (!prefix && size <= 8)
+  {
+    value->u= lcc_binlog_le(p, (uint8_t)size);
+    value->i= size ? (int64_t)(value->u << (64 - 8 * size)) >> (64 - 8 * size) : 0;
+  }
+
+  switch (column->type) {
+  case LCC_COLTYPE_FLOAT:
+  {
+    float f;
+
+    memcpy(&f, p, sizeof(float));
+    value->d= f;
+    break;
+  }
+  case LCC_COLTYPE_DOUBLE:
+    memcpy(&value->d, p, sizeof(double));
+    break;
+  case LCC_COLTYPE_YEAR:
+    value->i= value->u ? (int64_t)value->u + 1900 : 0;
+    value->time.year= (uint16_t)value->i;
+    break;
+  case LCC_COLTYPE_DATE:
+    value->time.day= (uint8_t)(value->u & 31);
+    value->time.month= (uint8_t)((value->u >> 5) & 15);
+    value->time.year= (uint16_t)(value->u >> 9);
+    break;
+  case LCC_COLTYPE_TIME:
+    value->time.negative= value->i < 0;
+    v= value->time.negative ? (uint64_t)-value->i : (uint64_t)value->i;
+    value->time.hour= (uint16_t)(v / 10000);
+    value->time.minute= (uint8_t)(v / 100 % 100);
+    value->time.second= (uint8_t)(v % 100);
+    break;
+  case LCC_COLTYPE_DATETIME:
+    v= value->u;
+    value->time.second= (uint8_t)(v % 100);
+    value->time.minute= (uint8_t)(v / 100 % 100);
+    value->time.hour= (uint16_t)(v / 10000 % 100);
+    v/= 1000000;
+    value->time.day= (uint8_t)(v % 100);
+    value->time.month= (uint8_t)(v / 100 % 100);
+    value->time.year= (uint16_t)(v / 10000);
+    break;
+  case LCC_COLTYPE_TIMESTAMP:
+    value->i= (int64_t)value->u;
+    break;
+  case LCC_COLTYPE_TIMESTAMP2:
+    value->u= lcc_binlog_be(p, 4);
+    value->i= (int64_t)value->u;
+    value->time.microseconds= lcc_binlog_frac(p + 4, column->decimals);
+    break;
+  case LCC_COLTYPE_DATETIME2:
+  {
+    uint64_t ymd, ym, hms;
+
+    v= lcc_binlog_be(p, 5) - 0x8000000000ULL;
+    ymd= v >> 17;
+    ym= ymd >> 5;
+    hms= v % (1 << 17);
+    value->time.day= (uint8_t)(ymd % (1 << 5));
+    value->time.month= (uint8_t)(ym % 13);
+    value->time.year= (uint16_t)(ym / 13);
+    value->time.second= (uint8_t)(hms % (1 << 6));
+    value->time.minute= (uint8_t)((hms >> 6) % (1 << 6));
+    value->time.hour= (uint16_t)(hms >> 12);
+    value->time.microseconds= lcc_binlog_frac(p + 5, column->decimals);
+    break;
+  }
+  case LCC_COLTYPE_TIME2:
+    lcc_binlog_time2(value, p, column->decimals);
+    break;
+  case LCC_COLTYPE_BIT:
+    if (size <= 8)
+      value->i= (int64_t)(value->u= lcc_binlog_be(p, (uint8_t)size));
+    break;
+  case LCC_COLTYPE_INT24:
+  case LCC_COLTYPE_INT8:
+  case LCC_COLTYPE_INT16:
+  case LCC_COLTYPE_INT32:
+  case LCC_COLTYPE_INT64:
+  case LCC_COLTYPE_ENUM:
+  case LCC_COLTYPE_SET:
+  default:
+    break;
+  }
+  *pos= p + size;
+  return 0;
+}
+
+static inline uint32_t
+lcc_binlog_bit_count(const u_char *bitmap, uint32_t bits)
+{
+  uint32_t i, count= 0;
+
+  for (i=0; i < bits; i++)
+    count+= (bitmap[i / 8] >> (i % 8)) & 1;
+  return count;
+}
+
+/* decodes one row image */
+static uint8_t
+lcc_binlog_image(const LCC_BINLOG_TABLE *table, const u_char *present,
+                 u_char **pos, u_char *end, LCC_BINLOG_VALUE *values)
+{
+  uint32_t null_size= (lcc_binlog_bit_count(present, table->column_count) + 7) / 8;
+  u_char *nulls= *pos;
+  uint32_t i, k= 0;
+
+  if ((uint32_t)(end - *pos) < null_size)
+    return 1;
+  *pos+= null_size;
+  memset(values, 0, table->column_count * sizeof(LCC_BINLOG_VALUE));
+
+  for (i=0; i < table->column_count; i++)
+  {
+    if (!((present[i / 8] >> (i % 8)) & 1))
+      continue;
+    values[i].present= 1;
+    if ((nulls[k / 8] >> (k % 8)) & 1)
+      values[i].is_null= 1;
+    else if (lcc_binlog_value(&table->columns[i], pos, end, &values[i]))
+      return 1;
+    k++;
+  }
+  return 0;
+}
+
+/**
+ * @brief: decodes the rows of a row event
+ *
+ * Values are stored in arrays of the slot, which are reused by later
+ * events, so no memory is allocated in the steady state.
+ */
+static LCC_ERRNO
+lcc_binlog_decode_rows(lcc_binlog *binlog, lcc_binlog_slot *slot)
+{
+  LCC_BINLOG_EVENT *event= &slot->event;
+  const LCC_BINLOG_TABLE *table= &slot->table->table;
+  uint8_t type= event->type;
+  uint8_t images= (type == LCC_BINLOG_UPDATE_ROWS || type == LCC_BINLOG_UPDATE_ROWS_V1) ? 2 : 1;
+  u_char *pos= (u_char *)event->data + 8;
+  u_char *end= (u_char *)event->data + event->length;
+  u_char *present[2];
+  uint64_t column_count;
+  size_t bitmap_size, used= 0;
+  uint32_t i;
+  uint8_t error= 0;
+
+  /* extra data of version 2 row events */
+  if (type >= LCC_BINLOG_WRITE_ROWS)
+  {
+    if (end - pos < 2 || end - pos < (ptrdiff_t)lcc_binlog_le(pos, 2))
+      return ER_MALFORMED_PACKET;
+    pos+= lcc_binlog_le(pos, 2);
+  }
+  else if (binlog->post_header[type] > 8)
+    pos+= binlog->post_header[type] - 8;
+
+  column_count= p_to_lenc(&pos, end, &error);
+  if (error || column_count != table->column_count)
+    return ER_MALFORMED_PACKET;
+  bitmap_size= (size_t)(column_count + 7) / 8;
+  if ((size_t)(end - pos) < images * bitmap_size)
+    return ER_MALFORMED_PACKET;
+  present[0]= present[1]= pos;
+  pos+= bitmap_size;
+  if (images == 2)
+  {
+    present[1]= pos;
+    pos+= bitmap_size;
+  }
+
+  event->row_count= 0;
+  while (pos < end)
+  {
+    if (used + images * column_count > slot->values_size)
+    {
+      size_t size= lcc_MAX(slot->values_size * 2, used + images * column_count + 64);
+      LCC_BINLOG_VALUE *values;
+
+      if (!(values= (LCC_BINLOG_VALUE *)realloc(slot->values, size * sizeof(LCC_BINLOG_VALUE))))
+        return ER_OUT_OF_MEMORY;
+      slot->values= values;
+      slot->values_size= size;
+    }
+    if (event->row_count == slot->rows_size)
+    {
+      uint32_t size= slot->rows_size ? slot->rows_size * 2 : 16;
+      LCC_BINLOG_ROW *rows;
+
+      if (!(rows= (LCC_BINLOG_ROW *)realloc(slot->rows, size * sizeof(LCC_BINLOG_ROW))))
+        return ER_OUT_OF_MEMORY;
+      slot->rows= rows;
+      slot->rows_size= size;
+    }
+
+    if (lcc_binlog_image(table, present[0], &pos, end, slot->values + used))
+      return ER_MALFORMED_PACKET;
+    if (images == 2 &&
+        lcc_binlog_image(table, present[1], &pos, end, slot->values + used + column_count))
+      return ER_MALFORMED_PACKET;
+
+    /* offsets, the values might be reallocated */
+    slot->rows[event->row_count].before= (LCC_BINLOG_VALUE *)(uintptr_t)used;
+    used+= images * column_count;
+    event->row_count++;
+  }
+
+  for (i=0; i < event->row_count; i++)
+  {
+    LCC_BINLOG_VALUE *values= slot->values + (uintptr_t)slot->rows[i].before;
+
+    switch (type) {
+    case LCC_BINLOG_WRITE_ROWS:
+    case LCC_BINLOG_WRITE_ROWS_V1:
+      slot->rows[i].before= NULL;
+      slot->rows[i].after= values;
+      break;
+    case LCC_BINLOG_DELETE_ROWS:
+    case LCC_BINLOG_DELETE_ROWS_V1:
+      slot->rows[i].before= values;
+      slot->rows[i].after= NULL;
+      break;
+    default:
+      slot->rows[i].before= values;
+      slot->rows[i].after= values + column_count;
+      break;
+    }
+  }
+  event->rows= slot->rows;
+  return ER_OK;
+}
+
+/* decodes header and body of a queued event */
+static LCC_ERRNO
+lcc_binlog_decode(lcc_binlog *binlog, lcc_binlog_slot *slot)
+{
+  LCC_BINLOG_EVENT *event= &slot->event;
+  u_char *p= (u_char *)slot->data;
+
+  memset(event, 0, sizeof(LCC_BINLOG_EVENT));
+  event->timestamp= (uint32_t)lcc_binlog_le(p, 4);
+  event->type= p[4];
+  event->server_id= (uint32_t)lcc_binlog_le(p + 5, 4);
+  event->next_position= (uint32_t)lcc_binlog_le(p + 13, 4);
+  event->flags= (uint16_t)lcc_binlog_le(p + 17, 2);
+  event->data= slot->data + LCC_BINLOG_HEADER_SIZE;
+  event->length= slot->length - LCC_BINLOG_HEADER_SIZE;
+  p+= LCC_BINLOG_HEADER_SIZE;
+
+  switch (event->type) {
+  case LCC_BINLOG_GTID:
+    if (event->length < 12)
+      return ER_MALFORMED_PACKET;
+    event->gtid_sequence= lcc_binlog_le(p, 8);
+    event->gtid_domain= (uint32_t)lcc_binlog_le(p + 8, 4);
+    break;
+  case LCC_BINLOG_QUERY:
+  {
+    size_t status_len, db_len;
+
+    if (event->length < 13)
+      return ER_MALFORMED_PACKET;
+    db_len= p[8];
+    status_len= (size_t)lcc_binlog_le(p + 11, 2);
+    if (event->length < binlog->post_header[LCC_BINLOG_QUERY] + status_len + db_len + 1)
+      return ER_MALFORMED_PACKET;
+    p+= binlog->post_header[LCC_BINLOG_QUERY] + status_len;
+    event->database.str= (char *)p;
+    event->database.len= db_len;
+    p+= db_len + 1;
+    event->query.str= (char *)p;
+    event->query.len= event->data + event->length - (char *)p;
+    break;
+  }
+  case LCC_BINLOG_TABLE_MAP:
+    if (slot->table)
+      event->table= &slot->table->table;
+    break;
+  default:
+    if (lcc_binlog_is_row_event(event->type))
+    {
+      /* without table map the rows can't be decoded */
+      if (!slot->table)
+        return ER_MALFORMED_PACKET;
+      event->table= &slot->table->table;
+      return lcc_binlog_decode_rows(binlog, slot);
+    }
+    break;
+  }
+  return ER_OK;
+}
+
+static void *
+lcc_binlog_worker(void *arg)
+{
+  lcc_binlog *binlog= (lcc_binlog *)arg;
+
+  for (;;)
+  {
+    lcc_binlog_slot *slot;
+    uint64_t seq;
+    LCC_ERRNO rc;
+
+    pthread_mutex_lock(&binlog->lock);
+    while (binlog->dispatched == binlog->written && !binlog->stop && !binlog->done)
+      pthread_cond_wait(&binlog->decodable, &binlog->lock);
+    if (binlog->stop || binlog->dispatched == binlog->written)
+    {
+      pthread_mutex_unlock(&binlog->lock);
+      break;
+    }
+    seq= binlog->dispatched++;
+    slot= &binlog->slots[seq % binlog->slot_count];
+    pthread_mutex_unlock(&binlog->lock);
+
+    rc= lcc_binlog_decode(binlog, slot);
+
+    pthread_mutex_lock(&binlog->lock);
+    slot->rc= rc;
+    slot->decoded= 1;
+    if (seq == binlog->consumed)
+      pthread_cond_broadcast(&binlog->readable);
+    pthread_mutex_unlock(&binlog->lock);
+  }
+  return NULL;
+}
+
+/* sends a statement without result set */
+static LCC_ERRNO
+lcc_binlog_command(lcc_connection *conn, const char *statement)
+{
+  LCC_ERRNO rc;
+
+  if (!(rc= lcc_io_write(conn, CMD_QUERY, (char *)statement, strlen(statement))))
+    rc= lcc_read_response(conn);
+  return rc;
+}
+
+/* reads the checksum algorithm of the server: events which arrive
+   before the format description event (the rotate event) carry a
+   checksum as well */
+static LCC_ERRNO
+lcc_binlog_read_checksum(lcc_binlog *binlog, lcc_connection *conn)
+{
+  const char *statement= "SELECT @@global.binlog_checksum";
+  lcc_stored_result *stored;
+  LCC_ERRNO rc;
+
+  conn->column_count= 0;
+  if ((rc= lcc_io_write(conn, CMD_QUERY, (char *)statement, strlen(statement))) ||
+      (rc= lcc_read_response(conn)))
+    return rc;
+  if (!conn->column_count)
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_NO_RESULT_AVAILABLE, "HY000", NULL);
+  if ((rc= lcc_result_store(conn, &stored)))
+    return rc;
+  binlog->checksum= stored->row_count && stored->rows[0].str &&
+                    !strcasecmp(stored->rows[0].str, "CRC32");
+  lcc_stored_result_release(stored);
+  return ER_OK;
+}
+
+/**
+ * @brief: registers as replica and starts streaming binlog events
+ *
+ * @param: handle - binlog handle
+ * @param: connection - connection to a MariaDB server, the connection
+ *                      can't be used for other commands afterwards
+ * @param: server_id - unique server id of the replica
+ * @param: gtid_position - GTID position to start from (e.g. "0-1-100"),
+ *                         NULL for the current binlog position
+ *
+ * The number of decoder threads and the queue size (LCC_OPT_BINLOG_WORKERS),
+ * semi-sync replication (LCC_OPT_BINLOG_SEMI_SYNC) and the heartbeat
+ * period (LCC_OPT_BINLOG_HEARTBEAT) must be set before.
+ * With semi-sync replication an event is acknowledged when it was
+ * received and queued.
+ *
+ * @return: ER_OK or error code, error information is stored in the
+ *          binlog handle.
+ */
+LCC_ERRNO API_FUNC
+LCC_binlog_start(LCC_HANDLE *handle,
+                 LCC_HANDLE *connection,
+                 uint32_t server_id,
+                 const char *gtid_position)
+{
+  lcc_binlog *binlog= (lcc_binlog *)handle;
+  lcc_connection *conn= (lcc_connection *)connection;
+  char statement[256], buffer[32];
+  size_t cached, size;
+  uint32_t i;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_BINLOG) ||
+      lcc_validate_handle(connection, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+  if (binlog->started)
+    return lcc_set_error(&binlog->error, LCC_ERROR_INFO, ER_ALREADY_INITIALIZED, "HY000", NULL);
+  if (!conn->server.is_mariadb)
+    return lcc_set_error(&binlog->error, LCC_ERROR_INFO, ER_UNSUPPORTED_SERVER_VERSION, "HY000", NULL);
+  if (gtid_position && (strlen(gtid_position) > 128 ||
+                        strspn(gtid_position, "0123456789-,") != strlen(gtid_position)))
+    return lcc_set_error(&binlog->error, LCC_ERROR_INFO, ER_INVALID_VALUE, "HY000", NULL);
+
+  lcc_clear_error(&binlog->error);
+  binlog->conn= conn;
+
+  if (gtid_position)
+    snprintf(statement, sizeof(statement), "SET @slave_connect_state='%s'", gtid_position);
+  else
+    snprintf(statement, sizeof(statement), "SET @slave_connect_state=@@global.gtid_binlog_pos");
+  if ((rc= lcc_binlog_read_checksum(binlog, conn)) ||
+      (rc= lcc_binlog_command(conn, "SET @master_binlog_checksum=@@global.binlog_checksum")) ||
+      (rc= lcc_binlog_command(conn, "SET @mariadb_slave_capability=4")) ||
+      (rc= lcc_binlog_command(conn, statement)))
+    goto error;
+  if (binlog->heartbeat)
+  {
+    snprintf(statement, sizeof(statement), "SET @master_heartbeat_period=%llu",
+             (unsigned long long)binlog->heartbeat * 1000000);
+    if ((rc= lcc_binlog_command(conn, statement)))
+      goto error;
+  }
+  if (binlog->semi_sync &&
+      (rc= lcc_binlog_command(conn, "SET @rpl_semi_sync_slave=1")))
+    goto error;
+
+  /* server id, host, user, password, port, rank and master id */
+  memset(buffer, 0, sizeof(buffer));
+  ui32_to_p(buffer, server_id);
+  if ((rc= lcc_io_write(conn, CMD_REGISTER_SLAVE, buffer, 17)) ||
+      (rc= lcc_read_response(conn)))
+    goto error;
+
+  /* position, flags, server id, empty file name: the position is
+     taken from @slave_connect_state */
+  memset(buffer, 0, sizeof(buffer));
+  ui32_to_p(buffer, 4);
+  ui32_to_p(buffer + 6, server_id);
+  if (!(binlog->slots= (lcc_binlog_slot *)calloc(binlog->slot_count, sizeof(lcc_binlog_slot))) ||
+      !(binlog->workers= (pthread_t *)calloc(binlog->worker_count, sizeof(pthread_t))))
+  {
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                      binlog->slot_count * sizeof(lcc_binlog_slot));
+    goto error;
+  }
+  if ((rc= lcc_io_write(conn, CMD_BINLOG_DUMP, buffer, 10)))
+    goto error;
+  /* the stream has no deadline */
+  conn->deadline= 0;
+
+  /* data which was already read belongs to the stream */
+  cached= conn->io.read_end - conn->io.read_pos;
+  size= lcc_MAX(cached, (size_t)LCC_BINLOG_BLOCK_SIZE);
+  if (!(binlog->block= (lcc_binlog_block *)malloc(sizeof(lcc_binlog_block) + size)))
+  {
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, size);
+    goto error;
+  }
+  binlog->block->refcount= 1;
+  binlog->block->size= size;
+  memcpy(binlog->block->data, conn->io.read_pos, cached);
+  binlog->read_pos= binlog->block->data;
+  binlog->read_end= binlog->block->data + cached;
+  conn->io.read_pos= conn->io.read_end= conn->io.readbuf;
+  /* event types without format description */
+  memset(binlog->post_header, 0, sizeof(binlog->post_header));
+  binlog->post_header[LCC_BINLOG_QUERY]= 13;
+  binlog->post_header[LCC_BINLOG_TABLE_MAP]= 8;
+
+  if (pthread_create(&binlog->reader, NULL, lcc_binlog_reader, binlog))
+  {
+    lcc_binlog_block_release(binlog->block);
+    binlog->block= NULL;
+    rc= lcc_set_error(&binlog->error, LCC_ERROR_INFO, ER_UNKNOWN, "HY000", NULL);
+    return rc;
+  }
+  for (i=0; i < binlog->worker_count; i++)
+  {
+    if (pthread_create(&binlog->workers[i], NULL, lcc_binlog_worker, binlog))
+      break;
+  }
+  binlog->worker_count= i;
+  binlog->started= 1;
+  return ER_OK;
+
+error:
+  memcpy(&binlog->error, &conn->error, sizeof(LCC_ERROR));
+  return rc;
+}
+
+/**
+ * @brief: returns the next event of the stream
+ *
+ * @param: handle - binlog handle
+ * @param: eof - set to 1 if the stream ended
+ *
+ * Waits until the next event was received and decoded, events are
+ * returned in the order of the stream. The event (BINLOG_INFO_EVENT)
+ * is valid until the next call.
+ * If an event couldn't be decoded, an error is returned but the
+ * undecoded event is available.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_binlog_fetch(LCC_HANDLE *handle, uint8_t *eof)
+{
+  lcc_binlog *binlog= (lcc_binlog *)handle;
+  lcc_binlog_slot *slot;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_BINLOG))
+    return ER_INVALID_HANDLE;
+  if (!eof)
+    return ER_INVALID_POINTER;
+  if (!binlog->started)
+    return lcc_set_error(&binlog->error, LCC_ERROR_INFO, ER_NO_RESULT_AVAILABLE, "HY000", NULL);
+
+  *eof= 0;
+  pthread_mutex_lock(&binlog->lock);
+  if (binlog->pending)
+  {
+    lcc_binlog_slot_release(&binlog->slots[binlog->consumed % binlog->slot_count]);
+    binlog->consumed++;
+    binlog->pending= 0;
+    pthread_cond_signal(&binlog->writable);
+  }
+
+  for (;;)
+  {
+    slot= &binlog->slots[binlog->consumed % binlog->slot_count];
+    if (binlog->consumed < binlog->written && slot->decoded)
+      break;
+    if (binlog->done && binlog->consumed == binlog->written)
+    {
+      rc= binlog->rc;
+      pthread_mutex_unlock(&binlog->lock);
+      *eof= !rc;
+      return rc;
+    }
+    pthread_cond_wait(&binlog->readable, &binlog->lock);
+  }
+  binlog->pending= 1;
+  pthread_mutex_unlock(&binlog->lock);
+
+  if ((rc= slot->rc))
+    return lcc_set_error(&binlog->error, LCC_ERROR_INFO, rc, "HY000", NULL,
+                         rc == ER_OUT_OF_MEMORY ? (long)slot->length : 0L);
+  return ER_OK;
+}
+
+/**
+ * @brief: converts a binary DECIMAL value of a row image into a string
+ *
+ * @return: length of the string, the string is truncated if the
+ *          buffer is too small
+ */
+size_t API_FUNC
+LCC_binlog_decimal(const LCC_BINLOG_COLUMN *column,
+                   const LCC_BINLOG_VALUE *value,
+                   char *buffer,
+                   size_t size)
+{
+  u_char bin[40];
+  char str[96], *out= str;
+  uint32_t intg, frac, i;
+  uint8_t mask, leading= 1;
+  size_t len, bytes;
+  const u_char *p;
+
+  if (!column || !value || column->type != LCC_COLTYPE_NEWDECIMAL ||
+      value->is_null || !value->present ||
+      (len= lcc_binlog_decimal_size(column)) != value->str.len || len > sizeof(bin))
+    return 0;
+
+  memcpy(bin, value->str.str, len);
+  /* negative values are stored inverted, the sign bit is flipped */
+  mask= (bin[0] & 0x80) ? 0 : 0xFF;
+  bin[0]^= 0x80;
+  if (mask)
+    *out++= '-';
+  p= bin;
+  intg= column->precision - column->decimals;
+  frac= column->decimals;
+
+  /* integer part: leading digits, then groups of 9 digits */
+  if ((bytes= lcc_dig2bytes[intg % 9]))
+  {
+    uint32_t v= (uint32_t)(lcc_binlog_be(p, (uint8_t)bytes) ^ (mask ? (1ULL << (bytes * 8)) - 1 : 0));
+
+    if (v)
+    {
+      out+= sprintf(out, "%u", v);
+      leading= 0;
+    }
+    p+= bytes;
+  }
+  for (i=0; i < intg / 9; i++, p+= 4)
+  {
+    uint32_t v= (uint32_t)lcc_binlog_be(p, 4) ^ (mask ? 0xFFFFFFFF : 0);
+
+    if (leading && !v)
+      continue;
+    out+= sprintf(out, leading ? "%u" : "%09u", v);
+    leading= 0;
+  }
+  if (leading)
+    *out++= '0';
+
+  if (frac)
+  {
+    *out++= '.';
+    for (i=0; i < frac / 9; i++, p+= 4)
+      out+= sprintf(out, "%09u", (uint32_t)lcc_binlog_be(p, 4) ^ (mask ? 0xFFFFFFFF : 0));
+    if ((bytes= lcc_dig2bytes[frac % 9]))
+      out+= sprintf(out, "%0*u", (int)(frac % 9),
+                    (uint32_t)(lcc_binlog_be(p, (uint8_t)bytes) ^ (mask ? (1ULL << (bytes * 8)) - 1 : 0)));
+  }
+  *out= 0;
+
+  len= out - str;
+  if (size)
+  {
+    memcpy(buffer, str, lcc_MIN(len, size - 1));
+    buffer[lcc_MIN(len, size - 1)]= 0;
+  }
+  return len;
+}
@@ -124,6 +124,48 @@ lcc_configuration_options lcc_conf_options[]=
     LCC_CONF_INT8,
     (const char *[]){"remember_config", NULL}
   },
+  {
+    LCC_OPT_HEDGE_READS,
+    offsetof(lcc_connection, configuration.hedge_reads),
+    LCC_CONF_INT8,
+    (const char *[]){"hedge_reads", NULL}
+  },
+  {
+    LCC_OPT_HEDGE_PERCENTILE,
+    offsetof(lcc_connection, configuration.hedge_percentile),
+    LCC_CONF_INT8,
+    (const char *[]){"hedge_percentile", NULL}
+  },
+  {
+    LCC_OPT_HEDGE_MIN_DELAY,
+    offsetof(lcc_connection, configuration.hedge_min_delay),
+    LCC_CONF_INT32,
+    (const char *[]){"hedge_min_delay", NULL}
+  },
+  {
+    LCC_OPT_READ_TIMEOUT,
+    offsetof(lcc_connection, configuration.read_timeout),
+    LCC_CONF_INT32,
+    (const char *[]){"read_timeout", "net_read_timeout", NULL}
+  },
+  {
+    LCC_OPT_WRITE_TIMEOUT,
+    offsetof(lcc_connection, configuration.write_timeout),
+    LCC_CONF_INT32,
+    (const char *[]){"write_timeout", "net_write_timeout", NULL}
+  },
+  {
+    LCC_OPT_DEADLINE,
+    offsetof(lcc_connection, configuration.deadline),
+    LCC_CONF_INT32,
+    (const char *[]){"deadline", NULL}
+  },
+  {
+    LCC_OPT_LOCAL_INFILE_DIR,
+    offsetof(lcc_connection, configuration.local_infile_dir),
+    LCC_CONF_STR,
+    (const char *[]){"local_infile_dir", "load_data_local_dir", NULL}
+  },
 };
 
 /*
@@ -364,6 +406,319 @@ LCC_set_option(LCC_HANDLE *handle, LCC_OPTION option, ...)
       stmt->param_callback= opt2;
       break;
     }
+    case LCC_OPT_BACKEND_LIMITS:
+    {
+      /* parameters: minimum, maximum and initial number of
+         in-flight commands (uint32_t *) */
+      lcc_backend *backend= (lcc_backend *)handle;
+      uint32_t *max_limit, *initial;
+      if (lcc_validate_handle(handle, LCC_BACKEND))
+        return ER_INVALID_HANDLE;
+      max_limit= va_arg(ap, uint32_t *);
+      initial= va_arg(ap, uint32_t *);
+      if (!opt1 || !max_limit || !initial ||
+          !*(uint32_t *)opt1 || *(uint32_t *)opt1 > *max_limit)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      pthread_mutex_lock(&backend->lock);
+      backend->min_limit= *(uint32_t *)opt1;
+      backend->max_limit= *max_limit;
+      backend->limit= lcc_MIN(lcc_MAX(*initial, backend->min_limit), backend->max_limit);
+      pthread_mutex_unlock(&backend->lock);
+      break;
+    }
+    case LCC_OPT_CIRCUIT_BREAKER:
+    {
+      /* parameters: error threshold in percent, minimum number of commands,
+         window (ms) and open time (ms) (uint32_t *) */
+      lcc_backend *backend= (lcc_backend *)handle;
+      uint32_t *min_requests, *window, *open_time;
+      if (lcc_validate_handle(handle, LCC_BACKEND))
+        return ER_INVALID_HANDLE;
+      min_requests= va_arg(ap, uint32_t *);
+      window= va_arg(ap, uint32_t *);
+      open_time= va_arg(ap, uint32_t *);
+      if (!opt1 || !min_requests || !window || !open_time ||
+          *(uint32_t *)opt1 > 100)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      pthread_mutex_lock(&backend->lock);
+      backend->error_threshold= *(uint32_t *)opt1;
+      backend->min_requests= *min_requests;
+      backend->window= *window;
+      backend->open_time= *open_time;
+      pthread_mutex_unlock(&backend->lock);
+      break;
+    }
+    case LCC_OPT_GROUP_COMMIT:
+    {
+      /* parameters: maximum number of statements per batch and
+         maximum wait time in usec (uint32_t *) */
+      lcc_group_commit *group= (lcc_group_commit *)handle;
+      uint32_t *window;
+      if (lcc_validate_handle(handle, LCC_GROUP_COMMIT))
+        return ER_INVALID_HANDLE;
+      window= va_arg(ap, uint32_t *);
+      if (!opt1 || !window || !*(uint32_t *)opt1)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      pthread_mutex_lock(&group->lock);
+      group->max_count= *(uint32_t *)opt1;
+      group->window= *window;
+      pthread_mutex_unlock(&group->lock);
+      break;
+    }
+    case LCC_OPT_POOL_CLASS:
+    {
+      /* parameters: priority class (uint8_t *), weight and maximum
+         number of checked out connections (uint32_t *, 0 = unlimited) */
+      lcc_pool *pool= (lcc_pool *)handle;
+      uint32_t *weight, *max_active;
+      uint8_t priority_class;
+      if (lcc_validate_handle(handle, LCC_POOL))
+        return ER_INVALID_HANDLE;
+      weight= va_arg(ap, uint32_t *);
+      max_active= va_arg(ap, uint32_t *);
+      if (!opt1 || !weight || !max_active || !*weight ||
+          *weight > 65536 || *(uint8_t *)opt1 >= LCC_SCHED_CLASSES)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      priority_class= *(uint8_t *)opt1;
+      pthread_mutex_lock(&pool->lock);
+      pool->classes[priority_class].weight= *weight;
+      pool->classes[priority_class].max_active= *max_active;
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    case LCC_OPT_POOL_MAINTENANCE:
+    {
+      /* parameters: ping interval, idle timeout and maximum lifetime
+         of idle connections in ms (uint32_t *, 0 = disabled) */
+      uint32_t *idle_timeout, *max_lifetime;
+      if (lcc_validate_handle(handle, LCC_POOL))
+        return ER_INVALID_HANDLE;
+      idle_timeout= va_arg(ap, uint32_t *);
+      max_lifetime= va_arg(ap, uint32_t *);
+      if (!opt1 || !idle_timeout || !max_lifetime)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      lcc_pool_set_maintenance((lcc_pool *)handle, *(uint32_t *)opt1,
+                               *idle_timeout, *max_lifetime);
+      break;
+    }
+    case LCC_OPT_LOCAL_INFILE_CALLBACK:
+    {
+      /* parameters: callback function and user data */
+      lcc_connection *conn= (lcc_connection *)handle;
+      if (lcc_validate_handle(handle, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      conn->configuration.callbacks.local_infile= (LCC_INFILE_CALLBACK)opt1;
+      conn->configuration.callbacks.local_infile_data= va_arg(ap, void *);
+      break;
+    }
+    case LCC_OPT_KILL_POOL:
+    {
+      /* parameter: pool handle (or NULL) which provides connections
+         for killing statements which exceeded their deadline */
+      lcc_connection *conn= (lcc_connection *)handle;
+      if (lcc_validate_handle(handle, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      if (opt1 && lcc_validate_handle((LCC_HANDLE *)opt1, LCC_POOL))
+      {
+        error_code= ER_INVALID_HANDLE;
+        break;
+      }
+      conn->kill_pool= (lcc_pool *)opt1;
+      break;
+    }
+    case LCC_OPT_BINLOG_WORKERS:
+    {
+      /* parameters: number of decoder threads and maximum number of
+         queued events (uint32_t *) */
+      lcc_binlog *binlog= (lcc_binlog *)handle;
+      uint32_t *queue_size;
+      if (lcc_validate_handle(handle, LCC_BINLOG))
+        return ER_INVALID_HANDLE;
+      queue_size= va_arg(ap, uint32_t *);
+      if (binlog->started || !opt1 || !queue_size ||
+          !*(uint32_t *)opt1 || *(uint32_t *)opt1 > 256 || !*queue_size)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      binlog->worker_count= *(uint32_t *)opt1;
+      binlog->slot_count= *queue_size;
+      break;
+    }
+    case LCC_OPT_BINLOG_SEMI_SYNC:
+    {
+      /* parameter: acknowledge received events (uint8_t *) */
+      lcc_binlog *binlog= (lcc_binlog *)handle;
+      if (lcc_validate_handle(handle, LCC_BINLOG))
+        return ER_INVALID_HANDLE;
+      if (binlog->started || !opt1)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      binlog->semi_sync= *(uint8_t *)opt1;
+      break;
+    }
+    case LCC_OPT_BINLOG_HEARTBEAT:
+    {
+      /* parameter: heartbeat period of the server in ms
+         (uint32_t *, 0 = disabled) */
+      lcc_binlog *binlog= (lcc_binlog *)handle;
+      if (lcc_validate_handle(handle, LCC_BINLOG))
+        return ER_INVALID_HANDLE;
+      if (binlog->started || !opt1)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      binlog->heartbeat= *(uint32_t *)opt1;
+      break;
+    }
+    case LCC_OPT_LOOP_THREADS:
+    {
+      /* parameters: number of loop threads (uint32_t *) and
+         pinning of threads to CPUs (uint8_t *) */
+      lcc_loop *loop= (lcc_loop *)handle;
+      uint8_t *pin;
+      if (lcc_validate_handle(handle, LCC_LOOP))
+        return ER_INVALID_HANDLE;
+      pin= va_arg(ap, uint8_t *);
+      if (loop->started || !opt1 || !pin || !*(uint32_t *)opt1)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      loop->shard_count= *(uint32_t *)opt1;
+      loop->pin= *pin;
+      break;
+    }
+    case LCC_OPT_WAIT_CALLBACK:
+    {
+      /* parameters: wait function (or NULL for poll) and user data */
+      lcc_connection *conn= (lcc_connection *)handle;
+      if (lcc_validate_handle(handle, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      conn->configuration.callbacks.wait= (LCC_WAIT_CALLBACK)opt1;
+      conn->configuration.callbacks.wait_data= va_arg(ap, void *);
+      break;
+    }
+    case LCC_OPT_ASYNC_STACK_SIZE:
+    {
+      /* parameter: stack size of LCC_async_start() operations in bytes
+         (size_t *), 0 = default */
+      lcc_connection *conn= (lcc_connection *)handle;
+      if (lcc_validate_handle(handle, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      if (!opt1 || (*(size_t *)opt1 && *(size_t *)opt1 < 0x4000))
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      conn->configuration.async_stack_size= *(size_t *)opt1;
+      break;
+    }
+    case LCC_OPT_PIPELINE_DEPTH:
+    {
+      /* parameter: max. number of commands in flight (uint32_t *) */
+      if (lcc_validate_handle(handle, LCC_PIPELINE))
+        return ER_INVALID_HANDLE;
+      if (!opt1 || !*(uint32_t *)opt1)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      __atomic_store_n(&((lcc_pipeline *)handle)->depth, *(uint32_t *)opt1, __ATOMIC_RELAXED);
+      break;
+    }
+    case LCC_OPT_READ_AHEAD:
+    {
+      /* parameters: rows per batch (uint32_t *) and number of batches
+         (uint32_t *), 0 = default */
+      uint32_t *batches;
+      if (lcc_validate_handle(handle, LCC_RESULT))
+        return ER_INVALID_HANDLE;
+      batches= va_arg(ap, uint32_t *);
+      if (!opt1 || !batches)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      error_code= lcc_read_ahead_start((lcc_result *)handle, *(uint32_t *)opt1, *batches);
+      break;
+    }
+    case LCC_OPT_NUMA_NODE:
+    {
+      /* parameter: NUMA node of buffers and threads (int32_t *),
+         -1 = no binding */
+      int32_t node;
+      if (!opt1)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      if (!handle)
+        return ER_INVALID_HANDLE;
+      node= *(int32_t *)opt1;
+      if (!lcc_numa_valid(node))
+      {
+        error_code= ER_NUMA_NODE;
+        break;
+      }
+      switch (handle->type) {
+      case LCC_CONNECTION:
+      {
+        lcc_connection *conn= (lcc_connection *)handle;
+        if (conn->status != CONN_STATUS_READY || conn->loop)
+        {
+          error_code= ER_NUMA_NODE_BUSY;
+          break;
+        }
+        if (node != conn->numa_node)
+          error_code= lcc_io_set_node(conn, node);
+        break;
+      }
+      case LCC_POOL:
+        ((lcc_pool *)handle)->numa_node= node;
+        break;
+      case LCC_LOOP:
+        error_code= lcc_loop_set_node((lcc_loop *)handle, node);
+        break;
+      default:
+        return ER_INVALID_HANDLE;
+      }
+      break;
+    }
+    case LCC_OPT_EXEC_HISTORY:
+    {
+      /* parameters: number of statements (uint32_t *), 0 = disabled, and
+         expected rows which start read-ahead (uint32_t *), 0 = never */
+      uint32_t *read_ahead_rows;
+      if (lcc_validate_handle(handle, LCC_CONNECTION))
+        return ER_INVALID_HANDLE;
+      read_ahead_rows= va_arg(ap, uint32_t *);
+      if (!opt1 || !read_ahead_rows)
+      {
+        error_code= ER_INVALID_VALUE;
+        break;
+      }
+      error_code= lcc_history_set((lcc_connection *)handle, *(uint32_t *)opt1, *read_ahead_rows);
+      break;
+    }
     default:
       error_code= ER_INVALID_OPTION;
   }
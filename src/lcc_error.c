@@ -30,10 +30,29 @@ const char *lcc_errormsg[]=
   /* 2013 */ "Invalid buffer size",
   /* 2014 */ "This server version is not supported anymore",
   /* 2015 */ "Unknown or invalid handle",
-  /* 2016 */ "Unknown field attribute (=%d)."
-  /* 2017 */ "No result set available."
-  /* 2018 */ "Statement doesn't have parameter(s)."
-  /* 2019 */ "Statement can't be executed yet."
+  /* 2016 */ "Unknown field attribute (=%d).",
+  /* 2017 */ "No result set available.",
+  /* 2018 */ "Statement doesn't have parameter(s).",
+  /* 2019 */ "Statement can't be executed yet.",
+  /* 2020 */ "Can't connect to server '%s' (%d).",
+  /* 2021 */ "Statement is not a read-only query.",
+  /* 2022 */ "Backend is not available (circuit open).",
+  /* 2023 */ "Backend concurrency limit (%u) reached.",
+  /* 2024 */ "Connection has a pending result.",
+  /* 2025 */ "Pool has no connections.",
+  /* 2026 */ "Transaction of group commit was rolled back (error %u).",
+  /* 2027 */ "Deadline of command exceeded.",
+  /* 2028 */ "Result set of shard %u doesn't match (%u columns).",
+  /* 2029 */ "Can't send local file '%s' (%d).",
+  /* 2030 */ "Event loop was stopped.",
+  /* 2031 */ "Asynchronous operation is in progress.",
+  /* 2032 */ "Row type has %u fields, result has %u columns.",
+  /* 2033 */ "Column %u ('%s') doesn't match the field type of the row.",
+  /* 2034 */ "Value of column %u ('%s') can't be converted to the field type.",
+  /* 2035 */ "Statement has %u parameters, %u were given.",
+  /* 2036 */ "NUMA node %d is not available.",
+  /* 2037 */ "Sort column %u ('%s') is not binary and can't be merged.",
+  /* 2038 */ "NUMA node of a busy connection can't be changed."
 };
 
 #define LCC_CLIENT_ERROR(x) lcc_errormsg[(x)-2000]
@@ -0,0 +1,318 @@
+/* client side group commit for autocommit writes */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* default settings */
+#define LCC_GROUP_COMMIT_MAX_COUNT 128
+#define LCC_GROUP_COMMIT_WINDOW 2000
+
+/* server error which rolls back the entire transaction */
+#define LCC_ER_LOCK_DEADLOCK 1213
+
+#define LCC_BEGIN_SQL "START TRANSACTION"
+#define LCC_COMMIT_SQL "COMMIT"
+
+LCC_ERRNO
+lcc_group_commit_init(lcc_group_commit *group, lcc_connection *conn)
+{
+  pthread_condattr_t attr;
+
+  if (pthread_mutex_init(&group->lock, NULL))
+    return ER_UNKNOWN;
+
+  /* wait times are calculated with lcc_now_usec() */
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  if (pthread_cond_init(&group->cond, &attr))
+  {
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_destroy(&group->lock);
+    return ER_UNKNOWN;
+  }
+  pthread_condattr_destroy(&attr);
+
+  group->conn= conn;
+  group->max_count= LCC_GROUP_COMMIT_MAX_COUNT;
+  group->window= LCC_GROUP_COMMIT_WINDOW;
+  return ER_OK;
+}
+
+/**
+ * @brief: releases group commit handle
+ *
+ * The handle must not be in use by other threads.
+ */
+void
+lcc_group_commit_close(lcc_group_commit *group)
+{
+  if (group->conn)
+    lcc_list_clear_element(group->conn->handles, group);
+  pthread_cond_destroy(&group->cond);
+  pthread_mutex_destroy(&group->lock);
+}
+
+/* reads the response of a pipelined command */
+static LCC_ERRNO
+lcc_group_commit_response(lcc_connection *conn)
+{
+  LCC_ERRNO rc;
+
+  conn->column_count= 0;
+  if ((rc= lcc_read_response(conn)))
+    return rc;
+  /* e.g. INSERT ... RETURNING */
+  if (conn->column_count)
+    return lcc_skip_result(conn);
+  return ER_OK;
+}
+
+/* sets error for all entries which didn't fail yet */
+static void
+lcc_group_commit_fail(lcc_group_commit_entry *entry, LCC_ERRNO rc, LCC_ERROR *error)
+{
+  for (; entry; entry= entry->next)
+  {
+    if (entry->rc)
+      continue;
+    entry->affected_rows= entry->last_insert_id= 0;
+    entry->rc= rc;
+    memcpy(&entry->error, error, sizeof(LCC_ERROR));
+  }
+}
+
+/* marks successful statements between entry and end as rolled back */
+static void
+lcc_group_commit_abort(lcc_group_commit_entry *entry,
+                       lcc_group_commit_entry *end,
+                       uint16_t error_no)
+{
+  for (; entry != end; entry= entry->next)
+  {
+    if (entry->rc)
+      continue;
+    entry->affected_rows= entry->last_insert_id= 0;
+    entry->rc= lcc_set_error(&entry->error, LCC_ERROR_INFO, ER_GROUP_COMMIT_ABORTED,
+                             "40001", NULL, error_no);
+  }
+}
+
+/**
+ * @brief: executes a batch of statements in one transaction
+ *
+ * All statements (including START TRANSACTION and COMMIT) are sent
+ * with one write, afterwards the responses are read in order.
+ * Each statement receives its own result. If the server rolled back
+ * the transaction (e.g. deadlock), the statements which were executed
+ * before will be marked with ER_GROUP_COMMIT_ABORTED, while the
+ * remaining statements were executed in autocommit mode.
+ */
+static void
+lcc_group_commit_run(lcc_connection *conn, lcc_group_commit_entry *batch)
+{
+  lcc_group_commit_entry *entry;
+  uint8_t in_trans= 1;
+  uint16_t last_error= 0;
+  LCC_ERRNO rc;
+
+  lcc_clear_error(&conn->error);
+  conn->io.write_pos= conn->io.writebuf;
+
+  rc= lcc_io_queue(conn, CMD_QUERY, LCC_BEGIN_SQL, strlen(LCC_BEGIN_SQL));
+  for (entry= batch; entry && !rc; entry= entry->next)
+    rc= lcc_io_queue(conn, CMD_QUERY, (char *)entry->statement, entry->length);
+  if (rc ||
+      (rc= lcc_io_queue(conn, CMD_QUERY, LCC_COMMIT_SQL, strlen(LCC_COMMIT_SQL))) ||
+      (rc= lcc_io_flush(conn)))
+  {
+    conn->io.write_pos= conn->io.writebuf;
+    lcc_group_commit_fail(batch, rc, &conn->error);
+    return;
+  }
+
+  if ((rc= lcc_group_commit_response(conn)))
+  {
+    if (lcc_is_client_error(rc))
+    {
+      lcc_group_commit_fail(batch, rc, &conn->error);
+      return;
+    }
+    /* statements will be executed in autocommit mode */
+    in_trans= 0;
+  }
+
+  for (entry= batch; entry; entry= entry->next)
+  {
+    if ((rc= lcc_group_commit_response(conn)))
+    {
+      if (lcc_is_client_error(rc))
+      {
+        /* outcome of the open transaction is unknown */
+        lcc_group_commit_fail(in_trans ? batch : entry, rc, &conn->error);
+        return;
+      }
+      entry->rc= rc;
+      memcpy(&entry->error, &conn->error, sizeof(LCC_ERROR));
+      last_error= rc;
+
+      if (in_trans && rc == LCC_ER_LOCK_DEADLOCK)
+      {
+        lcc_group_commit_abort(batch, entry, rc);
+        in_trans= 0;
+      }
+      continue;
+    }
+
+    /* transaction was rolled back by a previous error (e.g. lock wait
+       timeout with innodb_rollback_on_timeout), so this statement was
+       executed in autocommit mode */
+    if (in_trans && !(conn->server.status & LCC_STATUS_IN_TRANS))
+    {
+      lcc_group_commit_abort(batch, entry, last_error);
+      in_trans= 0;
+    }
+    entry->affected_rows= conn->server.affected_rows;
+    entry->last_insert_id= conn->server.last_insert_id;
+  }
+
+  /* COMMIT */
+  if ((rc= lcc_group_commit_response(conn)) && in_trans)
+    lcc_group_commit_fail(batch, rc, &conn->error);
+}
+
+static void
+lcc_group_commit_wait(lcc_group_commit *group, uint64_t deadline)
+{
+  struct timespec ts;
+
+  ts.tv_sec= deadline / 1000000;
+  ts.tv_nsec= (deadline % 1000000) * 1000;
+  pthread_cond_timedwait(&group->cond, &group->lock, &ts);
+}
+
+/**
+ * @brief: executes an autocommit write as part of a group commit
+ *
+ * @param: group - group commit handle
+ * @param: statement - INSERT, UPDATE, DELETE or REPLACE statement
+ * @param: length - length of statement or LCC_NTS
+ * @param: affected_rows - returns number of affected rows (optional)
+ * @param: last_insert_id - returns last insert id (optional)
+ * @param: error - returns error information (optional)
+ *
+ * Statements of concurrent callers are collected until the configured
+ * number of statements (LCC_OPT_GROUP_COMMIT) is reached or the window
+ * of the first statement expired. The caller which queued the first
+ * statement becomes leader: it sends the batch pipelined within one
+ * transaction on the connection of the group commit handle, while the
+ * other callers wait for their result. This way a batch requires only
+ * one fsync on the server.
+ *
+ * Since statements of different callers share one transaction, a
+ * deadlock rolls back other callers' statements too: they will fail
+ * with ER_GROUP_COMMIT_ABORTED and should be retried.
+ *
+ * @return: ER_OK, client or server error code
+ */
+LCC_ERRNO API_FUNC
+LCC_group_commit_execute(LCC_HANDLE *handle,
+                         const char *statement,
+                         size_t length,
+                         uint64_t *affected_rows,
+                         uint64_t *last_insert_id,
+                         LCC_ERROR *error)
+{
+  lcc_group_commit *group= (lcc_group_commit *)handle;
+  lcc_group_commit_entry entry, *batch, *last, *next;
+  lcc_connection *conn;
+  const char *keywords[]= {"INSERT", "UPDATE", "DELETE", "REPLACE", NULL};
+  uint64_t deadline;
+  uint32_t count;
+
+  if (lcc_validate_handle(handle, LCC_GROUP_COMMIT))
+    return ER_INVALID_HANDLE;
+  if (!statement)
+    return ER_INVALID_POINTER;
+
+  if ((ssize_t)length == -1)
+    length= strlen(statement);
+
+  /* other statements might commit implicitly or return results */
+  if (!lcc_statement_starts_with(statement, length, keywords))
+  {
+    if (error)
+      lcc_set_error(error, LCC_ERROR_INFO, ER_INVALID_VALUE, "HY000", NULL);
+    return ER_INVALID_VALUE;
+  }
+
+  memset(&entry, 0, sizeof(lcc_group_commit_entry));
+  lcc_clear_error(&entry.error);
+  entry.statement= statement;
+  entry.length= length;
+  entry.enqueued= lcc_now_usec();
+
+  pthread_mutex_lock(&group->lock);
+  if (group->tail)
+    group->tail->next= &entry;
+  else
+    group->head= &entry;
+  group->tail= &entry;
+  if (++group->queued >= group->max_count)
+    pthread_cond_broadcast(&group->cond);
+
+  while (!entry.done)
+  {
+    if (group->leader || group->head != &entry)
+    {
+      pthread_cond_wait(&group->cond, &group->lock);
+      continue;
+    }
+
+    /* first statement in queue: collect the batch */
+    group->leader= 1;
+    deadline= entry.enqueued + group->window;
+    while (group->queued < group->max_count && lcc_now_usec() < deadline)
+      lcc_group_commit_wait(group, deadline);
+
+    batch= last= group->head;
+    for (count= 1; count < group->max_count && last->next; count++)
+      last= last->next;
+    if (!(group->head= last->next))
+      group->tail= NULL;
+    last->next= NULL;
+    group->queued-= count;
+    conn= group->conn;
+    pthread_mutex_unlock(&group->lock);
+
+    if (conn)
+      lcc_group_commit_run(conn, batch);
+    else
+    {
+      LCC_ERROR invalid;
+      lcc_set_error(&invalid, LCC_ERROR_INFO, ER_INVALID_HANDLE, "HY000", NULL);
+      lcc_group_commit_fail(batch, ER_INVALID_HANDLE, &invalid);
+    }
+
+    pthread_mutex_lock(&group->lock);
+    for (last= batch; last; last= next)
+    {
+      next= last->next;
+      last->done= 1;
+    }
+    group->batches++;
+    group->statements+= count;
+    group->leader= 0;
+    pthread_cond_broadcast(&group->cond);
+  }
+  pthread_mutex_unlock(&group->lock);
+
+  if (affected_rows)
+    *affected_rows= entry.affected_rows;
+  if (last_insert_id)
+    *last_insert_id= entry.last_insert_id;
+  if (error)
+    memcpy(error, &entry.error, sizeof(LCC_ERROR));
+  return entry.rc;
+}
@@ -0,0 +1,437 @@
+/* hedged reads across replicas */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <alloca.h>
+#include <sys/poll.h>
+
+/* don't hedge before we know the latency of a connection */
+#define LCC_HEDGE_MIN_SAMPLES 8
+#define LCC_HEDGE_DEFAULT_PERCENTILE 95
+#define LCC_HEDGE_NEVER UINT64_MAX
+
+/**
+ * @brief: stores the response time of a command
+ *
+ * @param: conn - a connection handle
+ * @param: usec - response time in microseconds
+ */
+void lcc_latency_add(lcc_connection *conn, uint64_t usec)
+{
+  lcc_latency *latency= &conn->latency;
+
+  latency->samples[latency->sample_pos]= (uint32_t)lcc_MIN(usec, (uint64_t)UINT32_MAX);
+  latency->sample_pos= (latency->sample_pos + 1) % LCC_LATENCY_SAMPLES;
+  if (latency->sample_count < LCC_LATENCY_SAMPLES)
+    latency->sample_count++;
+}
+
+static int lcc_cmp_uint32(const void *a, const void *b)
+{
+  uint32_t v1= *(const uint32_t *)a,
+           v2= *(const uint32_t *)b;
+  return (v1 > v2) - (v1 < v2);
+}
+
+/**
+ * @brief: returns the given percentile of the recent response times
+ *
+ * @param: conn - a connection handle
+ * @param: percentile - percentile (1..100)
+ *
+ * @return: response time in microseconds, 0 if no samples are available
+ */
+uint32_t lcc_latency_percentile(lcc_connection *conn, uint8_t percentile)
+{
+  uint32_t sorted[LCC_LATENCY_SAMPLES];
+  uint32_t count= conn->latency.sample_count;
+  uint32_t rank;
+
+  if (!count)
+    return 0;
+
+  memcpy(sorted, conn->latency.samples, count * sizeof(uint32_t));
+  qsort(sorted, count, sizeof(uint32_t), lcc_cmp_uint32);
+
+  /* nearest rank */
+  rank= (count * lcc_MIN(percentile, 100) + 99) / 100;
+  return sorted[rank ? rank - 1 : 0];
+}
+
+/* time in usec we wait for a response before the query will be sent
+   to the next replica, hedging must be enabled (LCC_OPT_HEDGE_READS) */
+static uint64_t lcc_hedge_delay(lcc_connection *conn)
+{
+  uint64_t min_delay= (uint64_t)conn->configuration.hedge_min_delay * 1000;
+  uint8_t percentile= conn->configuration.hedge_percentile ?
+                      conn->configuration.hedge_percentile : LCC_HEDGE_DEFAULT_PERCENTILE;
+
+  if (!conn->configuration.hedge_reads)
+    return LCC_HEDGE_NEVER;
+  if (conn->latency.sample_count < LCC_HEDGE_MIN_SAMPLES)
+    return min_delay ? min_delay : LCC_HEDGE_NEVER;
+  return lcc_MAX((uint64_t)lcc_latency_percentile(conn, percentile), min_delay);
+}
+
+/**
+ * @brief: checks if statement starts with one of the given keywords
+ *
+ * @param: statement - SQL statement
+ * @param: length - length of statement
+ * @param: keywords - NULL terminated list of keywords (upper case)
+ *
+ * @return: 1 if statement starts with a keyword, otherwise 0
+ */
+uint8_t lcc_statement_starts_with(const char *statement, size_t length,
+                                  const char **keywords)
+{
+  const char *pos= statement,
+             *end= statement + length;
+  uint8_t i;
+
+  /* skip whitespaces and comments */
+  while (pos < end)
+  {
+    if (isspace(*pos))
+      pos++;
+    else if (end - pos > 1 && pos[0] == '/' && pos[1] == '*')
+    {
+      for (pos+= 2; end - pos > 1 && !(pos[0] == '*' && pos[1] == '/'); pos++);
+      pos+= 2;
+    }
+    else if (*pos == '#' || (end - pos > 2 && !strncmp(pos, "-- ", 3)))
+    {
+      while (pos < end && *pos != '\n')
+        pos++;
+    }
+    else
+      break;
+  }
+
+  for (i=0; keywords[i]; i++)
+  {
+    size_t len= strlen(keywords[i]);
+    if ((size_t)(end - pos) >= len &&
+        !strncasecmp(pos, keywords[i], len) &&
+        (pos + len == end || !(isalnum(pos[len]) || pos[len] == '_')))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief: returns the next word of a statement
+ *
+ * String literals, quoted identifiers and comments are skipped, the
+ * content of executable comments is part of the statement.
+ *
+ * @return: start of the word or NULL at the end of the statement
+ */
+static const char *lcc_statement_next_word(const char *pos, const char *end, size_t *len)
+{
+  while (pos < end)
+  {
+    if (isalnum(*pos) || *pos == '_' || *pos == '$')
+    {
+      const char *word= pos;
+
+      while (pos < end && (isalnum(*pos) || *pos == '_' || *pos == '$'))
+        pos++;
+      *len= (size_t)(pos - word);
+      return word;
+    }
+    if (*pos == '\'' || *pos == '"' || *pos == '`')
+    {
+      char quote= *pos++;
+
+      for (; pos < end && *pos != quote; pos++)
+        if (*pos == '\\' && quote != '`')
+          pos++;
+      pos++;
+    }
+    else if (end - pos > 1 && pos[0] == '/' && pos[1] == '*')
+    {
+      pos+= 2;
+      /* executable comment, skip version number */
+      if (pos < end && (*pos == '!' || (end - pos > 1 && pos[0] == 'M' && pos[1] == '!')))
+      {
+        for (pos+= (*pos == '!') ? 1 : 2; pos < end && isdigit(*pos); pos++);
+        continue;
+      }
+      for (; end - pos > 1 && !(pos[0] == '*' && pos[1] == '/'); pos++);
+      pos+= 2;
+    }
+    else if (*pos == '#' || (end - pos > 2 && !strncmp(pos, "-- ", 3)))
+    {
+      while (pos < end && *pos != '\n')
+        pos++;
+    }
+    else
+      pos++;
+  }
+  return NULL;
+}
+
+/* clauses which lock rows, write data or change sequences */
+static const char *lcc_writing_clauses[][5]= {
+  {"FOR", "UPDATE", NULL},
+  {"FOR", "SHARE", NULL},
+  {"LOCK", "IN", "SHARE", "MODE", NULL},
+  {"INTO", NULL},
+  {"NEXT", "VALUE", "FOR", NULL},
+  {"NEXTVAL", NULL},
+  {"SETVAL", NULL},
+  {"GET_LOCK", NULL}
+};
+
+/* checks if one of the writing clauses starts at word */
+static uint8_t lcc_is_writing_clause(const char *word, size_t len, const char *end)
+{
+  uint32_t i, j;
+
+  for (i=0; i < sizeof(lcc_writing_clauses) / sizeof(lcc_writing_clauses[0]); i++)
+  {
+    const char *pos= word;
+    size_t pos_len= len;
+
+    for (j=0; lcc_writing_clauses[i][j]; j++)
+    {
+      if (!pos || pos_len != strlen(lcc_writing_clauses[i][j]) ||
+          strncasecmp(pos, lcc_writing_clauses[i][j], pos_len))
+        break;
+      if (!lcc_writing_clauses[i][j + 1])
+        return 1;
+      pos= lcc_statement_next_word(pos + pos_len, end, &pos_len);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief: checks if a statement is read-only
+ *
+ * The statement must start with a keyword of a read-only command and
+ * must not lock rows (FOR UPDATE, LOCK IN SHARE MODE), write data
+ * (INTO @var, INTO OUTFILE/DUMPFILE) or change sequences.
+ *
+ * @return: 1 if statement is read-only, otherwise 0
+ */
+uint8_t lcc_is_read_only(const char *statement, size_t length)
+{
+  const char *keywords[]= {"SELECT", "SHOW", "DESCRIBE", "DESC", "EXPLAIN", NULL};
+  const char *end= statement + length, *word= statement;
+  size_t len= 0;
+
+  if (!lcc_statement_starts_with(statement, length, keywords))
+    return 0;
+  while ((word= lcc_statement_next_word(word + len, end, &len)))
+  {
+    if (lcc_is_writing_clause(word, len, end))
+      return 0;
+  }
+  return 1;
+}
+
+/* the response of a replica isn't needed: it will be discarded before
+   the connection is used the next time, the statement is killed if a
+   kill pool was configured */
+static void
+lcc_hedge_cancel(lcc_connection *conn)
+{
+  conn->abandoned= 1;
+  lcc_conn_cmd_done(conn, CMD_RESULT_CANCELED);
+  if (conn->kill_pool)
+    (void)lcc_io_cancel(conn);
+}
+
+/**
+ * @brief: sends a read-only query to several replicas
+ *
+ * @param: handles - array of connection handles, ordered by preference
+ * @param: count - number of connection handles
+ * @param: statement - SQL statement
+ * @param: length - length of statement or LCC_NTS
+ * @param: winner - returns the connection which answered first
+ *
+ * The statement is sent to the first connection. If no response
+ * arrives within the configured percentile (hedge_percentile) of the
+ * recent response times of that connection, the statement will also
+ * be sent to the next connection, and so on. The response of the first
+ * connection which answers will be read, the other connections are
+ * marked as abandoned: their responses will be discarded before
+ * the connection is used the next time. If a kill pool was configured
+ * (LCC_OPT_KILL_POOL), their statements are killed.
+ *
+ * The wait for a response is limited by the read timeout and the
+ * deadline of the connections.
+ *
+ * Since a statement might be executed more than once, only idempotent
+ * read-only statements are accepted, and the statement is only sent to
+ * further connections if hedging was enabled for the first connection
+ * (LCC_OPT_HEDGE_READS). Otherwise the next connection is only used if
+ * the statement can't be sent.
+ *
+ * @return: ER_OK or error code. On success the result of the statement
+ *          can be retrieved from winner.
+ */
+LCC_ERRNO API_FUNC
+LCC_hedged_execute(LCC_HANDLE **handles,
+                   uint32_t count,
+                   const char *statement,
+                   size_t length,
+                   LCC_HANDLE **winner)
+{
+  struct pollfd *fds;
+  lcc_connection *conn;
+  uint64_t next_hedge= 0, now;
+  uint32_t sent= 0, pending= 0, i, j;
+  LCC_ERRNO rc= ER_OK;
+  int32_t timeout, wait;
+  uint8_t hedge_wait, expired;
+  int ready;
+
+  if (!handles || !count || !statement || !winner)
+    return ER_INVALID_POINTER;
+
+  *winner= NULL;
+  for (i=0; i < count; i++)
+    if (lcc_validate_handle(handles[i], LCC_CONNECTION))
+      return ER_INVALID_HANDLE;
+
+  if ((ssize_t)length == -1)
+    length= strlen(statement);
+
+  if (!lcc_is_read_only(statement, length))
+    return lcc_set_error(&((lcc_connection *)handles[0])->error, LCC_ERROR_INFO,
+                         ER_NOT_READ_ONLY, "HY000", NULL);
+
+  fds= (struct pollfd *)alloca(count * sizeof(struct pollfd));
+
+  for (;;)
+  {
+    /* send statement to next replica */
+    if (sent < count && lcc_now_usec() >= next_hedge)
+    {
+      conn= (lcc_connection *)handles[sent];
+      lcc_clear_error(&conn->error);
+      fds[sent].fd= conn->socket;
+      fds[sent].events= POLLIN;
+      fds[sent].revents= 0;
+
+      if ((rc= lcc_io_write(conn, CMD_QUERY, (char *)statement, length)))
+      {
+        /* try next replica immediately */
+        fds[sent++].fd= -1;
+        next_hedge= 0;
+        continue;
+      }
+      lcc_history_begin(conn, lcc_history_key(statement, length, 0));
+      pending++;
+      next_hedge= lcc_hedge_delay(conn);
+      if (next_hedge != LCC_HEDGE_NEVER)
+        next_hedge+= lcc_now_usec();
+      sent++;
+    }
+
+    if (!pending)
+      return rc;
+
+    /* response might be already buffered */
+    for (i=0; i < sent; i++)
+    {
+      conn= (lcc_connection *)handles[i];
+      fds[i].revents= 0;
+      if (fds[i].fd >= 0 && conn->io.read_pos < conn->io.read_end)
+        fds[i].revents= POLLIN;
+    }
+
+    for (i=0; i < sent && !fds[i].revents; i++);
+
+    if (i == sent)
+    {
+      /* wait until a response arrives, the statement has to be sent
+         to the next replica, or a pending connection times out */
+      timeout= -1;
+      for (j=0; j < sent; j++)
+      {
+        if (fds[j].fd < 0)
+          continue;
+        conn= (lcc_connection *)handles[j];
+        wait= lcc_io_timeout(conn, conn->configuration.read_timeout);
+        if (wait >= 0 && (timeout < 0 || wait < timeout))
+          timeout= wait;
+      }
+      hedge_wait= 0;
+      if (sent < count && next_hedge != LCC_HEDGE_NEVER)
+      {
+        now= lcc_now_usec();
+        wait= (next_hedge > now) ? (int32_t)((next_hedge - now + 999) / 1000) : 0;
+        if (timeout < 0 || wait <= timeout)
+        {
+          timeout= wait;
+          hedge_wait= 1;
+        }
+      }
+
+      do {
+        ready= poll(fds, sent, timeout);
+      } while (ready == -1 && errno == EINTR);
+
+      if (ready < 0)
+        return lcc_set_error(&((lcc_connection *)handles[0])->error, LCC_ERROR_INFO,
+                             ER_COMM_READ, "08001", NULL, errno);
+      if (!ready && hedge_wait)
+        continue;
+      if (!ready)
+      {
+        /* no replica answered in time */
+        now= lcc_now_usec();
+        expired= 0;
+        for (j=0; j < sent; j++)
+        {
+          if (fds[j].fd < 0)
+            continue;
+          conn= (lcc_connection *)handles[j];
+          if (conn->deadline && now >= conn->deadline)
+            expired= 1;
+          lcc_hedge_cancel(conn);
+        }
+        conn= (lcc_connection *)handles[0];
+        if (expired)
+          return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_DEADLINE_EXCEEDED, "HYT00", NULL);
+        return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_READ, "08001", NULL, ETIMEDOUT);
+      }
+
+      for (i=0; i < sent && (fds[i].fd < 0 || !fds[i].revents); i++);
+      if (i == sent)
+        continue;
+    }
+
+    conn= (lcc_connection *)handles[i];
+    rc= lcc_read_response(conn);
+
+    /* connection is broken: wait for the other replicas */
+    if ((rc == ER_COMM_READ || rc == ER_MALFORMED_PACKET) && pending > 1)
+    {
+      fds[i].fd= -1;
+      pending--;
+      continue;
+    }
+    break;
+  }
+
+  *winner= handles[i];
+
+  /* responses of the other replicas will be discarded later */
+  for (j=0; j < sent; j++)
+  {
+    if (j == i || fds[j].fd < 0)
+      continue;
+    lcc_hedge_cancel((lcc_connection *)handles[j]);
+  }
+  return rc;
+}
@@ -0,0 +1,188 @@
+/*
+ * Execution history of statements
+ *
+ * A connection remembers the result set sizes of the last statements
+ * (keyed by a hash of the statement text). When a statement is executed
+ * again, the read buffer, the memory of stored results and read-ahead
+ * batches are sized for the expected result, and large results can be
+ * read ahead by a helper thread (LCC_OPT_EXEC_HISTORY).
+ */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMM_HEADER_SIZE 4
+
+/* the read buffer is enlarged up to this size for streaming rows,
+   larger rows still grow it */
+#define LCC_HISTORY_READ_BUFFER 0x40000ULL
+#define LCC_HISTORY_MAX_SIZE 0x10000
+
+/**
+ * @brief: returns the history key of a statement
+ *
+ * @param: binary - 1 for prepared statements, their rows have a
+ *                  different size
+ */
+uint64_t
+lcc_history_key(const char *statement, size_t length, uint8_t binary)
+{
+  uint64_t key= lcc_hash(statement, length);
+
+  if (binary)
+    key^= 0x9e3779b97f4a7c15ULL;
+  return key ? key : 1;
+}
+
+/**
+ * @brief: starts recording the result set of a command
+ *
+ * Must be called after the command was sent, since sending a command
+ * stops recording.
+ */
+void
+lcc_history_begin(lcc_connection *conn, uint64_t key)
+{
+  lcc_history *history= &conn->history;
+
+  history->key= history->size ? key : 0;
+  history->rows= 0;
+  history->bytes= 0;
+  history->max_packet= 0;
+}
+
+/**
+ * @brief: returns the history of the pending command or NULL
+ */
+const lcc_history_entry *
+lcc_history_find(lcc_connection *conn)
+{
+  lcc_history *history= &conn->history;
+  lcc_history_entry *entry;
+
+  if (!history->key || !history->entries)
+    return NULL;
+  entry= &history->entries[history->key & (history->size - 1)];
+  return (entry->key == history->key) ? entry : NULL;
+}
+
+/**
+ * @brief: prepares the connection for the rows of a result set
+ *
+ * Called after the metadata of the result set was read: the read
+ * buffer is enlarged for the expected rows, or shrunk (not below its
+ * initial size) if the expected rows need much less space.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_history_apply(lcc_result *result)
+{
+  lcc_connection *conn= result->conn;
+  const lcc_history_entry *entry;
+  size_t size;
+
+  result->expected_rows= 0;
+  if (!(entry= lcc_history_find(conn)))
+    return ER_OK;
+  result->expected_rows= entry->rows;
+
+  size= (size_t)lcc_MIN(entry->bytes + entry->rows * COMM_HEADER_SIZE,
+                        LCC_HISTORY_READ_BUFFER);
+  size= lcc_MAX(size, (size_t)entry->max_packet + COMM_HEADER_SIZE);
+  if (size > conn->io.read_size && lcc_io_realloc(conn, size))
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, size);
+  /* results became smaller: release the memory, small changes don't
+     reallocate the buffer */
+  if (size <= conn->io.read_size / 4)
+    lcc_io_shrink(conn, size);
+  return ER_OK;
+}
+
+/**
+ * @brief: records the result set after its last row was read
+ *
+ * Sizes grow with the last execution and shrink slowly, so results
+ * of varying size are rarely undersized.
+ */
+void
+lcc_history_end(lcc_connection *conn)
+{
+  lcc_history *history= &conn->history;
+  lcc_history_entry *entry;
+
+  if (!history->key)
+    return;
+  if (!history->entries &&
+      !(history->entries= (lcc_history_entry *)calloc(history->size, sizeof(lcc_history_entry))))
+  {
+    history->key= 0;
+    return;
+  }
+
+  entry= &history->entries[history->key & (history->size - 1)];
+  /* replaces another statement */
+  if (entry->key != history->key)
+  {
+    memset(entry, 0, sizeof(lcc_history_entry));
+    entry->key= history->key;
+  }
+  if (history->rows >= entry->rows)
+    entry->rows= history->rows;
+  else
+    entry->rows= (entry->rows * 3 + history->rows) / 4;
+  if (history->bytes >= entry->bytes)
+    entry->bytes= history->bytes;
+  else
+    entry->bytes= (entry->bytes * 3 + history->bytes) / 4;
+  if (history->max_packet >= entry->max_packet)
+    entry->max_packet= history->max_packet;
+  else
+    entry->max_packet= (entry->max_packet * 3 + history->max_packet) / 4;
+  if (entry->executions < UINT32_MAX)
+    entry->executions++;
+  history->key= 0;
+}
+
+/**
+ * @brief: configures the execution history of a connection
+ *
+ * @param: size - number of statements (rounded up to a power of 2),
+ *                0 = disabled
+ * @param: read_ahead_rows - result sets with at least this number of
+ *                expected rows are read ahead, 0 = never
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_history_set(lcc_connection *conn, uint32_t size, uint32_t read_ahead_rows)
+{
+  lcc_history *history= &conn->history;
+  uint32_t slots= 1;
+
+  if (size > LCC_HISTORY_MAX_SIZE)
+    return ER_INVALID_VALUE;
+  while (slots < size)
+    slots<<= 1;
+  if (!size)
+    slots= 0;
+
+  if (slots != history->size)
+  {
+    free(history->entries);
+    history->entries= NULL;
+    history->size= slots;
+  }
+  history->read_ahead_rows= read_ahead_rows;
+  history->key= 0;
+  return ER_OK;
+}
+
+void
+lcc_history_close(lcc_connection *conn)
+{
+  free(conn->history.entries);
+  memset(&conn->history, 0, sizeof(lcc_history));
+}
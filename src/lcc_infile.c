@@ -0,0 +1,286 @@
+/* LOAD DATA LOCAL INFILE: sends data requested by the server */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <lcc_pack.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#define COMM_HEADER_SIZE 4
+
+/* payload of a data packet */
+#define LCC_INFILE_PACKET_SIZE 0x40000
+
+extern uint32_t max_packet_size;
+
+/* buffer of the producer thread */
+typedef struct {
+  char *data;                 /* packet header + payload */
+  int64_t length;             /* payload, 0 = end of data, < 0 = error */
+  uint8_t filled;
+} lcc_infile_buffer;
+
+/* a producer thread fills one buffer by the callback, while the
+   other buffer is sent */
+typedef struct {
+  lcc_connection *conn;
+  const char *filename;
+  size_t packet_size;
+  lcc_infile_buffer buffers[2];
+  uint8_t stop;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} lcc_infile_producer;
+
+static inline size_t
+lcc_infile_packet_size(void)
+{
+  return lcc_MIN((size_t)LCC_INFILE_PACKET_SIZE, (size_t)max_packet_size - COMM_HEADER_SIZE);
+}
+
+/* header of the next data packet, the sequence continues the
+   sequence of the server's request */
+static void
+lcc_infile_header(lcc_connection *conn, char *header, size_t length)
+{
+  ui24_to_p(header, length);
+  header[3]= (char)++conn->io.read_pkt;
+}
+
+static void *
+lcc_infile_produce(void *arg)
+{
+  lcc_infile_producer *producer= (lcc_infile_producer *)arg;
+  lcc_callbacks *callbacks= &producer->conn->configuration.callbacks;
+  uint8_t i= 0;
+
+  for (;;)
+  {
+    lcc_infile_buffer *buffer= &producer->buffers[i];
+    int64_t length;
+
+    pthread_mutex_lock(&producer->lock);
+    while (buffer->filled && !producer->stop)
+      pthread_cond_wait(&producer->cond, &producer->lock);
+    if (producer->stop)
+    {
+      pthread_mutex_unlock(&producer->lock);
+      break;
+    }
+    pthread_mutex_unlock(&producer->lock);
+
+    length= callbacks->local_infile(callbacks->local_infile_data, producer->filename,
+                                    buffer->data + COMM_HEADER_SIZE, producer->packet_size);
+    if (length > (int64_t)producer->packet_size)
+      length= -1;
+
+    pthread_mutex_lock(&producer->lock);
+    buffer->length= length;
+    buffer->filled= 1;
+    pthread_cond_broadcast(&producer->cond);
+    pthread_mutex_unlock(&producer->lock);
+
+    if (length <= 0)
+      break;
+    i^= 1;
+  }
+  return NULL;
+}
+
+/**
+ * @brief: sends data of the infile callback
+ *
+ * Data is produced by a separate thread into two buffers, so the
+ * callback can fill the next packet while the current one is sent.
+ */
+static LCC_ERRNO
+lcc_infile_send_callback(lcc_connection *conn, const char *filename)
+{
+  lcc_infile_producer producer;
+  pthread_t thread;
+  uint8_t i= 0;
+  LCC_ERRNO rc= ER_OK;
+
+  memset(&producer, 0, sizeof(producer));
+  producer.conn= conn;
+  producer.filename= filename;
+  producer.packet_size= lcc_infile_packet_size();
+
+  if (!(producer.buffers[0].data= (char *)malloc(producer.packet_size + COMM_HEADER_SIZE)) ||
+      !(producer.buffers[1].data= (char *)malloc(producer.packet_size + COMM_HEADER_SIZE)))
+  {
+    free(producer.buffers[0].data);
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         producer.packet_size + COMM_HEADER_SIZE);
+  }
+  pthread_mutex_init(&producer.lock, NULL);
+  pthread_cond_init(&producer.cond, NULL);
+
+  if (pthread_create(&thread, NULL, lcc_infile_produce, &producer))
+  {
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_LOCAL_INFILE, "HY000", NULL, filename, errno);
+    goto end;
+  }
+
+  for (;;)
+  {
+    lcc_infile_buffer *buffer= &producer.buffers[i];
+
+    pthread_mutex_lock(&producer.lock);
+    while (!buffer->filled)
+      pthread_cond_wait(&producer.cond, &producer.lock);
+    pthread_mutex_unlock(&producer.lock);
+
+    if (buffer->length < 0)
+    {
+      rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_LOCAL_INFILE, "HY000", NULL, filename, EIO);
+      break;
+    }
+    if (!buffer->length)
+      break;
+
+    lcc_infile_header(conn, buffer->data, (size_t)buffer->length);
+    if ((rc= lcc_io_write_socket(conn, buffer->data, (size_t)buffer->length + COMM_HEADER_SIZE)))
+      break;
+
+    pthread_mutex_lock(&producer.lock);
+    buffer->filled= 0;
+    pthread_cond_broadcast(&producer.cond);
+    pthread_mutex_unlock(&producer.lock);
+    i^= 1;
+  }
+
+  pthread_mutex_lock(&producer.lock);
+  producer.stop= 1;
+  pthread_cond_broadcast(&producer.cond);
+  pthread_mutex_unlock(&producer.lock);
+  pthread_join(thread, NULL);
+
+end:
+  pthread_cond_destroy(&producer.cond);
+  pthread_mutex_destroy(&producer.lock);
+  free(producer.buffers[0].data);
+  free(producer.buffers[1].data);
+  return rc;
+}
+
+/* checks if the file is located in the directory for local files */
+static uint8_t
+lcc_infile_allowed(lcc_connection *conn, const char *filename, char *path)
+{
+  char dir[PATH_MAX];
+  size_t len;
+
+  if (!conn->configuration.local_infile_dir ||
+      !realpath(conn->configuration.local_infile_dir, dir) ||
+      !realpath(filename, path))
+    return 0;
+  len= strlen(dir);
+  return !strncmp(path, dir, len) && (path[len] == '/' || (len == 1 && dir[0] == '/'));
+}
+
+/**
+ * @brief: sends a file in packets, the payload is sent by
+ *         sendfile(), so it isn't copied to user space
+ */
+static LCC_ERRNO
+lcc_infile_send_file(lcc_connection *conn, const char *path)
+{
+  char header[COMM_HEADER_SIZE];
+  size_t packet_size= lcc_infile_packet_size();
+  struct stat st;
+  off_t remaining;
+  LCC_ERRNO rc= ER_OK;
+  int fd;
+
+  if ((fd= open(path, O_RDONLY)) < 0)
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_LOCAL_INFILE, "HY000", NULL, path, errno);
+  if (fstat(fd, &st))
+  {
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_LOCAL_INFILE, "HY000", NULL, path, errno);
+    goto end;
+  }
+
+  for (remaining= st.st_size; remaining > 0 && !rc; remaining-= (off_t)packet_size)
+  {
+    if ((size_t)remaining < packet_size)
+      packet_size= (size_t)remaining;
+    lcc_infile_header(conn, header, packet_size);
+    if (!(rc= lcc_io_write_socket(conn, header, COMM_HEADER_SIZE)))
+      rc= lcc_io_send_file(conn, fd, packet_size);
+  }
+  /* file was truncated: the header announced more data than was sent,
+     the packet can't be completed and the connection is unusable */
+  if (rc == ER_LOCAL_INFILE)
+  {
+    lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+    shutdown(conn->socket, SHUT_RDWR);
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, EIO);
+  }
+end:
+  close(fd);
+  return rc;
+}
+
+/**
+ * @brief: answers a LOCAL INFILE request of the server
+ *
+ * @param: conn - connection
+ * @param: filename - file name of the LOAD DATA statement
+ * @param: length - length of file name
+ *
+ * If a callback was registered (LCC_OPT_LOCAL_INFILE_CALLBACK), the data
+ * is read by the callback, otherwise the file will be sent if it is
+ * located below the directory specified by LCC_OPT_LOCAL_INFILE_DIR.
+ * The data ends with an empty packet.
+ *
+ * If the data can't be read, the data which was sent already will be
+ * loaded by the server: the server's response is consumed and
+ * ER_LOCAL_INFILE is returned, so the caller can roll back. If a file
+ * is truncated while it is sent, the connection is broken and
+ * ER_COMM_WRITE is returned.
+ *
+ * @return: ER_OK if the response of the server can be read, otherwise
+ *          error code
+ */
+LCC_ERRNO
+lcc_local_infile(lcc_connection *conn, const char *filename, size_t length)
+{
+  char name[PATH_MAX], path[PATH_MAX], header[COMM_HEADER_SIZE];
+  LCC_ERROR error;
+  LCC_ERRNO rc;
+
+  if (length >= PATH_MAX)
+    length= PATH_MAX - 1;
+  memcpy(name, filename, length);
+  name[length]= 0;
+
+  if (conn->configuration.callbacks.local_infile)
+    rc= lcc_infile_send_callback(conn, name);
+  else if (lcc_infile_allowed(conn, name, path))
+    rc= lcc_infile_send_file(conn, path);
+  else
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_LOCAL_INFILE, "HY000", NULL, name, EACCES);
+
+  if (rc && rc != ER_LOCAL_INFILE)
+    return rc;
+
+  /* end of data */
+  lcc_infile_header(conn, header, 0);
+  if (rc == ER_OK)
+    return lcc_io_write_socket(conn, header, COMM_HEADER_SIZE);
+
+  memcpy(&error, &conn->error, sizeof(LCC_ERROR));
+  if ((rc= lcc_io_write_socket(conn, header, COMM_HEADER_SIZE)))
+    return rc;
+  /* response for the data which was sent before */
+  if (lcc_is_client_error(rc= lcc_read_response(conn)))
+    return rc;
+  memcpy(&conn->error, &error, sizeof(LCC_ERROR));
+  return ER_LOCAL_INFILE;
+}
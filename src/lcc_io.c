@@ -8,11 +8,17 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 #include <ctype.h>
 
 #define MAX_COMM_PACKET_SIZE 0xFFFFFF
 #define COMM_HEADER_SIZE 4
 #define COMM_CACHE_SIZE 0x4000
+/* ms to wait for the response of a killed statement */
+#define LCC_KILL_GRACE_TIME 5000
 
 #ifdef _WIN32
 #define socket_error() WinGetLastError()
@@ -22,6 +28,7 @@
 
 extern uint32_t comm_buffer_length;
 
+#ifdef LCC_DEBUG
 void lcc_dump(const char* title, const void* data, size_t size) {
 	char ascii[17];
 	size_t i, j;
@@ -51,6 +58,9 @@ void lcc_dump(const char* title, const void* data, size_t size) {
 		}
 	}
 }
+#else
+#define lcc_dump(title, data, size)
+#endif
 
 void 
 lcc_io_close(lcc_connection *conn)
@@ -59,8 +69,8 @@ lcc_io_close(lcc_connection *conn)
   {
     (void)lcc_io_write(conn, CMD_CLOSE, NULL, 0);
 
-    free(conn->io.readbuf);
-    free(conn->io.writebuf);
+    lcc_numa_free(conn->io.readbuf);
+    lcc_numa_free(conn->io.writebuf);
     free(conn->scramble.plugin);
     memset(&conn->io, 0, sizeof(lcc_io));
   }
@@ -72,8 +82,8 @@ lcc_io_close(lcc_connection *conn)
 LCC_ERRNO
 lcc_io_init(lcc_connection *connection)
 {
-  if ((connection->io.readbuf= calloc(1, comm_buffer_length)) &&
-      (connection->io.writebuf= calloc(1, comm_buffer_length)))
+  if ((connection->io.readbuf= lcc_numa_alloc(connection->numa_node, comm_buffer_length)) &&
+      (connection->io.writebuf= lcc_numa_alloc(connection->numa_node, comm_buffer_length)))
   {
     /* set initial size */
     connection->io.read_size=
@@ -97,14 +107,71 @@ lcc_io_realloc(lcc_connection *conn, size_t size)
   char *tmp;
   size_t new_size= lcc_align_size(MIN_COM_BUFFER_SIZE, size);
 
-  if (!(tmp= (char *)realloc(conn->io.readbuf, new_size)))
+  if (!(tmp= (char *)lcc_numa_realloc(conn->io.readbuf, new_size)))
     return ER_OUT_OF_MEMORY;
   conn->io.read_pos= tmp + (conn->io.read_pos - conn->io.readbuf);
+  conn->io.read_end= tmp + (conn->io.read_end - conn->io.readbuf);
   conn->io.readbuf= tmp;
   conn->io.read_size= new_size;
   return ER_OK;
 }
 
+/**
+ * @brief: shrinks the read buffer, but not below its initial size
+ *
+ * Data which was read already is kept. If it doesn't fit into the
+ * smaller buffer, the buffer keeps its size.
+ *
+ * @return: ER_OK on success, otherwise error number
+ **/
+LCC_ERRNO
+lcc_io_shrink(lcc_connection *conn, size_t size)
+{
+  lcc_io *io= &conn->io;
+  size_t cached_bytes= io->read_end - io->read_pos;
+
+  size= lcc_align_size(MIN_COM_BUFFER_SIZE, lcc_MAX(size, (size_t)comm_buffer_length));
+  if (size >= io->read_size || cached_bytes > size)
+    return ER_OK;
+  memmove(io->readbuf, io->read_pos, cached_bytes);
+  io->read_pos= io->readbuf;
+  io->read_end= io->readbuf + cached_bytes;
+  return lcc_io_realloc(conn, size);
+}
+
+/**
+ * @brief: moves the communication buffers to a NUMA node
+ *
+ * Results, statements and threads which are created afterwards use
+ * the node of the connection too.
+ *
+ * @return: ER_OK on success, otherwise error number
+ **/
+LCC_ERRNO
+lcc_io_set_node(lcc_connection *conn, int32_t node)
+{
+  char *readbuf, *writebuf;
+
+  if (!(readbuf= lcc_numa_alloc(node, conn->io.read_size)))
+    return ER_OUT_OF_MEMORY;
+  if (!(writebuf= lcc_numa_alloc(node, conn->io.write_size)))
+  {
+    lcc_numa_free(readbuf);
+    return ER_OUT_OF_MEMORY;
+  }
+  memcpy(readbuf, conn->io.readbuf, conn->io.read_size);
+  memcpy(writebuf, conn->io.writebuf, conn->io.write_size);
+  conn->io.read_pos= readbuf + (conn->io.read_pos - conn->io.readbuf);
+  conn->io.read_end= readbuf + (conn->io.read_end - conn->io.readbuf);
+  if (conn->io.write_pos)
+    conn->io.write_pos= writebuf + (conn->io.write_pos - conn->io.writebuf);
+  lcc_numa_free(conn->io.readbuf);
+  lcc_numa_free(conn->io.writebuf);
+  conn->io.readbuf= readbuf;
+  conn->io.writebuf= writebuf;
+  conn->numa_node= node;
+  return ER_OK;
+}
 
 uint32_t lcc_buffered_packets(lcc_connection *conn)
 {
@@ -140,36 +207,119 @@ uint32_t lcc_buffered_error_packet(lcc_connection *conn)
   return packet_nr;
 }
 
+/* commands which don't send a response */
+static inline uint8_t lcc_cmd_has_response(lcc_io_cmd command)
+{
+  return command != CMD_NONE &&
+         command != CMD_CLOSE &&
+         command != CMD_STMT_CLOSE &&
+         command != CMD_STMT_SEND_LONG_DATA;
+}
+
+/**
+ * @brief: called before a command which expects a response will be sent
+ *
+ * If the connection belongs to a backend, a slot of the backend's
+ * concurrency limit will be acquired.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_conn_cmd_start(lcc_connection *conn)
+{
+  LCC_ERRNO rc;
+
+  if (conn->backend && !conn->backend_slot)
+  {
+    if ((rc= lcc_backend_acquire(conn->backend)))
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, rc, "HY000", NULL,
+                           (uint32_t)conn->backend->limit);
+    conn->backend_slot= 1;
+  }
+  conn->latency.cmd_start= lcc_now_usec();
+  conn->deadline= conn->configuration.deadline ?
+                  conn->latency.cmd_start + (uint64_t)conn->configuration.deadline * 1000 : 0;
+  conn->killed= 0;
+
+  /* session state information belongs to the previous command */
+  conn->server.session_state_changed= 0;
+  if (conn->server.session_state)
+  {
+    lcc_list_delete(conn->server.session_state, lcc_clear_session_state);
+    conn->server.session_state= conn->server.current_session_state= NULL;
+  }
+  return ER_OK;
+}
+
+/**
+ * @brief: called when the first response packet of a command
+ *         was received, or the command failed or was abandoned
+ */
+void
+lcc_conn_cmd_done(lcc_connection *conn, lcc_cmd_result result)
+{
+  uint64_t rtt= 0;
+
+  if (conn->latency.cmd_start &&
+      (result == CMD_RESULT_OK || result == CMD_RESULT_SERVER_ERROR))
+  {
+    rtt= lcc_now_usec() - conn->latency.cmd_start;
+    lcc_latency_add(conn, rtt);
+    if (conn->pool)
+      lcc_pool_account(conn, rtt);
+  }
+  conn->latency.cmd_start= 0;
+
+  if (conn->backend_slot)
+  {
+    conn->backend_slot= 0;
+    if (conn->backend)
+      lcc_backend_release(conn->backend, result, rtt);
+  }
+}
+
+/* default wait implementation */
 static int
-lcc_io_wait(lcc_connection *conn, int32_t timeout, uint8_t type)
+lcc_io_poll(lcc_connection *conn, int32_t timeout, uint8_t type)
 {
   int rc;
 
 #ifndef _WIN32
-  struct pollfd p_fd;
+  struct pollfd p_fd[2];
+  nfds_t nfds= 1;
 #else
   struct timeval tv= {0,0};
   fd_set fds, exc_fds;
 #endif
 
 #ifndef _WIN32
-  memset(&p_fd, 0, sizeof(p_fd));
-  p_fd.fd= conn->socket;
+  memset(p_fd, 0, sizeof(p_fd));
+  p_fd[0].fd= conn->socket;
   if (type == 0) /* read */
-    p_fd.events= POLLIN;
+  {
+    p_fd[0].events= POLLIN;
+    if (conn->wakeup_fd >= 0)
+    {
+      p_fd[1].fd= conn->wakeup_fd;
+      p_fd[1].events= POLLIN;
+      nfds= 2;
+    }
+  }
   else
-    p_fd.events= POLLOUT;
-
-  /* if no timeout was specified, we set it to infinitive */
-  if (timeout == 0)
-      timeout= -1;
+    p_fd[0].events= POLLOUT;
 
+  /* timeout < 0: infinite */
   do {
-    rc= poll(&p_fd, 1, timeout);
+    rc= poll(p_fd, nfds, timeout);
   } while (rc == -1 && errno == EINTR);
 
   if (rc == 0)
     errno= ETIMEDOUT;
+  else if (rc > 0 && p_fd[1].revents)
+  {
+    rc= -1;
+    errno= ECANCELED;
+  }
 #else
   FD_ZERO(&fds);
   FD_ZERO(&exc_fds);
@@ -213,49 +363,242 @@ lcc_io_wait(lcc_connection *conn, int32_t timeout, uint8_t type)
   return rc;
 }
 
+/**
+ * @brief: waits until the socket is readable (type= 0) or writable
+ *
+ * An operation of LCC_async_start() returns to its caller instead,
+ * otherwise the wait callback (LCC_OPT_WAIT_CALLBACK) or poll() waits.
+ *
+ * @return: > 0 if the socket is ready, 0 on timeout, < 0 on error
+ */
+static int
+lcc_io_wait(lcc_connection *conn, int32_t timeout, uint8_t type)
+{
+  uint8_t events= type ? LCC_WAIT_WRITE : LCC_WAIT_READ;
+
+  /* helper thread which can be interrupted */
+  if (conn->wakeup_fd >= 0)
+    return lcc_io_poll(conn, timeout, type);
+  if (conn->async && conn->async->running)
+    return lcc_async_wait(conn, events, timeout);
+  if (conn->configuration.callbacks.wait)
+    return conn->configuration.callbacks.wait((LCC_HANDLE *)conn, conn->socket, events, timeout,
+                                              conn->configuration.callbacks.wait_data);
+  return lcc_io_poll(conn, timeout, type);
+}
+
+/* time in ms to wait for the socket (-1 = infinite), limited by
+   the deadline of the current command */
+int32_t
+lcc_io_timeout(lcc_connection *conn, int timeout)
+{
+  uint64_t now, remaining;
+
+  if (!conn->deadline)
+    return timeout > 0 ? timeout : -1;
+
+  now= lcc_now_usec();
+  if (now >= conn->deadline)
+    return 0;
+  remaining= lcc_MIN((conn->deadline - now + 999) / 1000, (uint64_t)INT32_MAX);
+  return timeout > 0 ? (int32_t)lcc_MIN((uint64_t)timeout, remaining) : (int32_t)remaining;
+}
+
+/**
+ * @brief: deadline of a command expired while waiting for the response,
+ *         or its response isn't needed anymore (hedged reads)
+ *
+ * The statement will be killed by KILL QUERY, sent over a connection
+ * borrowed from the kill pool (LCC_OPT_KILL_POOL). The server answers
+ * the killed statement with an error, so the connection stays in sync
+ * and can be used again.
+ *
+ * @return: ER_OK if the statement was killed
+ */
+LCC_ERRNO
+lcc_io_cancel(lcc_connection *conn)
+{
+  lcc_connection *killer;
+  char query[32];
+  int len;
+  LCC_ERRNO rc;
+
+  if (!conn->kill_pool || conn->killed)
+    return ER_UNKNOWN;
+
+  conn->killed= 1;
+  if (!(killer= lcc_pool_borrow(conn->kill_pool)))
+    return ER_POOL_EMPTY;
+
+  len= snprintf(query, sizeof(query), "KILL QUERY %u", conn->client.thread_id);
+  killer->column_count= 0;
+  rc= lcc_io_write(killer, CMD_QUERY, query, (size_t)len);
+  if (!rc)
+    rc= lcc_read_response(killer);
+  LCC_pool_checkin((LCC_HANDLE *)conn->kill_pool, (LCC_HANDLE *)killer);
+
+  /* wait a limited time for the error response */
+  if (!rc)
+    conn->deadline= lcc_now_usec() + LCC_KILL_GRACE_TIME * 1000;
+  return rc;
+}
+
+/* a packet was sent or read only partially: the protocol can't be
+   resumed, the connection can only be closed */
+static void
+lcc_io_broken(lcc_connection *conn)
+{
+  conn->broken= 1;
+  shutdown(conn->socket, SHUT_RDWR);
+}
+
+/* reading or writing timed out */
+static LCC_ERRNO
+lcc_io_timed_out(lcc_connection *conn, LCC_ERRNO error)
+{
+  lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+  if (conn->deadline && lcc_now_usec() >= conn->deadline)
+  {
+    /* the response will be discarded before the next command */
+    if (error == ER_COMM_READ)
+      conn->abandoned= 1;
+    else
+      lcc_io_broken(conn);
+    conn->deadline= 0;
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_DEADLINE_EXCEEDED, "HYT00", NULL);
+  }
+  lcc_io_broken(conn);
+  return lcc_set_error(&conn->error, LCC_ERROR_INFO, error, "08001", NULL, ETIMEDOUT);
+}
+
 LCC_ERRNO
 lcc_io_read_socket(lcc_connection *conn, char *buffer, size_t size, ssize_t *bytes_read)
 {
-  conn->configuration.read_timeout= 1000;
+  int rc;
 
   while ((*bytes_read= recv(conn->socket, buffer, size, MSG_DONTWAIT)) <= 0L)
   {
-    if ((socket_error() != EAGAIN) || conn->configuration.read_timeout == 0)
-      return ER_COMM_READ;
+    /* connection was closed or an error occurred */
+    if (!*bytes_read || socket_error() != EAGAIN)
+    {
+      lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+      lcc_io_broken(conn);
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_READ, "08001", NULL,
+                           *bytes_read ? errno : ECONNRESET);
+    }
+
+    if ((rc= lcc_io_wait(conn, lcc_io_timeout(conn, conn->configuration.read_timeout), 0)) < 0)
+    {
+      /* interrupted by wakeup_fd: the command isn't finished, the
+         remaining response can still be read */
+      if (errno != ECANCELED)
+      {
+        lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+        lcc_io_broken(conn);
+      }
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_READ, "08001", NULL, errno);
+    }
 
-    if (lcc_io_wait(conn, conn->configuration.read_timeout, 0) < 0)
+    if (!rc)
     {
-      lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_READ, "08001", NULL, errno);
-      return ER_COMM_READ;
+      if (conn->deadline && lcc_now_usec() >= conn->deadline &&
+          !lcc_io_cancel(conn))
+        continue;
+      return lcc_io_timed_out(conn, ER_COMM_READ);
     }
   }
   lcc_dump("read_socket", buffer, *bytes_read);
   return ER_OK;
 }
 
-static LCC_ERRNO
+LCC_ERRNO
 lcc_io_write_socket(lcc_connection *conn,
                       char *buffer,
                       size_t len)
 {
-  int rc;
+  ssize_t bytes_sent;
   int flags= MSG_DONTWAIT | MSG_NOSIGNAL;
-  conn->configuration.write_timeout= 1000;
+  int rc;
 
   lcc_dump("write_socket", buffer, len);
 
-  while ((rc= send(conn->socket, buffer, len, flags)) < -1)
+  while (len)
   {
-    if ((socket_error() != EAGAIN) || conn->configuration.write_timeout == 0)
-      return ER_COMM_WRITE;
+    if ((bytes_sent= send(conn->socket, buffer, len, flags)) > 0)
+    {
+      buffer+= bytes_sent;
+      len-= (size_t)bytes_sent;
+      continue;
+    }
+
+    if (socket_error() != EAGAIN)
+    {
+      lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+      lcc_io_broken(conn);
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, errno);
+    }
+
+    if ((rc= lcc_io_wait(conn, lcc_io_timeout(conn, conn->configuration.write_timeout), 1)) < 0)
+    {
+      lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+      lcc_io_broken(conn);
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, errno);
+    }
+    if (!rc)
+      return lcc_io_timed_out(conn, ER_COMM_WRITE);
+  }
+  return ER_OK;
+}
+
+/**
+ * @brief: sends length bytes of a file, starting at the current
+ *         file offset, without copying them into user space
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_io_send_file(lcc_connection *conn, int fd, size_t length)
+{
+  ssize_t bytes_sent;
+  int rc;
+
+  while (length)
+  {
+#ifdef __linux__
+    bytes_sent= sendfile(conn->socket, fd, NULL, length);
+#else
+    char buffer[COMM_CACHE_SIZE];
+
+    if ((bytes_sent= read(fd, buffer, lcc_MIN(length, sizeof(buffer)))) > 0)
+    {
+      if ((rc= lcc_io_write_socket(conn, buffer, (size_t)bytes_sent)))
+        return rc;
+    }
+#endif
+    if (bytes_sent > 0)
+    {
+      length-= (size_t)bytes_sent;
+      continue;
+    }
 
-    if (lcc_io_wait(conn, conn->configuration.write_timeout, 1) < 0)
+    /* file was truncated */
+    if (!bytes_sent)
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_LOCAL_INFILE, "HY000", NULL, "", EIO);
+
+    if (errno != EAGAIN)
+    {
+      lcc_io_broken(conn);
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, errno);
+    }
+
+    if ((rc= lcc_io_wait(conn, lcc_io_timeout(conn, conn->configuration.write_timeout), 1)) < 0)
     {
-      lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, errno);
-      return ER_COMM_WRITE;
+      lcc_io_broken(conn);
+      return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, errno);
     }
+    if (!rc)
+      return lcc_io_timed_out(conn, ER_COMM_WRITE);
   }
-  printf("sent - rc=%d\n", rc);
   return ER_OK;
 }
 
@@ -278,13 +621,16 @@ lcc_io_write_buffer(lcc_connection *conn,
   char *end= conn->io.writebuf + conn->io.write_size;
   uint32_t free_bytes= end - conn->io.write_pos;
 
+#ifdef LCC_DEBUG
   printf("wb: %u\n", len);
+#endif
 
   if (!buffer || !len)
     return ER_OK;
 
-  if (free_bytes > 0 && 
-      len > free_bytes)
+  /* buffer might contain several queued packets, so data could
+     exceed the buffer more than once */
+  while (len > free_bytes)
   {
     memcpy(conn->io.write_pos, buffer, free_bytes);
     if ((rc= lcc_io_write_socket(conn, conn->io.writebuf, end - conn->io.writebuf)))
@@ -292,6 +638,7 @@ lcc_io_write_buffer(lcc_connection *conn,
     conn->io.write_pos= conn->io.writebuf;
     buffer+= free_bytes;
     len-= free_bytes;
+    free_bytes= conn->io.write_size;
   }
   memcpy(conn->io.write_pos, buffer, len);
   conn->io.write_pos+= len;
@@ -299,20 +646,53 @@ lcc_io_write_buffer(lcc_connection *conn,
 }
 
 /**
-  * @brief: stores a logical packet into write buffer
+  * @brief: appends a logical packet to the write buffer without sending it
   * format: pkt_len (3 bytes) packet_number (1 byte) [command (1 byte)] data
+  *
+  * Several commands can be queued and sent with one lcc_io_flush() call
+  * (pipelining), their responses have to be read in the same order.
 **/
 LCC_ERRNO
-lcc_io_write(lcc_connection *conn, lcc_io_cmd command, char *buffer, size_t len)
+lcc_io_queue(lcc_connection *conn, lcc_io_cmd command, char *buffer, size_t len)
 {
   char header[COMM_HEADER_SIZE + 1];
   uint8_t pkt_nr= 0;
   LCC_ERRNO rc;
 
-  conn->io.write_pos= conn->io.writebuf;
+  if (conn->broken)
+  {
+    if (command == CMD_CLOSE)
+      return ER_OK;
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, ENOTCONN);
+  }
+
+  /* a previous command was abandoned (e.g. the slower replica of a
+     hedged read): its response needs to be consumed first, within
+     the deadline of the new command */
+  if (conn->abandoned && command != CMD_CLOSE)
+  {
+    conn->deadline= conn->configuration.deadline ?
+                    lcc_now_usec() + (uint64_t)conn->configuration.deadline * 1000 : 0;
+    if ((rc= lcc_drain_connection(conn)))
+    {
+      /* a killed statement answered within the grace time: the
+         connection is still in sync */
+      if (rc != ER_DEADLINE_EXCEEDED || conn->abandoned)
+        lcc_io_broken(conn);
+      return rc;
+    }
+  }
+
+  /* the result set of the command isn't recorded unless the caller
+     starts the history again */
+  if (command != CMD_NONE)
+    conn->history.key= 0;
 
   if (command == CMD_NONE)
     pkt_nr= 1;
+  else if (lcc_cmd_has_response(command) &&
+           (rc= lcc_conn_cmd_start(conn)))
+    return rc;
 //  else
 //    len+= 1;
 
@@ -345,17 +725,32 @@ lcc_io_write(lcc_connection *conn, lcc_io_cmd command, char *buffer, size_t len)
   if (command != CMD_NONE)
     header[4]= (uint8_t)command;
   if ((rc= lcc_io_write_buffer(conn, header, COMM_HEADER_SIZE + (command != CMD_NONE))) ||
-      (rc= lcc_io_write_buffer(conn, buffer, (uint32_t)len)) ||
-      (rc= lcc_io_flush(conn)))
+      (rc= lcc_io_write_buffer(conn, buffer, (uint32_t)len)))
       return rc;
   return ER_OK;
 }
 
+/**
+  * @brief: writes a logical packet and sends it to the server
+**/
+LCC_ERRNO
+lcc_io_write(lcc_connection *conn, lcc_io_cmd command, char *buffer, size_t len)
+{
+  LCC_ERRNO rc;
+
+  /* discard leftovers of a failed write */
+  conn->io.write_pos= conn->io.writebuf;
+
+  if ((rc= lcc_io_queue(conn, command, buffer, len)))
+    return rc;
+  return lcc_io_flush(conn);
+}
+
+/* makes sure that at least length bytes are available in read buffer */
 static LCC_ERRNO
-lcc_io_read_buffer(lcc_connection *conn, size_t *length)
+lcc_io_read_buffer(lcc_connection *conn, size_t length)
 {
   lcc_io *io= &conn->io;
-  size_t cached_bytes= io->read_end - io->read_pos;
   ssize_t bytes_read;
   LCC_ERRNO rc;
 
@@ -365,25 +760,30 @@ lcc_io_read_buffer(lcc_connection *conn, size_t *length)
     io->read_pos= io->read_end= io->readbuf;
   }
 
-  /* check if required data is cached */
-  if (cached_bytes >= *length)
+  while ((size_t)(io->read_end - io->read_pos) < length)
   {
-    return ER_OK;
-  }
+    size_t cached_bytes= io->read_end - io->read_pos;
 
-  /* move block to the beginning */
-  if (cached_bytes && io->read_pos > io->readbuf)
-  {
-    memmove(io->readbuf, io->read_pos, cached_bytes);
-    io->read_pos= io->readbuf;
-    io->read_end= io->readbuf + cached_bytes;
-  }
+    /* not enough space left: move block to the beginning */
+    if (io->read_pos > io->readbuf &&
+        io->read_pos + length > io->readbuf + io->read_size)
+    {
+      memmove(io->readbuf, io->read_pos, cached_bytes);
+      io->read_pos= io->readbuf;
+      io->read_end= io->readbuf + cached_bytes;
+    }
 
-  if ((rc= lcc_io_read_socket(conn, io->read_end, io->read_size - cached_bytes, &bytes_read)))
-    return rc;
+    if (length > io->read_size &&
+        (rc= lcc_io_realloc(conn, length)))
+      return rc;
 
-  /* mark end of readbuf */
-  io->read_end+= bytes_read;
+    if ((rc= lcc_io_read_socket(conn, io->read_end,
+                                io->read_size - (io->read_end - io->readbuf), &bytes_read)))
+      return rc;
+
+    /* mark end of readbuf */
+    io->read_end+= bytes_read;
+  }
   return ER_OK;
 }
 
@@ -401,30 +801,21 @@ lcc_io_read(lcc_connection *conn,
               size_t *pkt_len)
 {
   LCC_ERRNO rc;
-  size_t bytes_read;
   uint32_t len= 0;
   
   *pkt_len= 0;
 
   do {
-    bytes_read= COMM_HEADER_SIZE;
-    if ((rc= lcc_io_read_buffer(conn, &bytes_read)))
+    if ((rc= lcc_io_read_buffer(conn, COMM_HEADER_SIZE)))
       return rc;
-    if (bytes_read < COMM_HEADER_SIZE)
-      return ER_COMM_READ;
     len= p_to_ui24(conn->io.read_pos);
+    /* read_pos stays at the header until the packet is complete, so
+       an interrupted read can be continued */
+    if ((rc= lcc_io_read_buffer(conn, COMM_HEADER_SIZE + len)))
+      return rc;
+    conn->io.read_pkt= (uint8_t)conn->io.read_pos[3];
     conn->io.read_pos+= COMM_HEADER_SIZE;
     *pkt_len= len;
-    if (*pkt_len > conn->io.read_size)
-    {
-      rc= lcc_io_realloc(conn, *pkt_len);
-      if (rc)
-        return rc;
-    }
-    bytes_read= len;
-    rc= lcc_io_read_buffer(conn, &bytes_read);
-    if (rc)
-      return rc;
   }
   while (len == MAX_COMM_PACKET_SIZE);
 
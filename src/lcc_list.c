@@ -62,6 +62,7 @@ void lcc_list_clear_element(LCC_LIST *list, void *search)
       list->data= NULL;
       return;
     }
+    list= list->next;
   }
 }
 
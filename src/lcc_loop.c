@@ -0,0 +1,914 @@
+/* event loops: connections driven by non-blocking state machines
+
+   Each loop (shard) is a thread, optionally pinned to a CPU, with an
+   edge-triggered epoll instance. A connection belongs to one loop,
+   which sends its commands and reads the responses without blocking:
+   a response is received into the read buffer of the connection until
+   it is complete, then the completion callback runs on the loop
+   thread and can read the result from the buffer.
+   Other threads submit commands through a queue of the loop and wake
+   it up by an eventfd.
+*/
+#define _GNU_SOURCE
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <lcc_pack.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define COMM_HEADER_SIZE 4
+#define MAX_COMM_PACKET_SIZE 0xFFFFFF
+
+#define LCC_LOOP_EVENTS 256
+/* resolution of deadline timers in usec */
+#define LCC_LOOP_TIMER_RESOLUTION 1000
+
+/* position of the response scanner */
+enum {
+  LCC_LOOP_SCAN_RESPONSE= 0,
+  LCC_LOOP_SCAN_COLUMNS,      /* column definitions and EOF packet */
+  LCC_LOOP_SCAN_ROWS
+};
+
+LCC_ERRNO
+lcc_loop_init(lcc_loop *loop)
+{
+  cpu_set_t cpus;
+  long count;
+
+  lcc_clear_error(&loop->error);
+  /* one loop per CPU the process may run on */
+  if (!sched_getaffinity(0, sizeof(cpus), &cpus))
+    loop->shard_count= (uint32_t)CPU_COUNT(&cpus);
+  else if ((count= sysconf(_SC_NPROCESSORS_ONLN)) > 0)
+    loop->shard_count= (uint32_t)count;
+  if (!loop->shard_count)
+    loop->shard_count= 1;
+  loop->pin= 1;
+  loop->numa_node= -1;
+  return ER_OK;
+}
+
+/**
+ * @brief: binds the threads of a loop which wasn't started yet to
+ *         a NUMA node, one thread per CPU of the node is started
+ */
+LCC_ERRNO
+lcc_loop_set_node(lcc_loop *loop, int32_t node)
+{
+  cpu_set_t cpus;
+
+  if (loop->started)
+    return ER_INVALID_VALUE;
+  loop->numa_node= node;
+  if (node >= 0 && !sched_getaffinity(0, sizeof(cpus), &cpus))
+  {
+    lcc_numa_node_cpus(node, &cpus);
+    if (CPU_COUNT(&cpus))
+      loop->shard_count= (uint32_t)CPU_COUNT(&cpus);
+  }
+  return ER_OK;
+}
+
+static void
+lcc_loop_append(lcc_loop_task **head, lcc_loop_task **tail, lcc_loop_task *task)
+{
+  task->next= NULL;
+  if (*tail)
+    (*tail)->next= task;
+  else
+    *head= task;
+  *tail= task;
+}
+
+/**
+ * @brief: submits a task to a loop
+ *
+ * Tasks of the loop thread itself (e.g. submitted by a callback) are
+ * added to the run queue, other threads add them to the submission
+ * queue and wake up the loop if the queue was empty.
+ */
+static void
+lcc_loop_submit(lcc_loop_shard *shard, lcc_loop_task *task)
+{
+  uint64_t wakeup= 1;
+  uint8_t empty;
+
+  if (pthread_equal(pthread_self(), shard->thread))
+  {
+    lcc_loop_append(&shard->run_head, &shard->run_tail, task);
+    return;
+  }
+  pthread_mutex_lock(&shard->lock);
+  empty= !shard->submitted;
+  lcc_loop_append(&shard->submitted, &shard->submitted_tail, task);
+  pthread_mutex_unlock(&shard->lock);
+  if (empty && write(shard->event_fd, &wakeup, sizeof(wakeup)) < 0)
+  {
+    /* counter overflow: the loop is woken up anyway */
+  }
+}
+
+static lcc_loop_task *
+lcc_loop_task_alloc(lcc_loop_task_type type, lcc_connection *conn,
+                    LCC_LOOP_CALLBACK callback, void *data, size_t length)
+{
+  lcc_loop_task *task;
+
+  if (!(task= (lcc_loop_task *)malloc(sizeof(lcc_loop_task) + length)))
+    return NULL;
+  task->next= NULL;
+  task->type= type;
+  task->conn= conn;
+  task->callback= callback;
+  task->data= data;
+  task->length= length;
+  return task;
+}
+
+/* size of a command packet, split into parts of 16 MB */
+static inline size_t
+lcc_loop_packet_size(size_t length)
+{
+  return length + 1 + COMM_HEADER_SIZE * ((length + 1) / MAX_COMM_PACKET_SIZE + 1);
+}
+
+/* writes command and statement as packets, so they can be sent
+   without blocking */
+static void
+lcc_loop_packet(char *packet, lcc_io_cmd command, const char *statement, size_t length)
+{
+  size_t left= length + 1, part, len;
+  uint8_t pkt_nr= 0;
+
+  do {
+    part= lcc_MIN(left, (size_t)MAX_COMM_PACKET_SIZE);
+    ui24_to_p(packet, part);
+    packet[3]= (char)pkt_nr;
+    packet+= COMM_HEADER_SIZE;
+    left-= part;
+    len= part;
+    if (!pkt_nr++)
+    {
+      *packet++= (char)command;
+      len--;
+    }
+    memcpy(packet, statement, len);
+    packet+= len;
+    statement+= len;
+  } while (left || part == MAX_COMM_PACKET_SIZE);
+}
+
+/* receives all available data into the read buffer of connection */
+static LCC_ERRNO
+lcc_loop_recv(lcc_connection *conn)
+{
+  lcc_io *io= &conn->io;
+  ssize_t bytes_read;
+
+  if (io->read_pos == io->read_end)
+    io->read_pos= io->read_end= io->readbuf;
+
+  for (;;)
+  {
+    /* buffer is full: move unread data to the beginning or grow */
+    if (io->read_end == io->readbuf + io->read_size)
+    {
+      if (io->read_pos > io->readbuf)
+      {
+        size_t cached= io->read_end - io->read_pos;
+
+        memmove(io->readbuf, io->read_pos, cached);
+        io->read_pos= io->readbuf;
+        io->read_end= io->readbuf + cached;
+      }
+      else if (lcc_io_realloc(conn, io->read_size * 2))
+        return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                             io->read_size * 2);
+    }
+
+    bytes_read= recv(conn->socket, io->read_end, io->readbuf + io->read_size - io->read_end,
+                     MSG_DONTWAIT);
+    if (bytes_read > 0)
+    {
+      io->read_end+= bytes_read;
+      continue;
+    }
+    if (bytes_read < 0 && errno == EINTR)
+      continue;
+    if (bytes_read < 0 && errno == EAGAIN)
+      return ER_OK;
+    lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_READ, "08001", NULL,
+                         bytes_read ? errno : ECONNRESET);
+  }
+}
+
+/**
+ * @brief: checks if the response of the active command is complete
+ *
+ * The scan continues where the previous scan stopped. A response
+ * consists of OK, EOF or error packet, or a result set, followed by
+ * further responses if the server status has
+ * LCC_STATUS_MORE_RESULTS_EXIST set.
+ *
+ * @return: 1 if the response is complete
+ */
+uint8_t
+lcc_loop_scan(lcc_loop_conn *lc)
+{
+  lcc_io *io= &lc->conn->io;
+
+  for (;;)
+  {
+    char *start= io->read_pos + lc->scan_offset,
+         *pos= start;
+    u_char *pkt, *p;
+    size_t len, part;
+    uint16_t status= 0;
+    uint8_t error= 0;
+
+    /* packets of 16 MB or more consist of several parts */
+    do {
+      if (io->read_end - pos < COMM_HEADER_SIZE)
+        return 0;
+      part= p_to_ui24(pos);
+      if ((size_t)(io->read_end - pos) < COMM_HEADER_SIZE + part)
+        return 0;
+      pos+= COMM_HEADER_SIZE + part;
+    } while (part == MAX_COMM_PACKET_SIZE);
+
+    lc->scan_offset= pos - io->read_pos;
+    len= p_to_ui24(start);
+    pkt= (u_char *)start + COMM_HEADER_SIZE;
+
+    switch (lc->scan_phase) {
+    case LCC_LOOP_SCAN_RESPONSE:
+      if (!len)
+        return 1;
+      if (pkt[0] == 0xFF)
+      {
+        /* progress indication */
+        if (len >= 3 && p_to_ui16(pkt + 1) == 0xFFFF)
+          continue;
+        return 1;
+      }
+      /* local infile request */
+      if (pkt[0] == 0xFB)
+        return 1;
+      if (pkt[0] == 0x00)
+      {
+        p= pkt + 1;
+        (void)p_to_lenc(&p, pkt + len, &error);
+        (void)p_to_lenc(&p, pkt + len, &error);
+        if (!error && pkt + len - p >= 2)
+          status= p_to_ui16(p);
+      }
+      else if (pkt[0] == 0xFE && len < 9)
+      {
+        if (len >= 5)
+          status= p_to_ui16(pkt + 3);
+      }
+      else
+      {
+        p= pkt;
+        lc->scan_columns= p_to_lenc(&p, pkt + len, &error);
+        if (error)
+          return 1;
+        lc->scan_phase= LCC_LOOP_SCAN_COLUMNS;
+        continue;
+      }
+      if (!(status & LCC_STATUS_MORE_RESULTS_EXIST))
+        return 1;
+      break;
+    case LCC_LOOP_SCAN_COLUMNS:
+      if (lc->scan_columns)
+        lc->scan_columns--;
+      else
+        lc->scan_phase= LCC_LOOP_SCAN_ROWS;
+      break;
+    case LCC_LOOP_SCAN_ROWS:
+      if (len && pkt[0] == 0xFF)
+        return 1;
+      if (len && pkt[0] == 0xFE && len < 9)
+      {
+        if (len >= 5)
+          status= p_to_ui16(pkt + 3);
+        lc->scan_phase= LCC_LOOP_SCAN_RESPONSE;
+        if (!(status & LCC_STATUS_MORE_RESULTS_EXIST))
+          return 1;
+      }
+      break;
+    }
+  }
+}
+
+/* removes the active command and runs its callback */
+static void
+lcc_loop_complete(lcc_loop_conn *lc, LCC_ERRNO rc)
+{
+  lcc_loop_task *task= lc->head;
+
+  lcc_timer_cancel(&lc->shard->wheel, &lc->timer);
+  lc->head= task->next;
+  if (!lc->head)
+    lc->tail= NULL;
+  lc->state= LCC_LOOP_IDLE;
+  if (!lc->expired)
+    task->callback((LCC_HANDLE *)lc->conn, rc, task->data);
+  lc->expired= 0;
+  free(task);
+}
+
+/* fails the commands of a connection which was removed */
+static void
+lcc_loop_cancel(lcc_loop_task *task, LCC_ERRNO rc)
+{
+  while (task)
+  {
+    lcc_loop_task *next= task->next;
+
+    if (task->type == LCC_LOOP_REMOVE)
+      task->callback((LCC_HANDLE *)task->conn, ER_OK, task->data);
+    else
+      task->callback((LCC_HANDLE *)task->conn, rc, task->data);
+    free(task);
+    task= next;
+  }
+}
+
+static void
+lcc_loop_detach(lcc_loop_conn *lc)
+{
+  lcc_loop_shard *shard= lc->shard;
+
+  pthread_mutex_lock(&shard->lock);
+  if (lc->prev)
+    lc->prev->next= lc->next;
+  else
+    shard->conns= lc->next;
+  if (lc->next)
+    lc->next->prev= lc->prev;
+  pthread_mutex_unlock(&shard->lock);
+  __atomic_sub_fetch(&shard->conn_count, 1, __ATOMIC_RELAXED);
+  lc->conn->loop= NULL;
+}
+
+/* deadline of the active command exceeded: the command fails, the
+   response will be discarded when it arrives */
+static void
+lcc_loop_expired(lcc_timer *timer)
+{
+  lcc_loop_conn *lc= (lcc_loop_conn *)timer->data;
+  lcc_loop_task *task= lc->head;
+
+  lcc_conn_cmd_done(lc->conn, CMD_RESULT_CANCELED);
+  lcc_set_error(&lc->conn->error, LCC_ERROR_INFO, ER_DEADLINE_EXCEEDED, "HYT00", NULL);
+  lc->expired= 1;
+  task->callback((LCC_HANDLE *)lc->conn, ER_DEADLINE_EXCEEDED, task->data);
+}
+
+/**
+ * @brief: advances the state machine of a connection until it has to
+ *         wait for the socket
+ *
+ * @return: 1 if the connection was removed from the loop
+ */
+static uint8_t
+lcc_loop_drive(lcc_loop_conn *lc, uint32_t events)
+{
+  lcc_connection *conn= lc->conn;
+  LCC_ERRNO rc;
+
+  for (;;)
+  {
+    lcc_loop_task *task= lc->head;
+
+    switch (lc->state) {
+    case LCC_LOOP_IDLE:
+      if (!task)
+      {
+        /* detect a closed connection */
+        if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !lc->rc)
+          lc->rc= lcc_loop_recv(conn);
+        return 0;
+      }
+      if (task->type == LCC_LOOP_REMOVE)
+      {
+        lc->head= NULL;
+        epoll_ctl(lc->shard->epoll_fd, EPOLL_CTL_DEL, conn->socket, NULL);
+        lcc_loop_detach(lc);
+        free(lc);
+        lcc_loop_cancel(task, ER_LOOP_STOPPED);
+        return 1;
+      }
+      if (lc->rc)
+      {
+        lcc_loop_complete(lc, lc->rc);
+        break;
+      }
+      lcc_clear_error(&conn->error);
+      conn->column_count= 0;
+      conn->status= CONN_STATUS_READY;
+      if ((rc= lcc_conn_cmd_start(conn)))
+      {
+        lcc_loop_complete(lc, rc);
+        break;
+      }
+      if (conn->deadline)
+        lcc_timer_add(&lc->shard->wheel, &lc->timer, conn->deadline);
+      lc->write_offset= 0;
+      lc->scan_offset= 0;
+      lc->scan_phase= LCC_LOOP_SCAN_RESPONSE;
+      lc->state= LCC_LOOP_WRITING;
+      break;
+
+    case LCC_LOOP_WRITING:
+      while (lc->write_offset < task->length)
+      {
+        ssize_t bytes_sent= send(conn->socket, task->packet + lc->write_offset,
+                                 task->length - lc->write_offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytes_sent > 0)
+        {
+          lc->write_offset+= (size_t)bytes_sent;
+          continue;
+        }
+        if (errno == EINTR)
+          continue;
+        if (errno == EAGAIN)
+          return 0;
+        lcc_conn_cmd_done(conn, CMD_RESULT_COMM_ERROR);
+        lc->rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_COMM_WRITE, "08001", NULL, errno);
+        break;
+      }
+      if (lc->rc)
+        lcc_loop_complete(lc, lc->rc);
+      else
+        lc->state= LCC_LOOP_READING;
+      break;
+
+    case LCC_LOOP_READING:
+    {
+      size_t end;
+
+      if ((lc->rc= lcc_loop_recv(conn)))
+      {
+        lcc_loop_complete(lc, lc->rc);
+        break;
+      }
+      if (!lcc_loop_scan(lc))
+        return 0;
+
+      /* the response is buffered, so it can be read without blocking */
+      end= (conn->io.read_pos - conn->io.readbuf) + lc->scan_offset;
+      rc= lc->expired ? ER_OK : lcc_read_response(conn);
+      if (rc == ER_COMM_READ || rc == ER_COMM_WRITE)
+        lc->rc= rc;
+      lcc_loop_complete(lc, rc);
+      /* discard what the callback didn't read */
+      conn->io.read_pos= lcc_MIN(conn->io.readbuf + end, conn->io.read_end);
+      conn->status= CONN_STATUS_READY;
+      conn->column_count= 0;
+      break;
+    }
+    }
+  }
+}
+
+/* runs the tasks which were queued before */
+static void
+lcc_loop_run_tasks(lcc_loop_shard *shard)
+{
+  lcc_loop_task *task= shard->run_head;
+
+  shard->run_head= shard->run_tail= NULL;
+  while (task)
+  {
+    lcc_loop_task *next= task->next;
+    lcc_loop_conn *lc= task->conn->loop;
+
+    task->next= NULL;
+    if (task->type == LCC_LOOP_POST)
+    {
+      task->callback((LCC_HANDLE *)task->conn, ER_OK, task->data);
+      free(task);
+    }
+    else if (!lc || lc->shard != shard)
+      lcc_loop_cancel(task, ER_LOOP_STOPPED);
+    else
+    {
+      lcc_loop_append(&lc->head, &lc->tail, task);
+      if (lc->head == task)
+        lcc_loop_drive(lc, 0);
+    }
+    task= next;
+  }
+}
+
+static void *
+lcc_loop_run(void *arg)
+{
+  lcc_loop_shard *shard= (lcc_loop_shard *)arg;
+  struct epoll_event events[LCC_LOOP_EVENTS];
+  uint8_t stop= 0;
+
+  lcc_numa_prefer(shard->loop->numa_node);
+
+  while (!stop)
+  {
+    uint64_t next, now;
+    int i, count, timeout= -1;
+
+    lcc_loop_run_tasks(shard);
+
+    if ((next= lcc_timer_wheel_next(&shard->wheel)) != UINT64_MAX)
+    {
+      now= lcc_now_usec();
+      timeout= next > now ? (int)((next - now + 999) / 1000) : 0;
+    }
+    if ((count= epoll_wait(shard->epoll_fd, events, LCC_LOOP_EVENTS, timeout)) < 0)
+      count= 0;
+
+    for (i=0; i < count; i++)
+    {
+      if (!events[i].data.ptr)
+      {
+        uint64_t value;
+
+        /* submissions of other threads */
+        if (read(shard->event_fd, &value, sizeof(value)) < 0)
+        {
+          /* not signaled */
+        }
+        pthread_mutex_lock(&shard->lock);
+        if (shard->submitted)
+        {
+          if (shard->run_tail)
+            shard->run_tail->next= shard->submitted;
+          else
+            shard->run_head= shard->submitted;
+          shard->run_tail= shard->submitted_tail;
+          shard->submitted= shard->submitted_tail= NULL;
+        }
+        stop= shard->stop;
+        pthread_mutex_unlock(&shard->lock);
+        continue;
+      }
+      lcc_loop_drive((lcc_loop_conn *)events[i].data.ptr, events[i].events);
+    }
+
+    if (shard->wheel.count)
+      lcc_timer_wheel_advance(&shard->wheel, lcc_now_usec());
+  }
+  return NULL;
+}
+
+/* stops the loop threads and releases the loops */
+static void
+lcc_loop_stop(lcc_loop *loop, uint32_t count)
+{
+  uint32_t i;
+
+  for (i=0; i < count; i++)
+  {
+    lcc_loop_shard *shard= &loop->shards[i];
+    uint64_t wakeup= 1;
+
+    pthread_mutex_lock(&shard->lock);
+    shard->stop= 1;
+    pthread_mutex_unlock(&shard->lock);
+    if (write(shard->event_fd, &wakeup, sizeof(wakeup)) < 0)
+    {
+      /* the loop was already signaled */
+    }
+  }
+
+  for (i=0; i < count; i++)
+  {
+    lcc_loop_shard *shard= &loop->shards[i];
+
+    pthread_join(shard->thread, NULL);
+
+    /* commands which were not started */
+    if (shard->run_tail)
+      shard->run_tail->next= shard->submitted;
+    else
+      shard->run_head= shard->submitted;
+    lcc_loop_cancel(shard->run_head, ER_LOOP_STOPPED);
+
+    /* connections are detached, a command which was sent will be
+       discarded before the connection is used again */
+    while (shard->conns)
+    {
+      lcc_loop_conn *lc= shard->conns;
+      lcc_loop_task *tasks= lc->head;
+
+      if (lc->state != LCC_LOOP_IDLE)
+      {
+        lc->conn->abandoned= 1;
+        lcc_conn_cmd_done(lc->conn, CMD_RESULT_CANCELED);
+        if (lc->expired)
+        {
+          tasks= tasks->next;
+          free(lc->head);
+        }
+      }
+      lcc_loop_detach(lc);
+      free(lc);
+      lcc_loop_cancel(tasks, ER_LOOP_STOPPED);
+    }
+    close(shard->event_fd);
+    close(shard->epoll_fd);
+    pthread_mutex_destroy(&shard->lock);
+  }
+  free(loop->shards);
+  loop->shards= NULL;
+}
+
+void
+lcc_loop_close(lcc_loop *loop)
+{
+  if (loop->started)
+    lcc_loop_stop(loop, loop->shard_count);
+  loop->started= 0;
+}
+
+/**
+ * @brief: starts the event loop threads
+ *
+ * @param: handle - loop handle
+ *
+ * The number of threads and CPU pinning can be set by LCC_OPT_LOOP_THREADS
+ * before, by default one thread per CPU is started and thread n is
+ * pinned to the n-th CPU the process may run on. If the loop was bound
+ * to a NUMA node (LCC_OPT_NUMA_NODE), only CPUs of the node are used.
+ *
+ * @return: ER_OK or error code, ER_NUMA_NODE if the process may not run
+ *          on any CPU of the node
+ */
+LCC_ERRNO API_FUNC
+LCC_loop_start(LCC_HANDLE *handle)
+{
+  lcc_loop *loop= (lcc_loop *)handle;
+  struct epoll_event event;
+  cpu_set_t cpus;
+  uint32_t i, cpu= 0;
+
+  if (lcc_validate_handle(handle, LCC_LOOP))
+    return ER_INVALID_HANDLE;
+  if (loop->started)
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_ALREADY_INITIALIZED, "HY000", NULL);
+  if (sched_getaffinity(0, sizeof(cpus), &cpus))
+  {
+    loop->pin= 0;
+    CPU_ZERO(&cpus);
+  }
+  else
+  {
+    lcc_numa_node_cpus(loop->numa_node, &cpus);
+    /* none of the CPUs of the node is in the affinity mask */
+    if (!CPU_COUNT(&cpus))
+      return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_NUMA_NODE, "HY000", NULL,
+                           loop->numa_node);
+  }
+  if (!(loop->shards= (lcc_loop_shard *)calloc(loop->shard_count, sizeof(lcc_loop_shard))))
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         loop->shard_count * sizeof(lcc_loop_shard));
+
+  for (i=0; i < loop->shard_count; i++)
+  {
+    lcc_loop_shard *shard= &loop->shards[i];
+
+    shard->loop= loop;
+    shard->index= i;
+    lcc_timer_wheel_init(&shard->wheel, LCC_LOOP_TIMER_RESOLUTION, lcc_now_usec());
+    if ((shard->epoll_fd= epoll_create1(EPOLL_CLOEXEC)) < 0)
+      goto error;
+    if ((shard->event_fd= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+      close(shard->epoll_fd);
+      goto error;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events= EPOLLIN | EPOLLET;
+    event.data.ptr= NULL;
+    pthread_mutex_init(&shard->lock, NULL);
+    if (epoll_ctl(shard->epoll_fd, EPOLL_CTL_ADD, shard->event_fd, &event) ||
+        pthread_create(&shard->thread, NULL, lcc_loop_run, shard))
+    {
+      pthread_mutex_destroy(&shard->lock);
+      close(shard->event_fd);
+      close(shard->epoll_fd);
+      goto error;
+    }
+
+    if (loop->pin)
+    {
+      cpu_set_t set;
+
+      /* next CPU of the affinity mask */
+      while (!CPU_ISSET(cpu % CPU_SETSIZE, &cpus))
+        cpu++;
+      CPU_ZERO(&set);
+      CPU_SET(cpu % CPU_SETSIZE, &set);
+      pthread_setaffinity_np(shard->thread, sizeof(set), &set);
+      cpu++;
+    }
+    /* threads run on any CPU of the node */
+    else if (loop->numa_node >= 0 && CPU_COUNT(&cpus))
+      pthread_setaffinity_np(shard->thread, sizeof(cpus), &cpus);
+  }
+  loop->started= 1;
+  return ER_OK;
+
+error:
+  lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_UNKNOWN, "HY000", NULL);
+  lcc_loop_stop(loop, i);
+  return ER_UNKNOWN;
+}
+
+/**
+ * @brief: adds a connection to the loop with the fewest connections
+ *
+ * @param: handle - loop handle
+ * @param: connection - connected connection without pending result
+ *
+ * Afterwards the connection is owned by the loop thread: commands
+ * must be submitted by LCC_loop_execute() until the connection was
+ * removed by LCC_loop_remove().
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_loop_add(LCC_HANDLE *handle, LCC_HANDLE *connection)
+{
+  lcc_loop *loop= (lcc_loop *)handle;
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_loop_shard *shard;
+  struct epoll_event event;
+  lcc_loop_conn *lc;
+  uint32_t i;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_LOOP) ||
+      lcc_validate_handle(connection, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+  if (!loop->started)
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_LOOP_STOPPED, "HY000", NULL);
+  if (conn->loop)
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_ALREADY_INITIALIZED, "HY000", NULL);
+
+  /* response of an abandoned command */
+  if (conn->abandoned && (rc= lcc_drain_connection(conn)))
+  {
+    memcpy(&loop->error, &conn->error, sizeof(LCC_ERROR));
+    return rc;
+  }
+
+  /* buffers of the connection are placed on the node of the loop */
+  if (loop->numa_node >= 0 && conn->numa_node != loop->numa_node &&
+      (rc= lcc_io_set_node(conn, loop->numa_node)))
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, rc, "HY000", NULL, conn->io.read_size);
+
+  shard= &loop->shards[0];
+  for (i=1; i < loop->shard_count; i++)
+    if (__atomic_load_n(&loop->shards[i].conn_count, __ATOMIC_RELAXED) <
+        __atomic_load_n(&shard->conn_count, __ATOMIC_RELAXED))
+      shard= &loop->shards[i];
+
+  if (!(lc= (lcc_loop_conn *)calloc(1, sizeof(lcc_loop_conn))))
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         sizeof(lcc_loop_conn));
+  lc->shard= shard;
+  lc->conn= conn;
+  lc->timer.callback= lcc_loop_expired;
+  lc->timer.data= lc;
+  conn->loop= lc;
+
+  pthread_mutex_lock(&shard->lock);
+  lc->next= shard->conns;
+  if (shard->conns)
+    shard->conns->prev= lc;
+  shard->conns= lc;
+  pthread_mutex_unlock(&shard->lock);
+  __atomic_add_fetch(&shard->conn_count, 1, __ATOMIC_RELAXED);
+
+  memset(&event, 0, sizeof(event));
+  event.events= EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.ptr= lc;
+  if (epoll_ctl(shard->epoll_fd, EPOLL_CTL_ADD, conn->socket, &event))
+  {
+    lcc_loop_detach(lc);
+    free(lc);
+    return lcc_set_error(&loop->error, LCC_ERROR_INFO, ER_INVALID_SOCKET_DESCRIPTOR, "HY000", NULL);
+  }
+  return ER_OK;
+}
+
+/**
+ * @brief: removes a connection from its loop
+ *
+ * @param: connection - connection handle
+ * @param: callback - called on the loop thread when the connection was
+ *                    removed, after the commands submitted before
+ * @param: data - user data of callback
+ *
+ * Commands can't be submitted after the connection was removed, unless
+ * it is added again.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_loop_remove(LCC_HANDLE *connection, LCC_LOOP_CALLBACK callback, void *data)
+{
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_loop_task *task;
+
+  if (lcc_validate_handle(connection, LCC_CONNECTION) || !conn->loop)
+    return ER_INVALID_HANDLE;
+  if (!callback)
+    return ER_INVALID_POINTER;
+  if (!(task= lcc_loop_task_alloc(LCC_LOOP_REMOVE, conn, callback, data, 0)))
+    return ER_OUT_OF_MEMORY;
+  lcc_loop_submit(conn->loop->shard, task);
+  return ER_OK;
+}
+
+/**
+ * @brief: submits a statement to the loop which owns the connection
+ *
+ * @param: connection - connection which was added to a loop
+ * @param: statement - SQL statement, it is copied
+ * @param: length - length of statement or LCC_NTS
+ * @param: callback - called on the loop thread when the command completed
+ * @param: data - user data of callback
+ *
+ * Can be called by any thread. Commands of a connection are executed in
+ * the order they were submitted. The callback is called when the complete
+ * response was received: a result set can be read without blocking by a
+ * result handle, which must be closed before the callback returns. Further
+ * result sets are discarded.
+ * LOAD DATA LOCAL INFILE requests are answered on the loop thread,
+ * which blocks it while the data is sent.
+ * If a deadline was set (LCC_OPT_DEADLINE) and exceeded, the callback
+ * is called with ER_DEADLINE_EXCEEDED and the response will be discarded.
+ *
+ * @return: ER_OK if the statement was submitted, otherwise error code
+ *          (the callback will not be called)
+ */
+LCC_ERRNO API_FUNC
+LCC_loop_execute(LCC_HANDLE *connection,
+                 const char *statement,
+                 size_t length,
+                 LCC_LOOP_CALLBACK callback,
+                 void *data)
+{
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_loop_task *task;
+
+  if (lcc_validate_handle(connection, LCC_CONNECTION) || !conn->loop)
+    return ER_INVALID_HANDLE;
+  if (!statement || !callback)
+    return ER_INVALID_POINTER;
+  if ((ssize_t)length == -1)
+    length= strlen(statement);
+  if (!length)
+    return ER_INVALID_VALUE;
+
+  if (!(task= lcc_loop_task_alloc(LCC_LOOP_EXECUTE, conn, callback, data,
+                                  lcc_loop_packet_size(length))))
+    return ER_OUT_OF_MEMORY;
+  lcc_loop_packet(task->packet, CMD_QUERY, statement, length);
+  lcc_loop_submit(conn->loop->shard, task);
+  return ER_OK;
+}
+
+/**
+ * @brief: runs a function on the loop thread which owns the connection
+ *
+ * The function is called with rc ER_OK from the run queue of the loop,
+ * or with ER_LOOP_STOPPED if the loop was stopped before.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_loop_post(LCC_HANDLE *connection, LCC_LOOP_CALLBACK callback, void *data)
+{
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_loop_task *task;
+
+  if (lcc_validate_handle(connection, LCC_CONNECTION) || !conn->loop)
+    return ER_INVALID_HANDLE;
+  if (!callback)
+    return ER_INVALID_POINTER;
+  if (!(task= lcc_loop_task_alloc(LCC_LOOP_POST, conn, callback, data, 0)))
+    return ER_OUT_OF_MEMORY;
+  lcc_loop_submit(conn->loop->shard, task);
+  return ER_OK;
+}
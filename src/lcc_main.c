@@ -0,0 +1,95 @@
+/* test program: connects to a local server and executes a prepared statement */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <libsocket/libinetsocket.h>
+
+int main()
+{
+  LCC_HANDLE *conn, *stmt;
+  LCC_ERRNO rc;
+  LCC_BIND bind;
+  uint8_t eof= 0;
+  int sock, ret;
+  const char *filenames[]= {"/etc/my.cnf","/home/georg/.my.cnf", NULL};
+
+  LCC_init_handle(&conn, LCC_CONNECTION, NULL);
+
+  LCC_configuration_load_file(conn, filenames, NULL);
+
+  ret= sock= create_inet_stream_socket("localhost", "3306", LIBSOCKET_IPv4, 0);
+
+  if (ret < 0) {
+      printf("ret= %d\n", ret);
+      exit(1);
+  }
+
+  LCC_configuration_set(conn, NULL, LCC_OPT_SOCKET_NO, &sock);
+  LCC_configuration_set(conn, NULL, LCC_OPT_AUTH_PLUGIN, (void *)"mysql_native_password");
+  ((lcc_connection *)conn)->socket= sock;
+
+  rc= lcc_read_server_hello((lcc_connection *)conn);
+  printf("rc=%d\n", rc);
+
+  rc= lcc_send_client_hello((lcc_connection *)conn);
+  printf("rc=%d\n", rc);
+  rc= lcc_read_response((lcc_connection *)conn);
+  printf("rc=%d\n", rc);
+
+  LCC_init_handle(&stmt, LCC_STATEMENT, conn);
+  printf("----------------------------------------------\n");
+  rc= LCC_statement_prepare(stmt, "SELECT 1,2,3,?", -1);
+  printf("prepare rc=%d\n", rc);
+  rc= LCC_statement_read_prepare_response(stmt);
+  printf("prepare response rc=%d\n", rc);
+  printf("%s\n", ((lcc_stmt *)stmt)->error.error);
+
+  memset(&bind, 0, sizeof(LCC_BIND));
+  eof= 1;
+  bind.buffer.buf= &eof;
+  bind.buffer_type= LCC_COLTYPE_INT8;
+
+  rc= LCC_stmt_set_param((LCC_HANDLE *)stmt, &bind);
+  printf("rc=%d\n", rc);
+
+  rc= LCC_stmt_fill_exec_buffer((LCC_HANDLE *)stmt);
+  printf("fill exec buffer rc=%d\n", rc);
+
+  rc= LCC_stmt_execute((LCC_HANDLE *)stmt);
+  printf("stmt_execute rc=%d\n", rc);
+
+  rc= lcc_read_response(((lcc_stmt *)stmt)->conn);
+  printf("read_response rc=%d\n", rc);
+/*
+  rc= LCC_execute(conn, "SELECT 1,2,'foo' UNION SELECT 2,3,'bar' UNION SELECT 3,4,'foobar'", -1);
+  printf("rc=%d\n", rc);
+  rc= lcc_read_response((lcc_connection *)conn);
+  printf("rc=%d\n", rc);
+  LCC_init_handle(&result, LCC_RESULT, conn);
+  rc= lcc_read_result_metadata(stmt->result);
+
+  rc= LCC_get_info(result, RESULT_INFO_COLUMNS, &columns);
+  printf("rc=%d\n", rc);
+
+  while (!eof && rc == ER_OK) {
+    rc= lcc_result_fetch_one((lcc_result *)result, &eof);
+    if (!eof && !rc) {
+      int i;
+      for (i= 0; i < 3; i++)
+        printf("%.*s ", (int)((lcc_result *)result)->data[i].len, ((lcc_result *)result)->data[i].str);
+      printf("\n");
+    }
+  }
+  printf("max_length: %d  length: %d \n", columns[1].max_column_size, columns[1].column_size);
+  printf("num_rwos: %lu\n", ((lcc_result *)result)->row_count);
+
+  LCC_close_handle(result);
+*/
+  LCC_close_handle(conn);
+
+  destroy_inet_socket(sock);
+}
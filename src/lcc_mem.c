@@ -3,7 +3,7 @@
 #include <lcc_error.h>
 
 static lcc_mem_block
-*lcc_mem_new_block(size_t size)
+*lcc_mem_new_block(size_t size, int32_t node)
 {
   void *p, *end;
   lcc_mem_block *mem_block= NULL;
@@ -12,7 +12,8 @@ static lcc_mem_block
   total_size= size + sizeof(lcc_mem_block);
   total_size= lcc_align_size(LCC_MEM_ALIGN_SIZE, total_size);
 
-  if (!(p= mem_block= (lcc_mem_block *)malloc(total_size)))
+  /* zero filled */
+  if (!(p= mem_block= (lcc_mem_block *)lcc_numa_alloc(node, total_size)))
     return NULL;
   end= p + total_size;
 
@@ -20,7 +21,6 @@ static lcc_mem_block
   mem_block->buffer= p;
   mem_block->used_size= 0;
   mem_block->total_size= end - p;
-  memset(mem_block->buffer, 0, mem_block->total_size);
   mem_block->next= NULL;
 
   return mem_block;
@@ -33,11 +33,25 @@ static lcc_mem_block
 LCC_ERRNO
 lcc_mem_init(lcc_mem *mem,
               size_t prealloc)
+{
+  return lcc_mem_init_node(mem, prealloc, -1);
+}
+
+/**
+ * @brief: initializes a memory pool with blocks on a NUMA node
+ * @param: prealloc   size of preallocated buffer.
+ * @param: node       NUMA node, -1 = any
+ */
+LCC_ERRNO
+lcc_mem_init_node(lcc_mem *mem,
+                  size_t prealloc,
+                  int32_t node)
 {
   prealloc= lcc_align_size(LCC_MEM_ALIGN_SIZE, prealloc);
-  if (!(mem->block= lcc_mem_new_block(prealloc)))
+  if (!(mem->block= lcc_mem_new_block(prealloc, node)))
     return ER_OUT_OF_MEMORY;
   mem->prealloc_size= prealloc;
+  mem->node= node;
   mem->in_use= 1;
   return ER_OK;
 }
@@ -53,7 +67,7 @@ void *lcc_mem_alloc(lcc_mem *mem,
 {
 #define free_size(c) (c)->total_size - (c)->used_size
   lcc_mem_block *found_block= NULL, *current, *last= NULL;
-  size_t min= 0xFFFF;
+  size_t min= (size_t)~0;
 
   for (current= mem->block; current; current= current->next)
   {
@@ -69,7 +83,7 @@ void *lcc_mem_alloc(lcc_mem *mem,
   if (!found_block)
   {
     size_t new_size= lcc_align_size(LCC_MEM_ALIGN_SIZE, lcc_MAX(size, mem->prealloc_size));
-    found_block= last->next= lcc_mem_new_block(new_size);
+    found_block= last->next= lcc_mem_new_block(new_size, mem->node);
   }
 
   if (found_block)
@@ -81,6 +95,31 @@ void *lcc_mem_alloc(lcc_mem *mem,
   return NULL;
 }
 
+/**
+ * @brief: makes sure that size bytes can be allocated from the
+ *         memory pool without allocating another block
+ *
+ * @param: mem - memory pool
+ * @param: size - expected size of allocations
+ *
+ * @return: ER_OK or ER_OUT_OF_MEMORY
+ */
+LCC_ERRNO
+lcc_mem_reserve(lcc_mem *mem, size_t size)
+{
+  lcc_mem_block *current, *last= NULL;
+
+  for (current= mem->block; current; current= current->next)
+  {
+    if (free_size(current) >= size)
+      return ER_OK;
+    last= current;
+  }
+  if (!(last->next= lcc_mem_new_block(lcc_align_size(LCC_MEM_ALIGN_SIZE, size), mem->node)))
+    return ER_OUT_OF_MEMORY;
+  return ER_OK;
+}
+
 /**
  * @brief: closes memory pool and releases all memory
  *
@@ -92,7 +131,7 @@ void lcc_mem_close(lcc_mem *mem)
   {
     lcc_mem_block *free_block= mem->block;
     mem->block= mem->block->next;
-    free(free_block);
+    lcc_numa_free(free_block);
   }
   memset(mem, 0, sizeof(lcc_mem));
   return;
@@ -108,9 +147,8 @@ void lcc_mem_close(lcc_mem *mem)
  */
 void lcc_mem_reset(lcc_mem *mem)
 {
-  while (mem->block)
-  {
-    mem->block->used_size= 0;
-    mem->block= mem->block->next;
-  }
+  lcc_mem_block *block;
+
+  for (block= mem->block; block; block= block->next)
+    block->used_size= 0;
 }
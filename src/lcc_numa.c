@@ -0,0 +1,192 @@
+/*
+ * NUMA placement of connection buffers, memory pools and threads
+ *
+ * A connection, pool or loop which was bound to a node (LCC_OPT_NUMA_NODE)
+ * allocates its I/O buffers, result arenas and handles on that node and
+ * runs its threads on the CPUs of the node. Without libnuma only node -1
+ * (no binding) is available.
+ */
+#define _GNU_SOURCE
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+/* numa_alloc_onnode() maps whole pages by a system call: smaller
+   allocations (e.g. handles) are served by malloc and placed by the
+   memory policy of the calling thread, which prefers the node for
+   threads of a bound pool or loop */
+#define LCC_NUMA_MIN_SIZE 0x2000
+
+/* header of an allocation, keeps the data aligned */
+typedef union {
+  struct {
+    size_t size;              /* including header */
+    int32_t node;             /* -1: allocated by malloc */
+  } info;
+  char align[LCC_MEM_ALIGN_SIZE];
+} lcc_numa_header;
+
+/**
+ * @brief: checks if memory can be bound to node
+ *
+ * @return: 1 if node is -1 or a node of the system
+ */
+uint8_t
+lcc_numa_valid(int32_t node)
+{
+  if (node == -1)
+    return 1;
+#ifdef HAVE_LIBNUMA
+  if (node >= 0 && numa_available() >= 0 && node <= numa_max_node() &&
+      numa_bitmask_isbitset(numa_all_nodes_ptr, (unsigned int)node))
+    return 1;
+#endif
+  return 0;
+}
+
+/**
+ * @brief: allocates zero filled memory on node
+ *
+ * @param: node - NUMA node or -1 for the default policy
+ * @param: size - size of memory
+ *
+ * Only buffers and arenas of at least LCC_NUMA_MIN_SIZE bytes are
+ * bound to the node. The memory must be released by lcc_numa_free().
+ */
+void *
+lcc_numa_alloc(int32_t node, size_t size)
+{
+  lcc_numa_header *header;
+  size_t total= size + sizeof(lcc_numa_header);
+
+#ifdef HAVE_LIBNUMA
+  if (node >= 0 && total >= LCC_NUMA_MIN_SIZE)
+  {
+    /* pages of numa_alloc_onnode are zero filled */
+    if (!(header= (lcc_numa_header *)numa_alloc_onnode(total, node)))
+      return NULL;
+  }
+  else
+#endif
+  {
+    node= -1;
+    if (!(header= (lcc_numa_header *)calloc(1, total)))
+      return NULL;
+  }
+  header->info.size= total;
+  header->info.node= node;
+  return header + 1;
+}
+
+/**
+ * @brief: resizes memory of lcc_numa_alloc(), which stays on its node
+ *
+ * Like realloc() the new part isn't initialized and the memory isn't
+ * released if it can't be resized.
+ */
+void *
+lcc_numa_realloc(void *ptr, size_t size)
+{
+  lcc_numa_header *header;
+  size_t total= size + sizeof(lcc_numa_header);
+
+  if (!ptr)
+    return lcc_numa_alloc(-1, size);
+
+  header= (lcc_numa_header *)ptr - 1;
+#ifdef HAVE_LIBNUMA
+  if (header->info.node >= 0)
+  {
+    /* keeps the memory policy of the node */
+    if (!(header= (lcc_numa_header *)numa_realloc(header, header->info.size, total)))
+      return NULL;
+  }
+  else
+#endif
+  if (!(header= (lcc_numa_header *)realloc(header, total)))
+    return NULL;
+  header->info.size= total;
+  return header + 1;
+}
+
+void
+lcc_numa_free(void *ptr)
+{
+  lcc_numa_header *header;
+
+  if (!ptr)
+    return;
+  header= (lcc_numa_header *)ptr - 1;
+#ifdef HAVE_LIBNUMA
+  if (header->info.node >= 0)
+  {
+    numa_free(header, header->info.size);
+    return;
+  }
+#endif
+  free(header);
+}
+
+/**
+ * @brief: prefers node for memory which is allocated by the
+ *         calling thread
+ */
+void
+lcc_numa_prefer(int32_t node)
+{
+#ifdef HAVE_LIBNUMA
+  if (node >= 0)
+    numa_set_preferred(node);
+#else
+  (void)node;
+#endif
+}
+
+/**
+ * @brief: runs the calling thread on the CPUs of node and prefers its
+ *         memory
+ */
+void
+lcc_numa_bind_thread(int32_t node)
+{
+#ifdef HAVE_LIBNUMA
+  if (node >= 0)
+  {
+    numa_run_on_node(node);
+    numa_set_preferred(node);
+  }
+#else
+  (void)node;
+#endif
+}
+
+/**
+ * @brief: removes the CPUs which don't belong to node from cpus
+ */
+void
+lcc_numa_node_cpus(int32_t node, cpu_set_t *cpus)
+{
+#ifdef HAVE_LIBNUMA
+  struct bitmask *mask;
+  int cpu;
+
+  if (node < 0 || !(mask= numa_allocate_cpumask()))
+    return;
+  if (!numa_node_to_cpus(node, mask))
+  {
+    for (cpu= 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, cpus) && !numa_bitmask_isbitset(mask, (unsigned int)cpu))
+        CPU_CLR(cpu, cpus);
+  }
+  numa_free_cpumask(mask);
+#else
+  (void)node;
+  (void)cpus;
+#endif
+}
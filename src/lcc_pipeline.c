@@ -0,0 +1,297 @@
+/* pipeline: many threads share one connection
+
+   Threads submit commands through a lock-free queue. The owner thread of
+   the pipeline sends all commands which were submitted while it waited
+   for a response with one write, and reads the responses in order. Each
+   submitter receives its response by a completion callback, which runs
+   on the owner thread.
+*/
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+/* default number of commands in flight */
+#define LCC_PIPELINE_DEPTH 128
+
+/* discards what the completion callback didn't read */
+static LCC_ERRNO
+lcc_pipeline_skip(lcc_connection *conn)
+{
+  LCC_ERRNO rc= ER_OK;
+
+  if (conn->status != CONN_STATUS_READY)
+    rc= lcc_skip_result(conn);
+  while (!rc && (conn->server.status & LCC_STATUS_MORE_RESULTS_EXIST))
+  {
+    conn->column_count= 0;
+    if (!(rc= lcc_read_response(conn)) && conn->column_count)
+      rc= lcc_skip_result(conn);
+  }
+  conn->status= CONN_STATUS_READY;
+  conn->column_count= 0;
+  return rc;
+}
+
+/* calls the callbacks of all commands in list with rc */
+static void
+lcc_pipeline_fail(lcc_connection *conn, lcc_pipeline_task *task, LCC_ERRNO rc)
+{
+  while (task)
+  {
+    lcc_pipeline_task *next= task->next;
+
+    task->callback((LCC_HANDLE *)conn, rc, task->data);
+    free(task);
+    task= next;
+  }
+}
+
+/* waits until a command was submitted, returns NULL if the pipeline
+   was stopped */
+static lcc_pipeline_task *
+lcc_pipeline_wait(lcc_pipeline *pipeline)
+{
+  lcc_mpsc_node *node;
+
+  pthread_mutex_lock(&pipeline->lock);
+  /* submitters check sleeping after pushing */
+  __atomic_store_n(&pipeline->sleeping, 1, __ATOMIC_SEQ_CST);
+  while (!(node= lcc_mpsc_pop(&pipeline->queue)) && !pipeline->stop)
+    pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+  __atomic_store_n(&pipeline->sleeping, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&pipeline->lock);
+  return (lcc_pipeline_task *)node;
+}
+
+static void *
+lcc_pipeline_run(void *arg)
+{
+  lcc_pipeline *pipeline= (lcc_pipeline *)arg;
+  lcc_connection *conn= pipeline->conn;
+  lcc_pipeline_task *head= NULL, *tail= NULL, *task= NULL;
+  uint32_t in_flight= 0, queued;
+  LCC_ERRNO rc, broken= ER_OK;
+
+  lcc_numa_bind_thread(conn->numa_node);
+  for (;;)
+  {
+    /* send all submitted commands with one write */
+    conn->io.write_pos= conn->io.writebuf;
+    queued= 0;
+    while (in_flight < __atomic_load_n(&pipeline->depth, __ATOMIC_RELAXED) &&
+           (task || (task= (lcc_pipeline_task *)lcc_mpsc_pop(&pipeline->queue))))
+    {
+      if (broken)
+      {
+        task->next= NULL;
+        lcc_pipeline_fail(conn, task, broken);
+        task= NULL;
+        continue;
+      }
+      if ((rc= lcc_io_queue(conn, CMD_QUERY, task->statement, task->length)))
+      {
+        broken= rc;
+        continue;
+      }
+      task->next= NULL;
+      if (tail)
+        tail->next= task;
+      else
+        head= task;
+      tail= task;
+      task= NULL;
+      in_flight++;
+      queued++;
+    }
+
+    if (queued && !broken)
+    {
+      if ((rc= lcc_io_flush(conn)))
+        broken= rc;
+      else
+      {
+        __atomic_add_fetch(&pipeline->flushes, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pipeline->commands, queued, __ATOMIC_RELAXED);
+      }
+    }
+
+    if (broken && head)
+    {
+      lcc_pipeline_fail(conn, head, broken);
+      head= tail= NULL;
+      in_flight= 0;
+      continue;
+    }
+
+    if (head)
+    {
+      task= head;
+      if (!(head= head->next))
+        tail= NULL;
+      in_flight--;
+
+      conn->column_count= 0;
+      rc= lcc_read_response(conn);
+      if (!rc && conn->column_count)
+        conn->status= CONN_STATUS_FETCH;
+      task->callback((LCC_HANDLE *)conn, rc, task->data);
+      free(task);
+      task= NULL;
+
+      if (lcc_is_client_error(rc) ||
+          (lcc_is_client_error(rc= lcc_pipeline_skip(conn))))
+        broken= rc;
+      continue;
+    }
+
+    if (!(task= lcc_pipeline_wait(pipeline)))
+      break;
+  }
+  return NULL;
+}
+
+LCC_ERRNO
+lcc_pipeline_init(lcc_pipeline *pipeline, lcc_connection *conn)
+{
+  if (pthread_mutex_init(&pipeline->lock, NULL))
+    return ER_UNKNOWN;
+  if (pthread_cond_init(&pipeline->cond, NULL))
+  {
+    pthread_mutex_destroy(&pipeline->lock);
+    return ER_UNKNOWN;
+  }
+  lcc_mpsc_init(&pipeline->queue);
+  pipeline->conn= conn;
+  pipeline->depth= LCC_PIPELINE_DEPTH;
+
+  if (pthread_create(&pipeline->thread, NULL, lcc_pipeline_run, pipeline))
+  {
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->lock);
+    return ER_UNKNOWN;
+  }
+  pipeline->running= 1;
+  return ER_OK;
+}
+
+/**
+ * @brief: stops the owner thread after all submitted commands completed
+ *
+ * Called before the connection is closed. Commands which were submitted
+ * while the owner thread exited are not sent: their callbacks are
+ * called with ER_LOOP_STOPPED by the calling thread.
+ */
+void
+lcc_pipeline_stop(lcc_pipeline *pipeline)
+{
+  lcc_pipeline_task *head= NULL, *tail= NULL, *task;
+
+  if (!pipeline->running)
+    return;
+
+  pthread_mutex_lock(&pipeline->lock);
+  __atomic_store_n(&pipeline->stop, 1, __ATOMIC_SEQ_CST);
+  pthread_cond_signal(&pipeline->cond);
+  pthread_mutex_unlock(&pipeline->lock);
+  pthread_join(pipeline->thread, NULL);
+  pipeline->running= 0;
+
+  /* submitters which passed the stop check push their command before
+     they leave */
+  while (__atomic_load_n(&pipeline->submitting, __ATOMIC_SEQ_CST))
+    sched_yield();
+  while ((task= (lcc_pipeline_task *)lcc_mpsc_pop(&pipeline->queue)))
+  {
+    task->next= NULL;
+    if (tail)
+      tail->next= task;
+    else
+      head= task;
+    tail= task;
+  }
+  lcc_pipeline_fail(pipeline->conn, head, ER_LOOP_STOPPED);
+}
+
+/**
+ * @brief: releases a pipeline handle
+ *
+ * The handle must not be used by other threads anymore.
+ */
+void
+lcc_pipeline_close(lcc_pipeline *pipeline)
+{
+  lcc_pipeline_stop(pipeline);
+  if (pipeline->conn)
+    lcc_list_clear_element(pipeline->conn->handles, pipeline);
+  pthread_cond_destroy(&pipeline->cond);
+  pthread_mutex_destroy(&pipeline->lock);
+}
+
+/**
+ * @brief: submits a statement to a pipeline
+ *
+ * @param: handle - pipeline handle
+ * @param: statement - SQL statement
+ * @param: length - length of statement or LCC_NTS
+ * @param: callback - completion callback
+ * @param: data - user data which is passed to callback
+ *
+ * Can be called by any thread. The statement is sent together with the
+ * statements of other threads, the callback runs on the owner thread of
+ * the pipeline when the response arrived: a result set can be read with
+ * a result handle of the connection, rows which weren't read will be
+ * discarded after the callback returned. Callbacks must not block and
+ * must not send commands on the connection.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_pipeline_submit(LCC_HANDLE *handle,
+                    const char *statement,
+                    size_t length,
+                    LCC_LOOP_CALLBACK callback,
+                    void *data)
+{
+  lcc_pipeline *pipeline= (lcc_pipeline *)handle;
+  lcc_pipeline_task *task;
+
+  if (lcc_validate_handle(handle, LCC_PIPELINE))
+    return ER_INVALID_HANDLE;
+  if (!statement || !callback)
+    return ER_INVALID_POINTER;
+  if ((ssize_t)length == -1)
+    length= strlen(statement);
+  if (!length)
+    return ER_INVALID_VALUE;
+  if (__atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE))
+    return ER_INVALID_HANDLE;
+
+  if (!(task= (lcc_pipeline_task *)malloc(sizeof(lcc_pipeline_task) + length)))
+    return ER_OUT_OF_MEMORY;
+  task->callback= callback;
+  task->data= data;
+  task->length= length;
+  memcpy(task->statement, statement, length);
+
+  /* lcc_pipeline_stop() waits for submitters which saw stop unset,
+     so their command is either sent or failed */
+  __atomic_add_fetch(&pipeline->submitting, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&pipeline->stop, __ATOMIC_SEQ_CST))
+  {
+    __atomic_sub_fetch(&pipeline->submitting, 1, __ATOMIC_SEQ_CST);
+    free(task);
+    return ER_INVALID_HANDLE;
+  }
+  lcc_mpsc_push(&pipeline->queue, &task->node);
+  if (__atomic_load_n(&pipeline->sleeping, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&pipeline->lock);
+    pthread_cond_signal(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->lock);
+  }
+  __atomic_sub_fetch(&pipeline->submitting, 1, __ATOMIC_SEQ_CST);
+  return ER_OK;
+}
@@ -0,0 +1,979 @@
+/* connection pool and session multiplexing */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_pack.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* session tracking which is required to detect session state */
+#define LCC_SESSION_TRACKING_SQL "SET session_track_state_change=1, "\
+                                 "session_track_schema=1, "\
+                                 "session_track_transaction_info='STATE'"
+
+/* sends a command and reads the response */
+static LCC_ERRNO
+lcc_pool_command(lcc_connection *conn, lcc_io_cmd command, const char *arg, size_t len)
+{
+  LCC_ERRNO rc;
+
+  conn->column_count= 0;
+  if ((rc= lcc_io_write(conn, command, (char *)arg, len)) ||
+      (rc= lcc_read_response(conn)))
+    return rc;
+  if (conn->column_count)
+    return lcc_skip_result(conn);
+  return ER_OK;
+}
+
+/* resets the session state of a connection (COM_RESET_CONNECTION) */
+static LCC_ERRNO
+lcc_pool_reset(lcc_connection *conn)
+{
+  LCC_ERRNO rc;
+
+  if ((rc= lcc_pool_command(conn, CMD_RESET_CONNECTION, NULL, 0)))
+    return rc;
+  /* the reset restores the server defaults of session tracking */
+  if ((conn->server.capabilities & CAP_SESSION_TRACKING) &&
+      (rc= lcc_pool_command(conn, CMD_QUERY, LCC_SESSION_TRACKING_SQL,
+                            strlen(LCC_SESSION_TRACKING_SQL))))
+    return rc;
+  /* the OK packets of the reset and of the tracking setup may report
+     the state change themselves */
+  conn->server.status&= ~(LCC_STATUS_IN_TRANS | LCC_STATUS_SESSION_STATE_CHANGED);
+  conn->server.session_state_changed= 0;
+  return ER_OK;
+}
+
+/* scale of virtual time: a checkout of a class with weight 1 advances
+   virtual time by LCC_SCHED_SCALE */
+#define LCC_SCHED_SCALE 65536
+
+/* resolution of maintenance timers (usec) */
+#define LCC_POOL_TIMER_RESOLUTION 10000
+/* maximum sleep time of maintenance thread (usec) */
+#define LCC_POOL_MAINTENANCE_SLEEP 1000000
+
+typedef enum {
+  POOL_ACTION_NONE= 0,
+  POOL_ACTION_PING,
+  POOL_ACTION_RESET,
+  POOL_ACTION_CLOSE
+} lcc_pool_action;
+
+LCC_ERRNO
+lcc_pool_init(lcc_pool *pool)
+{
+  pthread_condattr_t attr;
+  uint8_t i;
+
+  if (pthread_mutex_init(&pool->lock, NULL))
+    return ER_UNKNOWN;
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  if (pthread_cond_init(&pool->maintenance_cond, &attr))
+  {
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_destroy(&pool->lock);
+    return ER_UNKNOWN;
+  }
+  pthread_condattr_destroy(&attr);
+
+  for (i=0; i < LCC_SCHED_CLASSES; i++)
+    pool->classes[i].weight= 1;
+  pool->numa_node= -1;
+  lcc_timer_wheel_init(&pool->wheel, LCC_POOL_TIMER_RESOLUTION, lcc_now_usec());
+  return ER_OK;
+}
+
+/* timer callback: connection needs maintenance, called with pool lock held */
+static void
+lcc_pool_timer_expired(lcc_timer *timer)
+{
+  lcc_connection *conn= (lcc_connection *)timer->data;
+  lcc_pool *pool= conn->pool;
+
+  if (conn->pool_state == POOL_CONN_IDLE)
+  {
+    if (conn->prev_idle)
+      conn->prev_idle->next_idle= conn->next_idle;
+    else
+      pool->idle= conn->next_idle;
+    if (conn->next_idle)
+      conn->next_idle->prev_idle= conn->prev_idle;
+    pool->idle_count--;
+    conn->pool_state= POOL_CONN_MAINTENANCE;
+  }
+  conn->prev_idle= NULL;
+  conn->next_idle= pool->due;
+  pool->due= conn;
+}
+
+/* schedules the next maintenance of an idle connection */
+static void
+lcc_pool_schedule(lcc_pool *pool, lcc_connection *conn)
+{
+  uint64_t expires= UINT64_MAX;
+
+  if (conn->reset_pending)
+    expires= 0;
+  if (pool->ping_interval)
+    expires= lcc_MIN(expires, conn->last_ping + pool->ping_interval);
+  if (pool->idle_timeout)
+    expires= lcc_MIN(expires, conn->idle_since + pool->idle_timeout);
+  if (pool->max_lifetime)
+    expires= lcc_MIN(expires, conn->pool_added + pool->max_lifetime);
+
+  if (expires == UINT64_MAX)
+  {
+    lcc_timer_cancel(&pool->wheel, &conn->timer);
+    return;
+  }
+  conn->timer.callback= lcc_pool_timer_expired;
+  conn->timer.data= conn;
+  lcc_timer_add(&pool->wheel, &conn->timer, expires);
+}
+
+/* adds a connection to the list of idle connections */
+static void
+lcc_pool_push_idle(lcc_pool *pool, lcc_connection *conn)
+{
+  conn->pool_state= POOL_CONN_IDLE;
+  conn->prev_idle= NULL;
+  conn->next_idle= pool->idle;
+  if (pool->idle)
+    pool->idle->prev_idle= conn;
+  pool->idle= conn;
+  pool->idle_count++;
+  lcc_pool_schedule(pool, conn);
+}
+
+/* removes a connection from the list of idle connections, O(1) */
+static void
+lcc_pool_unlink_idle(lcc_pool *pool, lcc_connection *conn)
+{
+  if (conn->prev_idle)
+    conn->prev_idle->next_idle= conn->next_idle;
+  else
+    pool->idle= conn->next_idle;
+  if (conn->next_idle)
+    conn->next_idle->prev_idle= conn->prev_idle;
+  conn->next_idle= conn->prev_idle= NULL;
+  pool->idle_count--;
+  lcc_timer_cancel(&pool->wheel, &conn->timer);
+}
+
+/* checks if class has a waiter and didn't reach its concurrency limit */
+static inline uint8_t
+lcc_sched_eligible(lcc_sched_class *cls)
+{
+  return cls->head && (!cls->max_active || cls->active < cls->max_active);
+}
+
+/**
+ * @brief: assigns idle connections to waiting callers
+ *
+ * Weighted fair queuing: the waiter with the lowest virtual finish
+ * time of all classes which are below their concurrency limit will
+ * be served first. Must be called with pool lock held.
+ */
+static void
+lcc_pool_dispatch(lcc_pool *pool)
+{
+  while (pool->idle)
+  {
+    lcc_sched_class *cls= NULL;
+    lcc_sched_waiter *waiter;
+    lcc_connection *conn;
+    uint8_t i;
+
+    for (i=0; i < LCC_SCHED_CLASSES; i++)
+    {
+      if (lcc_sched_eligible(&pool->classes[i]) &&
+          (!cls || pool->classes[i].head->finish < cls->head->finish))
+        cls= &pool->classes[i];
+    }
+    if (!cls)
+      return;
+
+    waiter= cls->head;
+    if (!(cls->head= waiter->next))
+      cls->tail= NULL;
+    cls->waiting--;
+
+    conn= pool->idle;
+    lcc_pool_unlink_idle(pool, conn);
+    conn->pool_state= POOL_CONN_ACTIVE;
+    conn->sched_class= (uint8_t)(cls - pool->classes);
+    cls->active++;
+
+    pool->virtual_time= waiter->finish;
+    waiter->conn= conn;
+    pthread_cond_signal(&waiter->cond);
+  }
+}
+
+/* wakes up all waiters: the pool has no connections anymore */
+static void
+lcc_pool_wakeup_all(lcc_pool *pool)
+{
+  lcc_sched_waiter *waiter;
+  uint8_t i;
+
+  for (i=0; i < LCC_SCHED_CLASSES; i++)
+    for (waiter= pool->classes[i].head; waiter; waiter= waiter->next)
+      pthread_cond_signal(&waiter->cond);
+}
+
+/* removes a waiter which gave up */
+static void
+lcc_sched_remove(lcc_sched_class *cls, lcc_sched_waiter *waiter)
+{
+  lcc_sched_waiter **w, *prev= NULL;
+
+  for (w= &cls->head; *w; prev= *w, w= &(*w)->next)
+  {
+    if (*w == waiter)
+    {
+      *w= waiter->next;
+      if (cls->tail == waiter)
+        cls->tail= prev;
+      cls->waiting--;
+      return;
+    }
+  }
+}
+
+/**
+ * @brief: accounts server time of a command to the priority class
+ *         of the connection
+ */
+void
+lcc_pool_account(lcc_connection *conn, uint64_t server_time)
+{
+  lcc_sched_class *cls= &conn->pool->classes[conn->sched_class];
+
+  __atomic_add_fetch(&cls->commands, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&cls->server_time, server_time, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief: closes the pool and all of its connections
+ */
+void
+lcc_pool_close(lcc_pool *pool)
+{
+  LCC_LIST *list;
+
+  if (pool->maintenance_running)
+  {
+    pthread_mutex_lock(&pool->lock);
+    pool->maintenance_running= 0;
+    pthread_cond_signal(&pool->maintenance_cond);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_join(pool->maintenance_thread, NULL);
+  }
+
+  for (list= pool->connections; list; list= list->next)
+  {
+    lcc_connection *conn= (lcc_connection *)list->data;
+    if (!conn)
+      continue;
+    conn->pool= NULL;
+    LCC_close_handle((LCC_HANDLE *)conn);
+  }
+  lcc_list_delete(pool->connections, NULL);
+  pthread_cond_destroy(&pool->maintenance_cond);
+  pthread_mutex_destroy(&pool->lock);
+}
+
+/**
+ * @brief: removes a connection from its pool
+ */
+void
+lcc_pool_detach(lcc_connection *conn)
+{
+  lcc_pool *pool= conn->pool;
+
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  switch (conn->pool_state) {
+  case POOL_CONN_IDLE:
+    lcc_pool_unlink_idle(pool, conn);
+    break;
+  case POOL_CONN_ACTIVE:
+    if (pool->classes[conn->sched_class].active)
+      pool->classes[conn->sched_class].active--;
+    break;
+  default:
+    break;
+  }
+  lcc_timer_cancel(&pool->wheel, &conn->timer);
+  lcc_list_clear_element(pool->connections, conn);
+  if (!--pool->size)
+    lcc_pool_wakeup_all(pool);
+  conn->pool= NULL;
+  conn->next_idle= conn->prev_idle= NULL;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief: adds a connected connection to a pool
+ *
+ * @param: pool - pool handle
+ * @param: connection - connection handle
+ *
+ * The pool takes ownership of the connection: it will be closed
+ * when the pool gets closed.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_add(LCC_HANDLE *handle, LCC_HANDLE *connection)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  lcc_connection *conn= (lcc_connection *)connection;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_POOL) ||
+      lcc_validate_handle(connection, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+
+  if (conn->pool)
+    return ER_ALREADY_INITIALIZED;
+
+  /* enable tracking of session state, so sessions can be multiplexed */
+  if ((conn->server.capabilities & CAP_SESSION_TRACKING) &&
+      (rc= lcc_pool_command(conn, CMD_QUERY, LCC_SESSION_TRACKING_SQL,
+                            strlen(LCC_SESSION_TRACKING_SQL))))
+    return rc;
+
+  if (!conn->server.current_db && conn->configuration.current_db &&
+      !(conn->server.current_db= strdup(conn->configuration.current_db)))
+    return ER_OUT_OF_MEMORY;
+
+  /* buffers of the connection are placed on the node of the pool */
+  if (pool->numa_node >= 0 && conn->numa_node != pool->numa_node &&
+      (rc= lcc_io_set_node(conn, pool->numa_node)))
+    return rc;
+
+  pthread_mutex_lock(&pool->lock);
+  if ((rc= lcc_list_add(&pool->connections, conn)))
+    goto end;
+  conn->pool= pool;
+  conn->pool_added= conn->idle_since= conn->last_ping= lcc_now_usec();
+  pool->size++;
+  lcc_pool_push_idle(pool, conn);
+  lcc_pool_dispatch(pool);
+end:
+  pthread_mutex_unlock(&pool->lock);
+  return rc;
+}
+
+/**
+ * @brief: takes an idle connection from the pool
+ *
+ * @param: pool - pool handle
+ * @param: priority_class - priority class (0 .. LCC_SCHED_CLASSES - 1)
+ * @param: connection - returns the connection
+ *
+ * If no connection is idle, or the class reached its concurrency limit
+ * (LCC_OPT_POOL_CLASS), the caller will be queued. Connections which
+ * are returned by LCC_pool_checkin() are assigned to the waiting callers
+ * by weighted fair queuing, so a burst of requests of one class can't
+ * starve other classes.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_checkout_class(LCC_HANDLE *handle, uint8_t priority_class, LCC_HANDLE **connection)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  lcc_sched_class *cls;
+  lcc_sched_waiter waiter;
+  uint64_t start= lcc_now_usec();
+
+  if (lcc_validate_handle(handle, LCC_POOL))
+    return ER_INVALID_HANDLE;
+  if (!connection)
+    return ER_INVALID_POINTER;
+  if (priority_class >= LCC_SCHED_CLASSES)
+    return ER_INVALID_VALUE;
+
+  cls= &pool->classes[priority_class];
+  memset(&waiter, 0, sizeof(lcc_sched_waiter));
+  if (pthread_cond_init(&waiter.cond, NULL))
+    return ER_UNKNOWN;
+
+  pthread_mutex_lock(&pool->lock);
+
+  /* virtual start time is the later of the current virtual time and
+     the finish time of the previous request of this class */
+  waiter.finish= lcc_MAX(pool->virtual_time, cls->last_finish) +
+                 LCC_SCHED_SCALE / cls->weight;
+  cls->last_finish= waiter.finish;
+
+  if (cls->tail)
+    cls->tail->next= &waiter;
+  else
+    cls->head= &waiter;
+  cls->tail= &waiter;
+  cls->waiting++;
+
+  lcc_pool_dispatch(pool);
+  while (!waiter.conn && pool->size)
+    pthread_cond_wait(&waiter.cond, &pool->lock);
+
+  if (!waiter.conn)
+  {
+    lcc_sched_remove(cls, &waiter);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_cond_destroy(&waiter.cond);
+    return ER_POOL_EMPTY;
+  }
+  cls->requests++;
+  cls->queue_time+= lcc_now_usec() - start;
+  pthread_mutex_unlock(&pool->lock);
+  pthread_cond_destroy(&waiter.cond);
+
+  *connection= (LCC_HANDLE *)waiter.conn;
+  return ER_OK;
+}
+
+/**
+ * @brief: takes an idle connection from the pool
+ *
+ * Same as LCC_pool_checkout_class() with priority class 0.
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_checkout(LCC_HANDLE *handle, LCC_HANDLE **connection)
+{
+  return LCC_pool_checkout_class(handle, 0, connection);
+}
+
+/**
+ * @brief: takes an idle connection without waiting
+ *
+ * Used for urgent internal commands (e.g. KILL QUERY), the connection
+ * bypasses the scheduler and must be returned by LCC_pool_checkin().
+ *
+ * @return: connection or NULL if no connection is idle
+ */
+lcc_connection *
+lcc_pool_borrow(lcc_pool *pool)
+{
+  lcc_connection *conn;
+
+  pthread_mutex_lock(&pool->lock);
+  if ((conn= pool->idle))
+  {
+    lcc_pool_unlink_idle(pool, conn);
+    conn->pool_state= POOL_CONN_ACTIVE;
+    conn->sched_class= 0;
+    pool->classes[0].active++;
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return conn;
+}
+
+/* connection has an open transaction or left over session state */
+static uint8_t
+lcc_pool_needs_reset(lcc_connection *conn)
+{
+  return (conn->server.status & (LCC_STATUS_IN_TRANS | LCC_STATUS_SESSION_STATE_CHANGED)) ||
+         conn->server.session_state_changed;
+}
+
+/**
+ * @brief: returns a connection to the pool
+ *
+ * An unread result of the connection will be discarded before the
+ * connection is used the next time. An open transaction or session
+ * state is reset (COM_RESET_CONNECTION) before the connection becomes
+ * idle: by the maintenance thread if it is running, otherwise before
+ * this function returns. A connection which can't be reset is closed.
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_checkin(LCC_HANDLE *handle, LCC_HANDLE *connection)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_sched_class *cls;
+
+  if (lcc_validate_handle(handle, LCC_POOL) ||
+      lcc_validate_handle(connection, LCC_CONNECTION) ||
+      conn->pool != pool)
+    return ER_INVALID_HANDLE;
+
+  /* a connection which lost the protocol state can't be reused */
+  if (conn->broken)
+  {
+    LCC_close_handle((LCC_HANDLE *)conn);
+    return ER_OK;
+  }
+
+  if (conn->status == CONN_STATUS_RESULT)
+    conn->abandoned= 1;
+
+  pthread_mutex_lock(&pool->lock);
+  if (!pool->maintenance_running && lcc_pool_needs_reset(conn))
+  {
+    /* the connection is still active, no other thread uses it */
+    pthread_mutex_unlock(&pool->lock);
+    if (lcc_pool_reset(conn))
+    {
+      LCC_close_handle((LCC_HANDLE *)conn);
+      return ER_OK;
+    }
+    pthread_mutex_lock(&pool->lock);
+  }
+  cls= &pool->classes[conn->sched_class];
+  if (cls->active)
+    cls->active--;
+  conn->idle_since= lcc_now_usec();
+
+  /* if maintenance is running, left over session state will be
+     reset before the connection can be used again */
+  if (lcc_pool_needs_reset(conn))
+  {
+    conn->reset_pending= 1;
+    conn->pool_state= POOL_CONN_MAINTENANCE;
+    lcc_pool_schedule(pool, conn);
+    pthread_cond_signal(&pool->maintenance_cond);
+  }
+  else
+  {
+    lcc_pool_push_idle(pool, conn);
+    lcc_pool_dispatch(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return ER_OK;
+}
+
+/**
+ * @brief: returns statistics of a priority class
+ *
+ * Queue time (waiting for a connection) and server time (response
+ * time of the commands) are reported separately.
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_class_stats(LCC_HANDLE *handle, uint8_t priority_class, LCC_POOL_CLASS_STATS *stats)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  lcc_sched_class *cls;
+
+  if (lcc_validate_handle(handle, LCC_POOL))
+    return ER_INVALID_HANDLE;
+  if (!stats)
+    return ER_INVALID_POINTER;
+  if (priority_class >= LCC_SCHED_CLASSES)
+    return ER_INVALID_VALUE;
+
+  cls= &pool->classes[priority_class];
+  pthread_mutex_lock(&pool->lock);
+  stats->requests= cls->requests;
+  stats->queue_time= cls->queue_time;
+  stats->commands= __atomic_load_n(&cls->commands, __ATOMIC_RELAXED);
+  stats->server_time= __atomic_load_n(&cls->server_time, __ATOMIC_RELAXED);
+  stats->active= cls->active;
+  stats->waiting= cls->waiting;
+  pthread_mutex_unlock(&pool->lock);
+  return ER_OK;
+}
+
+/* determines what needs to be done with a connection */
+static lcc_pool_action
+lcc_pool_maintenance_action(lcc_pool *pool, lcc_connection *conn, uint64_t now)
+{
+  if (pool->max_lifetime && now >= conn->pool_added + pool->max_lifetime)
+    return POOL_ACTION_CLOSE;
+  if (conn->reset_pending)
+    return POOL_ACTION_RESET;
+  if (pool->idle_timeout && now >= conn->idle_since + pool->idle_timeout)
+    return POOL_ACTION_CLOSE;
+  if (pool->ping_interval && now >= conn->last_ping + pool->ping_interval)
+    return POOL_ACTION_PING;
+  return POOL_ACTION_NONE;
+}
+
+/**
+ * @brief: runs expired maintenance timers
+ *
+ * Called with pool lock held, the lock will be released while
+ * commands are sent to the server.
+ */
+static void
+lcc_pool_run_maintenance(lcc_pool *pool)
+{
+  lcc_connection *conn;
+  uint64_t now= lcc_now_usec();
+
+  lcc_timer_wheel_advance(&pool->wheel, now);
+
+  while ((conn= pool->due))
+  {
+    lcc_pool_action action= lcc_pool_maintenance_action(pool, conn, now);
+    LCC_ERRNO rc= ER_OK;
+
+    pool->due= conn->next_idle;
+    conn->next_idle= NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    switch (action) {
+    case POOL_ACTION_PING:
+      rc= lcc_pool_command(conn, CMD_PING, NULL, 0);
+      break;
+    case POOL_ACTION_RESET:
+      rc= lcc_pool_reset(conn);
+      break;
+    case POOL_ACTION_CLOSE:
+      rc= ER_UNKNOWN;
+      break;
+    default:
+      break;
+    }
+
+    /* connection is broken or expired */
+    if (rc)
+    {
+      LCC_close_handle((LCC_HANDLE *)conn);
+      pthread_mutex_lock(&pool->lock);
+      continue;
+    }
+
+    now= lcc_now_usec();
+    pthread_mutex_lock(&pool->lock);
+    if (action != POOL_ACTION_NONE)
+      conn->last_ping= now;
+    conn->reset_pending= 0;
+    lcc_pool_push_idle(pool, conn);
+    lcc_pool_dispatch(pool);
+  }
+}
+
+static void *
+lcc_pool_maintenance_thread(void *arg)
+{
+  lcc_pool *pool= (lcc_pool *)arg;
+  struct timespec ts;
+  uint64_t next;
+
+  lcc_numa_bind_thread(pool->numa_node);
+  pthread_mutex_lock(&pool->lock);
+  while (pool->maintenance_running)
+  {
+    lcc_pool_run_maintenance(pool);
+    if (!pool->maintenance_running)
+      break;
+    next= lcc_MIN(lcc_timer_wheel_next(&pool->wheel),
+                  lcc_now_usec() + LCC_POOL_MAINTENANCE_SLEEP);
+    ts.tv_sec= next / 1000000;
+    ts.tv_nsec= (next % 1000000) * 1000;
+    pthread_cond_timedwait(&pool->maintenance_cond, &pool->lock, &ts);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/**
+ * @brief: runs maintenance of idle connections
+ *
+ * @param: pool - pool handle
+ * @param: timeout - returns the time in ms until the function needs
+ *                   to be called again (optional)
+ *
+ * Connections which exceeded idle timeout or maximum lifetime will be
+ * closed, connections which were idle longer than the ping interval
+ * will be checked by CMD_PING, connections with left over session state
+ * are reset by CMD_RESET_CONNECTION. Timers are kept in a timer wheel,
+ * so only connections which need maintenance will be touched.
+ *
+ * This function allows to integrate maintenance into an event loop,
+ * LCC_pool_start_maintenance() runs maintenance in a background thread.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_maintenance(LCC_HANDLE *handle, uint32_t *timeout)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  uint64_t next, now;
+
+  if (lcc_validate_handle(handle, LCC_POOL))
+    return ER_INVALID_HANDLE;
+
+  pthread_mutex_lock(&pool->lock);
+  lcc_pool_run_maintenance(pool);
+  next= lcc_timer_wheel_next(&pool->wheel);
+  pthread_mutex_unlock(&pool->lock);
+
+  if (timeout)
+  {
+    now= lcc_now_usec();
+    if (next == UINT64_MAX)
+      *timeout= UINT32_MAX;
+    else
+      *timeout= next > now ? (uint32_t)lcc_MIN((next - now + 999) / 1000, (uint64_t)UINT32_MAX - 1) : 0;
+  }
+  return ER_OK;
+}
+
+/**
+ * @brief: starts a background thread for maintenance of idle
+ *         connections. The thread stops when the pool is closed.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_pool_start_maintenance(LCC_HANDLE *handle)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  LCC_ERRNO rc= ER_OK;
+
+  if (lcc_validate_handle(handle, LCC_POOL))
+    return ER_INVALID_HANDLE;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->maintenance_running)
+    rc= ER_ALREADY_INITIALIZED;
+  else
+  {
+    pool->maintenance_running= 1;
+    if (pthread_create(&pool->maintenance_thread, NULL, lcc_pool_maintenance_thread, pool))
+    {
+      pool->maintenance_running= 0;
+      rc= ER_UNKNOWN;
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return rc;
+}
+
+/**
+ * @brief: sets maintenance intervals (ms, 0 = disabled) and
+ *         reschedules the timers of idle connections
+ */
+void
+lcc_pool_set_maintenance(lcc_pool *pool, uint32_t ping_interval,
+                         uint32_t idle_timeout, uint32_t max_lifetime)
+{
+  lcc_connection *conn;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->ping_interval= (uint64_t)ping_interval * 1000;
+  pool->idle_timeout= (uint64_t)idle_timeout * 1000;
+  pool->max_lifetime= (uint64_t)max_lifetime * 1000;
+  for (conn= pool->idle; conn; conn= conn->next_idle)
+    lcc_pool_schedule(pool, conn);
+  pthread_cond_signal(&pool->maintenance_cond);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* returns the value of a session tracking record */
+static uint8_t
+lcc_session_track_value(LCC_SESSION_TRACK_INFO *info, LCC_STRING *value)
+{
+  u_char *pos= (u_char *)info->str.str;
+  uint8_t error= 0;
+
+  if (!info->str.len)
+    return 0;
+  value->len= p_to_lenc(&pos, (u_char *)info->str.str + info->str.len, &error);
+  if (error || (char *)pos + value->len > info->str.str + info->str.len)
+    return 0;
+  value->str= (char *)pos;
+  return 1;
+}
+
+/**
+ * @brief: checks if the last command created session state
+ *
+ * Schema changes are remembered by the session and will be replayed
+ * when the session is attached to another connection. Changes of system
+ * or user variables, temporary tables, prepared statements or table locks
+ * require that the session stays on the connection.
+ *
+ * @return: 1 if the session needs to be pinned to its connection
+ */
+static uint8_t
+lcc_session_state_changed(lcc_session *session, lcc_connection *conn)
+{
+  LCC_LIST *list;
+  LCC_STRING value;
+  uint8_t state_change= 0, schema_change= 0, pin= 0;
+
+  /* without session tracking we can't tell */
+  if (!(conn->server.capabilities & CAP_SESSION_TRACKING))
+    return 1;
+
+  for (list= conn->server.session_state; list; list= list->next)
+  {
+    LCC_SESSION_TRACK_INFO *info= (LCC_SESSION_TRACK_INFO *)list->data;
+
+    if (!info || !lcc_session_track_value(info, &value))
+      continue;
+
+    switch (info->type) {
+    case TRACK_SCHEMA:
+      free(session->current_db);
+      free(conn->server.current_db);
+      session->current_db= strndup(value.str, value.len);
+      conn->server.current_db= strndup(value.str, value.len);
+      schema_change= 1;
+      break;
+    case TRACK_STATE_CHANGE:
+      if (value.len && value.str[0] == '1')
+        state_change= 1;
+      break;
+    case TRACK_SYSTEM_VARIABLES:
+      pin= 1;
+      break;
+    case TRACK_TRANSACTION_STATE:
+      /* LOCK TABLES */
+      if (memchr(value.str, 'L', value.len))
+        pin= 1;
+      break;
+    default:
+      break;
+    }
+  }
+
+  /* state changed, but server didn't send details (e.g. EOF packet) */
+  if (!conn->server.session_state &&
+      (conn->server.session_state_changed ||
+       (conn->server.status & LCC_STATUS_SESSION_STATE_CHANGED)))
+    pin= 1;
+
+  if (state_change && !schema_change)
+    pin= 1;
+  return pin;
+}
+
+/* server side prepared statements only exist on their connection */
+static uint8_t
+lcc_session_has_statements(lcc_connection *conn)
+{
+  LCC_LIST *list;
+
+  for (list= conn->handles; list; list= list->next)
+  {
+    if (list->data && ((LCC_HANDLE *)list->data)->type == LCC_STATEMENT)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief: attaches a logical session to a physical connection
+ *
+ * @param: session - session handle
+ * @param: connection - returns the connection which has to be used
+ *                      for the next statement
+ *
+ * If the session isn't attached yet, an idle connection will be taken
+ * from the pool and the current schema of the session will be applied.
+ * After the response (and result set) of the statement was read,
+ * LCC_session_detach() must be called.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_session_attach(LCC_HANDLE *handle, LCC_HANDLE **connection)
+{
+  lcc_session *session= (lcc_session *)handle;
+  lcc_connection *conn;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_SESSION) || !session->pool)
+    return ER_INVALID_HANDLE;
+  if (!connection)
+    return ER_INVALID_POINTER;
+
+  if (!session->conn)
+  {
+    if ((rc= LCC_pool_checkout((LCC_HANDLE *)session->pool, (LCC_HANDLE **)&conn)))
+      return rc;
+
+    if (session->current_db &&
+        (!conn->server.current_db || strcmp(conn->server.current_db, session->current_db)))
+    {
+      if ((rc= lcc_pool_command(conn, CMD_INIT_DB, session->current_db,
+                                strlen(session->current_db))))
+      {
+        LCC_pool_checkin((LCC_HANDLE *)session->pool, (LCC_HANDLE *)conn);
+        return rc;
+      }
+      free(conn->server.current_db);
+      conn->server.current_db= strdup(session->current_db);
+    }
+    session->conn= conn;
+  }
+  *connection= (LCC_HANDLE *)session->conn;
+  return ER_OK;
+}
+
+/**
+ * @brief: detaches a session from its connection
+ *
+ * The connection is returned to the pool unless a transaction is
+ * active, the session created session state or it has prepared
+ * statements: in this case the session stays attached to the
+ * connection.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_session_detach(LCC_HANDLE *handle)
+{
+  lcc_session *session= (lcc_session *)handle;
+  lcc_connection *conn;
+
+  if (lcc_validate_handle(handle, LCC_SESSION))
+    return ER_INVALID_HANDLE;
+
+  if (!(conn= session->conn))
+    return ER_OK;
+
+  if (conn->status == CONN_STATUS_RESULT)
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_SESSION_BUSY, "HY000", NULL);
+
+  if (lcc_session_state_changed(session, conn) ||
+      lcc_session_has_statements(conn))
+    session->pinned= 1;
+
+  if (session->pinned ||
+      (conn->server.status & LCC_STATUS_IN_TRANS))
+    return ER_OK;
+
+  session->conn= NULL;
+  return LCC_pool_checkin((LCC_HANDLE *)session->pool, (LCC_HANDLE *)conn);
+}
+
+/**
+ * @brief: releases the connection of a session
+ *
+ * Session state of a pinned connection (or an open transaction)
+ * will be reset before the connection is returned to the pool.
+ */
+void
+lcc_session_close(lcc_session *session)
+{
+  lcc_connection *conn= session->conn;
+
+  if (conn && session->pool)
+  {
+    if (conn->status == CONN_STATUS_RESULT)
+      conn->abandoned= 1;
+    if ((session->pinned || (conn->server.status & LCC_STATUS_IN_TRANS)) &&
+        lcc_pool_reset(conn))
+      LCC_close_handle((LCC_HANDLE *)conn);
+    else
+      LCC_pool_checkin((LCC_HANDLE *)session->pool, (LCC_HANDLE *)conn);
+  }
+  free(session->current_db);
+  memset(session, 0, sizeof(lcc_session));
+}
@@ -0,0 +1,614 @@
+/* parallel processing of a result set
+
+   The calling thread receives the rows into reference counted blocks
+   and parses them in place: a batch of rows is a list of views into
+   the blocks, no value is copied. Batches are distributed round robin
+   to the deques of the workers, an idle worker steals batches from the
+   other deques. Batches are retired in the order of the result set,
+   which calls the optional ordered callback and releases the blocks.
+*/
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <lcc_pack.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define COMM_HEADER_SIZE 4
+#define MAX_COMM_PACKET_SIZE 0xFFFFFF
+
+#define LCC_PROCESS_BLOCK_SIZE 0x40000
+/* default number of rows per batch */
+#define LCC_PROCESS_ROWS 256
+#define LCC_PROCESS_MAX_THREADS 256
+/* batches in flight per worker */
+#define LCC_PROCESS_WINDOW 4
+
+static void
+lcc_process_block_release(lcc_process_block *block)
+{
+  if (block && !__atomic_sub_fetch(&block->refcount, 1, __ATOMIC_ACQ_REL))
+    lcc_numa_free(block);
+}
+
+/* releases the blocks of a batch */
+static void
+lcc_process_batch_release(lcc_process_batch *batch)
+{
+  uint32_t i;
+
+  for (i=0; i < batch->block_count; i++)
+    lcc_process_block_release(batch->blocks[i]);
+  batch->block_count= 0;
+  batch->rows= 0;
+  batch->output= NULL;
+}
+
+/* records the first error */
+static void
+lcc_process_fail(lcc_process *process, LCC_ERRNO rc)
+{
+  pthread_mutex_lock(&process->lock);
+  if (!process->failed)
+  {
+    process->rc= rc;
+    __atomic_store_n(&process->failed, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&process->lock);
+}
+
+static void
+lcc_process_push(lcc_process_deque *deque, lcc_process_batch *batch, uint32_t size)
+{
+  pthread_mutex_lock(&deque->lock);
+  deque->batches[(deque->head + deque->count++) % size]= batch;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+/* takes the oldest batch: a thief which takes the oldest batch helps
+   retiring the batches in order */
+static lcc_process_batch *
+lcc_process_take(lcc_process_deque *deque, uint32_t size)
+{
+  lcc_process_batch *batch= NULL;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->count)
+  {
+    batch= deque->batches[deque->head];
+    deque->head= (deque->head + 1) % size;
+    deque->count--;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return batch;
+}
+
+/**
+ * @brief: marks a batch as processed and retires all processed
+ *         batches in order
+ *
+ * Only one thread retires batches at a time, the ordered callback
+ * doesn't run concurrently.
+ */
+static void
+lcc_process_done(lcc_process *process, lcc_process_batch *batch)
+{
+  LCC_ERRNO rc;
+
+  pthread_mutex_lock(&process->lock);
+  batch->done= 1;
+  if (process->retiring)
+  {
+    pthread_mutex_unlock(&process->lock);
+    return;
+  }
+  process->retiring= 1;
+  while (process->retired < process->dispatched &&
+         (batch= &process->batches[process->retired % process->window])->done)
+  {
+    uint8_t failed= process->failed;
+
+    pthread_mutex_unlock(&process->lock);
+    if (process->ordered && !failed &&
+        (rc= process->ordered(process->data, batch->nr, batch->values, batch->rows,
+                              batch->output)))
+      lcc_process_fail(process, rc);
+    lcc_process_batch_release(batch);
+    pthread_mutex_lock(&process->lock);
+    batch->done= 0;
+    process->retired++;
+    process->in_flight--;
+    pthread_cond_signal(&process->space);
+  }
+  process->retiring= 0;
+  pthread_mutex_unlock(&process->lock);
+}
+
+typedef struct {
+  lcc_process *process;
+  uint32_t id;
+} lcc_process_worker;
+
+static void *
+lcc_process_run(void *arg)
+{
+  lcc_process *process= ((lcc_process_worker *)arg)->process;
+  uint32_t id= ((lcc_process_worker *)arg)->id;
+  lcc_process_batch *batch;
+  uint32_t i;
+  LCC_ERRNO rc;
+
+  free(arg);
+  lcc_numa_bind_thread(process->result->conn->numa_node);
+  for (;;)
+  {
+    batch= NULL;
+    /* own deque first, then steal from the others */
+    for (i=0; i < process->threads && !batch; i++)
+      batch= lcc_process_take(&process->deques[(id + i) % process->threads], process->window);
+
+    if (!batch)
+    {
+      pthread_mutex_lock(&process->lock);
+      while (!__atomic_load_n(&process->queued, __ATOMIC_ACQUIRE) && !process->finished)
+        pthread_cond_wait(&process->work, &process->lock);
+      if (!__atomic_load_n(&process->queued, __ATOMIC_ACQUIRE))
+      {
+        pthread_mutex_unlock(&process->lock);
+        break;
+      }
+      pthread_mutex_unlock(&process->lock);
+      continue;
+    }
+    __atomic_sub_fetch(&process->queued, 1, __ATOMIC_ACQ_REL);
+
+    if (!__atomic_load_n(&process->failed, __ATOMIC_ACQUIRE) &&
+        (rc= process->process(process->data, batch->nr, batch->values, batch->rows,
+                              process->column_count, &batch->output)))
+      lcc_process_fail(process, rc);
+    lcc_process_done(process, batch);
+  }
+  return NULL;
+}
+
+/* passes a batch to the deque of a worker */
+static void
+lcc_process_dispatch(lcc_process *process, lcc_process_batch *batch)
+{
+  /* dispatched must be counted before a worker can retire the batch */
+  pthread_mutex_lock(&process->lock);
+  process->dispatched++;
+  lcc_process_push(&process->deques[batch->nr % process->threads], batch, process->window);
+  __atomic_add_fetch(&process->queued, 1, __ATOMIC_ACQ_REL);
+  pthread_cond_signal(&process->work);
+  pthread_mutex_unlock(&process->lock);
+}
+
+/* waits until the slot of the next batch was retired */
+static lcc_process_batch *
+lcc_process_next_batch(lcc_process *process, uint64_t nr)
+{
+  lcc_process_batch *batch= &process->batches[nr % process->window];
+
+  pthread_mutex_lock(&process->lock);
+  while (process->in_flight == process->window)
+    pthread_cond_wait(&process->space, &process->lock);
+  process->in_flight++;
+  pthread_mutex_unlock(&process->lock);
+  batch->nr= nr;
+  return batch;
+}
+
+/**
+ * @brief: reads the next packet into the current block
+ *
+ * An incomplete packet at the end of a block is moved into a new
+ * block, packets of 16 MB or more are joined in place.
+ */
+LCC_ERRNO
+lcc_process_read_packet(lcc_process *process, char **packet, size_t *length)
+{
+  lcc_connection *conn= process->result->conn;
+  ssize_t bytes_read;
+  LCC_ERRNO rc;
+
+  for (;;)
+  {
+    char *pos= process->read_pos;
+    size_t need= 0;
+
+    for (;;)
+    {
+      size_t len;
+
+      if (process->read_end - pos < COMM_HEADER_SIZE)
+      {
+        need= pos + COMM_HEADER_SIZE - process->read_pos;
+        break;
+      }
+      len= p_to_ui24(pos);
+      if ((size_t)(process->read_end - pos) < COMM_HEADER_SIZE + len)
+      {
+        need= pos + COMM_HEADER_SIZE + len - process->read_pos;
+        break;
+      }
+      pos+= COMM_HEADER_SIZE + len;
+      if (len < MAX_COMM_PACKET_SIZE)
+        break;
+    }
+
+    if (!need)
+    {
+      char *dst= process->read_pos + COMM_HEADER_SIZE;
+      char *src= dst;
+
+      for (;;)
+      {
+        size_t len= p_to_ui24(src - COMM_HEADER_SIZE);
+
+        if (dst != src)
+          memmove(dst, src, len);
+        dst+= len;
+        src+= len + COMM_HEADER_SIZE;
+        if (len < MAX_COMM_PACKET_SIZE)
+          break;
+      }
+      *packet= process->read_pos + COMM_HEADER_SIZE;
+      *length= dst - *packet;
+      process->read_pos= pos;
+      return ER_OK;
+    }
+
+    /* not enough space left: continue in a new block */
+    if (process->read_pos + need > process->block->data + process->block->size)
+    {
+      size_t cached= process->read_end - process->read_pos;
+      size_t size= lcc_MAX(need, (size_t)LCC_PROCESS_BLOCK_SIZE);
+      lcc_process_block *block;
+
+      if (!(block= (lcc_process_block *)lcc_numa_alloc(conn->numa_node,
+                                                       sizeof(lcc_process_block) + size)))
+        return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, size);
+      block->refcount= 1;
+      block->size= size;
+      memcpy(block->data, process->read_pos, cached);
+      lcc_process_block_release(process->block);
+      process->block= block;
+      process->read_pos= block->data;
+      process->read_end= block->data + cached;
+    }
+
+    if ((rc= lcc_io_read_socket(conn, process->read_end,
+                                process->block->data + process->block->size - process->read_end,
+                                &bytes_read)))
+      return rc;
+    process->read_end+= bytes_read;
+  }
+}
+
+/* parses a row into the batch, the values point into the current block */
+static LCC_ERRNO
+lcc_process_parse_row(lcc_process *process, lcc_process_batch *batch,
+                      char *pos, char *end)
+{
+  lcc_result *result= process->result;
+  LCC_STRING *row= batch->values + (size_t)batch->rows * process->column_count;
+  uint8_t error= 0;
+  uint32_t i;
+
+  for (i=0; i < process->column_count; i++)
+  {
+    row[i].len= p_to_lenc((u_char **)&pos, (u_char *)end, &error);
+    if (error)
+      goto malformed_packet;
+    if (row[i].len == (uint64_t)~0)
+    {
+      row[i].len= 0;
+      row[i].str= NULL;
+      continue;
+    }
+    if (row[i].len > (size_t)(end - pos))
+      goto malformed_packet;
+    row[i].str= pos;
+    if (row[i].len > result->columns[i].max_column_size)
+      result->columns[i].max_column_size= row[i].len;
+    pos+= row[i].len;
+  }
+
+  /* the batch holds a reference to each block with one of its rows */
+  if (!batch->block_count || batch->blocks[batch->block_count - 1] != process->block)
+  {
+    if (batch->block_count == batch->block_size)
+    {
+      uint32_t size= batch->block_size ? batch->block_size * 2 : 4;
+      lcc_process_block **blocks;
+
+      if (!(blocks= (lcc_process_block **)realloc(batch->blocks, size * sizeof(lcc_process_block *))))
+        return lcc_set_error(&result->conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                             size * sizeof(lcc_process_block *));
+      batch->blocks= blocks;
+      batch->block_size= size;
+    }
+    __atomic_add_fetch(&process->block->refcount, 1, __ATOMIC_RELAXED);
+    batch->blocks[batch->block_count++]= process->block;
+  }
+  batch->rows++;
+  result->row_count++;
+  return ER_OK;
+
+malformed_packet:
+  return lcc_set_error(&result->conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL,
+                       (size_t)(end - pos));
+}
+
+/* reads the rows and passes them in batches to the workers */
+static LCC_ERRNO
+lcc_process_read(lcc_process *process)
+{
+  lcc_connection *conn= process->result->conn;
+  lcc_process_batch *batch= NULL;
+  uint64_t nr= 0;
+  size_t pkt_len;
+  char *pos;
+  LCC_ERRNO rc;
+
+  for (;;)
+  {
+    if ((rc= lcc_process_read_packet(process, &pos, &pkt_len)))
+      break;
+
+    if (pkt_len <= 8 && (u_char)*pos == 0xFE)
+    {
+      pos++;
+      conn->server.warning_count= p_to_ui16(pos);
+      pos+= 2;
+      conn->server.status= p_to_ui16(pos);
+      conn->status= CONN_STATUS_READY;
+      break;
+    }
+
+    /* statement failed while sending rows (e.g. it was killed) */
+    if ((u_char)*pos == 0xFF)
+    {
+      conn->status= CONN_STATUS_READY;
+      rc= lcc_read_command_error(conn, pos + 1, pkt_len - 1);
+      break;
+    }
+
+    /* after an error of a callback the remaining rows are discarded */
+    if (!batch && __atomic_load_n(&process->failed, __ATOMIC_ACQUIRE))
+      continue;
+    if (!batch)
+      batch= lcc_process_next_batch(process, nr++);
+    if ((rc= lcc_process_parse_row(process, batch, pos, pos + pkt_len)))
+      break;
+    if (batch->rows == process->batch_rows)
+    {
+      lcc_process_dispatch(process, batch);
+      batch= NULL;
+    }
+  }
+
+  if (batch)
+  {
+    if (rc)
+      lcc_process_batch_release(batch);
+    else
+      lcc_process_dispatch(process, batch);
+    /* an undispatched batch leaves its slot */
+    if (rc)
+    {
+      pthread_mutex_lock(&process->lock);
+      process->in_flight--;
+      pthread_mutex_unlock(&process->lock);
+    }
+  }
+  return rc;
+}
+
+/* moves data behind the result set back into the read buffer */
+static LCC_ERRNO
+lcc_process_restore_buffer(lcc_process *process)
+{
+  lcc_connection *conn= process->result->conn;
+  size_t cached= process->read_end - process->read_pos;
+  LCC_ERRNO rc;
+
+  if (cached > conn->io.read_size &&
+      (rc= lcc_io_realloc(conn, cached)))
+    return rc;
+  memcpy(conn->io.readbuf, process->read_pos, cached);
+  conn->io.read_pos= conn->io.readbuf;
+  conn->io.read_end= conn->io.readbuf + cached;
+  return ER_OK;
+}
+
+static void
+lcc_process_free(lcc_process *process)
+{
+  uint32_t i;
+
+  if (process->deques)
+  {
+    for (i=0; i < process->threads; i++)
+    {
+      free(process->deques[i].batches);
+      pthread_mutex_destroy(&process->deques[i].lock);
+    }
+    free(process->deques);
+  }
+  if (process->batches)
+  {
+    for (i=0; i < process->window; i++)
+    {
+      free(process->batches[i].values);
+      free(process->batches[i].blocks);
+    }
+    free(process->batches);
+  }
+  free(process->workers);
+  pthread_cond_destroy(&process->space);
+  pthread_cond_destroy(&process->work);
+  pthread_mutex_destroy(&process->lock);
+}
+
+static LCC_ERRNO
+lcc_process_alloc(lcc_process *process)
+{
+  uint32_t i;
+
+  if (!(process->workers= (pthread_t *)calloc(process->threads, sizeof(pthread_t))) ||
+      !(process->deques= (lcc_process_deque *)calloc(process->threads, sizeof(lcc_process_deque))) ||
+      !(process->batches= (lcc_process_batch *)calloc(process->window, sizeof(lcc_process_batch))))
+    return ER_OUT_OF_MEMORY;
+
+  for (i=0; i < process->threads; i++)
+  {
+    pthread_mutex_init(&process->deques[i].lock, NULL);
+    if (!(process->deques[i].batches= (lcc_process_batch **)calloc(process->window,
+                                                                    sizeof(lcc_process_batch *))))
+      return ER_OUT_OF_MEMORY;
+  }
+  for (i=0; i < process->window; i++)
+  {
+    if (!(process->batches[i].values= (LCC_STRING *)malloc((size_t)process->batch_rows *
+                                       process->column_count * sizeof(LCC_STRING))))
+      return ER_OUT_OF_MEMORY;
+  }
+  return ER_OK;
+}
+
+/* starts the workers, returns the number of started workers */
+static uint32_t
+lcc_process_start(lcc_process *process)
+{
+  lcc_process_worker *worker;
+  uint32_t i;
+
+  for (i=0; i < process->threads; i++)
+  {
+    if (!(worker= (lcc_process_worker *)malloc(sizeof(lcc_process_worker))))
+      break;
+    worker->process= process;
+    worker->id= i;
+    if (pthread_create(&process->workers[i], NULL, lcc_process_run, worker))
+    {
+      free(worker);
+      break;
+    }
+  }
+  return i;
+}
+
+/**
+ * @brief: processes the rows of a result set by a pool of threads
+ *
+ * @param: handle - result handle which reads from a connection
+ * @param: threads - number of worker threads (0 = number of CPUs)
+ * @param: batch_rows - number of rows per batch (0 = default)
+ * @param: process - called by a worker for each batch
+ * @param: ordered - optional, called for each processed batch in the
+ *                   order of the result set
+ * @param: data - user data which is passed to the callbacks
+ *
+ * The rows are read by the calling thread, their values are not copied
+ * but point into the read buffers, which are released when all batches
+ * using them were retired. Batches are processed concurrently in any
+ * order, idle workers steal batches which were queued for busy ones.
+ * After the first error of a callback the remaining rows are discarded.
+ * Returns after all rows were processed.
+ *
+ * @return: ER_OK, error code or first error of a callback
+ */
+LCC_ERRNO API_FUNC
+LCC_result_process(LCC_HANDLE *handle,
+                   uint32_t threads,
+                   uint32_t batch_rows,
+                   LCC_BATCH_CALLBACK process,
+                   LCC_ORDERED_CALLBACK ordered,
+                   void *data)
+{
+  lcc_result *result= (lcc_result *)handle;
+  lcc_connection *conn;
+  lcc_process p;
+  size_t cached, size;
+  uint32_t i, started;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_RESULT))
+    return ER_INVALID_HANDLE;
+  if (!process)
+    return ER_INVALID_POINTER;
+  if (!(conn= result->conn) || result->stored || result->read_ahead)
+    return ER_INVALID_HANDLE;
+  if (conn->status != CONN_STATUS_RESULT || !conn->column_count)
+    return ER_NO_RESULT_AVAILABLE;
+
+  if (!threads)
+  {
+    long cpus= sysconf(_SC_NPROCESSORS_ONLN);
+    threads= cpus > 0 ? (uint32_t)cpus : 1;
+  }
+  threads= lcc_MIN(threads, (uint32_t)LCC_PROCESS_MAX_THREADS);
+
+  memset(&p, 0, sizeof(lcc_process));
+  p.result= result;
+  p.process= process;
+  p.ordered= ordered;
+  p.data= data;
+  p.column_count= conn->column_count;
+  p.batch_rows= batch_rows ? batch_rows : LCC_PROCESS_ROWS;
+  p.threads= threads;
+  p.window= threads * LCC_PROCESS_WINDOW;
+  pthread_mutex_init(&p.lock, NULL);
+  pthread_cond_init(&p.work, NULL);
+  pthread_cond_init(&p.space, NULL);
+
+  if (lcc_process_alloc(&p))
+  {
+    lcc_process_free(&p);
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         (size_t)p.window * p.batch_rows * p.column_count * sizeof(LCC_STRING));
+  }
+
+  /* data which was already read belongs to the result set */
+  cached= conn->io.read_end - conn->io.read_pos;
+  size= lcc_MAX(cached, (size_t)LCC_PROCESS_BLOCK_SIZE);
+  if (!(p.block= (lcc_process_block *)lcc_numa_alloc(conn->numa_node,
+                                                     sizeof(lcc_process_block) + size)))
+  {
+    lcc_process_free(&p);
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, size);
+  }
+  p.block->refcount= 1;
+  p.block->size= size;
+  memcpy(p.block->data, conn->io.read_pos, cached);
+  p.read_pos= p.block->data;
+  p.read_end= p.block->data + cached;
+  conn->io.read_pos= conn->io.read_end= conn->io.readbuf;
+
+  if (!(started= lcc_process_start(&p)))
+  {
+    lcc_process_restore_buffer(&p);
+    lcc_process_block_release(p.block);
+    lcc_process_free(&p);
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_UNKNOWN, "HY000", NULL);
+  }
+  /* if not all workers were started, the batches of deques without
+     a worker are stolen by the others */
+  rc= lcc_process_read(&p);
+
+  pthread_mutex_lock(&p.lock);
+  p.finished= 1;
+  pthread_cond_broadcast(&p.work);
+  pthread_mutex_unlock(&p.lock);
+  for (i=0; i < started; i++)
+    pthread_join(p.workers[i], NULL);
+
+  if (!rc)
+    rc= lcc_process_restore_buffer(&p);
+  lcc_process_block_release(p.block);
+  lcc_process_free(&p);
+  return rc ? rc : p.rc;
+}
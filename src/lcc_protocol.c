@@ -65,6 +65,21 @@ lcc_read_server_error_packet(char *buffer, size_t buffer_length, LCC_ERROR *erro
   return error->error_number;
 }
 
+/* server error of a statement which was killed by KILL QUERY */
+#define LCC_ER_QUERY_INTERRUPTED 1317
+
+/* reads error packet of a command response, a statement which was
+   killed after its deadline expired is reported as ER_DEADLINE_EXCEEDED */
+LCC_ERRNO
+lcc_read_command_error(lcc_connection *conn, char *buffer, size_t buffer_length)
+{
+  LCC_ERRNO rc= lcc_read_server_error_packet(buffer, buffer_length, &conn->error);
+
+  if (conn->killed && rc == LCC_ER_QUERY_INTERRUPTED)
+    rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_DEADLINE_EXCEEDED, "HYT00", NULL);
+  return rc;
+}
+
 LCC_ERRNO lcc_send_client_hello(lcc_connection *conn)
 {
   u_char buffer[LCC_NET_BUFFER_SIZE];
@@ -83,6 +98,12 @@ LCC_ERRNO lcc_send_client_hello(lcc_connection *conn)
 
   if (conn->configuration.current_db)
     client_flags|= CAP_CONNECT_WITH_DB;
+
+  /* the server only sends LOAD DATA LOCAL INFILE requests if the
+     client announced that it can answer them */
+  if (conn->configuration.callbacks.local_infile ||
+      conn->configuration.local_infile_dir)
+    client_flags|= CAP_LOCAL_FILES;
   ui32_to_p(p, client_flags);
   p+= 4;
 
@@ -348,6 +369,33 @@ static size_t column_offsets[]=
   offsetof(LCC_COLUMN, column_name)
 };
 
+/* remembers the client character set if it was changed (SET NAMES) */
+static LCC_ERRNO
+lcc_track_charset(lcc_connection *conn, LCC_SESSION_TRACK_INFO *info)
+{
+  u_char *pos= (u_char *)info->str.str;
+  u_char *end= pos + info->str.len;
+  size_t name_len, value_len;
+  char *charset;
+  uint8_t error= 0;
+
+  name_len= p_to_lenc(&pos, end, &error);
+  if (error || name_len > (size_t)(end - pos))
+    return ER_OK;
+  if (name_len != sizeof("character_set_client") - 1 ||
+      memcmp(pos, "character_set_client", name_len))
+    return ER_OK;
+  pos+= name_len;
+  value_len= p_to_lenc(&pos, end, &error);
+  if (error || value_len > (size_t)(end - pos))
+    return ER_OK;
+  if (!(charset= strndup((char *)pos, value_len)))
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, value_len);
+  free(conn->server.charset);
+  conn->server.charset= charset;
+  return ER_OK;
+}
+
 LCC_ERRNO lcc_read_response(lcc_connection *conn)
 {
   size_t pkt_len= 0;
@@ -382,7 +430,8 @@ start:
     error_no= p_to_ui16(pos);
     if (error_no != 0xFFFF)
     {
-      return lcc_read_server_error_packet(pos, end - pos, &conn->error);
+      lcc_conn_cmd_done(conn, lcc_server_error_result(error_no));
+      return lcc_read_command_error(conn, pos, end - pos);
     }
 
     if (conn->configuration.callbacks.report_progress)
@@ -408,6 +457,17 @@ start:
     goto start;
   }
 
+  /* LOCAL DATA/XML INFILE: server requests the content of a file */
+  if ((u_char)*pos == 0xFB)
+  {
+    pos++;
+    if ((rc= lcc_local_infile(conn, pos, end - pos)))
+      return rc;
+    goto start;
+  }
+
+  lcc_conn_cmd_done(conn, CMD_RESULT_OK);
+
   /* EOF packet */
   if ((u_char)*pos == 0xFE && 
       pkt_len < 0xFFFFFF)
@@ -415,9 +475,9 @@ start:
     pos++;
     if (pos + 4 > end)
       goto malformed_packet;
-    conn->server.warning_count= p_to_ui32(pos);
+    conn->server.warning_count= p_to_ui16(pos);
     pos+= 2;
-    conn->server.status= p_to_ui32(pos);
+    conn->server.status= p_to_ui16(pos);
 
     if (conn->configuration.callbacks.status_change &&
         conn->server.status & conn->configuration.callbacks.status_flags)
@@ -425,16 +485,16 @@ start:
     return ER_OK;
   }
 
-  /* LOCAL DATA/XML INFILE */
-  if ((u_char)*pos == 0xFB)
-  {
-    /* todo */
-  }
-
   /* OK packet */
   if (*pos == 0x00)
   {
     pos++;
+
+    /* session state information is collected for all results of the
+       command, lcc_conn_cmd_start() resets it */
+    free(conn->server.info);
+    conn->server.info= NULL;
+
     conn->server.affected_rows= p_to_lenc((u_char **)&pos, (u_char *)end, &error);
     if (error)
       goto malformed_packet;
@@ -446,12 +506,14 @@ start:
 
     conn->server.status= p_to_ui16(pos);
     pos+= 2;
+    if (conn->server.status & LCC_STATUS_SESSION_STATE_CHANGED)
+      conn->server.session_state_changed= 1;
 
     if (conn->configuration.callbacks.status_change &&
         conn->server.status & conn->configuration.callbacks.status_flags)
       conn->configuration.callbacks.status_change((LCC_HANDLE *)conn, conn->server.status);
 
-    conn->server.warning_count= p_to_ui32(pos);
+    conn->server.warning_count= p_to_ui16(pos);
     pos+= 2;
 
     if (pos == end)
@@ -469,9 +531,6 @@ start:
     if (pos < end &&
         conn->server.capabilities & CAP_SESSION_TRACKING)
     {
-      lcc_list_delete(conn->server.session_state, lcc_clear_session_state);
-      conn->server.current_session_state= NULL;
-
       if (conn->server.status & LCC_STATUS_SESSION_STATE_CHANGED)
       {
         char *start_pos;
@@ -512,6 +571,13 @@ start:
           memcpy(info->str.str, pos, info->str.len);
           pos+= info->str.len;
 
+          if (info->type == TRACK_SYSTEM_VARIABLES &&
+              (rc= lcc_track_charset(conn, info)))
+          {
+            lcc_clear_session_state(info);
+            return rc;
+          }
+
           lcc_list_add(&conn->server.session_state, info);
         }
       }
@@ -542,7 +608,7 @@ lcc_read_result_metadata(lcc_result *result)
   if (!result || result->type != LCC_RESULT)
     return ER_INVALID_HANDLE;
 
-  if (lcc_mem_init(&result->memory, 8192) != ER_OK)
+  if (lcc_mem_init_node(&result->memory, 8192, conn->numa_node) != ER_OK)
     return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, 8192);
 
   if (!(result->columns= (LCC_COLUMN *)lcc_mem_alloc(&result->memory,
@@ -628,12 +694,92 @@ lcc_read_result_metadata(lcc_result *result)
   }
   conn->status= CONN_STATUS_RESULT;
   /* last packet should be EOF packet */
-  return lcc_read_response(conn);
+  if ((rc= lcc_read_response(conn)))
+    return rc;
+  return lcc_history_apply(result);
 
 malformed_packet:
   return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL, pos - conn->io.read_pos);
 }
 
+/**
+ * @brief: parses a row of the binary protocol
+ *
+ * Values point into the read buffer: numbers and floating point
+ * values in little endian byte order with the storage size of their
+ * column type, dates and times without their length byte (see
+ * p_to_time), all other values as strings.
+ */
+static LCC_ERRNO
+lcc_result_parse_binary_row(lcc_result *result, char *pos, char *end)
+{
+  uint32_t column_count= result->conn->column_count;
+  size_t null_size= (column_count + 9) / 8;
+  u_char *null_bits= (u_char *)pos;
+  uint8_t error= 0;
+  uint32_t i;
+
+  if ((size_t)(end - pos) < null_size)
+    goto malformed_packet;
+  pos+= null_size;
+
+  for (i=0; i < column_count; i++)
+  {
+    LCC_STRING *value= &result->data[i];
+
+    /* the first two bits of the null bitmap are reserved */
+    if (null_bits[(i + 2) / 8] & (1 << ((i + 2) & 7)))
+    {
+      value->len= 0;
+      value->str= NULL;
+      continue;
+    }
+
+    switch (result->columns[i].type) {
+    case LCC_COLTYPE_INT8:
+      value->len= 1;
+      break;
+    case LCC_COLTYPE_INT16:
+    case LCC_COLTYPE_YEAR:
+      value->len= 2;
+      break;
+    case LCC_COLTYPE_INT24:
+    case LCC_COLTYPE_INT32:
+    case LCC_COLTYPE_FLOAT:
+      value->len= 4;
+      break;
+    case LCC_COLTYPE_INT64:
+    case LCC_COLTYPE_DOUBLE:
+      value->len= 8;
+      break;
+    case LCC_COLTYPE_DATE:
+    case LCC_COLTYPE_TIME:
+    case LCC_COLTYPE_DATETIME:
+    case LCC_COLTYPE_TIMESTAMP:
+      if (pos >= end)
+        goto malformed_packet;
+      value->len= (u_char)*pos++;
+      break;
+    default:
+      value->len= p_to_lenc((u_char **)&pos, (u_char *)end, &error);
+      if (error)
+        goto malformed_packet;
+      break;
+    }
+    if (value->len > (size_t)(end - pos))
+      goto malformed_packet;
+    value->str= pos;
+    if (value->len > result->columns[i].max_column_size)
+      result->columns[i].max_column_size= value->len;
+    pos+= value->len;
+  }
+  return ER_OK;
+
+malformed_packet:
+  return lcc_set_error(&result->conn->error, LCC_ERROR_INFO, ER_MALFORMED_PACKET, "HY000", NULL,
+                       pos - result->conn->io.read_pos);
+}
+
 LCC_ERRNO lcc_result_fetch_one(lcc_result *result, uint8_t *eof)
 {
   LCC_ERRNO rc;
@@ -654,16 +800,32 @@ LCC_ERRNO lcc_result_fetch_one(lcc_result *result, uint8_t *eof)
   {
     *eof= 1;
     pos++;
-    result->conn->server.warning_count= p_to_ui16(result->conn->io.read_pos);
+    result->conn->server.warning_count= p_to_ui16(pos);
     pos+= 2;
-    result->conn->server.status = p_to_ui16(result->conn->io.read_pos + 3);
+    result->conn->server.status = p_to_ui16(pos);
     pos+= 2;
+    result->conn->status= CONN_STATUS_READY;
+    lcc_history_end(result->conn);
     return ER_OK;
   }
 
+  /* statement failed while sending rows (e.g. it was killed) */
+  if ((u_char)*pos == 0xFF)
+  {
+    result->conn->status= CONN_STATUS_READY;
+    return lcc_read_command_error(result->conn, pos + 1, pkt_len - 1);
+  }
+
   if (!result->conn->column_count)
     return ER_NO_RESULT_AVAILABLE;
 
+  if (result->conn->history.key)
+  {
+    result->conn->history.rows++;
+    result->conn->history.bytes+= pkt_len;
+    result->conn->history.max_packet= lcc_MAX(result->conn->history.max_packet, (uint32_t)pkt_len);
+  }
+
   if (!result->data)
   {
     if (!(result->data= (LCC_STRING *)lcc_mem_alloc(&result->memory,
@@ -672,18 +834,30 @@ LCC_ERRNO lcc_result_fetch_one(lcc_result *result, uint8_t *eof)
                          sizeof(LCC_STRING) * result->conn->column_count);
   }
 
+  if (result->binary)
+  {
+    if ((rc= lcc_result_parse_binary_row(result, pos + 1, end)))
+      return rc;
+    result->row_count++;
+    return ER_OK;
+  }
+
   for (i=0; i < result->conn->column_count; i++)
   {
     result->data[i].len= p_to_lenc((u_char **)&pos, (u_char *)end, &error);
-    if (error || pos + result->data[i].len > end)
+    if (error)
       goto malformed_packet;
 
-    if (!result->data[i].len)
-      result->data[i].str= NULL;
-    else
+    /* NULL value */
+    if (result->data[i].len == (uint64_t)~0)
     {
-      result->data[i].str= pos;
+      result->data[i].len= 0;
+      result->data[i].str= NULL;
+      continue;
     }
+    if (result->data[i].len > (size_t)(end - pos))
+      goto malformed_packet;
+    result->data[i].str= pos;
     if (result->data[i].len > result->columns[i].max_column_size)
     {
       result->columns[i].max_column_size= result->data[i].len;
@@ -715,6 +889,10 @@ lcc_read_prepare_response(lcc_stmt *stmt)
 
   stmt->conn->io.read_pos= end;
 
+  lcc_conn_cmd_done(stmt->conn, ((u_char)*pos == 0xFF && pkt_len >= 3) ?
+                                lcc_server_error_result(p_to_ui16(pos + 1)) :
+                                CMD_RESULT_OK);
+
   if ((u_char)*pos == 0xFF)
   {
     pos++;
@@ -749,14 +927,21 @@ lcc_read_prepare_response(lcc_stmt *stmt)
   }
 
   if (stmt->result)
-    LCC_reset_handle((LCC_HANDLE *)stmt->result);
+  {
+    LCC_close_handle((LCC_HANDLE *)stmt->result);
+    stmt->result= NULL;
+  }
 
   /* if column_count is > 0, metadata will follow */
   if (stmt->column_count)
   {
-    if ((rc= LCC_init_handle((LCC_HANDLE **)&stmt->result, LCC_RESULT, (LCC_HANDLE *)stmt->conn)))
-      return rc;
-    return lcc_read_result_metadata(stmt->result);
+    /* reads the column definitions */
+    stmt->conn->status= CONN_STATUS_READY;
+    rc= LCC_init_handle((LCC_HANDLE **)&stmt->result, LCC_RESULT, (LCC_HANDLE *)stmt->conn);
+    /* no rows follow the column definitions of a prepared statement */
+    stmt->conn->status= CONN_STATUS_READY;
+    stmt->conn->column_count= 0;
+    return rc;
   }
   return ER_OK;
 
@@ -766,3 +951,120 @@ malformed_packet:
 }
 
 
+
+/**
+ * @brief: reads and discards the remaining packets of a result set
+ *
+ * @param: conn - a connection handle
+ *
+ * If the column definitions were not read yet (connection status is
+ * not CONN_STATUS_RESULT), they will be skipped too.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_skip_result(lcc_connection *conn)
+{
+  size_t pkt_len;
+  LCC_ERRNO rc;
+  uint32_t i;
+  char *pos;
+
+  if (conn->status != CONN_STATUS_RESULT)
+  {
+    for (i=0; i < conn->column_count; i++)
+    {
+      if ((rc= lcc_io_read(conn, &pkt_len)))
+        return rc;
+      conn->io.read_pos+= pkt_len;
+    }
+    /* eof packet */
+    if ((rc= lcc_read_response(conn)))
+      return rc;
+  }
+
+  for (;;)
+  {
+    if ((rc= lcc_io_read(conn, &pkt_len)))
+      return rc;
+    pos= conn->io.read_pos;
+    conn->io.read_pos+= pkt_len;
+
+    if (!pkt_len)
+      continue;
+
+    if ((u_char)*pos == 0xFF)
+    {
+      conn->status= CONN_STATUS_READY;
+      return lcc_read_server_error_packet(pos + 1, pkt_len - 1, &conn->error);
+    }
+
+    if ((u_char)*pos == 0xFE && pkt_len <= 8)
+    {
+      if (pkt_len >= 5)
+      {
+        conn->server.warning_count= p_to_ui16(pos + 1);
+        conn->server.status= p_to_ui16(pos + 3);
+      }
+      break;
+    }
+  }
+  conn->status= CONN_STATUS_READY;
+  return ER_OK;
+}
+
+/**
+ * @brief: consumes the response of an abandoned command
+ *
+ * @param: conn - a connection handle
+ *
+ * Reads and discards all outstanding packets (including further
+ * result sets) of a command which was marked as abandoned, so the
+ * connection can be reused. Server errors of the abandoned command are
+ * discarded, communication errors and an expired deadline are returned.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_drain_connection(lcc_connection *conn)
+{
+  LCC_ERRNO rc;
+
+  conn->abandoned= 0;
+  /* the error of a statement which was killed before is discarded */
+  conn->killed= 0;
+
+  if (conn->status == CONN_STATUS_RESULT)
+    rc= lcc_skip_result(conn);
+  else
+  {
+    conn->column_count= 0;
+    if (!(rc= lcc_read_response(conn)) && conn->column_count)
+      rc= lcc_skip_result(conn);
+  }
+
+  while (!rc && (conn->server.status & LCC_STATUS_MORE_RESULTS_EXIST))
+  {
+    conn->column_count= 0;
+    if (!(rc= lcc_read_response(conn)) && conn->column_count)
+      rc= lcc_skip_result(conn);
+  }
+
+  conn->status= CONN_STATUS_READY;
+  conn->column_count= 0;
+
+  switch (rc) {
+    case ER_OK:
+      break;
+    case ER_COMM_READ:
+    case ER_COMM_WRITE:
+    case ER_MALFORMED_PACKET:
+    case ER_OUT_OF_MEMORY:
+    case ER_DEADLINE_EXCEEDED:
+      return rc;
+    default:
+      lcc_clear_error(&conn->error);
+      break;
+  }
+  return ER_OK;
+}
@@ -0,0 +1,104 @@
+/* lock-free queues */
+#include <lcc.h>
+#include <lcc_priv.h>
+
+/**
+ * @brief: initializes an empty multi-producer single-consumer queue
+ */
+void
+lcc_mpsc_init(lcc_mpsc_queue *queue)
+{
+  queue->stub.next= NULL;
+  queue->head= queue->tail= &queue->stub;
+}
+
+/**
+ * @brief: appends a node, can be called by any thread
+ */
+void
+lcc_mpsc_push(lcc_mpsc_queue *queue, lcc_mpsc_node *node)
+{
+  lcc_mpsc_node *prev;
+
+  node->next= NULL;
+  prev= __atomic_exchange_n(&queue->head, node, __ATOMIC_SEQ_CST);
+  /* until the link is stored, the consumer sees the queue ending at prev */
+  __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief: removes the oldest node, must only be called by the consumer
+ *
+ * @return: node or NULL if the queue is empty (or a producer didn't
+ *          link its node yet)
+ */
+lcc_mpsc_node *
+lcc_mpsc_pop(lcc_mpsc_queue *queue)
+{
+  lcc_mpsc_node *tail= queue->tail;
+  lcc_mpsc_node *next= __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+  if (tail == &queue->stub)
+  {
+    if (!next)
+      return NULL;
+    queue->tail= tail= next;
+    next= __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+  }
+  if (next)
+  {
+    queue->tail= next;
+    return tail;
+  }
+
+  /* tail is the last node: it can only be removed if the stub
+     takes its place */
+  if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+    return NULL;
+  lcc_mpsc_push(queue, &queue->stub);
+  if ((next= __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE)))
+  {
+    queue->tail= next;
+    return tail;
+  }
+  return NULL;
+}
+
+/**
+ * @brief: initializes an empty single-producer single-consumer ring
+ *         with size slots
+ */
+void
+lcc_spsc_init(lcc_spsc_ring *ring, uint32_t size)
+{
+  ring->size= size;
+  ring->head= ring->tail= 0;
+}
+
+/* producer: slot head % size can't be filled yet */
+uint8_t
+lcc_spsc_full(lcc_spsc_ring *ring)
+{
+  return ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->size;
+}
+
+/* producer: slot head % size was filled */
+void
+lcc_spsc_publish(lcc_spsc_ring *ring)
+{
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+}
+
+/* consumer: there is no filled slot */
+uint8_t
+lcc_spsc_empty(lcc_spsc_ring *ring)
+{
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+}
+
+/* consumer: slot tail % size can be reused */
+void
+lcc_spsc_release(lcc_spsc_ring *ring)
+{
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_SEQ_CST);
+}
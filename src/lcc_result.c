@@ -1,6 +1,9 @@
 #include <lcc.h>
 #include <lcc_priv.h>
 #include <lcc_error.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
  /* todo: mysql needs a list of pointers where 
     e.g. result->conn will be invalidated;
@@ -11,12 +14,498 @@
   LCC_result_options(handle, option, ..)
 */
 
+/* read-ahead: a helper thread reads the rows of a result set and
+   copies them into batches, which are passed to the consumer by a
+   single-producer single-consumer ring. Waiting for the network and
+   parsing packets overlaps with the processing of rows. */
+
+/* default number of rows per batch and number of batches */
+#define LCC_READ_AHEAD_ROWS 256
+#define LCC_READ_AHEAD_BATCHES 4
+/* memory of a batch, which is preallocated at most for the rows of the
+   execution history */
+#define LCC_READ_AHEAD_MEMORY 16384
+#define LCC_READ_AHEAD_MAX_MEMORY 0x100000ULL
+
+/* producer: waits until a batch can be filled, returns 1 if read-ahead
+   was stopped */
+static uint8_t
+lcc_read_ahead_wait_slot(lcc_read_ahead *ra)
+{
+  uint8_t stop;
+
+  if (!lcc_spsc_full(&ra->ring))
+    return __atomic_load_n(&ra->stop, __ATOMIC_ACQUIRE);
+
+  pthread_mutex_lock(&ra->lock);
+  /* the consumer checks producer_waiting after releasing a batch */
+  __atomic_store_n(&ra->producer_waiting, 1, __ATOMIC_SEQ_CST);
+  while (lcc_spsc_full(&ra->ring) && !ra->stop)
+    pthread_cond_wait(&ra->cond, &ra->lock);
+  __atomic_store_n(&ra->producer_waiting, 0, __ATOMIC_RELAXED);
+  stop= ra->stop;
+  pthread_mutex_unlock(&ra->lock);
+  return stop;
+}
+
+static void
+lcc_read_ahead_wake(lcc_read_ahead *ra, uint8_t *waiting)
+{
+  if (!__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+    return;
+  pthread_mutex_lock(&ra->lock);
+  pthread_cond_signal(&ra->cond);
+  pthread_mutex_unlock(&ra->lock);
+}
+
+/* reads rows into the next batch */
+static void
+lcc_read_ahead_fill(lcc_read_ahead *ra, lcc_read_ahead_batch *batch)
+{
+  lcc_result *reader= &ra->reader;
+  uint32_t column_count= reader->conn->column_count;
+  uint32_t i;
+  uint8_t eof= 0;
+
+  lcc_mem_reset(&batch->memory);
+  batch->rows= 0;
+  batch->last= 0;
+  batch->rc= ER_OK;
+
+  while (batch->rows < ra->batch_rows)
+  {
+    LCC_STRING *row= batch->values + (size_t)batch->rows * column_count;
+
+    if ((batch->rc= lcc_result_fetch_one(reader, &eof)) || eof)
+    {
+      batch->last= 1;
+      return;
+    }
+
+    /* the read buffer will be overwritten by the next row */
+    for (i=0; i < column_count; i++)
+    {
+      row[i].len= reader->data[i].len;
+      row[i].str= NULL;
+      if (!reader->data[i].str)
+        continue;
+      if (!(row[i].str= (char *)lcc_mem_alloc(&batch->memory, row[i].len + 1)))
+      {
+        batch->rc= lcc_set_error(&reader->conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                                 row[i].len + 1);
+        batch->last= 1;
+        return;
+      }
+      memcpy(row[i].str, reader->data[i].str, row[i].len);
+      row[i].str[row[i].len]= 0;
+    }
+    batch->rows++;
+  }
+}
+
+static void *
+lcc_read_ahead_run(void *arg)
+{
+  lcc_read_ahead *ra= (lcc_read_ahead *)arg;
+  lcc_read_ahead_batch *batch;
+
+  lcc_numa_bind_thread(ra->reader.conn->numa_node);
+  do {
+    if (lcc_read_ahead_wait_slot(ra))
+      break;
+    batch= &ra->batches[ra->ring.head % ra->ring.size];
+    lcc_read_ahead_fill(ra, batch);
+    lcc_spsc_publish(&ra->ring);
+    lcc_read_ahead_wake(ra, &ra->consumer_waiting);
+  } while (!batch->last);
+  return NULL;
+}
+
+/* consumer: returns the next row of the batches */
+static LCC_ERRNO
+lcc_read_ahead_fetch(lcc_result *result, uint8_t *eof)
+{
+  lcc_read_ahead *ra= result->read_ahead;
+  lcc_read_ahead_batch *batch;
+
+  for (;;)
+  {
+    if ((batch= ra->current))
+    {
+      if (ra->pos < batch->rows)
+      {
+        result->data= batch->values + (size_t)ra->pos++ * ra->reader.conn->column_count;
+        result->row_count++;
+        *eof= 0;
+        return ER_OK;
+      }
+      if (batch->last)
+      {
+        /* the helper thread doesn't use the connection anymore */
+        uint32_t i;
+        for (i=0; i < ra->reader.conn->column_count; i++)
+          result->columns[i].max_column_size= lcc_MAX(result->columns[i].max_column_size,
+                                                      ra->reader.columns[i].max_column_size);
+        *eof= !batch->rc;
+        return batch->rc;
+      }
+      ra->current= NULL;
+      lcc_spsc_release(&ra->ring);
+      lcc_read_ahead_wake(ra, &ra->producer_waiting);
+    }
+
+    if (lcc_spsc_empty(&ra->ring))
+    {
+      pthread_mutex_lock(&ra->lock);
+      /* the producer checks consumer_waiting after publishing */
+      __atomic_store_n(&ra->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+      while (lcc_spsc_empty(&ra->ring))
+        pthread_cond_wait(&ra->cond, &ra->lock);
+      __atomic_store_n(&ra->consumer_waiting, 0, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&ra->lock);
+    }
+    ra->current= &ra->batches[ra->ring.tail % ra->ring.size];
+    ra->pos= 0;
+  }
+}
+
+static void
+lcc_read_ahead_free(lcc_read_ahead *ra, uint32_t batches)
+{
+  uint32_t i;
+
+  for (i=0; i < batches; i++)
+  {
+    if (ra->batches[i].memory.in_use)
+      lcc_mem_close(&ra->batches[i].memory);
+    free(ra->batches[i].values);
+  }
+  free(ra->batches);
+  if (ra->reader.memory.in_use)
+    lcc_mem_close(&ra->reader.memory);
+  free(ra);
+}
+
+/**
+ * @brief: starts reading the rows of a result set by a helper thread
+ *
+ * @param: result - result handle which reads from a connection
+ * @param: batch_rows - number of rows per batch (0 = default)
+ * @param: batches - number of batches which can be read ahead
+ *                   (0 = default, rounded up to a power of 2)
+ *
+ * Rows which were fetched stay valid until the next fetch. The
+ * connection must not be used until all rows were fetched or the
+ * result handle was closed.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_read_ahead_start(lcc_result *result, uint32_t batch_rows, uint32_t batches)
+{
+  lcc_connection *conn= result->conn;
+  const lcc_history_entry *history;
+  lcc_read_ahead *ra;
+  uint32_t i, size= 1;
+  size_t memory= LCC_READ_AHEAD_MEMORY;
+
+  if (!conn || result->stored)
+    return ER_INVALID_HANDLE;
+  if (result->read_ahead)
+    return ER_ALREADY_INITIALIZED;
+  if (conn->status != CONN_STATUS_RESULT)
+    return ER_NO_RESULT_AVAILABLE;
+
+  batch_rows= batch_rows ? batch_rows : LCC_READ_AHEAD_ROWS;
+  batches= batches ? batches : LCC_READ_AHEAD_BATCHES;
+  while (size < batches)
+    size<<= 1;
+  if ((history= lcc_history_find(conn)) && history->rows)
+    memory= lcc_MAX(memory, (size_t)lcc_MIN(history->bytes / history->rows * batch_rows,
+                                            LCC_READ_AHEAD_MAX_MEMORY));
+
+  if (!(ra= (lcc_read_ahead *)calloc(1, sizeof(lcc_read_ahead))))
+    return ER_OUT_OF_MEMORY;
+  if (!(ra->batches= (lcc_read_ahead_batch *)calloc(size, sizeof(lcc_read_ahead_batch))))
+  {
+    free(ra);
+    return ER_OUT_OF_MEMORY;
+  }
+  for (i=0; i < size; i++)
+  {
+    if (lcc_mem_init_node(&ra->batches[i].memory, memory, conn->numa_node) ||
+        !(ra->batches[i].values= (LCC_STRING *)malloc((size_t)batch_rows *
+                                  lcc_MAX(conn->column_count, 1U) * sizeof(LCC_STRING))))
+    {
+      lcc_read_ahead_free(ra, size);
+      return ER_OUT_OF_MEMORY;
+    }
+  }
+
+  /* the helper thread has its own result, column sizes are merged at
+     the end of the result set */
+  ra->reader.type= LCC_RESULT;
+  ra->reader.conn= conn;
+  ra->reader.binary= result->binary;
+  if (lcc_mem_init_node(&ra->reader.memory, 8192, conn->numa_node) ||
+      !(ra->reader.columns= (LCC_COLUMN *)lcc_mem_alloc(&ra->reader.memory,
+                                          conn->column_count * sizeof(LCC_COLUMN))))
+  {
+    lcc_read_ahead_free(ra, size);
+    return ER_OUT_OF_MEMORY;
+  }
+  memcpy(ra->reader.columns, result->columns, conn->column_count * sizeof(LCC_COLUMN));
+
+  /* the helper thread waits for the socket without a timeout (if
+     read_timeout is 0), lcc_read_ahead_stop() interrupts the wait */
+  if ((ra->wakeup_fd= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+  {
+    lcc_read_ahead_free(ra, size);
+    return ER_UNKNOWN;
+  }
+
+  lcc_spsc_init(&ra->ring, size);
+  ra->batch_rows= batch_rows;
+  pthread_mutex_init(&ra->lock, NULL);
+  pthread_cond_init(&ra->cond, NULL);
+  conn->wakeup_fd= ra->wakeup_fd;
+  if (pthread_create(&ra->thread, NULL, lcc_read_ahead_run, ra))
+  {
+    conn->wakeup_fd= -1;
+    close(ra->wakeup_fd);
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->lock);
+    lcc_read_ahead_free(ra, size);
+    return ER_UNKNOWN;
+  }
+  result->read_ahead= ra;
+  return ER_OK;
+}
+
+/**
+ * @brief: stops the helper thread and releases the batches
+ *
+ * A helper thread which waits for the server is interrupted, rows which
+ * weren't read will be discarded before the next command.
+ */
+void
+lcc_read_ahead_stop(lcc_result *result)
+{
+  lcc_read_ahead *ra= result->read_ahead;
+  uint64_t wakeup= 1;
+
+  if (!ra)
+    return;
+
+  pthread_mutex_lock(&ra->lock);
+  __atomic_store_n(&ra->stop, 1, __ATOMIC_SEQ_CST);
+  pthread_cond_signal(&ra->cond);
+  pthread_mutex_unlock(&ra->lock);
+  if (write(ra->wakeup_fd, &wakeup, sizeof(wakeup)) < 0)
+  {
+    /* counter can't overflow, the thread is woken up already */
+  }
+  pthread_join(ra->thread, NULL);
+  ra->reader.conn->wakeup_fd= -1;
+  close(ra->wakeup_fd);
+
+  if (ra->reader.conn->status == CONN_STATUS_RESULT)
+    ra->reader.conn->abandoned= 1;
+  result->data= NULL;
+  result->read_ahead= NULL;
+  pthread_cond_destroy(&ra->cond);
+  pthread_mutex_destroy(&ra->lock);
+  lcc_read_ahead_free(ra, ra->ring.size);
+}
+
 const LCC_COLUMN API_FUNC
 *LCC_result_columns(LCC_HANDLE *handle)
 {
   if (!handle || handle->type != LCC_RESULT)
     return NULL;
+  if (((lcc_result *)handle)->stored)
+    return ((lcc_result *)handle)->columns;
   if (!((lcc_result *)handle)->conn->column_count)
     return NULL;
   return ((lcc_result *)handle)->columns;
 }
+
+/**
+ * @brief: fetches the next row of a result set
+ *
+ * @param: handle - result handle
+ * @param: eof - will be set to 1 if no more rows are available
+ *
+ * The column values of the row can be retrieved with
+ * LCC_get_info(RESULT_INFO_ROW).
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_result_fetch(LCC_HANDLE *handle, uint8_t *eof)
+{
+  lcc_result *result= (lcc_result *)handle;
+
+  if (lcc_validate_handle(handle, LCC_RESULT))
+    return ER_INVALID_HANDLE;
+  if (!eof)
+    return ER_INVALID_POINTER;
+
+  if (result->read_ahead)
+    return lcc_read_ahead_fetch(result, eof);
+
+  if (!result->stored)
+  {
+    if (!result->conn)
+      return ER_INVALID_HANDLE;
+    return lcc_result_fetch_one(result, eof);
+  }
+
+  *eof= (result->current_row >= result->stored->row_count);
+  if (!*eof)
+    result->data= result->stored->rows +
+                  result->current_row++ * result->stored->column_count;
+  return ER_OK;
+}
+
+/**
+ * @brief: reads a complete result set into memory
+ *
+ * @param: conn - connection with a pending result set
+ * @param: stored - returns the result, its reference count is 1
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO
+lcc_result_store(lcc_connection *conn, lcc_stored_result **stored)
+{
+  lcc_result result;
+  lcc_stored_result *store;
+  const lcc_history_entry *history;
+  LCC_STRING *row;
+  uint64_t max_rows= 0;
+  uint32_t i;
+  uint8_t eof= 0;
+  LCC_ERRNO rc;
+
+  if (!(store= (lcc_stored_result *)calloc(1, sizeof(lcc_stored_result))))
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         sizeof(lcc_stored_result));
+
+  memset(&result, 0, sizeof(lcc_result));
+  result.type= LCC_RESULT;
+  result.conn= conn;
+
+  if ((rc= lcc_read_result_metadata(&result)))
+    goto error;
+  store->column_count= conn->column_count;
+
+  /* rows and values of the last executions fit without growing */
+  if ((history= lcc_history_find(conn)) && history->rows)
+  {
+    max_rows= history->rows + history->rows / 8;
+    if (!(store->rows= (LCC_STRING *)malloc(max_rows * store->column_count * sizeof(LCC_STRING))) ||
+        lcc_mem_reserve(&result.memory, history->bytes + history->bytes / 8))
+    {
+      rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                        max_rows * store->column_count * sizeof(LCC_STRING));
+      goto error;
+    }
+  }
+
+  for (;;)
+  {
+    if ((rc= lcc_result_fetch_one(&result, &eof)))
+      goto error;
+    if (eof)
+      break;
+
+    if (store->row_count == max_rows)
+    {
+      max_rows= max_rows ? max_rows * 2 : 16;
+      if (!(row= (LCC_STRING *)realloc(store->rows,
+                       max_rows * store->column_count * sizeof(LCC_STRING))))
+      {
+        rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                          max_rows * store->column_count * sizeof(LCC_STRING));
+        goto error;
+      }
+      store->rows= row;
+    }
+
+    /* row data points into the read buffer, so it needs to be copied */
+    row= store->rows + store->row_count * store->column_count;
+    for (i=0; i < store->column_count; i++)
+    {
+      row[i].len= result.data[i].len;
+      row[i].str= NULL;
+      if (!result.data[i].str)
+        continue;
+      if (!(row[i].str= (char *)lcc_mem_alloc(&result.memory, row[i].len + 1)))
+      {
+        rc= lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                          row[i].len + 1);
+        goto error;
+      }
+      memcpy(row[i].str, result.data[i].str, row[i].len);
+      row[i].str[row[i].len]= 0;
+    }
+    store->row_count++;
+  }
+
+  /* further result sets will be discarded */
+  if (conn->server.status & LCC_STATUS_MORE_RESULTS_EXIST)
+    conn->abandoned= 1;
+
+  store->columns= result.columns;
+  store->memory= result.memory;
+  store->refcount= 1;
+  *stored= store;
+  return ER_OK;
+
+error:
+  if (conn->status == CONN_STATUS_RESULT)
+    conn->abandoned= 1;
+  if (result.memory.in_use)
+    lcc_mem_close(&result.memory);
+  free(store->rows);
+  free(store);
+  return rc;
+}
+
+/**
+ * @brief: creates a result handle for a stored result
+ *
+ * Each handle has its own row position, the rows of the stored
+ * result must not be modified.
+ */
+LCC_ERRNO
+lcc_result_from_stored(lcc_stored_result *stored, LCC_HANDLE **handle)
+{
+  lcc_result *result;
+
+  if (!(result= (lcc_result *)lcc_numa_alloc(-1, sizeof(lcc_result))))
+    return ER_OUT_OF_MEMORY;
+
+  __atomic_add_fetch(&stored->refcount, 1, __ATOMIC_RELAXED);
+  result->type= LCC_RESULT;
+  result->stored= stored;
+  result->columns= stored->columns;
+  result->row_count= stored->row_count;
+  *handle= (LCC_HANDLE *)result;
+  return ER_OK;
+}
+
+/**
+ * @brief: drops a reference of a stored result, the last
+ *         reference releases the memory
+ */
+void
+lcc_stored_result_release(lcc_stored_result *stored)
+{
+  if (__atomic_sub_fetch(&stored->refcount, 1, __ATOMIC_ACQ_REL))
+    return;
+  lcc_mem_close(&stored->memory);
+  free(stored->rows);
+  free(stored);
+}
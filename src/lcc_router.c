@@ -0,0 +1,157 @@
+/* sticky routing by shard key (consistent hashing) */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+
+LCC_ERRNO
+lcc_router_init(lcc_router *router)
+{
+  if (pthread_rwlock_init(&router->lock, NULL))
+    return ER_UNKNOWN;
+  return ER_OK;
+}
+
+/**
+ * @brief: releases router, the shard handles are not closed
+ */
+void
+lcc_router_close(lcc_router *router)
+{
+  free(router->shards);
+  pthread_rwlock_destroy(&router->lock);
+}
+
+/**
+ * @brief: jump consistent hash (Lamping, Veach)
+ *
+ * Maps key to a bucket in [0, buckets). If the number of buckets
+ * grows from n to n + 1, only 1/(n + 1) of the keys move (to the
+ * new bucket).
+ */
+static uint32_t
+lcc_jump_hash(uint64_t key, uint32_t buckets)
+{
+  int64_t b= -1, j= 0;
+
+  while (j < (int64_t)buckets)
+  {
+    b= j;
+    key= key * 2862933555777941757ULL + 1;
+    j= (int64_t)((b + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+  }
+  return (uint32_t)b;
+}
+
+/**
+ * @brief: appends a shard
+ *
+ * @param: router - router handle
+ * @param: shard - handle of the shard (e.g. pool, backend or connection)
+ *
+ * Shards are identified by their position: adding a shard moves only
+ * the keys which will be routed to the new shard.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_router_add(LCC_HANDLE *handle, LCC_HANDLE *shard)
+{
+  lcc_router *router= (lcc_router *)handle;
+  LCC_ERRNO rc= ER_OK;
+
+  if (lcc_validate_handle(handle, LCC_ROUTER))
+    return ER_INVALID_HANDLE;
+  if (!shard)
+    return ER_INVALID_POINTER;
+
+  pthread_rwlock_wrlock(&router->lock);
+  if (router->count == router->size)
+  {
+    uint32_t size= router->size ? router->size * 2 : 8;
+    LCC_HANDLE **shards;
+
+    if (!(shards= (LCC_HANDLE **)realloc(router->shards, size * sizeof(LCC_HANDLE *))))
+    {
+      rc= ER_OUT_OF_MEMORY;
+      goto end;
+    }
+    router->shards= shards;
+    router->size= size;
+  }
+  router->shards[router->count++]= shard;
+end:
+  pthread_rwlock_unlock(&router->lock);
+  return rc;
+}
+
+/**
+ * @brief: removes the last shard
+ *
+ * @param: router - router handle
+ * @param: shard - returns the removed shard (optional)
+ *
+ * Only keys of the removed shard will be routed to other shards.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_router_remove(LCC_HANDLE *handle, LCC_HANDLE **shard)
+{
+  lcc_router *router= (lcc_router *)handle;
+  LCC_ERRNO rc= ER_OK;
+
+  if (lcc_validate_handle(handle, LCC_ROUTER))
+    return ER_INVALID_HANDLE;
+
+  pthread_rwlock_wrlock(&router->lock);
+  if (!router->count)
+    rc= ER_INVALID_VALUE;
+  else
+  {
+    router->count--;
+    if (shard)
+      *shard= router->shards[router->count];
+  }
+  pthread_rwlock_unlock(&router->lock);
+  return rc;
+}
+
+/**
+ * @brief: returns the shard for a key
+ *
+ * @param: router - router handle
+ * @param: key - shard key (e.g. tenant or user id)
+ * @param: length - length of key or LCC_NTS
+ * @param: shard - returns the shard handle
+ *
+ * The same key will always be routed to the same shard as long
+ * as the set of shards doesn't change.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_router_route(LCC_HANDLE *handle, const char *key, size_t length, LCC_HANDLE **shard)
+{
+  lcc_router *router= (lcc_router *)handle;
+  uint64_t hash;
+  LCC_ERRNO rc= ER_OK;
+
+  if (lcc_validate_handle(handle, LCC_ROUTER))
+    return ER_INVALID_HANDLE;
+  if (!key || !shard)
+    return ER_INVALID_POINTER;
+
+  if ((ssize_t)length == -1)
+    length= strlen(key);
+  hash= lcc_hash(key, length);
+
+  pthread_rwlock_rdlock(&router->lock);
+  if (!router->count)
+    rc= ER_INVALID_VALUE;
+  else
+    *shard= router->shards[lcc_jump_hash(hash, router->count)];
+  pthread_rwlock_unlock(&router->lock);
+  return rc;
+}
@@ -0,0 +1,536 @@
+/* scatter-gather: one statement is sent to several shards, their results
+   are merged into one row stream */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* state of a shard */
+#define LCC_SHARD_DONE 0
+#define LCC_SHARD_PENDING 1   /* response wasn't read yet */
+#define LCC_SHARD_ROWS 2      /* rows are available */
+
+/* column flags */
+#define LCC_UNSIGNED_FLAG 32
+#define LCC_ENUM_FLAG 256
+#define LCC_SET_FLAG 2048
+
+/* character set number of binary strings */
+#define LCC_BINARY_CHARSET 63
+
+/* maximum length of a numeric value in text protocol */
+#define LCC_NUMBER_SIZE 72
+
+/**
+ * @brief: discards the outstanding responses of all shards
+ *
+ * The responses will be read before the next command of the
+ * connection is sent.
+ */
+static void
+lcc_scatter_abandon(lcc_scatter *scatter)
+{
+  uint32_t i;
+
+  for (i=0; i < scatter->shard_count; i++)
+  {
+    lcc_scatter_shard *shard= &scatter->shards[i];
+
+    if (shard->state != LCC_SHARD_DONE && shard->result.conn)
+      shard->result.conn->abandoned= 1;
+    shard->state= LCC_SHARD_DONE;
+  }
+  scatter->heap_size= 0;
+}
+
+/**
+ * @brief: releases the results of the last statement
+ *
+ * Connections must not be closed before the results were released.
+ */
+void
+lcc_scatter_close(lcc_scatter *scatter)
+{
+  uint32_t i;
+
+  lcc_scatter_abandon(scatter);
+  for (i=0; i < scatter->shard_count; i++)
+  {
+    if (scatter->shards[i].result.memory.in_use)
+      lcc_mem_close(&scatter->shards[i].result.memory);
+  }
+  free(scatter->shards);
+  free(scatter->heap);
+  free(scatter->keys);
+  scatter->shards= NULL;
+  scatter->heap= NULL;
+  scatter->keys= NULL;
+  scatter->shard_count= scatter->key_count= 0;
+  scatter->data= NULL;
+}
+
+/* copies a numeric value, so it can be converted by strtoxx() */
+static const char *
+lcc_scatter_number(const LCC_STRING *value, char *buffer)
+{
+  size_t len= lcc_MIN(value->len, (size_t)LCC_NUMBER_SIZE - 1);
+
+  memcpy(buffer, value->str, len);
+  buffer[len]= 0;
+  return buffer;
+}
+
+/* compares two DECIMAL or TIME values: by sign, then by the length
+   of the integer part and then digit by digit */
+static int
+lcc_scatter_compare_decimal(const LCC_STRING *a, const LCC_STRING *b)
+{
+  uint8_t neg_a= a->len && a->str[0] == '-',
+          neg_b= b->len && b->str[0] == '-';
+  const char *pa= a->str + neg_a, *pb= b->str + neg_b;
+  size_t len_a= a->len - neg_a, len_b= b->len - neg_b, int_a= 0, int_b= 0;
+  int rc;
+
+  if (neg_a != neg_b)
+    return neg_a ? -1 : 1;
+
+  while (int_a < len_a && pa[int_a] >= '0' && pa[int_a] <= '9')
+    int_a++;
+  while (int_b < len_b && pb[int_b] >= '0' && pb[int_b] <= '9')
+    int_b++;
+  if (int_a != int_b)
+    rc= (int_a > int_b) ? 1 : -1;
+  /* integer parts have the same length, fractional digits follow at
+     the same positions */
+  else if (!(rc= memcmp(pa, pb, lcc_MIN(len_a, len_b))))
+    rc= (len_a > len_b) - (len_a < len_b);
+  return neg_a ? -rc : rc;
+}
+
+/**
+ * @brief: checks if the values of a column can be merged
+ *
+ * Strings are compared byte by byte, which matches the order of the
+ * server only for binary strings: columns with another collation and
+ * ENUM or SET columns (sorted by their index) can't be sort columns.
+ */
+static uint8_t
+lcc_scatter_mergeable(const LCC_COLUMN *column)
+{
+  switch (column->type) {
+  case LCC_COLTYPE_ENUM:
+  case LCC_COLTYPE_SET:
+    return 0;
+  case LCC_COLTYPE_VARCHAR:
+  case LCC_COLTYPE_JSON:
+  case LCC_COLTYPE_BLOB8:
+  case LCC_COLTYPE_BLOB24:
+  case LCC_COLTYPE_BLOB64:
+  case LCC_COLTYPE_BLOB32:
+  case LCC_COLTYPE_VARSTR:
+  case LCC_COLTYPE_STR:
+    return column->charset_nr == LCC_BINARY_CHARSET &&
+           !(column->flags & (LCC_ENUM_FLAG | LCC_SET_FLAG));
+  default:
+    return 1;
+  }
+}
+
+/* compares two values of a column, NULL sorts first */
+int
+lcc_scatter_compare_value(const LCC_COLUMN *column, const LCC_STRING *a, const LCC_STRING *b)
+{
+  char buffer_a[LCC_NUMBER_SIZE], buffer_b[LCC_NUMBER_SIZE];
+  int rc;
+
+  if (!a->str || !b->str)
+    return (a->str != NULL) - (b->str != NULL);
+
+  switch (column->type) {
+  case LCC_COLTYPE_INT8:
+  case LCC_COLTYPE_INT16:
+  case LCC_COLTYPE_INT24:
+  case LCC_COLTYPE_INT32:
+  case LCC_COLTYPE_INT64:
+  case LCC_COLTYPE_YEAR:
+    if (column->flags & LCC_UNSIGNED_FLAG)
+    {
+      unsigned long long ua= strtoull(lcc_scatter_number(a, buffer_a), NULL, 10),
+                         ub= strtoull(lcc_scatter_number(b, buffer_b), NULL, 10);
+      return (ua > ub) - (ua < ub);
+    }
+    else
+    {
+      long long la= strtoll(lcc_scatter_number(a, buffer_a), NULL, 10),
+                lb= strtoll(lcc_scatter_number(b, buffer_b), NULL, 10);
+      return (la > lb) - (la < lb);
+    }
+  case LCC_COLTYPE_NEWDECIMAL:
+  case LCC_COLTYPE_TIME:
+    return lcc_scatter_compare_decimal(a, b);
+  case LCC_COLTYPE_FLOAT:
+  case LCC_COLTYPE_DOUBLE:
+  {
+    double da= strtod(lcc_scatter_number(a, buffer_a), NULL),
+           db= strtod(lcc_scatter_number(b, buffer_b), NULL);
+    return (da > db) - (da < db);
+  }
+  default:
+    /* binary comparison: binary strings, dates and datetimes */
+    if ((rc= memcmp(a->str, b->str, lcc_MIN(a->len, b->len))))
+      return rc;
+    return (a->len > b->len) - (a->len < b->len);
+  }
+}
+
+/* checks if the current row of shard a sorts before the row of shard b */
+static uint8_t
+lcc_scatter_before(lcc_scatter *scatter, uint32_t a, uint32_t b)
+{
+  lcc_result *ra= &scatter->shards[a].result,
+             *rb= &scatter->shards[b].result;
+  uint32_t i;
+  int rc;
+
+  for (i=0; i < scatter->key_count; i++)
+  {
+    uint32_t column= scatter->keys[i].column;
+
+    if ((rc= lcc_scatter_compare_value(&ra->columns[column],
+                                       &ra->data[column], &rb->data[column])))
+      return scatter->keys[i].descending ? rc > 0 : rc < 0;
+  }
+  /* equal rows are returned in shard order */
+  return a < b;
+}
+
+static void
+lcc_scatter_sift_down(lcc_scatter *scatter, uint32_t pos)
+{
+  uint32_t *heap= scatter->heap;
+
+  for (;;)
+  {
+    uint32_t child= 2 * pos + 1, tmp;
+
+    if (child >= scatter->heap_size)
+      return;
+    if (child + 1 < scatter->heap_size &&
+        lcc_scatter_before(scatter, heap[child + 1], heap[child]))
+      child++;
+    if (!lcc_scatter_before(scatter, heap[child], heap[pos]))
+      return;
+    tmp= heap[pos];
+    heap[pos]= heap[child];
+    heap[child]= tmp;
+    pos= child;
+  }
+}
+
+static void
+lcc_scatter_push(lcc_scatter *scatter, uint32_t shard)
+{
+  uint32_t *heap= scatter->heap;
+  uint32_t pos= scatter->heap_size++;
+
+  heap[pos]= shard;
+  while (pos)
+  {
+    uint32_t parent= (pos - 1) / 2;
+
+    if (!lcc_scatter_before(scatter, heap[pos], heap[parent]))
+      break;
+    heap[pos]= heap[parent];
+    heap[parent]= shard;
+    pos= parent;
+  }
+}
+
+/* reads the next row of a shard, the row of the previous
+   call will be overwritten */
+static LCC_ERRNO
+lcc_scatter_read(lcc_scatter *scatter, uint32_t i, uint8_t *eof)
+{
+  lcc_scatter_shard *shard= &scatter->shards[i];
+  lcc_connection *conn= shard->result.conn;
+  LCC_ERRNO rc;
+
+  *eof= 0;
+  if ((rc= lcc_result_fetch_one(&shard->result, eof)))
+  {
+    memcpy(&scatter->error, &conn->error, sizeof(LCC_ERROR));
+    shard->state= LCC_SHARD_DONE;
+    if (conn->status == CONN_STATUS_RESULT)
+      conn->abandoned= 1;
+    return rc;
+  }
+  if (*eof)
+  {
+    shard->state= LCC_SHARD_DONE;
+    /* further result sets will be discarded */
+    if (conn->server.status & LCC_STATUS_MORE_RESULTS_EXIST)
+      conn->abandoned= 1;
+  }
+  return ER_OK;
+}
+
+/**
+ * @brief: sends a statement to several shards and prepares a merged
+ *         result
+ *
+ * @param: handle - scatter handle
+ * @param: connections - connection handles of the shards
+ * @param: count - number of connections
+ * @param: statement - SQL statement which returns a result set
+ * @param: length - length of statement or LCC_NTS
+ * @param: keys - sort columns or NULL if results should be concatenated
+ * @param: key_count - number of sort columns
+ * @param: limit - maximum number of rows to return, 0 = unlimited
+ *
+ * The statement is sent to all shards before the first response is
+ * read, so the shards execute it concurrently. Rows are fetched with
+ * LCC_scatter_fetch(): if sort columns were specified, each shard must
+ * return its rows in the same order (ORDER BY) and the rows are merged
+ * by a k-way heap merge, otherwise the results are returned shard by
+ * shard. Only the current row of each shard is held in memory. String
+ * sort columns must be binary (e.g. ORDER BY CAST(c AS BINARY)), the
+ * collations of the server are not available to the client.
+ *
+ * Once limit rows were returned, no further rows will be read: the
+ * outstanding rows are discarded before the next command of the
+ * connection. The statement should contain the same LIMIT, so that
+ * no shard sends more rows than needed.
+ *
+ * Results of a previous statement will be released.
+ *
+ * @return: ER_OK or error code, error information can be retrieved
+ *          by LCC_get_error() of the scatter handle.
+ */
+LCC_ERRNO API_FUNC
+LCC_scatter_execute(LCC_HANDLE *handle,
+                    LCC_HANDLE **connections,
+                    uint32_t count,
+                    const char *statement,
+                    size_t length,
+                    const LCC_MERGE_KEY *keys,
+                    uint32_t key_count,
+                    uint64_t limit)
+{
+  lcc_scatter *scatter= (lcc_scatter *)handle;
+  lcc_connection *conn= NULL;
+  uint32_t i, column_count= 0;
+  uint8_t eof;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_SCATTER))
+    return ER_INVALID_HANDLE;
+  if (!connections || !statement || (key_count && !keys))
+    return ER_INVALID_POINTER;
+  if (!count)
+    return ER_INVALID_VALUE;
+  for (i=0; i < count; i++)
+  {
+    if (lcc_validate_handle(connections[i], LCC_CONNECTION))
+      return ER_INVALID_HANDLE;
+  }
+
+  lcc_scatter_close(scatter);
+  lcc_clear_error(&scatter->error);
+  scatter->row_count= 0;
+  scatter->current= 0;
+  scatter->advance= 0;
+  scatter->limit= limit;
+
+  if ((ssize_t)length == -1)
+    length= strlen(statement);
+
+  if (!(scatter->shards= (lcc_scatter_shard *)calloc(count, sizeof(lcc_scatter_shard))) ||
+      !(scatter->heap= (uint32_t *)calloc(count, sizeof(uint32_t))) ||
+      (key_count &&
+       !(scatter->keys= (LCC_MERGE_KEY *)malloc(key_count * sizeof(LCC_MERGE_KEY)))))
+    return lcc_set_error(&scatter->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         count * sizeof(lcc_scatter_shard));
+  if (key_count)
+    memcpy(scatter->keys, keys, key_count * sizeof(LCC_MERGE_KEY));
+  scatter->key_count= key_count;
+  scatter->shard_count= count;
+
+  /* send statement to all shards first */
+  for (i=0; i < count; i++)
+  {
+    conn= (lcc_connection *)connections[i];
+    scatter->shards[i].result.type= LCC_RESULT;
+    scatter->shards[i].result.conn= conn;
+    lcc_clear_error(&conn->error);
+    conn->column_count= 0;
+    if ((rc= lcc_io_write(conn, CMD_QUERY, (char *)statement, length)))
+      goto error;
+    lcc_history_begin(conn, lcc_history_key(statement, length, 0));
+    scatter->shards[i].state= LCC_SHARD_PENDING;
+  }
+
+  for (i=0; i < count; i++)
+  {
+    lcc_scatter_shard *shard= &scatter->shards[i];
+
+    conn= shard->result.conn;
+    shard->state= LCC_SHARD_DONE;
+    if ((rc= lcc_read_response(conn)))
+      goto error;
+    /* statement didn't return a result set */
+    if (!conn->column_count)
+      continue;
+
+    if ((rc= lcc_read_result_metadata(&shard->result)))
+    {
+      if (conn->status == CONN_STATUS_RESULT)
+        conn->abandoned= 1;
+      goto error;
+    }
+    shard->state= LCC_SHARD_ROWS;
+    shard->column_count= conn->column_count;
+
+    if (!column_count)
+      column_count= conn->column_count;
+    else if (column_count != conn->column_count)
+    {
+      lcc_scatter_abandon(scatter);
+      return lcc_set_error(&scatter->error, LCC_ERROR_INFO, ER_SHARD_RESULT_MISMATCH, "HY000",
+                           NULL, i, conn->column_count);
+    }
+  }
+
+  for (i=0; i < key_count; i++)
+  {
+    if (keys[i].column >= column_count)
+    {
+      lcc_scatter_abandon(scatter);
+      return lcc_set_error(&scatter->error, LCC_ERROR_INFO, ER_INVALID_VALUE, "HY000", NULL);
+    }
+  }
+  for (i=0; i < count && key_count; i++)
+  {
+    uint32_t k;
+
+    if (scatter->shards[i].state != LCC_SHARD_ROWS)
+      continue;
+    for (k=0; k < key_count; k++)
+    {
+      const LCC_COLUMN *column= &scatter->shards[i].result.columns[keys[k].column];
+
+      if (!lcc_scatter_mergeable(column))
+      {
+        lcc_scatter_abandon(scatter);
+        return lcc_set_error(&scatter->error, LCC_ERROR_INFO, ER_MERGE_KEY_COLLATION, "HY000",
+                             NULL, keys[k].column, column->column_name);
+      }
+    }
+    break;
+  }
+
+  /* ordered merge: the first row of each shard is needed */
+  if (key_count)
+  {
+    for (i=0; i < count; i++)
+    {
+      if (scatter->shards[i].state != LCC_SHARD_ROWS)
+        continue;
+      if ((rc= lcc_scatter_read(scatter, i, &eof)))
+      {
+        lcc_scatter_abandon(scatter);
+        return rc;
+      }
+      if (!eof)
+        lcc_scatter_push(scatter, i);
+    }
+  }
+  return ER_OK;
+
+error:
+  memcpy(&scatter->error, &conn->error, sizeof(LCC_ERROR));
+  lcc_scatter_abandon(scatter);
+  return rc;
+}
+
+/**
+ * @brief: fetches the next row of a merged result
+ *
+ * @param: handle - scatter handle
+ * @param: eof - will be set to 1 if no more rows are available
+ *
+ * The column values of the row can be retrieved with
+ * LCC_get_info(SCATTER_INFO_ROW), the number of the shard which
+ * returned the row with LCC_get_info(SCATTER_INFO_SHARD). The values
+ * are valid until the next call.
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_scatter_fetch(LCC_HANDLE *handle, uint8_t *eof)
+{
+  lcc_scatter *scatter= (lcc_scatter *)handle;
+  uint8_t shard_eof;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_SCATTER))
+    return ER_INVALID_HANDLE;
+  if (!eof)
+    return ER_INVALID_POINTER;
+
+  *eof= 0;
+  scatter->data= NULL;
+
+  if (scatter->limit && scatter->row_count >= scatter->limit)
+    goto end;
+
+  if (scatter->key_count)
+  {
+    /* replace the row which was returned last */
+    if (scatter->advance)
+    {
+      scatter->advance= 0;
+      if ((rc= lcc_scatter_read(scatter, scatter->heap[0], &shard_eof)))
+      {
+        lcc_scatter_abandon(scatter);
+        return rc;
+      }
+      if (shard_eof)
+        scatter->heap[0]= scatter->heap[--scatter->heap_size];
+      lcc_scatter_sift_down(scatter, 0);
+    }
+    if (!scatter->heap_size)
+      goto end;
+    scatter->current= scatter->heap[0];
+    scatter->advance= 1;
+  }
+  else
+  {
+    for (;;)
+    {
+      if (scatter->current >= scatter->shard_count)
+        goto end;
+      if (scatter->shards[scatter->current].state == LCC_SHARD_ROWS)
+      {
+        if ((rc= lcc_scatter_read(scatter, scatter->current, &shard_eof)))
+        {
+          lcc_scatter_abandon(scatter);
+          return rc;
+        }
+        if (!shard_eof)
+          break;
+      }
+      scatter->current++;
+    }
+  }
+
+  scatter->data= scatter->shards[scatter->current].result.data;
+  scatter->row_count++;
+  return ER_OK;
+
+end:
+  *eof= 1;
+  /* limit reached: remaining rows will be discarded */
+  lcc_scatter_abandon(scatter);
+  return ER_OK;
+}
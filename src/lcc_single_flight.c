@@ -0,0 +1,239 @@
+/* single-flight: identical concurrent reads are executed only once */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_error.h>
+#include <stdlib.h>
+#include <string.h>
+
+LCC_ERRNO
+lcc_single_flight_init(lcc_single_flight *group)
+{
+  if (pthread_mutex_init(&group->lock, NULL))
+    return ER_UNKNOWN;
+  if (pthread_cond_init(&group->done, NULL))
+  {
+    pthread_mutex_destroy(&group->lock);
+    return ER_UNKNOWN;
+  }
+  return ER_OK;
+}
+
+/**
+ * @brief: releases single-flight handle
+ *
+ * The handle must not be in use by other threads.
+ */
+void
+lcc_single_flight_close(lcc_single_flight *group)
+{
+  pthread_cond_destroy(&group->done);
+  pthread_mutex_destroy(&group->lock);
+}
+
+/* drops a reference, must be called with lock held */
+static void
+lcc_flight_release(lcc_flight *flight)
+{
+  if (--flight->refcount)
+    return;
+  if (flight->result)
+    lcc_stored_result_release(flight->result);
+  free(flight->statement);
+  free(flight->user);
+  free(flight->current_db);
+  free(flight->charset);
+  free(flight);
+}
+
+/* user, default schema and character set of a connection: rows are
+   only shared between callers with the same session context */
+static const char *
+lcc_flight_user(lcc_connection *conn)
+{
+  return conn->configuration.user ? conn->configuration.user : "";
+}
+
+static const char *
+lcc_flight_db(lcc_connection *conn)
+{
+  if (conn->server.current_db)
+    return conn->server.current_db;
+  return conn->configuration.current_db ? conn->configuration.current_db : "";
+}
+
+static const char *
+lcc_flight_charset(lcc_connection *conn)
+{
+  return conn->server.charset ? conn->server.charset : "utf8mb4";
+}
+
+static uint64_t
+lcc_flight_hash(lcc_connection *conn, const char *statement, size_t length)
+{
+  const char *context[3];
+  uint64_t hash= lcc_hash(statement, length);
+  uint32_t i;
+
+  context[0]= lcc_flight_user(conn);
+  context[1]= lcc_flight_db(conn);
+  context[2]= lcc_flight_charset(conn);
+  for (i=0; i < 3; i++)
+    hash= (hash ^ lcc_hash(context[i], strlen(context[i]))) * 0x100000001b3ULL;
+  return hash;
+}
+
+static lcc_flight *
+lcc_flight_find(lcc_single_flight *group, lcc_connection *conn,
+                const char *statement, size_t length, uint64_t hash)
+{
+  lcc_flight *flight;
+
+  for (flight= group->flights[hash % LCC_FLIGHT_SLOTS]; flight; flight= flight->next)
+  {
+    if (flight->hash == hash && flight->length == length &&
+        !memcmp(flight->statement, statement, length) &&
+        !strcmp(flight->user, lcc_flight_user(conn)) &&
+        !strcmp(flight->current_db, lcc_flight_db(conn)) &&
+        !strcmp(flight->charset, lcc_flight_charset(conn)))
+      return flight;
+  }
+  return NULL;
+}
+
+static void
+lcc_flight_unlink(lcc_single_flight *group, lcc_flight *flight)
+{
+  lcc_flight **slot;
+
+  for (slot= &group->flights[flight->hash % LCC_FLIGHT_SLOTS]; *slot; slot= &(*slot)->next)
+  {
+    if (*slot == flight)
+    {
+      *slot= flight->next;
+      break;
+    }
+  }
+  flight->next= NULL;
+}
+
+/**
+ * @brief: executes a read-only query, identical concurrent queries
+ *         will be sent only once
+ *
+ * @param: group - single-flight handle
+ * @param: connection - connection handle of the caller
+ * @param: statement - read-only SQL statement
+ * @param: length - length of statement or LCC_NTS
+ * @param: result - returns a result handle or NULL if the statement
+ *                  didn't return a result set
+ *
+ * If the same statement (byte by byte, including its literal
+ * parameters) is already in flight on behalf of another caller with
+ * the same user, default schema and character set, the
+ * caller waits for that query and receives a result handle for the
+ * same rows, otherwise the statement is executed on the connection
+ * and the complete result set is read into memory.
+ * The rows of the result are shared between all callers and must not
+ * be modified. Results are not cached: once the query finished, the
+ * next call will execute the statement again.
+ *
+ * @return: ER_OK or error code, error information is stored in
+ *          the connection handle.
+ */
+LCC_ERRNO API_FUNC
+LCC_single_flight_execute(LCC_HANDLE *handle,
+                          LCC_HANDLE *connection,
+                          const char *statement,
+                          size_t length,
+                          LCC_HANDLE **result)
+{
+  lcc_single_flight *group= (lcc_single_flight *)handle;
+  lcc_connection *conn= (lcc_connection *)connection;
+  lcc_stored_result *stored= NULL;
+  lcc_flight *flight;
+  uint64_t hash;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_SINGLE_FLIGHT) ||
+      lcc_validate_handle(connection, LCC_CONNECTION))
+    return ER_INVALID_HANDLE;
+  if (!statement || !result)
+    return ER_INVALID_POINTER;
+
+  *result= NULL;
+  if ((ssize_t)length == -1)
+    length= strlen(statement);
+
+  lcc_clear_error(&conn->error);
+  if (!lcc_is_read_only(statement, length))
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_NOT_READ_ONLY, "HY000", NULL);
+
+  hash= lcc_flight_hash(conn, statement, length);
+
+  pthread_mutex_lock(&group->lock);
+
+  /* same query is in flight: wait for its result */
+  if ((flight= lcc_flight_find(group, conn, statement, length, hash)))
+  {
+    flight->refcount++;
+    group->coalesced++;
+    while (!flight->done)
+      pthread_cond_wait(&group->done, &group->lock);
+
+    if ((rc= flight->rc))
+      memcpy(&conn->error, &flight->error, sizeof(LCC_ERROR));
+    else if (flight->result &&
+             (rc= lcc_result_from_stored(flight->result, result)))
+      lcc_set_error(&conn->error, LCC_ERROR_INFO, rc, "HY000", NULL, sizeof(lcc_result));
+    lcc_flight_release(flight);
+    pthread_mutex_unlock(&group->lock);
+    return rc;
+  }
+
+  if (!(flight= (lcc_flight *)calloc(1, sizeof(lcc_flight))) ||
+      !(flight->statement= (char *)malloc(length)) ||
+      !(flight->user= strdup(lcc_flight_user(conn))) ||
+      !(flight->current_db= strdup(lcc_flight_db(conn))) ||
+      !(flight->charset= strdup(lcc_flight_charset(conn))))
+  {
+    if (flight)
+    {
+      flight->refcount= 1;
+      lcc_flight_release(flight);
+    }
+    pthread_mutex_unlock(&group->lock);
+    return lcc_set_error(&conn->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL, length);
+  }
+  memcpy(flight->statement, statement, length);
+  flight->length= length;
+  flight->hash= hash;
+  flight->refcount= 1;
+  flight->next= group->flights[hash % LCC_FLIGHT_SLOTS];
+  group->flights[hash % LCC_FLIGHT_SLOTS]= flight;
+  group->executed++;
+  pthread_mutex_unlock(&group->lock);
+
+  conn->column_count= 0;
+  if (!(rc= lcc_io_write(conn, CMD_QUERY, (char *)statement, length)))
+  {
+    lcc_history_begin(conn, lcc_history_key(statement, length, 0));
+    if (!(rc= lcc_read_response(conn)) && conn->column_count)
+      rc= lcc_result_store(conn, &stored);
+  }
+
+  pthread_mutex_lock(&group->lock);
+  /* callers which arrive from now on will execute the query again */
+  lcc_flight_unlink(group, flight);
+  flight->rc= rc;
+  memcpy(&flight->error, &conn->error, sizeof(LCC_ERROR));
+  flight->result= stored;
+  flight->done= 1;
+  pthread_cond_broadcast(&group->done);
+
+  if (!rc && stored &&
+      (rc= lcc_result_from_stored(stored, result)))
+    lcc_set_error(&conn->error, LCC_ERROR_INFO, rc, "HY000", NULL, sizeof(lcc_result));
+  lcc_flight_release(flight);
+  pthread_mutex_unlock(&group->lock);
+  return rc;
+}
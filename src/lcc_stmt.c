@@ -8,6 +8,8 @@ lcc_bin_type lcc_bin_types[LCC_COLTYPE_GEOMETRY +1];
 uint8_t lcc_stmt_initialized= 0;
 
 #define STMT_EXEC_HEADER_SIZE 10
+/* statement id, flags and iteration count */
+#define STMT_EXEC_ID_SIZE 9
 
 void lcc_stmt_init_bin_types()
 {
@@ -71,18 +73,31 @@ void lcc_stmt_init_bin_types()
   lcc_stmt_initialized= 1;
 }
 
-LCC_ERRNO
-lcc_stmt_close(LCC_HANDLE *handle)
+/**
+ * @brief: releases a statement handle
+ *
+ * The prepared statement is closed on the server if the connection
+ * is idle, otherwise it stays until the connection was closed.
+ */
+void
+lcc_stmt_close(lcc_stmt *stmt)
 {
-  LCC_ERRNO rc;
-  lcc_stmt *stmt= (lcc_stmt *)handle;
-
-  if ((rc= lcc_validate_handle(handle, LCC_STATEMENT)))
-    goto error;
+  if (stmt->result)
+    LCC_close_handle((LCC_HANDLE *)stmt->result);
+  if (stmt->conn)
+  {
+    if (stmt->id && stmt->conn->status == CONN_STATUS_READY)
+    {
+      char buffer[4];
 
-  return ER_OK;
-error:
-  return lcc_set_error(&stmt->error, LCC_ERROR_INFO, rc, "HY000", NULL);
+      ui32_to_p(buffer, stmt->id);
+      lcc_io_write(stmt->conn, CMD_STMT_CLOSE, buffer, 4);
+    }
+    lcc_list_clear_element(stmt->conn->handles, stmt);
+  }
+  if (stmt->memory.in_use)
+    lcc_mem_close(&stmt->memory);
+  free(stmt->execbuf.buf);
 }
 
 LCC_ERRNO API_FUNC
@@ -95,6 +110,8 @@ LCC_statement_prepare(LCC_HANDLE *handle,
 
   if ((rc= lcc_validate_handle(handle, LCC_STATEMENT)))
     return rc;
+  if (!stmt->conn)
+    return ER_INVALID_HANDLE;
 
   if (!stmt_str || stmt_str[0] == 0 || len == 0)
   {
@@ -107,6 +124,7 @@ LCC_statement_prepare(LCC_HANDLE *handle,
 
   if((rc= lcc_io_write(stmt->conn, CMD_STMT_PREPARE, (char *)stmt_str, len)))
     goto error;
+  stmt->history_key= lcc_history_key(stmt_str, len, 1);
 
   return ER_OK;
 error:
@@ -116,7 +134,7 @@ error:
 LCC_ERRNO API_FUNC
 LCC_statement_read_prepare_response(LCC_HANDLE *handle)
 {
-  if (lcc_validate_handle(handle, LCC_STATEMENT))
+  if (lcc_validate_handle(handle, LCC_STATEMENT) || !((lcc_stmt *)handle)->conn)
     return ER_INVALID_HANDLE;
   return lcc_read_prepare_response((lcc_stmt *)handle);
 }
@@ -201,7 +219,7 @@ size_t lcc_store_param(u_char *buffer, LCC_BIND *param)
       return 4;
     case LCC_COLTYPE_DOUBLE:
       d_to_p(buffer, *((double *)param->buffer.buf));
-      return 4;
+      return 8;
     case LCC_COLTYPE_TIME:
     case LCC_COLTYPE_DATE:
     case LCC_COLTYPE_DATETIME:
@@ -212,6 +230,41 @@ size_t lcc_store_param(u_char *buffer, LCC_BIND *param)
   }
 }
 
+/**
+ * @brief: resizes the execute buffer and stores the execute header
+ *
+ * @return: position after the header or NULL if out of memory
+ */
+static u_char *
+lcc_stmt_exec_header(lcc_stmt *stmt, size_t total_length)
+{
+  u_char *pos;
+
+  if (total_length > stmt->execbuf.len)
+  {
+    void *tmp= stmt->execbuf.buf;
+    total_length= lcc_align_size(LCC_MEM_ALIGN_SIZE, total_length);
+    if (!(stmt->execbuf.buf= realloc(stmt->execbuf.buf, total_length)))
+    {
+      stmt->execbuf.buf= tmp;
+      return NULL;
+    }
+    stmt->execbuf.len= total_length;
+  }
+
+  pos= (u_char *)stmt->execbuf.buf;
+
+  /* Execute header */
+  ui32_to_p(pos, stmt->id);
+  pos+= 4;
+  *pos++= 0;
+  ui32_to_p(pos, (uint32_t)1);
+  pos+= 4;
+
+  stmt->exec_len= pos - (u_char *)stmt->execbuf.buf;
+  return pos;
+}
+
 /**
  * @brief: LCC_stmt_set_params
  *
@@ -246,29 +299,12 @@ LCC_stmt_fill_exec_buffer(LCC_HANDLE *handle)
     total_length+= len;
   }
 
-  if (total_length > stmt->execbuf.len)
+  if (!(pos= lcc_stmt_exec_header(stmt, total_length)))
   {
-    void *tmp= stmt->execbuf.buf;
-    total_length= lcc_align_size(LCC_MEM_ALIGN_SIZE, total_length);
-    if (!(stmt->execbuf.buf= realloc(stmt->execbuf.buf, total_length)))
-    {
-      rc= ER_OUT_OF_MEMORY;
-      stmt->execbuf.buf= tmp;
-      goto error;
-    }
-    stmt->execbuf.len= total_length;
+    rc= ER_OUT_OF_MEMORY;
+    goto error;
   }
-
-  pos= start= (u_char *)stmt->execbuf.buf;
-
-  /* Execute header */
-  ui32_to_p(pos, stmt->id);
-  pos+= 4;
-  *pos++= 0;
-  ui32_to_p(pos, (uint32_t)1);
-  pos+= 4;
-
-  stmt->exec_len= pos - start;
+  start= (u_char *)stmt->execbuf.buf;
 
   /* if statement has no parameters, we just quit */
   if (!stmt->param_count)
@@ -291,7 +327,7 @@ LCC_stmt_fill_exec_buffer(LCC_HANDLE *handle)
         bind->indicator == LCC_INDICATOR_NULL)
     {
       bind->has_data= 0;
-      null_pos[i/8]= (u_char)(1 << (i & 7));
+      null_pos[i/8]|= (u_char)(1 << (i & 7));
     } else
     {
       bind->has_data= 1;
@@ -315,13 +351,67 @@ error:
   return lcc_set_error(&stmt->error, LCC_ERROR_INFO, rc, "HY000", NULL);
 }
 
+/**
+ * @brief: returns the execute buffer for parameters which are encoded
+ *         by the caller instead of LCC_stmt_fill_exec_buffer()
+ *
+ * @param: handle - statement handle
+ * @param: param_count - number of encoded parameters
+ * @param: size - max. size of the encoded parameters: null bitmap,
+ *                send types flag, types and values
+ * @param: buffer - returns the position after the execute header
+ *
+ * The length of the encoded parameters is set by
+ * LCC_stmt_set_exec_length().
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_stmt_reserve_exec_buffer(LCC_HANDLE *handle,
+                             uint32_t param_count,
+                             size_t size,
+                             uint8_t **buffer)
+{
+  lcc_stmt *stmt= (lcc_stmt *)handle;
+
+  if (lcc_validate_handle(handle, LCC_STATEMENT))
+    return ER_INVALID_HANDLE;
+
+  if (param_count != stmt->param_count)
+    return lcc_set_error(&stmt->error, LCC_ERROR_INFO, ER_PARAM_COUNT_MISMATCH,
+                         "HY000", NULL, stmt->param_count, param_count);
+
+  if (!(*buffer= lcc_stmt_exec_header(stmt, STMT_EXEC_ID_SIZE + size)))
+    return lcc_set_error(&stmt->error, LCC_ERROR_INFO, ER_OUT_OF_MEMORY, "HY000", NULL,
+                         (long)(STMT_EXEC_ID_SIZE + size));
+  return ER_OK;
+}
+
+/**
+ * @brief: sets the length of the parameters which were encoded into
+ *         the buffer of LCC_stmt_reserve_exec_buffer()
+ */
+LCC_ERRNO API_FUNC
+LCC_stmt_set_exec_length(LCC_HANDLE *handle, size_t length)
+{
+  lcc_stmt *stmt= (lcc_stmt *)handle;
+
+  if (lcc_validate_handle(handle, LCC_STATEMENT))
+    return ER_INVALID_HANDLE;
+  if (!stmt->execbuf.buf || STMT_EXEC_ID_SIZE + length > stmt->execbuf.len)
+    return lcc_set_error(&stmt->error, LCC_ERROR_INFO, ER_INVALID_BUFFER_SIZE, "HY000", NULL);
+
+  stmt->exec_len= STMT_EXEC_ID_SIZE + length;
+  return ER_OK;
+}
+
 LCC_ERRNO API_FUNC
 LCC_stmt_execute(LCC_HANDLE *handle)
 {
   LCC_ERRNO rc;
   lcc_stmt *stmt= (lcc_stmt *)handle;
 
-  if (lcc_validate_handle(handle, LCC_STATEMENT))
+  if (lcc_validate_handle(handle, LCC_STATEMENT) || !stmt->conn)
     return ER_INVALID_HANDLE;
 
   if (!stmt->execbuf.buf ||
@@ -333,8 +423,34 @@ LCC_stmt_execute(LCC_HANDLE *handle)
 
   if((rc= lcc_io_write(stmt->conn, CMD_STMT_EXECUTE, (char *)stmt->execbuf.buf, stmt->exec_len)))
     goto error;
+  lcc_history_begin(stmt->conn, stmt->history_key);
 
   return ER_OK;
 error:
   return lcc_set_error(&stmt->error, LCC_ERROR_INFO, rc, "HY000", NULL);
 }
+
+/**
+ * @brief: reads the response of LCC_stmt_execute()
+ *
+ * @param: handle - statement handle
+ *
+ * If the statement returned a result set, the rows can be read by a
+ * result handle of the statement (LCC_init_handle(LCC_RESULT, stmt)).
+ *
+ * @return: ER_OK or error code
+ */
+LCC_ERRNO API_FUNC
+LCC_stmt_read_execute_response(LCC_HANDLE *handle)
+{
+  lcc_stmt *stmt= (lcc_stmt *)handle;
+  LCC_ERRNO rc;
+
+  if (lcc_validate_handle(handle, LCC_STATEMENT) || !stmt->conn)
+    return ER_INVALID_HANDLE;
+
+  stmt->conn->column_count= 0;
+  if ((rc= lcc_read_response(stmt->conn)))
+    memcpy(&stmt->error, &stmt->conn->error, sizeof(LCC_ERROR));
+  return rc;
+}
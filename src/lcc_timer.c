@@ -0,0 +1,167 @@
+/* hierarchical timer wheel */
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <string.h>
+
+#define LCC_WHEEL_MASK (LCC_WHEEL_SLOTS - 1)
+#define LCC_WHEEL_RANGE (1ULL << (LCC_WHEEL_BITS * LCC_WHEEL_LEVELS))
+
+/**
+ * @brief: initializes a timer wheel
+ *
+ * @param: wheel - timer wheel
+ * @param: resolution - length of a tick in usec
+ * @param: now - current time in usec (lcc_now_usec)
+ */
+void
+lcc_timer_wheel_init(lcc_timer_wheel *wheel, uint32_t resolution, uint64_t now)
+{
+  memset(wheel, 0, sizeof(lcc_timer_wheel));
+  wheel->resolution= resolution;
+  wheel->start= now;
+}
+
+/* links timer into the slot for its expiration tick */
+static void
+lcc_timer_link(lcc_timer_wheel *wheel, lcc_timer *timer)
+{
+  uint64_t delta= timer->expires - wheel->now;
+  lcc_timer **slot;
+  uint8_t level;
+
+  /* expiration exceeds range of the wheel */
+  if (delta >= LCC_WHEEL_RANGE)
+  {
+    timer->expires= wheel->now + LCC_WHEEL_RANGE - 1;
+    delta= LCC_WHEEL_RANGE - 1;
+  }
+
+  for (level= 0; delta >= (1ULL << (LCC_WHEEL_BITS * (level + 1))); level++);
+
+  slot= &wheel->slots[level][(timer->expires >> (LCC_WHEEL_BITS * level)) & LCC_WHEEL_MASK];
+  timer->next= *slot;
+  timer->prev= slot;
+  if (*slot)
+    (*slot)->prev= &timer->next;
+  *slot= timer;
+}
+
+static void
+lcc_timer_unlink(lcc_timer *timer)
+{
+  *timer->prev= timer->next;
+  if (timer->next)
+    timer->next->prev= timer->prev;
+  timer->next= NULL;
+  timer->prev= NULL;
+}
+
+/**
+ * @brief: schedules a timer, O(1)
+ *
+ * @param: wheel - timer wheel
+ * @param: timer - timer with callback and data
+ * @param: expires - expiration time in usec (lcc_now_usec)
+ *
+ * A pending timer will be rescheduled.
+ */
+void
+lcc_timer_add(lcc_timer_wheel *wheel, lcc_timer *timer, uint64_t expires)
+{
+  uint64_t tick= 0;
+
+  if (timer->prev)
+    lcc_timer_cancel(wheel, timer);
+
+  if (expires > wheel->start)
+    tick= (expires - wheel->start + wheel->resolution - 1) / wheel->resolution;
+  /* current tick was already processed */
+  timer->expires= lcc_MAX(tick, wheel->now + 1);
+  lcc_timer_link(wheel, timer);
+  wheel->count++;
+}
+
+/**
+ * @brief: cancels a pending timer, O(1)
+ */
+void
+lcc_timer_cancel(lcc_timer_wheel *wheel, lcc_timer *timer)
+{
+  if (!timer->prev)
+    return;
+  lcc_timer_unlink(timer);
+  wheel->count--;
+}
+
+/**
+ * @brief: advances the wheel to the given time and runs the callbacks
+ *         of expired timers
+ *
+ * @param: wheel - timer wheel
+ * @param: now - current time in usec (lcc_now_usec)
+ *
+ * Callbacks may add or cancel timers.
+ *
+ * @return: number of expired timers
+ */
+uint32_t
+lcc_timer_wheel_advance(lcc_timer_wheel *wheel, uint64_t now)
+{
+  uint64_t target;
+  uint32_t expired= 0;
+  lcc_timer *timer;
+  uint8_t level;
+
+  if (now < wheel->start)
+    return 0;
+  target= (now - wheel->start) / wheel->resolution;
+
+  while (wheel->now < target)
+  {
+    wheel->now++;
+
+    /* when a lower level wraps around, the timers of the next slot
+       of the higher level are moved to the lower levels */
+    for (level= 1; level < LCC_WHEEL_LEVELS; level++)
+    {
+      lcc_timer **slot;
+
+      if (wheel->now & ((1ULL << (LCC_WHEEL_BITS * level)) - 1))
+        break;
+      slot= &wheel->slots[level][(wheel->now >> (LCC_WHEEL_BITS * level)) & LCC_WHEEL_MASK];
+      while ((timer= *slot))
+      {
+        lcc_timer_unlink(timer);
+        lcc_timer_link(wheel, timer);
+      }
+    }
+
+    while ((timer= wheel->slots[0][wheel->now & LCC_WHEEL_MASK]))
+    {
+      lcc_timer_unlink(timer);
+      wheel->count--;
+      expired++;
+      timer->callback(timer);
+    }
+  }
+  return expired;
+}
+
+/**
+ * @brief: returns the time (usec) when the wheel needs to be advanced
+ *         the next time, or UINT64_MAX if no timer is pending
+ */
+uint64_t
+lcc_timer_wheel_next(lcc_timer_wheel *wheel)
+{
+  uint64_t tick;
+
+  if (!wheel->count)
+    return UINT64_MAX;
+
+  /* next pending slot of level 0, otherwise the next cascade */
+  for (tick= wheel->now + 1; tick & LCC_WHEEL_MASK; tick++)
+    if (wheel->slots[0][tick & LCC_WHEEL_MASK])
+      break;
+  return wheel->start + tick * wheel->resolution;
+}
@@ -0,0 +1,136 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <unistd.h>
+
+/* one command: acquire a slot and release it with the given result */
+static LCC_ERRNO command(lcc_backend *backend, lcc_cmd_result result, uint64_t rtt)
+{
+  LCC_ERRNO rc;
+
+  if ((rc= lcc_backend_acquire(backend)))
+    return rc;
+  lcc_backend_release(backend, result, rtt);
+  return ER_OK;
+}
+
+static int test_limit(void)
+{
+  LCC_HANDLE *handle;
+  lcc_backend *backend;
+  uint32_t min_limit= 1, max_limit= 8, initial= 2, i;
+  double limit;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_BACKEND, NULL), "Can't create backend");
+  backend= (lcc_backend *)handle;
+  ASSERT_EQ(ER_INVALID_VALUE, LCC_set_option(handle, LCC_OPT_BACKEND_LIMITS, &max_limit, &min_limit, &initial),
+            "Minimum above maximum was accepted");
+  ASSERT_EQ(ER_OK, LCC_set_option(handle, LCC_OPT_BACKEND_LIMITS, &min_limit, &max_limit, &initial),
+            "Can't set limits");
+
+  ASSERT_EQ(ER_OK, lcc_backend_acquire(backend), "Can't acquire first slot");
+  ASSERT_EQ(ER_OK, lcc_backend_acquire(backend), "Can't acquire second slot");
+  ASSERT_EQ(ER_CONCURRENCY_LIMIT, lcc_backend_acquire(backend), "Limit of 2 was exceeded");
+  ASSERT_EQ(2, backend->in_flight, "Expected 2 in-flight commands, got %u", backend->in_flight);
+  lcc_backend_release(backend, CMD_RESULT_OK, 1000);
+  ASSERT_EQ(ER_OK, lcc_backend_acquire(backend), "Released slot can't be acquired");
+  lcc_backend_release(backend, CMD_RESULT_OK, 1000);
+  lcc_backend_release(backend, CMD_RESULT_OK, 1000);
+  ASSERT_EQ(0, backend->in_flight, "Expected no in-flight commands, got %u", backend->in_flight);
+
+  /* constant response times of a fully used limit: the limit grows
+     up to the maximum */
+  for (i=0; i < 200; i++)
+  {
+    uint32_t j, n= (uint32_t)backend->limit;
+
+    for (j=0; j < n; j++)
+      ASSERT_EQ(ER_OK, lcc_backend_acquire(backend), "Can't acquire slot %u of %u", j, n);
+    for (j=0; j < n; j++)
+      lcc_backend_release(backend, CMD_RESULT_OK, 1000);
+  }
+  ASSERT_EQ(1, backend->limit > max_limit - 1, "Limit didn't grow: %f", backend->limit);
+  ASSERT_EQ(1, backend->limit <= max_limit, "Limit exceeds maximum: %f", backend->limit);
+
+  /* growing response times (queueing) shrink the limit */
+  limit= backend->limit;
+  for (i=0; i < 2; i++)
+  {
+    uint32_t j, n= (uint32_t)backend->limit;
+
+    for (j=0; j < n; j++)
+      ASSERT_EQ(ER_OK, lcc_backend_acquire(backend), "Can't acquire slot");
+    for (j=0; j < n; j++)
+      lcc_backend_release(backend, CMD_RESULT_OK, 10000);
+  }
+  ASSERT_EQ(1, backend->limit < limit, "Limit didn't shrink: %f", backend->limit);
+
+  /* failures decrease the limit down to the minimum */
+  for (i=0; i < 100; i++)
+    lcc_backend_release(backend, CMD_RESULT_SERVER_OVERLOAD, 0);
+  ASSERT_EQ(1, backend->limit == min_limit, "Limit %f isn't the minimum", backend->limit);
+
+  LCC_close_handle(handle);
+  return OK;
+}
+
+static int test_circuit(void)
+{
+  LCC_HANDLE *handle;
+  lcc_backend *backend;
+  uint32_t threshold= 50, min_requests= 4, window= 10000, open_time= 50;
+  LCC_CIRCUIT_STATE state;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_BACKEND, NULL), "Can't create backend");
+  backend= (lcc_backend *)handle;
+  ASSERT_EQ(ER_OK, LCC_set_option(handle, LCC_OPT_CIRCUIT_BREAKER, &threshold, &min_requests,
+                                  &window, &open_time), "Can't configure circuit breaker");
+
+  /* the error rate is only checked after min_requests commands */
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_COMM_ERROR, 0), "Command failed");
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_COMM_ERROR, 0), "Command failed");
+  ASSERT_EQ(LCC_CIRCUIT_CLOSED, backend->circuit, "Circuit opened before min_requests");
+  /* server errors other than overload are a successful round trip */
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_SERVER_ERROR, 1000), "Command failed");
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_OK, 1000), "Command failed");
+  ASSERT_EQ(LCC_CIRCUIT_CLOSED, backend->circuit, "Successful command opened circuit");
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_COMM_ERROR, 0), "Command failed");
+  ASSERT_EQ(LCC_CIRCUIT_OPEN, backend->circuit, "Circuit isn't open at 60%% errors");
+  ASSERT_EQ(ER_OK, LCC_get_info(handle, BACKEND_INFO_CIRCUIT_STATE, &state), "Can't read state");
+  ASSERT_EQ(LCC_CIRCUIT_OPEN, state, "Wrong circuit state %d", state);
+  ASSERT_EQ(ER_CIRCUIT_OPEN, lcc_backend_acquire(backend), "Open circuit accepted command");
+
+  /* after open_time a single probe is allowed */
+  usleep((open_time + 10) * 1000);
+  ASSERT_EQ(ER_OK, lcc_backend_acquire(backend), "Probe wasn't allowed");
+  ASSERT_EQ(LCC_CIRCUIT_HALF_OPEN, backend->circuit, "Circuit isn't half open");
+  ASSERT_EQ(ER_CIRCUIT_OPEN, lcc_backend_acquire(backend), "Second probe was allowed");
+
+  /* a canceled probe allows the next one */
+  lcc_backend_release(backend, CMD_RESULT_CANCELED, 0);
+  ASSERT_EQ(LCC_CIRCUIT_HALF_OPEN, backend->circuit, "Canceled probe changed state");
+
+  /* a failed probe opens the circuit again */
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_COMM_ERROR, 0), "Probe wasn't allowed");
+  ASSERT_EQ(LCC_CIRCUIT_OPEN, backend->circuit, "Failed probe didn't open circuit");
+  ASSERT_EQ(ER_CIRCUIT_OPEN, lcc_backend_acquire(backend), "Open circuit accepted command");
+
+  /* a successful probe closes it */
+  usleep((open_time + 10) * 1000);
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_OK, 1000), "Probe wasn't allowed");
+  ASSERT_EQ(LCC_CIRCUIT_CLOSED, backend->circuit, "Successful probe didn't close circuit");
+  ASSERT_EQ(0, backend->requests, "Window wasn't reset");
+  ASSERT_EQ(ER_OK, command(backend, CMD_RESULT_OK, 1000), "Closed circuit refused command");
+
+  LCC_close_handle(handle);
+  return OK;
+}
+
+int main()
+{
+  plan(2);
+  ok(!test_limit());
+  ok(!test_circuit());
+
+  done_testing();
+}
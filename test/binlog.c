@@ -0,0 +1,141 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <string.h>
+
+/* decodes one value, all bytes of the image have to be consumed */
+static int decode(const LCC_BINLOG_COLUMN *column, const u_char *image, size_t size,
+                  LCC_BINLOG_VALUE *value)
+{
+  u_char buffer[64], *pos= buffer;
+
+  memcpy(buffer, image, size);
+  memset(value, 0, sizeof(LCC_BINLOG_VALUE));
+  value->present= 1;
+  ASSERT_EQ(0, lcc_binlog_value(column, &pos, buffer + size, value), "Can't decode value");
+  ASSERT_EQ(size, (size_t)(pos - buffer), "Decoded %lu of %lu bytes",
+            (unsigned long)(pos - buffer), (unsigned long)size);
+  /* a truncated image is rejected */
+  pos= buffer;
+  ASSERT_EQ(1, lcc_binlog_value(column, &pos, buffer + size - 1, value), "Truncated value was decoded");
+  pos= buffer;
+  lcc_binlog_value(column, &pos, buffer + size, value);
+  return OK;
+}
+
+static int test_decimal(void)
+{
+  struct {
+    uint8_t precision, scale;
+    const char *image;
+    size_t size;
+    const char *expected;
+  } cases[]= {
+    {10, 2, "\x80\x12\xD6\x87\x59", 5, "1234567.89"},
+    {10, 2, "\x7F\xED\x29\x78\xA6", 5, "-1234567.89"},
+    {10, 2, "\x80\x00\x00\x00\x05", 5, "0.05"},
+    {20, 0, "\x80\x00\x00\x00\x00\x00\x00\x00\x00", 9, "0"},
+    {5, 5, "\x80\x30\x39", 3, "0.12345"},
+    {18, 9, "\x87\x5B\xCD\x15\x00\x00\x00\x01", 8, "123456789.000000001"},
+    {4, 0, "\x80\x07", 2, "7"},
+    {4, 0, "\x7F\xF8", 2, "-7"}
+  };
+  uint32_t i;
+
+  for (i=0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    LCC_BINLOG_COLUMN column;
+    LCC_BINLOG_VALUE value;
+    char buffer[64];
+    size_t len;
+
+    memset(&column, 0, sizeof(column));
+    column.type= LCC_COLTYPE_NEWDECIMAL;
+    column.precision= cases[i].precision;
+    column.decimals= cases[i].scale;
+    ASSERT_EQ(OK, decode(&column, (const u_char *)cases[i].image, cases[i].size, &value),
+              "Case %u: DECIMAL(%u,%u) has wrong size", i, cases[i].precision, cases[i].scale);
+    len= LCC_binlog_decimal(&column, &value, buffer, sizeof(buffer));
+    ASSERT_EQ(strlen(cases[i].expected), len, "Case %u: wrong length %lu", i, (unsigned long)len);
+    ASSERT_EQ(0, strcmp(cases[i].expected, buffer), "Case %u: expected %s, got %s", i,
+              cases[i].expected, buffer);
+  }
+  return OK;
+}
+
+static int test_time2(void)
+{
+  struct {
+    uint8_t decimals;
+    const char *image;
+    size_t size;
+    uint8_t negative;
+    uint16_t hour;
+    uint8_t minute, second;
+    uint32_t microseconds;
+  } cases[]= {
+    {0, "\x80\xC8\xB8", 3, 0, 12, 34, 56, 0},
+    {0, "\x7F\x37\x48", 3, 1, 12, 34, 56, 0},
+    {0, "\x80\x00\x00", 3, 0, 0, 0, 0, 0},
+    /* TIME values range up to 838 hours */
+    {1, "\xB4\x6E\xFB\x32", 4, 0, 838, 59, 59, 500000},
+    /* negative values with fraction borrow from the integer part */
+    {2, "\x7F\xFF\xFE\xE7", 4, 1, 0, 0, 1, 250000},
+    {4, "\x80\x00\x01\x04\xCE", 5, 0, 0, 0, 1, 123000},
+    {6, "\x80\x10\x83\x00\x00\x04", 6, 0, 1, 2, 3, 4},
+    {6, "\x7F\xEF\x7C\xFF\xFF\xFC", 6, 1, 1, 2, 3, 4}
+  };
+  uint32_t i;
+
+  for (i=0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    LCC_BINLOG_COLUMN column;
+    LCC_BINLOG_VALUE value;
+
+    memset(&column, 0, sizeof(column));
+    column.type= LCC_COLTYPE_TIME2;
+    column.decimals= cases[i].decimals;
+    ASSERT_EQ(OK, decode(&column, (const u_char *)cases[i].image, cases[i].size, &value),
+              "Case %u: TIME(%u) has wrong size", i, cases[i].decimals);
+    ASSERT_EQ(cases[i].negative, value.time.negative, "Case %u: wrong sign", i);
+    ASSERT_EQ(cases[i].hour, value.time.hour, "Case %u: expected hour %u, got %u", i,
+              cases[i].hour, value.time.hour);
+    ASSERT_EQ(cases[i].minute, value.time.minute, "Case %u: expected minute %u, got %u", i,
+              cases[i].minute, value.time.minute);
+    ASSERT_EQ(cases[i].second, value.time.second, "Case %u: expected second %u, got %u", i,
+              cases[i].second, value.time.second);
+    ASSERT_EQ(cases[i].microseconds, value.time.microseconds, "Case %u: expected %u usec, got %u", i,
+              cases[i].microseconds, value.time.microseconds);
+  }
+  return OK;
+}
+
+static int test_datetime2(void)
+{
+  LCC_BINLOG_COLUMN column;
+  LCC_BINLOG_VALUE value;
+
+  memset(&column, 0, sizeof(column));
+  column.type= LCC_COLTYPE_DATETIME2;
+  column.decimals= 3;
+  ASSERT_EQ(OK, decode(&column, (const u_char *)"\x99\xB2\xBB\x7E\xFA\x04\xCE", 7, &value),
+            "DATETIME(3) has wrong size");
+  ASSERT_EQ(2024, value.time.year, "Wrong year %u", value.time.year);
+  ASSERT_EQ(2, value.time.month, "Wrong month %u", value.time.month);
+  ASSERT_EQ(29, value.time.day, "Wrong day %u", value.time.day);
+  ASSERT_EQ(23, value.time.hour, "Wrong hour %u", value.time.hour);
+  ASSERT_EQ(59, value.time.minute, "Wrong minute %u", value.time.minute);
+  ASSERT_EQ(58, value.time.second, "Wrong second %u", value.time.second);
+  ASSERT_EQ(123000, value.time.microseconds, "Wrong microseconds %u", value.time.microseconds);
+  return OK;
+}
+
+int main()
+{
+  plan(3);
+  ok(!test_decimal());
+  ok(!test_time2());
+  ok(!test_datetime2());
+
+  done_testing();
+}
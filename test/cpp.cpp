@@ -0,0 +1,450 @@
+#include <lcc.hpp>
+extern "C" {
+#include <lcc_priv.h>
+}
+#include <lcc_test.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* packet with header */
+static std::string packet(uint8_t seq, std::string_view payload)
+{
+  std::string pkt;
+
+  pkt.push_back((char)(payload.size() & 0xFF));
+  pkt.push_back((char)((payload.size() >> 8) & 0xFF));
+  pkt.push_back((char)((payload.size() >> 16) & 0xFF));
+  pkt.push_back((char)seq);
+  pkt.append(payload);
+  return pkt;
+}
+
+static std::string lenc(std::string_view value)
+{
+  return std::string(1, (char)value.size()).append(value);
+}
+
+/* column definition packet */
+static std::string column(uint8_t seq, std::string_view name, uint8_t type, uint16_t flags= 0)
+{
+  std::string def= lenc("def") + lenc("") + lenc("t") + lenc("t") + lenc(name) + lenc(name);
+
+  /* fixed fields: charset, length, type, flags, decimals, filler */
+  def.append("\x0C\x21\x00\x0B\x00\x00\x00", 7);
+  def.push_back((char)type);
+  def.push_back((char)(flags & 0xFF));
+  def.push_back((char)(flags >> 8));
+  def.append("\x00\x00\x00", 3);
+  return packet(seq, def);
+}
+
+static std::string eof(uint8_t seq)
+{
+  return packet(seq, std::string_view("\xFE\x00\x00\x02\x00", 5));
+}
+
+/* result set with one column per type, rows are the payloads of the
+   row packets */
+static std::string result_set(const std::vector<std::pair<std::string, uint8_t>> &columns,
+                               const std::vector<std::string> &rows)
+{
+  uint8_t seq= 1;
+  std::string response= packet(seq++, std::string(1, (char)columns.size()));
+
+  for (const auto &[name, type] : columns)
+    response+= column(seq++, name, type);
+  response+= eof(seq++);
+  for (const std::string &row : rows)
+    response+= packet(seq++, row);
+  return response + eof(seq);
+}
+
+/* response to COM_STMT_PREPARE */
+static std::string prepare_ok(const std::vector<std::pair<std::string, uint8_t>> &columns,
+                              uint16_t params)
+{
+  uint8_t seq= 1;
+  std::string prepared("\x00\x01\x00\x00\x00", 5), response;
+
+  prepared.push_back((char)columns.size());
+  prepared.push_back(0);
+  prepared.push_back((char)params);
+  prepared.push_back(0);
+  prepared.append("\x00\x00\x00", 3);
+  response= packet(seq++, prepared);
+  for (uint16_t i= 0; i < params; i++)
+    response+= column(seq++, "?", LCC_COLTYPE_NULL);
+  if (params)
+    response+= eof(seq++);
+  for (const auto &[name, type] : columns)
+    response+= column(seq++, name, type);
+  if (!columns.empty())
+    response+= eof(seq);
+  return response;
+}
+
+/* value of a binary row */
+template <typename T>
+static std::string binary(T value)
+{
+  return std::string((const char *)&value, sizeof(T));
+}
+
+/* answers each command with the next response after a delay, so a
+   coroutine has to wait for it */
+class fake_server
+{
+public:
+  explicit fake_server(lcc::connection &conn, std::vector<std::string> responses)
+    : responses_(std::move(responses))
+  {
+    int sv[2];
+
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    ((lcc_connection *)conn.handle())->socket= sv[0];
+    fd_= sv[1];
+    thread_= std::thread([this] { run(); });
+  }
+  ~fake_server()
+  {
+    /* a failed test may not have sent all commands */
+    shutdown(fd_, SHUT_RDWR);
+    if (thread_.joinable())
+      thread_.join();
+    close(fd_);
+  }
+
+  /* payloads of the received commands, waits until all responses
+     were sent */
+  const std::vector<std::string> &commands()
+  {
+    if (thread_.joinable())
+      thread_.join();
+    return commands_;
+  }
+
+private:
+  bool read_all(char *buffer, size_t size)
+  {
+    ssize_t r;
+
+    for (; size; buffer+= r, size-= (size_t)r)
+      if ((r= read(fd_, buffer, size)) <= 0)
+        return false;
+    return true;
+  }
+
+  void run()
+  {
+    for (const std::string &response : responses_)
+    {
+      unsigned char header[4];
+      std::string payload;
+
+      if (!read_all((char *)header, 4))
+        return;
+      payload.resize(header[0] | header[1] << 8 | header[2] << 16);
+      if (!read_all(payload.data(), payload.size()))
+        return;
+      commands_.push_back(std::move(payload));
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      if (write(fd_, response.data(), response.size()) != (ssize_t)response.size())
+        return;
+    }
+  }
+
+  int fd_;
+  std::vector<std::string> responses_;
+  std::vector<std::string> commands_;
+  std::thread thread_;
+};
+
+static lcc::task<uint32_t> read_rows(lcc::connection &conn, std::vector<std::string> &values)
+{
+  lcc::result res= co_await conn.query("SELECT a FROM t");
+  uint32_t rows= 0;
+
+  while (lcc::row r= co_await res.next())
+  {
+    values.emplace_back(r[0]);
+    rows++;
+  }
+  co_return rows;
+}
+
+static int test_coroutine(void)
+{
+  lcc::poll_scheduler sched;
+  lcc::connection conn(&sched);
+  fake_server server(conn, {result_set({{"a", LCC_COLTYPE_INT32}}, {"\x01""1", "\x01""2"})});
+  std::vector<std::string> values;
+  lcc::task<uint32_t> task= read_rows(conn, values);
+
+  /* the coroutine suspends until the server answered */
+  task.start();
+  ASSERT_EQ(false, task.done(), "Coroutine didn't wait for the response");
+  sched.run();
+  ASSERT_EQ(true, task.done(), "Coroutine didn't finish");
+  ASSERT_EQ(2u, task.get(), "Expected 2 rows");
+  ASSERT_EQ(2u, values.size(), "Expected 2 values, got %zu", values.size());
+  ASSERT_EQ("1", values[0], "Wrong value %s", values[0].c_str());
+  ASSERT_EQ("2", values[1], "Wrong value %s", values[1].c_str());
+  ASSERT_EQ(std::string("\x03SELECT a FROM t"), server.commands().at(0), "Wrong command");
+  return OK;
+}
+
+static lcc::task<LCC_ERRNO> query_error(lcc::connection &conn, std::string &sqlstate)
+{
+  try {
+    co_await conn.query("SELECT a FROM missing");
+  } catch (const lcc::error &e) {
+    sqlstate= e.sqlstate();
+    co_return e.code();
+  }
+  co_return ER_OK;
+}
+
+static int test_coroutine_error(void)
+{
+  lcc::poll_scheduler sched;
+  lcc::connection conn(&sched);
+  fake_server server(conn, {packet(1, "\xFF\x7A\x04#42S02Table 'missing' doesn't exist")});
+  std::string sqlstate;
+  lcc::task<LCC_ERRNO> task= query_error(conn, sqlstate);
+
+  task.start();
+  sched.run();
+  ASSERT_EQ(true, task.done(), "Coroutine didn't finish");
+  ASSERT_EQ(1146, task.get(), "Error wasn't thrown");
+  ASSERT_EQ("42S02", sqlstate, "Wrong SQLSTATE %s", sqlstate.c_str());
+  return OK;
+}
+
+/* without a scheduler, operations block */
+static int test_blocking(void)
+{
+  lcc::connection conn;
+  fake_server server(conn, {result_set({{"id", LCC_COLTYPE_INT32}, {"name", LCC_COLTYPE_VARCHAR}},
+                                        {"\x01""1\x03""one", "\x01""2\xFB",
+                                         std::string("\x01""3\x00", 3)}),
+                            packet(1, std::string_view("\x00\x05\x07\x02\x00\x00\x00", 7))});
+  const char *names[]= {"one", nullptr, ""};
+  uint32_t rows= 0;
+  lcc::result res= conn.query("SELECT id, name FROM t").get();
+
+  ASSERT_EQ(true, (bool)res, "Query returned no result set");
+  ASSERT_EQ(2u, res.column_count(), "Expected 2 columns, got %u", res.column_count());
+  ASSERT_EQ(false, res.binary(), "Text result is binary");
+  for (const lcc::row &row : res)
+  {
+    std::vector<std::string_view> values(row.begin(), row.end());
+
+    ASSERT_EQ(2u, row.size(), "Row %u: expected 2 values", rows);
+    ASSERT_EQ(std::to_string(rows + 1), row[0], "Row %u: wrong id", rows);
+    ASSERT_EQ(!names[rows], row.is_null(1), "Row %u: wrong NULL indicator", rows);
+    ASSERT_EQ(names[rows] ? names[rows] : "", row[1], "Row %u: wrong name", rows);
+    ASSERT_EQ(row[1].size(), row.bytes(1).size(), "Row %u: wrong size of bytes", rows);
+    ASSERT_EQ(2u, values.size(), "Row %u: iterator returned %zu values", rows, values.size());
+    ASSERT_EQ(row[1], values[1], "Row %u: iterator returned wrong value", rows);
+    ASSERT_EQ(row[1], row.begin()[1], "Row %u: wrong indexed value", rows);
+    rows++;
+  }
+  ASSERT_EQ(3u, rows, "Expected 3 rows, got %u", rows);
+  ASSERT_EQ(false, (bool)res.next().get(), "Row after the last row");
+
+  /* a statement without result set */
+  res= conn.query("DELETE FROM t").get();
+  ASSERT_EQ(false, (bool)res, "Statement returned a result set");
+  ASSERT_EQ(5u, conn.affected_rows(), "Wrong affected rows");
+  ASSERT_EQ(7u, conn.last_insert_id(), "Wrong last insert id");
+  ASSERT_EQ(2u, server.commands().size(), "Expected 2 commands");
+  return OK;
+}
+
+static int test_blocking_error(void)
+{
+  lcc::connection conn;
+  fake_server server(conn, {packet(1, "\xFF\x7A\x04#42S02Table 'missing' doesn't exist"),
+                            packet(1, "\xFF\x7A\x04#42S02Table 'missing' doesn't exist")});
+  LCC_ERRNO rc= ER_OK;
+
+  try {
+    conn.query("SELECT a FROM missing").get();
+  } catch (const lcc::error &e) {
+    rc= e.code();
+  }
+  ASSERT_EQ(1146, rc, "Error wasn't thrown");
+  /* try_get() needs std::expected (C++23) */
+#ifdef __cpp_lib_expected
+  auto res= conn.query("SELECT a FROM missing").try_get();
+
+  ASSERT_EQ(false, res.has_value(), "Error wasn't returned");
+  ASSERT_EQ(1146, res.error().code(), "Wrong error %d", res.error().code());
+#endif
+  return OK;
+}
+
+struct item
+{
+  int64_t id;
+  std::string_view name;
+  std::optional<double> price;
+};
+
+static int test_typed_text(void)
+{
+  lcc::connection conn;
+  const std::vector<std::pair<std::string, uint8_t>> columns=
+    {{"id", LCC_COLTYPE_INT64}, {"name", LCC_COLTYPE_VARCHAR}, {"price", LCC_COLTYPE_NEWDECIMAL}};
+  fake_server server(conn, {result_set(columns, {"\x01""1\x03""one\x03""9.5", "\x02""-2\x03""two\xFB"}),
+                            result_set(columns, {"\x01""1\x03""one\x03""9.5"}),
+                            result_set(columns, {"\x01""x\x03""one\xFB"})});
+  std::vector<item> items;
+
+  {
+    lcc::result res= conn.query("SELECT id, name, price FROM t").get();
+
+    for (const item &it : res.as<item>())
+      items.push_back(it);
+  }
+  ASSERT_EQ(2u, items.size(), "Expected 2 rows, got %zu", items.size());
+  ASSERT_EQ(1, items[0].id, "Wrong id %ld", (long)items[0].id);
+  ASSERT_EQ("one", items[0].name, "Wrong name");
+  ASSERT_EQ(true, items[0].price == 9.5, "Wrong price");
+  ASSERT_EQ(-2, items[1].id, "Wrong id %ld", (long)items[1].id);
+  ASSERT_EQ(false, items[1].price.has_value(), "NULL wasn't decoded as std::nullopt");
+
+  /* tuples, and the columns are checked once per result */
+  {
+    lcc::result res= conn.query("SELECT id, name, price FROM t").get();
+    LCC_ERRNO rc= ER_OK;
+
+    try {
+      res.as<std::tuple<int64_t, std::string>>();
+    } catch (const lcc::error &e) {
+      rc= e.code();
+    }
+    ASSERT_EQ(ER_ROW_TYPE_MISMATCH, rc, "Wrong number of fields was accepted");
+    try {
+      res.as<std::tuple<int64_t, int64_t, double>>();
+    } catch (const lcc::error &e) {
+      rc= e.code();
+    }
+    ASSERT_EQ(ER_COLUMN_TYPE_MISMATCH, rc, "VARCHAR column was accepted for int64_t");
+
+    auto rows= res.as<std::tuple<int32_t, std::string, double>>();
+    std::optional<std::tuple<int32_t, std::string, double>> row= rows.next().get();
+
+    ASSERT_EQ(true, row.has_value(), "Row is missing");
+    ASSERT_EQ(1, std::get<0>(*row), "Wrong id");
+    ASSERT_EQ("one", std::get<1>(*row), "Wrong name");
+    ASSERT_EQ(false, rows.next().get().has_value(), "Row after the last row");
+  }
+
+  /* values which can't be converted */
+  {
+    lcc::result res= conn.query("SELECT id, name, price FROM t").get();
+    LCC_ERRNO rc= ER_OK;
+
+    try {
+      res.as<item>().next().get();
+    } catch (const lcc::error &e) {
+      rc= e.code();
+    }
+    ASSERT_EQ(ER_COLUMN_CONVERSION, rc, "Invalid number was decoded");
+  }
+  return OK;
+}
+
+static int test_typed_binary(void)
+{
+  lcc::connection conn;
+  const std::vector<std::pair<std::string, uint8_t>> columns=
+    {{"id", LCC_COLTYPE_INT64}, {"name", LCC_COLTYPE_VARCHAR}, {"price", LCC_COLTYPE_DOUBLE}};
+  /* header, null bitmap (offset 2) and values */
+  fake_server server(conn, {prepare_ok(columns, 0),
+                            result_set(columns, {std::string("\x00\x00", 2) + binary<int64_t>(1) +
+                                                 "\x03""one" + binary(9.5),
+                                                 std::string("\x00\x10", 2) + binary<int64_t>(-2) +
+                                                 "\x03""two"})});
+  lcc::statement stmt(conn);
+  std::vector<item> items;
+
+  stmt.prepare("SELECT id, name, price FROM t").get();
+  lcc::result res= stmt.execute().get();
+  LCC_ERRNO rc= ER_OK;
+
+  ASSERT_EQ(true, res.binary(), "Result of a statement isn't binary");
+  /* binary values must have the size of the field */
+  try {
+    res.as<std::tuple<int32_t, std::string_view, double>>();
+  } catch (const lcc::error &e) {
+    rc= e.code();
+  }
+  ASSERT_EQ(ER_COLUMN_TYPE_MISMATCH, rc, "BIGINT column was accepted for int32_t");
+  for (const item &it : res.as<item>())
+    items.push_back(it);
+  ASSERT_EQ(2u, items.size(), "Expected 2 rows, got %zu", items.size());
+  ASSERT_EQ(1, items[0].id, "Wrong id %ld", (long)items[0].id);
+  ASSERT_EQ("one", items[0].name, "Wrong name");
+  ASSERT_EQ(true, items[0].price == 9.5, "Wrong price");
+  ASSERT_EQ(-2, items[1].id, "Wrong id %ld", (long)items[1].id);
+  ASSERT_EQ("two", items[1].name, "Wrong name");
+  ASSERT_EQ(false, items[1].price.has_value(), "NULL wasn't decoded as std::nullopt");
+  return OK;
+}
+
+static int test_typed_params(void)
+{
+  lcc::connection conn;
+  fake_server server(conn, {prepare_ok({}, 7),
+                            packet(1, std::string_view("\x00\x01\x00\x02\x00\x00\x00", 7))});
+  lcc::statement stmt(conn);
+  std::string text(300, 'x');
+  std::string expected("\x17\x01\x00\x00\x00\x00\x01\x00\x00\x00", 10);
+  LCC_ERRNO rc= ER_OK;
+
+  stmt.prepare("INSERT INTO t VALUES (?, ?, ?, ?, ?, ?, ?)").get();
+
+  /* the number of arguments is checked when the statement is executed */
+  try {
+    stmt.execute(int64_t(42)).get();
+  } catch (const lcc::error &e) {
+    rc= e.code();
+  }
+  ASSERT_EQ(ER_PARAM_COUNT_MISMATCH, rc, "Wrong number of parameters was accepted");
+
+  lcc::result res= stmt.execute(int64_t(42), std::string_view("name"), std::optional<double>(), true,
+                                text, nullptr, uint16_t(7)).get();
+  ASSERT_EQ(false, (bool)res, "Statement returned a result set");
+
+  /* null bitmap: parameters 2 and 5, send types flag, type and flags
+     (128 = unsigned) of each parameter, values which aren't NULL */
+  expected.append("\x24\x01", 2);
+  expected.append("\x08\x00\xFE\x00\x05\x00\x01\x80\xFE\x00\x06\x00\x02\x80", 14);
+  expected+= binary<int64_t>(42) + "\x04name" + "\x01" + "\xFC\x2C\x01" + text + binary<uint16_t>(7);
+  ASSERT_EQ(2u, server.commands().size(), "Expected 2 commands, got %zu", server.commands().size());
+  ASSERT_EQ(expected, server.commands()[1], "Wrong execute packet");
+  return OK;
+}
+
+int main()
+{
+  signal(SIGPIPE, SIG_IGN);
+
+  plan(7);
+  ok(!test_coroutine());
+  ok(!test_coroutine_error());
+  ok(!test_blocking());
+  ok(!test_blocking_error());
+  ok(!test_typed_text());
+  ok(!test_typed_binary());
+  ok(!test_typed_params());
+
+  done_testing();
+}
@@ -0,0 +1,192 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+/* the worker functions of lcc-export are static */
+#define main lcc_export_main
+#include "../tools/lcc_export.c"
+#undef main
+
+static uint32_t resets, queries;
+
+static size_t packet(unsigned char *out, unsigned char *seq, const void *data, size_t len)
+{
+  out[0]= (unsigned char)len;
+  out[1]= (unsigned char)(len >> 8);
+  out[2]= (unsigned char)(len >> 16);
+  out[3]= (*seq)++;
+  memcpy(out + 4, data, len);
+  return len + 4;
+}
+
+/* result set with columns id and name, EOF packets report an open
+   transaction */
+static size_t result_set(unsigned char *out)
+{
+  const unsigned char column_count[]= {2},
+                      eof[]= {0xFE, 0, 0, LCC_STATUS_IN_TRANS, 0},
+                      row1[]= {1, '1', 1, 'a'},
+                      row2[]= {1, '2', 0xFB},
+                      row3[]= {1, '3', 3, 'x', ',', 'y'};
+  const char *names[]= {"id", "name"};
+  unsigned char column[64], seq= 1;
+  size_t len= 0, i;
+
+  len+= packet(out + len, &seq, column_count, sizeof(column_count));
+  for (i=0; i < 2; i++)
+  {
+    size_t pos= 0, j;
+
+    /* catalog, schema, table, org_table */
+    for (j=0; j < 4; j++)
+    {
+      column[pos++]= 1;
+      column[pos++]= 't';
+    }
+    /* name, org_name */
+    for (j=0; j < 2; j++)
+    {
+      column[pos]= (unsigned char)strlen(names[i]);
+      memcpy(column + pos + 1, names[i], column[pos]);
+      pos+= column[pos] + 1;
+    }
+    column[pos++]= 0x0C;
+    memset(column + pos, 0, 12);
+    column[pos]= 63;
+    column[pos + 2]= 11;
+    column[pos + 6]= i ? LCC_COLTYPE_VARCHAR : LCC_COLTYPE_INT32;
+    pos+= 12;
+    len+= packet(out + len, &seq, column, pos);
+  }
+  len+= packet(out + len, &seq, eof, sizeof(eof));
+  len+= packet(out + len, &seq, row1, sizeof(row1));
+  len+= packet(out + len, &seq, row2, sizeof(row2));
+  len+= packet(out + len, &seq, row3, sizeof(row3));
+  len+= packet(out + len, &seq, eof, sizeof(eof));
+  return len;
+}
+
+static void *fake_server(void *arg)
+{
+  static unsigned char in[0x10000], out[0x10000];
+  const unsigned char ok_in_trans[]= {0, 0, 0, LCC_STATUS_IN_TRANS, 0, 0, 0},
+                      ok[]= {0, 0, 0, LCC_STATUS_AUTOCOMMIT, 0, 0, 0};
+  int fd= *(int *)arg;
+  size_t length= 0, pos, out_len;
+
+  for (;;)
+  {
+    ssize_t r= read(fd, in + length, sizeof(in) - length);
+
+    if (r <= 0)
+      return NULL;
+    length+= (size_t)r;
+    for (pos= 0, out_len= 0; length - pos >= 4; )
+    {
+      size_t pkt_len= in[pos] | in[pos + 1] << 8 | in[pos + 2] << 16;
+      unsigned char seq= 1;
+
+      if (length - pos < pkt_len + 4)
+        break;
+      if (in[pos + 4] == CMD_RESET_CONNECTION)
+      {
+        resets++;
+        out_len+= packet(out + out_len, &seq, ok, sizeof(ok));
+      }
+      else if (pkt_len > 7 && !memcmp(in + pos + 5, "SELECT ", 7))
+      {
+        queries++;
+        out_len+= result_set(out + out_len);
+      }
+      else
+        out_len+= packet(out + out_len, &seq, ok_in_trans, sizeof(ok_in_trans));
+      pos+= pkt_len + 4;
+    }
+    memmove(in, in + pos, length - pos);
+    length-= pos;
+    if (out_len && write(fd, out, out_len) != (ssize_t)out_len)
+      return NULL;
+  }
+}
+
+static int test_snapshot_kept(void)
+{
+  export_options options;
+  export_job job;
+  export_thread worker;
+  LCC_HANDLE *conn;
+  pthread_t server;
+  char dir[]= "/tmp/lcc_export_XXXXXX", path[128], content[64];
+  FILE *file;
+  size_t len;
+  int sv[2];
+
+  ASSERT_EQ(dir, mkdtemp(dir), "Can't create output directory");
+  ASSERT_EQ(ER_OK, LCC_init_handle(&conn, LCC_CONNECTION, NULL), "Can't create connection");
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+  ((lcc_connection *)conn)->socket= sv[0];
+  pthread_create(&server, NULL, fake_server, &sv[1]);
+
+  ASSERT_EQ(0, export_command(conn, "START TRANSACTION WITH CONSISTENT SNAPSHOT"),
+            "Can't start transaction");
+
+  memset(&options, 0, sizeof(options));
+  options.database= "db";
+  options.table= "t";
+  options.outdir= dir;
+  options.format= EXPORT_CSV;
+  memset(&job, 0, sizeof(job));
+  job.options= &options;
+  strcpy(job.table, "`db`.`t`");
+  strcpy(job.key, "`id`");
+  job.min_key= 1;
+  job.max_key= 6;
+  job.width= 3;
+  job.chunk_count= 2;
+  worker.job= &job;
+  worker.conn= conn;
+  job.workers= &worker;
+  job.worker_count= 1;
+
+  /* both chunks are read by the same connection */
+  export_worker(&worker);
+  ASSERT_EQ(0, job.failed, "Export failed");
+  ASSERT_EQ(2, queries, "Expected 2 chunk queries, got %u", queries);
+  ASSERT_EQ(6, job.rows, "Expected 6 rows, got %lu", (unsigned long)job.rows);
+
+  /* the snapshot is still open after each chunk */
+  ASSERT_EQ(0, resets, "Connection was reset %u times", resets);
+  ASSERT_EQ(LCC_STATUS_IN_TRANS, ((lcc_connection *)conn)->server.status & LCC_STATUS_IN_TRANS,
+            "Connection isn't in a transaction after a chunk");
+
+  snprintf(path, sizeof(path), "%s/db.t.00001.csv", dir);
+  ASSERT_EQ(1, (file= fopen(path, "rb")) != NULL, "Chunk file %s is missing", path);
+  len= fread(content, 1, sizeof(content) - 1, file);
+  content[len]= 0;
+  fclose(file);
+  ASSERT_EQ(0, strcmp(content, "1,a\n2,\\N\n3,\"x,y\"\n"), "Wrong CSV output: %s", content);
+
+  snprintf(path, sizeof(path), "%s/db.t.00000.csv", dir);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/db.t.00001.csv", dir);
+  unlink(path);
+  rmdir(dir);
+
+  LCC_close_handle(conn);
+  shutdown(sv[1], SHUT_RDWR);
+  pthread_join(server, NULL);
+  close(sv[1]);
+  return OK;
+}
+
+int main()
+{
+  signal(SIGPIPE, SIG_IGN);
+
+  plan(1);
+  ok(!test_snapshot_kept());
+
+  done_testing();
+}
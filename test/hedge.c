@@ -0,0 +1,245 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* server which answers each command with an OK packet and
+   remembers the last statement */
+typedef struct {
+  int fd;
+  pthread_t thread;
+  char statement[64];
+} fake_server;
+
+static void *ok_server(void *arg)
+{
+  fake_server *server= (fake_server *)arg;
+  const unsigned char ok[]= {7, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0};
+  unsigned char in[256];
+  ssize_t len;
+
+  while ((len= read(server->fd, in, sizeof(in))) > 5)
+  {
+    size_t pkt_len= in[0] | in[1] << 8 | in[2] << 16;
+
+    pkt_len= lcc_MIN(pkt_len - 1, sizeof(server->statement) - 1);
+    memcpy(server->statement, in + 5, pkt_len);
+    server->statement[pkt_len]= 0;
+    if (write(server->fd, ok, sizeof(ok)) != (ssize_t)sizeof(ok))
+      break;
+  }
+  return NULL;
+}
+
+/* connection to a server which answers (server != NULL) or not */
+static int connect_fake(LCC_HANDLE **handle, int *peer, fake_server *server)
+{
+  int sv[2];
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(handle, LCC_CONNECTION, NULL), "Can't create connection");
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+  ((lcc_connection *)*handle)->socket= sv[0];
+  *peer= sv[1];
+  if (server)
+  {
+    server->fd= sv[1];
+    server->statement[0]= 0;
+    pthread_create(&server->thread, NULL, ok_server, server);
+  }
+  return OK;
+}
+
+static int test_percentile(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+  struct {
+    uint8_t percentile;
+    uint32_t expected;
+  } small[]= {
+    {0, 1}, {1, 1}, {10, 1}, {11, 2}, {50, 5}, {90, 9}, {95, 10}, {99, 10}, {100, 10}, {200, 10}
+  }, full[]= {
+    /* only the last LCC_LATENCY_SAMPLES (37..100) are kept */
+    {1, 37}, {50, 68}, {90, 94}, {99, 100}, {100, 100}
+  };
+  uint32_t i;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_CONNECTION, NULL), "Can't create connection");
+  conn= (lcc_connection *)handle;
+
+  ASSERT_EQ(0, lcc_latency_percentile(conn, 50), "Percentile without samples must be 0");
+
+  /* samples are not added in order */
+  for (i=0; i < 10; i++)
+    lcc_latency_add(conn, (i * 7) % 10 + 1);
+  for (i=0; i < sizeof(small) / sizeof(small[0]); i++)
+    ASSERT_EQ(small[i].expected, lcc_latency_percentile(conn, small[i].percentile),
+              "p%u: expected %u, got %u", small[i].percentile, small[i].expected,
+              lcc_latency_percentile(conn, small[i].percentile));
+
+  memset(&conn->latency, 0, sizeof(lcc_latency));
+  for (i=1; i <= 100; i++)
+    lcc_latency_add(conn, i);
+  ASSERT_EQ(LCC_LATENCY_SAMPLES, conn->latency.sample_count, "Wrong number of samples");
+  for (i=0; i < sizeof(full) / sizeof(full[0]); i++)
+    ASSERT_EQ(full[i].expected, lcc_latency_percentile(conn, full[i].percentile),
+              "p%u: expected %u, got %u", full[i].percentile, full[i].expected,
+              lcc_latency_percentile(conn, full[i].percentile));
+
+  /* response times exceeding 32 bit are capped */
+  lcc_latency_add(conn, 1ULL << 40);
+  ASSERT_EQ(UINT32_MAX, lcc_latency_percentile(conn, 100), "Sample wasn't capped");
+
+  LCC_close_handle(handle);
+  return OK;
+}
+
+static int test_read_only(void)
+{
+  struct {
+    const char *statement;
+    uint8_t read_only;
+  } cases[]= {
+    {"SELECT 1", 1},
+    {"  /* comment */ select * from t", 1},
+    {"SHOW TABLES", 1},
+    {"UPDATE t SET a=1", 0},
+    {"SELECT * FROM t FOR UPDATE", 0},
+    {"select * from t for  update", 0},
+    {"SELECT * FROM t FOR\nUPDATE", 0},
+    {"SELECT * FROM t FOR SHARE", 0},
+    {"SELECT * FROM t LOCK IN SHARE MODE", 0},
+    {"select * from t lock in share mode", 0},
+    {"SELECT a INTO @v FROM t", 0},
+    {"SELECT a, b INTO @v1, @v2 FROM t WHERE id=1", 0},
+    {"SELECT * FROM t INTO OUTFILE '/tmp/t.txt'", 0},
+    {"SELECT * INTO OUTFILE '/tmp/t.txt' FROM t", 0},
+    {"SELECT * FROM t INTO DUMPFILE '/tmp/t.bin'", 0},
+    {"SELECT * INTO DUMPFILE '/tmp/t.bin' FROM t", 0},
+    {"SELECT NEXTVAL(s)", 0},
+    {"SELECT NEXT VALUE FOR s", 0},
+    {"SELECT GET_LOCK('l', 1)", 0},
+    /* keywords in literals, identifiers and comments */
+    {"SELECT 'for update' FROM t", 1},
+    {"SELECT \"lock in share mode\" FROM t", 1},
+    {"SELECT 'it\\'s into' FROM t", 1},
+    {"SELECT `into` FROM t", 1},
+    {"SELECT into_x, format_update FROM t", 1},
+    {"SELECT 1 -- FOR UPDATE\n", 1},
+    {"SELECT 1 # INTO OUTFILE '/tmp/t.txt'\n", 1},
+    {"SELECT 1 /* INTO @v */", 1},
+    /* executable comments are executed by the server */
+    {"SELECT * FROM t /*!50000 FOR UPDATE */", 0},
+    {"SELECT * FROM t FOR", 1}
+  };
+  uint32_t i;
+
+  for (i=0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    ASSERT_EQ(cases[i].read_only, lcc_is_read_only(cases[i].statement, strlen(cases[i].statement)),
+              "Statement \"%s\": expected read_only=%u", cases[i].statement, cases[i].read_only);
+  return OK;
+}
+
+static int test_timeout(void)
+{
+  LCC_HANDLE *handles[2];
+  lcc_connection *conn;
+  uint64_t start;
+  int peers[2];
+  uint32_t i;
+  LCC_HANDLE *winner;
+
+  for (i=0; i < 2; i++)
+  {
+    ASSERT_EQ(OK, connect_fake(&handles[i], &peers[i], NULL), "Can't connect");
+    ((lcc_connection *)handles[i])->configuration.read_timeout= 100;
+  }
+  conn= (lcc_connection *)handles[0];
+  conn->configuration.hedge_reads= 1;
+  conn->configuration.hedge_min_delay= 10;
+
+  /* no replica answers: the wait ends with the read timeout */
+  start= lcc_now_usec();
+  ASSERT_EQ(ER_COMM_READ, LCC_hedged_execute(handles, 2, "SELECT 1", LCC_NTS, &winner),
+            "Hedged read didn't time out");
+  ASSERT_EQ(1, lcc_now_usec() - start < 2000000, "Hedged read took %lu usec",
+            (unsigned long)(lcc_now_usec() - start));
+  ASSERT_EQ(1, ((lcc_connection *)handles[0])->abandoned && ((lcc_connection *)handles[1])->abandoned,
+            "Pending connections weren't abandoned");
+
+  /* the deadline limits the wait as well */
+  for (i=0; i < 2; i++)
+  {
+    conn= (lcc_connection *)handles[i];
+    conn->configuration.read_timeout= 0;
+    conn->configuration.deadline= 50;
+    conn->abandoned= 0;
+  }
+  start= lcc_now_usec();
+  ASSERT_EQ(ER_DEADLINE_EXCEEDED, LCC_hedged_execute(handles, 2, "SELECT 1", LCC_NTS, &winner),
+            "Deadline didn't expire");
+  ASSERT_EQ(1, lcc_now_usec() - start < 2000000, "Hedged read took %lu usec",
+            (unsigned long)(lcc_now_usec() - start));
+
+  for (i=0; i < 2; i++)
+  {
+    LCC_close_handle(handles[i]);
+    close(peers[i]);
+  }
+  return OK;
+}
+
+static int test_kill_loser(void)
+{
+  LCC_HANDLE *handles[2], *pool, *killer, *winner;
+  fake_server replica, kill_server;
+  int peers[2], kill_peer;
+  uint32_t i;
+
+  ASSERT_EQ(OK, connect_fake(&handles[0], &peers[0], NULL), "Can't connect");
+  ASSERT_EQ(OK, connect_fake(&handles[1], &peers[1], &replica), "Can't connect");
+  ASSERT_EQ(OK, connect_fake(&killer, &kill_peer, &kill_server), "Can't connect");
+  ASSERT_EQ(ER_OK, LCC_init_handle(&pool, LCC_POOL, NULL), "Can't create pool");
+  ASSERT_EQ(ER_OK, LCC_pool_add(pool, killer), "Can't add connection to pool");
+
+  ((lcc_connection *)handles[0])->configuration.hedge_reads= 1;
+  ((lcc_connection *)handles[0])->configuration.hedge_min_delay= 10;
+  ((lcc_connection *)handles[0])->client.thread_id= 42;
+  ASSERT_EQ(ER_OK, LCC_set_option(handles[0], LCC_OPT_KILL_POOL, pool), "Can't set kill pool");
+
+  /* the first replica doesn't answer, the second one wins */
+  ASSERT_EQ(ER_OK, LCC_hedged_execute(handles, 2, "SELECT 1", LCC_NTS, &winner),
+            "Hedged read failed");
+  ASSERT_EQ(handles[1], winner, "Wrong winner");
+  ASSERT_EQ(1, ((lcc_connection *)handles[0])->abandoned, "Loser wasn't abandoned");
+  ASSERT_EQ(0, strcmp(kill_server.statement, "KILL QUERY 42"),
+            "Loser wasn't killed: \"%s\"", kill_server.statement);
+
+  LCC_close_handle(pool);
+  for (i=0; i < 2; i++)
+    LCC_close_handle(handles[i]);
+  shutdown(peers[1], SHUT_RDWR);
+  shutdown(kill_peer, SHUT_RDWR);
+  pthread_join(replica.thread, NULL);
+  pthread_join(kill_server.thread, NULL);
+  close(peers[0]);
+  close(peers[1]);
+  close(kill_peer);
+  return OK;
+}
+
+int main()
+{
+  signal(SIGPIPE, SIG_IGN);
+
+  plan(4);
+  ok(!test_percentile());
+  ok(!test_read_only());
+  ok(!test_timeout());
+  ok(!test_kill_loser());
+
+  done_testing();
+}
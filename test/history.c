@@ -0,0 +1,150 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <string.h>
+
+/* records an execution of statement key */
+static void record(lcc_connection *conn, uint64_t key, uint64_t rows, uint64_t bytes,
+                   uint32_t max_packet)
+{
+  lcc_history_begin(conn, key);
+  conn->history.rows= rows;
+  conn->history.bytes= bytes;
+  conn->history.max_packet= max_packet;
+  lcc_history_end(conn);
+}
+
+static int test_set(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_CONNECTION, NULL), "Can't create connection");
+  conn= (lcc_connection *)handle;
+
+  ASSERT_EQ(ER_OK, lcc_history_set(conn, 5, 0), "Can't enable history");
+  ASSERT_EQ(8, conn->history.size, "Size wasn't rounded up: %u", conn->history.size);
+  ASSERT_EQ(ER_INVALID_VALUE, lcc_history_set(conn, 0x10001, 0), "Size above maximum was accepted");
+
+  /* statements and prepared statements have different keys, 0 is
+     never a key */
+  ASSERT_EQ(1, lcc_history_key("SELECT 1", 8, 0) != lcc_history_key("SELECT 1", 8, 1),
+            "Text and binary protocol have the same key");
+  ASSERT_EQ(lcc_history_key("SELECT 1", 8, 0), lcc_history_key("SELECT 1", 8, 0), "Key isn't stable");
+  ASSERT_EQ(1, lcc_history_key("", 0, 0) != 0, "Key is 0");
+
+  /* disabled history doesn't record */
+  ASSERT_EQ(ER_OK, lcc_history_set(conn, 0, 0), "Can't disable history");
+  record(conn, 42, 10, 100, 10);
+  ASSERT_EQ(NULL, conn->history.entries, "Disabled history recorded a result");
+
+  LCC_close_handle(handle);
+  return OK;
+}
+
+static int test_decay(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+  const lcc_history_entry *entry;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_CONNECTION, NULL), "Can't create connection");
+  conn= (lcc_connection *)handle;
+  ASSERT_EQ(ER_OK, lcc_history_set(conn, 4, 0), "Can't enable history");
+
+  record(conn, 5, 1000, 100000, 200);
+  lcc_history_begin(conn, 5);
+  ASSERT_EQ(1, (entry= lcc_history_find(conn)) != NULL, "Result wasn't recorded");
+  ASSERT_EQ(1, entry->executions, "Wrong executions %u", entry->executions);
+  ASSERT_EQ(1000, entry->rows, "Wrong rows %lu", (unsigned long)entry->rows);
+
+  /* smaller results decay slowly */
+  record(conn, 5, 200, 20000, 100);
+  ASSERT_EQ(800, entry->rows, "Expected 800 rows, got %lu", (unsigned long)entry->rows);
+  ASSERT_EQ(80000, entry->bytes, "Expected 80000 bytes, got %lu", (unsigned long)entry->bytes);
+  ASSERT_EQ(175, entry->max_packet, "Expected max. packet 175, got %u", entry->max_packet);
+
+  /* larger results are taken at once */
+  record(conn, 5, 5000, 600000, 300);
+  ASSERT_EQ(5000, entry->rows, "Expected 5000 rows, got %lu", (unsigned long)entry->rows);
+  ASSERT_EQ(600000, entry->bytes, "Expected 600000 bytes, got %lu", (unsigned long)entry->bytes);
+  ASSERT_EQ(300, entry->max_packet, "Expected max. packet 300, got %u", entry->max_packet);
+  ASSERT_EQ(3, entry->executions, "Wrong executions %u", entry->executions);
+
+  /* another statement in the same slot replaces it */
+  record(conn, 9, 10, 100, 10);
+  lcc_history_begin(conn, 5);
+  ASSERT_EQ(NULL, lcc_history_find(conn), "Replaced statement was found");
+  lcc_history_begin(conn, 9);
+  ASSERT_EQ(1, (entry= lcc_history_find(conn)) != NULL, "Result wasn't recorded");
+  ASSERT_EQ(10, entry->rows, "History of the replaced statement was kept");
+  ASSERT_EQ(1, entry->executions, "Wrong executions %u", entry->executions);
+
+  LCC_close_handle(handle);
+  return OK;
+}
+
+static int test_apply(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+  lcc_result result;
+  size_t initial;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_CONNECTION, NULL), "Can't create connection");
+  conn= (lcc_connection *)handle;
+  ASSERT_EQ(ER_OK, lcc_history_set(conn, 16, 0), "Can't enable history");
+  initial= conn->io.read_size;
+  memset(&result, 0, sizeof(result));
+  result.conn= conn;
+
+  /* unknown statement: nothing changes */
+  lcc_history_begin(conn, 1);
+  ASSERT_EQ(ER_OK, lcc_history_apply(&result), "Can't apply history");
+  ASSERT_EQ(0, result.expected_rows, "Unknown statement has expected rows");
+  ASSERT_EQ(initial, conn->io.read_size, "Buffer was resized");
+
+  /* the buffer holds the rows and their headers */
+  record(conn, 1, 1000, 60000, 100);
+  lcc_history_begin(conn, 1);
+  ASSERT_EQ(ER_OK, lcc_history_apply(&result), "Can't apply history");
+  ASSERT_EQ(1000, result.expected_rows, "Expected 1000 rows, got %lu", (unsigned long)result.expected_rows);
+  ASSERT_EQ(1, conn->io.read_size >= 64000, "Buffer of %lu bytes is too small",
+            (unsigned long)conn->io.read_size);
+  ASSERT_EQ(1, conn->io.read_size < 0x40000, "Buffer of %lu bytes is too large",
+            (unsigned long)conn->io.read_size);
+
+  /* large results are streamed through a limited buffer */
+  record(conn, 2, 1000000, 100000000, 100);
+  lcc_history_begin(conn, 2);
+  ASSERT_EQ(ER_OK, lcc_history_apply(&result), "Can't apply history");
+  ASSERT_EQ(0x40000, conn->io.read_size, "Expected a buffer of 256 KB, got %lu",
+            (unsigned long)conn->io.read_size);
+
+  /* but the largest row has to fit */
+  record(conn, 3, 2, 0x100000, 0x80000);
+  lcc_history_begin(conn, 3);
+  ASSERT_EQ(ER_OK, lcc_history_apply(&result), "Can't apply history");
+  ASSERT_EQ(1, conn->io.read_size >= 0x80004, "Buffer of %lu bytes is too small for the row",
+            (unsigned long)conn->io.read_size);
+
+  /* much smaller results shrink the buffer, not below its initial size */
+  record(conn, 4, 1, 10, 10);
+  lcc_history_begin(conn, 4);
+  ASSERT_EQ(ER_OK, lcc_history_apply(&result), "Can't apply history");
+  ASSERT_EQ(initial, conn->io.read_size, "Expected a buffer of %lu bytes, got %lu",
+            (unsigned long)initial, (unsigned long)conn->io.read_size);
+
+  LCC_close_handle(handle);
+  return OK;
+}
+
+int main()
+{
+  plan(3);
+  ok(!test_set());
+  ok(!test_decay());
+  ok(!test_apply());
+
+  done_testing();
+}
@@ -0,0 +1,89 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* connection to a server which doesn't answer */
+static int connect_silent(LCC_HANDLE **handle, int *server)
+{
+  int sv[2];
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(handle, LCC_CONNECTION, NULL), "Can't create connection");
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+  ((lcc_connection *)*handle)->socket= sv[0];
+  *server= sv[1];
+  return OK;
+}
+
+static int test_drain_deadline(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+  uint64_t start;
+  char buffer[16];
+  int server;
+
+  ASSERT_EQ(OK, connect_silent(&handle, &server), "Can't connect");
+  conn= (lcc_connection *)handle;
+
+  /* the response of the abandoned command never arrives: the drain
+     stops at the deadline of the next command */
+  conn->abandoned= 1;
+  conn->configuration.deadline= 50;
+  start= lcc_now_usec();
+  ASSERT_EQ(ER_DEADLINE_EXCEEDED, lcc_io_write(conn, CMD_PING, NULL, 0),
+            "Drain didn't stop at the deadline");
+  ASSERT_EQ(1, lcc_now_usec() - start < 1000000, "Drain took %lu usec",
+            (unsigned long)(lcc_now_usec() - start));
+  ASSERT_EQ(1, conn->broken, "Connection isn't marked as broken");
+
+  /* the socket was shut down, no further command is sent */
+  ASSERT_EQ(ER_COMM_WRITE, lcc_io_write(conn, CMD_PING, NULL, 0),
+            "Command was sent over a broken connection");
+  ASSERT_EQ(0, read(server, buffer, sizeof(buffer)), "Server received data");
+
+  LCC_close_handle(handle);
+  close(server);
+  return OK;
+}
+
+static int test_partial_packet(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+  /* header announces 7 bytes, only 2 arrive */
+  const unsigned char partial[]= {7, 0, 0, 1, 0, 0};
+  char buffer[16];
+  int server;
+
+  ASSERT_EQ(OK, connect_silent(&handle, &server), "Can't connect");
+  conn= (lcc_connection *)handle;
+  conn->configuration.read_timeout= 50;
+
+  ASSERT_EQ(ER_OK, lcc_io_write(conn, CMD_PING, NULL, 0), "Can't send command");
+  ASSERT_EQ(5, read(server, buffer, sizeof(buffer)), "Server didn't receive the command");
+  ASSERT_EQ(sizeof(partial), write(server, partial, sizeof(partial)), "Can't send response");
+
+  ASSERT_EQ(ER_COMM_READ, lcc_read_response(conn), "Read didn't time out");
+  ASSERT_EQ(1, conn->broken, "Connection isn't marked as broken");
+  ASSERT_EQ(0, read(server, buffer, sizeof(buffer)), "Socket wasn't shut down");
+  ASSERT_EQ(ER_COMM_WRITE, lcc_io_write(conn, CMD_PING, NULL, 0),
+            "Command was sent over a broken connection");
+
+  LCC_close_handle(handle);
+  close(server);
+  return OK;
+}
+
+int main()
+{
+  signal(SIGPIPE, SIG_IGN);
+
+  plan(2);
+  ok(!test_drain_deadline());
+  ok(!test_partial_packet());
+
+  done_testing();
+}
@@ -0,0 +1,155 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_COMM_PACKET_SIZE 0xFFFFFF
+
+/* appends a packet with header to buffer */
+static size_t packet(char *buffer, size_t offset, const char *payload, size_t len)
+{
+  buffer[offset]= (char)(len & 0xFF);
+  buffer[offset + 1]= (char)((len >> 8) & 0xFF);
+  buffer[offset + 2]= (char)((len >> 16) & 0xFF);
+  buffer[offset + 3]= 0;
+  memcpy(buffer + offset + 4, payload, len);
+  return offset + 4 + len;
+}
+
+/* the response arrives byte by byte, it is only complete after the
+   last byte */
+static int scan(const char *response, size_t size)
+{
+  lcc_connection conn;
+  lcc_loop_conn lc;
+  char buffer[512];
+  size_t i;
+
+  memset(&conn, 0, sizeof(conn));
+  memset(&lc, 0, sizeof(lc));
+  lc.conn= &conn;
+  memcpy(buffer, response, size);
+  conn.io.read_pos= conn.io.read_end= buffer;
+
+  for (i=1; i <= size; i++)
+  {
+    conn.io.read_end= buffer + i;
+    ASSERT_EQ(i == size, lcc_loop_scan(&lc), "Byte %lu of %lu: wrong completion",
+              (unsigned long)i, (unsigned long)size);
+  }
+  return OK;
+}
+
+static int test_ok(void)
+{
+  char buffer[512];
+  size_t len;
+
+  len= packet(buffer, 0, "\x00\x01\x00\x02\x00\x00\x00", 7);
+  ASSERT_EQ(OK, scan(buffer, len), "OK packet");
+
+  len= packet(buffer, 0, "\xFF\x7A\x04#42000error", 14);
+  ASSERT_EQ(OK, scan(buffer, len), "Error packet");
+
+  /* progress indication is followed by the response */
+  len= packet(buffer, 0, "\xFF\xFF\xFF\x01\x01\x00\x00\x00\x00", 9);
+  len= packet(buffer, len, "\x00\x00\x00\x02\x00\x00\x00", 7);
+  ASSERT_EQ(OK, scan(buffer, len), "Progress indication");
+  return OK;
+}
+
+static int test_result(void)
+{
+  char buffer[512];
+  size_t len;
+
+  /* two columns, two rows */
+  len= packet(buffer, 0, "\x02", 1);
+  len= packet(buffer, len, "\x03""def\x00\x00\x00\x01""a", 10);
+  len= packet(buffer, len, "\x03""def\x00\x00\x00\x01""b", 10);
+  len= packet(buffer, len, "\xFE\x00\x00\x02\x00", 5);
+  len= packet(buffer, len, "\x01""1\x01""2", 4);
+  /* row which starts with 0xFE, but isn't an EOF packet */
+  len= packet(buffer, len, "\xFE\x00\x00\x00\x00\x00\x00\x00\x00\x01""x", 11);
+  len= packet(buffer, len, "\xFE\x00\x00\x02\x00", 5);
+  ASSERT_EQ(OK, scan(buffer, len), "Result set");
+
+  /* error while rows are sent */
+  len= packet(buffer, 0, "\x01", 1);
+  len= packet(buffer, len, "\x03""def\x00\x00\x00\x01""a", 10);
+  len= packet(buffer, len, "\xFE\x00\x00\x02\x00", 5);
+  len= packet(buffer, len, "\x01""1", 2);
+  len= packet(buffer, len, "\xFF\x7A\x04#42000error", 14);
+  ASSERT_EQ(OK, scan(buffer, len), "Result set with error");
+  return OK;
+}
+
+static int test_multi_result(void)
+{
+  char buffer[512];
+  size_t len;
+
+  /* OK packet, result set and OK packet of a multi statement or a
+     stored procedure */
+  len= packet(buffer, 0, "\x00\x01\x00\x0A\x00\x00\x00", 7);
+  len= packet(buffer, len, "\x01", 1);
+  len= packet(buffer, len, "\x03""def\x00\x00\x00\x01""a", 10);
+  len= packet(buffer, len, "\xFE\x00\x00\x0A\x00", 5);
+  len= packet(buffer, len, "\x01""1", 2);
+  len= packet(buffer, len, "\xFE\x00\x00\x0A\x00", 5);
+  len= packet(buffer, len, "\x00\x00\x00\x02\x00\x00\x00", 7);
+  ASSERT_EQ(OK, scan(buffer, len), "Multiple results");
+  return OK;
+}
+
+static int test_split_packet(void)
+{
+  lcc_connection conn;
+  lcc_loop_conn lc;
+  size_t size= 64 + 2 * (4 + MAX_COMM_PACKET_SIZE), len, part;
+  char *buffer= malloc(size), *row;
+
+  ASSERT_EQ(1, buffer != NULL, "Out of memory");
+  memset(&conn, 0, sizeof(conn));
+  memset(&lc, 0, sizeof(lc));
+  lc.conn= &conn;
+
+  len= packet(buffer, 0, "\x01", 1);
+  len= packet(buffer, len, "\x03""def\x00\x00\x00\x01""a", 10);
+  len= packet(buffer, len, "\xFE\x00\x00\x02\x00", 5);
+  /* row of 16 MB, sent as two packets */
+  row= buffer + len + 4;
+  len= packet(buffer, len, "", 0);
+  memset(row, 'x', MAX_COMM_PACKET_SIZE);
+  buffer[len - 4]= buffer[len - 3]= buffer[len - 2]= (char)0xFF;
+  len+= MAX_COMM_PACKET_SIZE;
+  part= len;
+  /* the second part starts like an EOF packet, but belongs to the row */
+  len= packet(buffer, len, "\xFE\x00\x00\x02\x00", 5);
+  len= packet(buffer, len, "\xFE\x00\x00\x02\x00", 5);
+
+  conn.io.read_pos= buffer;
+  conn.io.read_end= row + 1000;
+  ASSERT_EQ(0, lcc_loop_scan(&lc), "Incomplete row finished response");
+  conn.io.read_end= buffer + part + 4;
+  ASSERT_EQ(0, lcc_loop_scan(&lc), "First part finished response");
+  conn.io.read_end= buffer + len - 1;
+  ASSERT_EQ(0, lcc_loop_scan(&lc), "Second part finished response");
+  conn.io.read_end= buffer + len;
+  ASSERT_EQ(1, lcc_loop_scan(&lc), "Response isn't complete");
+
+  free(buffer);
+  return OK;
+}
+
+int main()
+{
+  plan(4);
+  ok(!test_ok());
+  ok(!test_result());
+  ok(!test_multi_result());
+  ok(!test_split_packet());
+
+  done_testing();
+}
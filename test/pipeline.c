@@ -0,0 +1,184 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define PRODUCERS 8
+#define ITEMS 5000
+
+typedef struct {
+  lcc_mpsc_node node;
+  uint32_t producer;
+  uint32_t seq;
+} item;
+
+static lcc_mpsc_queue queue;
+static item items[PRODUCERS][ITEMS];
+
+static void *mpsc_producer(void *arg)
+{
+  uint32_t producer= (uint32_t)(size_t)arg, i;
+
+  for (i=0; i < ITEMS; i++)
+  {
+    items[producer][i].producer= producer;
+    items[producer][i].seq= i;
+    lcc_mpsc_push(&queue, &items[producer][i].node);
+  }
+  return NULL;
+}
+
+static int test_mpsc(void)
+{
+  pthread_t threads[PRODUCERS];
+  uint32_t next[PRODUCERS]= {0}, popped= 0;
+  size_t i;
+
+  lcc_mpsc_init(&queue);
+  ASSERT_EQ(NULL, lcc_mpsc_pop(&queue), "Empty queue returned a node");
+
+  for (i=0; i < PRODUCERS; i++)
+    pthread_create(&threads[i], NULL, mpsc_producer, (void *)i);
+
+  /* the consumer runs concurrently with the producers */
+  while (popped < PRODUCERS * ITEMS)
+  {
+    item *it= (item *)lcc_mpsc_pop(&queue);
+
+    if (!it)
+      continue;
+    ASSERT_EQ(next[it->producer], it->seq, "Producer %u: expected item %u, got %u",
+              it->producer, next[it->producer], it->seq);
+    next[it->producer]++;
+    popped++;
+  }
+
+  for (i=0; i < PRODUCERS; i++)
+    pthread_join(threads[i], NULL);
+  ASSERT_EQ(NULL, lcc_mpsc_pop(&queue), "Queue returned more nodes than pushed");
+  return OK;
+}
+
+/* answers every command with an OK packet */
+static void *fake_server(void *arg)
+{
+  static unsigned char in[0x10000], out[0x10000];
+  const unsigned char ok_packet[]= {7, 0, 0, 1, 0, 1, 0, 2, 0, 0, 0};
+  int fd= *(int *)arg;
+  size_t length= 0, pos, out_len;
+
+  for (;;)
+  {
+    ssize_t r= read(fd, in + length, sizeof(in) - length);
+
+    if (r <= 0)
+      return NULL;
+    length+= (size_t)r;
+    for (pos= 0, out_len= 0; length - pos >= 4; )
+    {
+      size_t pkt_len= in[pos] | in[pos + 1] << 8 | in[pos + 2] << 16;
+
+      if (length - pos < pkt_len + 4)
+        break;
+      pos+= pkt_len + 4;
+      memcpy(out + out_len, ok_packet, sizeof(ok_packet));
+      out_len+= sizeof(ok_packet);
+    }
+    memmove(in, in + pos, length - pos);
+    length-= pos;
+    if (out_len && write(fd, out, out_len) != (ssize_t)out_len)
+      return NULL;
+  }
+}
+
+static LCC_HANDLE *pipeline;
+static uint32_t calls[PRODUCERS][ITEMS];
+static uint32_t last[PRODUCERS];
+static uint32_t completed, errors, out_of_order;
+
+static void completion(LCC_HANDLE *conn, LCC_ERRNO rc, void *data)
+{
+  uint32_t producer= (uint32_t)((size_t)data / ITEMS),
+           seq= (uint32_t)((size_t)data % ITEMS);
+
+  (void)conn;
+  if (rc)
+    errors++;
+  /* callbacks run in the pipeline thread */
+  if (seq && last[producer] != seq - 1)
+    out_of_order++;
+  last[producer]= seq;
+  calls[producer][seq]++;
+  __atomic_add_fetch(&completed, 1, __ATOMIC_SEQ_CST);
+}
+
+static void *pipeline_producer(void *arg)
+{
+  size_t producer= (size_t)arg, i;
+  char statement[32];
+
+  for (i=0; i < ITEMS; i++)
+  {
+    int len= snprintf(statement, sizeof(statement), "DO %zu", i);
+
+    if (LCC_pipeline_submit(pipeline, statement, (size_t)len, completion,
+                            (void *)(producer * ITEMS + i)))
+      __atomic_add_fetch(&errors, 1, __ATOMIC_SEQ_CST);
+  }
+  return NULL;
+}
+
+static int test_pipeline(void)
+{
+  LCC_HANDLE *conn;
+  pthread_t server, threads[PRODUCERS];
+  int sv[2];
+  uint32_t depth= 64;
+  size_t i, j;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&conn, LCC_CONNECTION, NULL), "Can't create connection");
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+  ((lcc_connection *)conn)->socket= sv[0];
+  pthread_create(&server, NULL, fake_server, &sv[1]);
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&pipeline, LCC_PIPELINE, conn), "Can't create pipeline");
+  ASSERT_EQ(ER_OK, LCC_set_option(pipeline, LCC_OPT_PIPELINE_DEPTH, &depth), "Can't set depth");
+
+  for (i=0; i < PRODUCERS; i++)
+    pthread_create(&threads[i], NULL, pipeline_producer, (void *)i);
+  for (i=0; i < PRODUCERS; i++)
+    pthread_join(threads[i], NULL);
+  while (__atomic_load_n(&completed, __ATOMIC_SEQ_CST) < PRODUCERS * ITEMS &&
+         !__atomic_load_n(&errors, __ATOMIC_SEQ_CST))
+    usleep(1000);
+
+  LCC_close_handle(pipeline);
+  ASSERT_EQ(0, errors, "%u commands failed", errors);
+  ASSERT_EQ(0, out_of_order, "%u commands completed out of order", out_of_order);
+  for (i=0; i < PRODUCERS; i++)
+    for (j=0; j < ITEMS; j++)
+      ASSERT_EQ(1, calls[i][j], "Callback of producer %zu item %zu ran %u times", i, j, calls[i][j]);
+
+  LCC_close_handle(conn);
+  shutdown(sv[1], SHUT_RDWR);
+  pthread_join(server, NULL);
+  close(sv[1]);
+  return OK;
+}
+
+int main()
+{
+  /* the fake server may close its end first */
+  signal(SIGPIPE, SIG_IGN);
+
+  plan(2);
+  ok(!test_mpsc());
+  ok(!test_pipeline());
+
+  done_testing();
+}
@@ -0,0 +1,148 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define WAITERS 4
+
+typedef struct {
+  LCC_HANDLE *pool;
+  uint8_t priority_class;
+  pthread_t thread;
+} waiter;
+
+/* classes in the order the waiters got the connection: the pool has
+   only one connection, so the waiters run one after another */
+static uint8_t order[2 * WAITERS];
+static uint32_t served;
+
+static void *checkout(void *arg)
+{
+  waiter *w= (waiter *)arg;
+  LCC_HANDLE *conn;
+
+  if (LCC_pool_checkout_class(w->pool, w->priority_class, &conn))
+    return NULL;
+  order[served++]= w->priority_class;
+  LCC_pool_checkin(w->pool, conn);
+  return NULL;
+}
+
+/* waits until count callers are queued */
+static void wait_queued(LCC_HANDLE *handle, uint32_t count)
+{
+  lcc_pool *pool= (lcc_pool *)handle;
+  uint32_t waiting, i;
+
+  do {
+    usleep(1000);
+    pthread_mutex_lock(&pool->lock);
+    for (waiting= 0, i=0; i < LCC_SCHED_CLASSES; i++)
+      waiting+= pool->classes[i].waiting;
+    pthread_mutex_unlock(&pool->lock);
+  } while (waiting < count);
+}
+
+/* adds a connection to a server which is never asked */
+static int add_connection(LCC_HANDLE *pool, int *peer)
+{
+  LCC_HANDLE *conn;
+  int sv[2];
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&conn, LCC_CONNECTION, NULL), "Can't create connection");
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+  ((lcc_connection *)conn)->socket= sv[0];
+  *peer= sv[1];
+  ASSERT_EQ(ER_OK, LCC_pool_add(pool, conn), "Can't add connection");
+  return OK;
+}
+
+static int test_weights(void)
+{
+  LCC_HANDLE *pool, *conn;
+  waiter waiters[2 * WAITERS];
+  uint32_t weight= 3, max_active= 0, i;
+  uint8_t priority_class= 1;
+  /* virtual finish times of class 0 (weight 1): 2, 3, 4, 5,
+     class 1 (weight 3): 1 1/3, 1 2/3, 2 - 1/65536, 2 1/3 */
+  const uint8_t expected[2 * WAITERS]= {1, 1, 1, 0, 1, 0, 0, 0};
+  int peer;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&pool, LCC_POOL, NULL), "Can't create pool");
+  ASSERT_EQ(ER_OK, LCC_set_option(pool, LCC_OPT_POOL_CLASS, &priority_class, &weight, &max_active),
+            "Can't set weight");
+  ASSERT_EQ(OK, add_connection(pool, &peer), "Can't add connection");
+  ASSERT_EQ(ER_OK, LCC_pool_checkout(pool, &conn), "Can't check out connection");
+
+  /* all waiters are queued before the connection is returned */
+  served= 0;
+  for (i=0; i < 2 * WAITERS; i++)
+  {
+    waiters[i].pool= pool;
+    waiters[i].priority_class= i % 2;
+    pthread_create(&waiters[i].thread, NULL, checkout, &waiters[i]);
+  }
+  wait_queued(pool, 2 * WAITERS);
+  LCC_pool_checkin(pool, conn);
+  for (i=0; i < 2 * WAITERS; i++)
+    pthread_join(waiters[i].thread, NULL);
+
+  ASSERT_EQ(2 * WAITERS, served, "Expected %u checkouts, got %u", 2 * WAITERS, served);
+  for (i=0; i < 2 * WAITERS; i++)
+    ASSERT_EQ(expected[i], order[i], "Checkout %u: expected class %u, got %u", i, expected[i], order[i]);
+
+  LCC_close_handle(pool);
+  close(peer);
+  return OK;
+}
+
+static int test_max_active(void)
+{
+  LCC_HANDLE *pool, *first, *other;
+  waiter w;
+  uint32_t weight= 1, max_active= 1;
+  uint8_t priority_class= 2;
+  int peers[2];
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&pool, LCC_POOL, NULL), "Can't create pool");
+  ASSERT_EQ(ER_OK, LCC_set_option(pool, LCC_OPT_POOL_CLASS, &priority_class, &weight, &max_active),
+            "Can't set concurrency limit");
+  ASSERT_EQ(OK, add_connection(pool, &peers[0]), "Can't add connection");
+  ASSERT_EQ(OK, add_connection(pool, &peers[1]), "Can't add connection");
+
+  ASSERT_EQ(ER_OK, LCC_pool_checkout_class(pool, 2, &first), "Can't check out connection");
+
+  /* the class is at its limit: the second caller waits although a
+     connection is idle */
+  served= 0;
+  w.pool= pool;
+  w.priority_class= 2;
+  pthread_create(&w.thread, NULL, checkout, &w);
+  wait_queued(pool, 1);
+  ASSERT_EQ(0, served, "Class exceeded its limit");
+
+  /* other classes are not affected */
+  ASSERT_EQ(ER_OK, LCC_pool_checkout(pool, &other), "Other class has to wait");
+  LCC_pool_checkin(pool, other);
+  ASSERT_EQ(0, served, "Class exceeded its limit");
+
+  LCC_pool_checkin(pool, first);
+  pthread_join(w.thread, NULL);
+  ASSERT_EQ(1, served, "Waiter wasn't served");
+  ASSERT_EQ(0, ((lcc_pool *)pool)->classes[2].active, "Expected no active connections");
+
+  LCC_close_handle(pool);
+  close(peers[0]);
+  close(peers[1]);
+  return OK;
+}
+
+int main()
+{
+  plan(2);
+  ok(!test_weights());
+  ok(!test_max_active());
+
+  done_testing();
+}
@@ -0,0 +1,137 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_COMM_PACKET_SIZE 0xFFFFFF
+#define SMALL_PACKETS 10
+#define SMALL_PACKET_SIZE 30
+
+typedef struct {
+  int fd;
+  char *data;
+  size_t size;
+} stream;
+
+static void *server(void *arg)
+{
+  stream *s= (stream *)arg;
+  size_t written= 0;
+  ssize_t rc;
+
+  while (written < s->size && (rc= write(s->fd, s->data + written, s->size - written)) > 0)
+    written+= rc;
+  return NULL;
+}
+
+/* payload byte at offset of packet nr */
+static char pattern(uint32_t nr, size_t offset)
+{
+  return (char)((offset + nr) % 251);
+}
+
+/* appends a packet, a payload of 16 MB or more is split into parts */
+static size_t packet(char *buffer, size_t offset, uint32_t nr, size_t len)
+{
+  size_t done= 0, part, i;
+  uint8_t seq= 0;
+
+  do {
+    part= lcc_MIN(len - done, (size_t)MAX_COMM_PACKET_SIZE);
+    buffer[offset]= (char)(part & 0xFF);
+    buffer[offset + 1]= (char)((part >> 8) & 0xFF);
+    buffer[offset + 2]= (char)((part >> 16) & 0xFF);
+    buffer[offset + 3]= (char)seq++;
+    offset+= 4;
+    for (i=0; i < part; i++)
+      buffer[offset++]= pattern(nr, done++);
+  } while (part == MAX_COMM_PACKET_SIZE);
+  return offset;
+}
+
+/* reads the next packet and compares it with the pattern */
+static int check(lcc_process *process, uint32_t nr, size_t expected)
+{
+  char *data;
+  size_t len, i;
+
+  ASSERT_EQ(ER_OK, lcc_process_read_packet(process, &data, &len), "Packet %u: read failed", nr);
+  ASSERT_EQ(expected, len, "Packet %u: expected %lu bytes, got %lu", nr,
+            (unsigned long)expected, (unsigned long)len);
+  for (i=0; i < len; i++)
+    if (data[i] != pattern(nr, i))
+      break;
+  ASSERT_EQ(len, i, "Packet %u: wrong data at offset %lu", nr, (unsigned long)i);
+  /* the packet lies in the current block */
+  ASSERT_EQ(1, data >= process->block->data && data + len <= process->block->data + process->block->size,
+            "Packet %u is outside of the current block", nr);
+  return OK;
+}
+
+static int test_read_packet(void)
+{
+  LCC_HANDLE *handle;
+  lcc_connection *conn;
+  lcc_result result;
+  lcc_process process;
+  pthread_t thread;
+  stream s;
+  /* packets which are split into two parts, and one of exactly 16 MB
+     which is followed by an empty part */
+  const size_t sizes[]= {MAX_COMM_PACKET_SIZE + 100, MAX_COMM_PACKET_SIZE, 5};
+  uint32_t i, nr;
+  int sv[2];
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&handle, LCC_CONNECTION, NULL), "Can't create connection");
+  conn= (lcc_connection *)handle;
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "Can't create socket pair");
+  conn->socket= sv[0];
+  conn->configuration.read_timeout= 5000;
+
+  s.fd= sv[1];
+  s.data= malloc(SMALL_PACKETS * (4 + SMALL_PACKET_SIZE) + 3 * (8 + MAX_COMM_PACKET_SIZE) + 200);
+  ASSERT_EQ(1, s.data != NULL, "Out of memory");
+  s.size= 0;
+  for (nr=0; nr < SMALL_PACKETS; nr++)
+    s.size= packet(s.data, s.size, nr, SMALL_PACKET_SIZE);
+  for (i=0; i < 3; i++)
+    s.size= packet(s.data, s.size, nr + i, sizes[i]);
+  pthread_create(&thread, NULL, server, &s);
+
+  /* a small block: incomplete packets are moved into a new block */
+  memset(&result, 0, sizeof(result));
+  result.conn= conn;
+  memset(&process, 0, sizeof(process));
+  process.result= &result;
+  ASSERT_EQ(1, (process.block= lcc_numa_alloc(conn->numa_node, sizeof(lcc_process_block) + 64)) != NULL,
+            "Out of memory");
+  process.block->refcount= 1;
+  process.block->size= 64;
+  process.read_pos= process.read_end= process.block->data;
+
+  for (nr=0; nr < SMALL_PACKETS; nr++)
+    ASSERT_EQ(OK, check(&process, nr, SMALL_PACKET_SIZE), "Small packet %u", nr);
+  for (i=0; i < 3; i++)
+    ASSERT_EQ(OK, check(&process, nr + i, sizes[i]), "Packet of %lu bytes", (unsigned long)sizes[i]);
+
+  pthread_join(thread, NULL);
+  lcc_numa_free(process.block);
+  free(s.data);
+  LCC_close_handle(handle);
+  close(sv[1]);
+  return OK;
+}
+
+int main()
+{
+  signal(SIGPIPE, SIG_IGN);
+
+  plan(1);
+  ok(!test_read_packet());
+
+  done_testing();
+}
@@ -0,0 +1,104 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define SLOTS 4
+#define ITEMS 200000
+
+static int test_boundaries(void)
+{
+  lcc_spsc_ring ring;
+  uint32_t starts[]= {0, UINT32_MAX - 1}, i, j;
+
+  /* second pass: head and tail wrap around */
+  for (i=0; i < sizeof(starts) / sizeof(starts[0]); i++)
+  {
+    lcc_spsc_init(&ring, SLOTS);
+    ring.head= ring.tail= starts[i];
+
+    ASSERT_EQ(1, lcc_spsc_empty(&ring), "New ring isn't empty");
+    ASSERT_EQ(0, lcc_spsc_full(&ring), "New ring is full");
+
+    for (j=0; j < SLOTS; j++)
+    {
+      ASSERT_EQ(0, lcc_spsc_full(&ring), "Ring with %u of %u slots is full", j, SLOTS);
+      lcc_spsc_publish(&ring);
+      ASSERT_EQ(0, lcc_spsc_empty(&ring), "Ring with %u slots is empty", j + 1);
+    }
+    ASSERT_EQ(1, lcc_spsc_full(&ring), "Ring with all slots filled isn't full");
+
+    /* releasing one slot lets the producer continue */
+    lcc_spsc_release(&ring);
+    ASSERT_EQ(0, lcc_spsc_full(&ring), "Ring is full after release");
+    lcc_spsc_publish(&ring);
+    ASSERT_EQ(1, lcc_spsc_full(&ring), "Ring isn't full after refill");
+
+    for (j=0; j < SLOTS; j++)
+    {
+      ASSERT_EQ(0, lcc_spsc_empty(&ring), "Ring with %u slots is empty", SLOTS - j);
+      lcc_spsc_release(&ring);
+    }
+    ASSERT_EQ(1, lcc_spsc_empty(&ring), "Ring isn't empty after releasing all slots");
+    ASSERT_EQ(0, lcc_spsc_full(&ring), "Empty ring is full");
+  }
+  return OK;
+}
+
+static lcc_spsc_ring ring;
+static uint32_t slots[SLOTS];
+static uint32_t full_waits;
+
+static void *producer(void *arg)
+{
+  uint32_t i;
+
+  (void)arg;
+  for (i=0; i < ITEMS; i++)
+  {
+    while (lcc_spsc_full(&ring))
+    {
+      full_waits++;
+      sched_yield();
+    }
+    slots[ring.head % SLOTS]= i;
+    lcc_spsc_publish(&ring);
+  }
+  return NULL;
+}
+
+static int test_concurrent(void)
+{
+  pthread_t thread;
+  uint32_t i, empty_waits= 0;
+
+  lcc_spsc_init(&ring, SLOTS);
+  pthread_create(&thread, NULL, producer, NULL);
+
+  for (i=0; i < ITEMS; i++)
+  {
+    while (lcc_spsc_empty(&ring))
+    {
+      empty_waits++;
+      sched_yield();
+    }
+    ASSERT_EQ(i, slots[ring.tail % SLOTS], "Expected item %u, got %u", i, slots[ring.tail % SLOTS]);
+    lcc_spsc_release(&ring);
+  }
+  pthread_join(thread, NULL);
+
+  ASSERT_EQ(1, lcc_spsc_empty(&ring), "Ring isn't empty after all items were read");
+  diag("producer waited %u times on a full ring, consumer %u times on an empty ring",
+       full_waits, empty_waits);
+  return OK;
+}
+
+int main()
+{
+  plan(2);
+  ok(!test_boundaries());
+  ok(!test_concurrent());
+
+  done_testing();
+}
@@ -0,0 +1,106 @@
+#include <lcc.h>
+#include <lcc_error.h>
+#include <lcc_test.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_SHARDS 33
+#define KEYS 20000
+
+/* the router only stores the shard handles, their position identifies
+   the shard */
+static LCC_HANDLE shards[MAX_SHARDS];
+
+static int route(LCC_HANDLE *router, uint32_t key, uint32_t *shard)
+{
+  char buffer[32];
+  LCC_HANDLE *handle;
+  int len= snprintf(buffer, sizeof(buffer), "tenant-%u", key);
+
+  if (LCC_router_route(router, buffer, (size_t)len, &handle))
+    return FAIL;
+  *shard= (uint32_t)(handle - shards);
+  return OK;
+}
+
+static int test_distribution(void)
+{
+  LCC_HANDLE *router, *handle;
+  uint32_t count[10]= {0}, i, shard;
+
+  ASSERT_EQ(ER_OK, LCC_init_handle(&router, LCC_ROUTER, NULL), "Can't create router");
+  ASSERT_EQ(ER_INVALID_VALUE, LCC_router_route(router, "key", 3, &handle),
+            "Router without shards must not route");
+  for (i=0; i < 10; i++)
+    ASSERT_EQ(ER_OK, LCC_router_add(router, &shards[i]), "Can't add shard %u", i);
+
+  for (i=0; i < KEYS; i++)
+  {
+    ASSERT_EQ(OK, route(router, i, &shard), "Can't route key %u", i);
+    ASSERT_EQ(1, shard < 10, "Key %u routed to unknown shard %u", i, shard);
+    count[shard]++;
+  }
+  /* each shard gets 1/10 of the keys, +- 10% */
+  for (i=0; i < 10; i++)
+    ASSERT_EQ(1, count[i] > KEYS / 10 * 9 / 10 && count[i] < KEYS / 10 * 11 / 10,
+              "Shard %u has %u keys, expected %u", i, count[i], KEYS / 10);
+
+  LCC_close_handle(router);
+  return OK;
+}
+
+static int test_growth(void)
+{
+  LCC_HANDLE *router, *handle;
+  uint32_t *before, n, i, shard;
+
+  if (!(before= (uint32_t *)malloc(KEYS * sizeof(uint32_t))))
+    return FAIL;
+  ASSERT_EQ(ER_OK, LCC_init_handle(&router, LCC_ROUTER, NULL), "Can't create router");
+  ASSERT_EQ(ER_OK, LCC_router_add(router, &shards[0]), "Can't add shard");
+
+  for (n=1; n < MAX_SHARDS; n++)
+  {
+    uint32_t moved= 0, expected= KEYS / (n + 1);
+
+    for (i=0; i < KEYS; i++)
+      ASSERT_EQ(OK, route(router, i, &before[i]), "Can't route key %u", i);
+    ASSERT_EQ(ER_OK, LCC_router_add(router, &shards[n]), "Can't add shard %u", n);
+
+    for (i=0; i < KEYS; i++)
+    {
+      ASSERT_EQ(OK, route(router, i, &shard), "Can't route key %u", i);
+      if (shard == before[i])
+        continue;
+      /* keys only move to the new shard */
+      ASSERT_EQ(n, shard, "Key %u moved from shard %u to %u", i, before[i], shard);
+      moved++;
+    }
+    /* 1/(n + 1) of the keys move, +- 15% */
+    ASSERT_EQ(1, moved > expected * 85 / 100 && moved < expected * 115 / 100,
+              "%u of %u keys moved from %u to %u shards, expected %u",
+              moved, KEYS, n, n + 1, expected);
+  }
+
+  /* removing the last shard restores the previous routing */
+  ASSERT_EQ(ER_OK, LCC_router_remove(router, &handle), "Can't remove shard");
+  ASSERT_EQ(&shards[MAX_SHARDS - 1], handle, "Removed wrong shard");
+  for (i=0; i < KEYS; i++)
+  {
+    ASSERT_EQ(OK, route(router, i, &shard), "Can't route key %u", i);
+    ASSERT_EQ(before[i], shard, "Key %u routed to %u after remove, expected %u", i, shard, before[i]);
+  }
+
+  LCC_close_handle(router);
+  free(before);
+  return OK;
+}
+
+int main()
+{
+  plan(2);
+  ok(!test_distribution());
+  ok(!test_growth());
+
+  done_testing();
+}
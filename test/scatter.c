@@ -0,0 +1,87 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <string.h>
+
+/* column flag of the protocol */
+#define UNSIGNED_FLAG 32
+
+static int sign(int rc)
+{
+  return (rc > 0) - (rc < 0);
+}
+
+static int test_compare(void)
+{
+  struct {
+    uint8_t type;
+    uint16_t flags;
+    const char *a, *b;
+    int expected;
+  } cases[]= {
+    /* integers are compared by value, not by text */
+    {LCC_COLTYPE_INT32, 0, "9", "10", -1},
+    {LCC_COLTYPE_INT32, 0, "-10", "-9", -1},
+    {LCC_COLTYPE_INT32, 0, "-1", "1", -1},
+    {LCC_COLTYPE_INT32, 0, "42", "42", 0},
+    {LCC_COLTYPE_INT64, 0, "-9223372036854775808", "9223372036854775807", -1},
+    {LCC_COLTYPE_INT64, UNSIGNED_FLAG, "18446744073709551615", "9223372036854775808", 1},
+    {LCC_COLTYPE_YEAR, 0, "1999", "2000", -1},
+    /* decimals: sign, length of the integer part, digits */
+    {LCC_COLTYPE_NEWDECIMAL, 0, "9.99", "10.00", -1},
+    {LCC_COLTYPE_NEWDECIMAL, 0, "10.01", "10.00", 1},
+    {LCC_COLTYPE_NEWDECIMAL, 0, "-10.00", "-9.99", -1},
+    {LCC_COLTYPE_NEWDECIMAL, 0, "-0.01", "0.00", -1},
+    {LCC_COLTYPE_NEWDECIMAL, 0, "123456789012345678901234567890.5", "123456789012345678901234567890.4", 1},
+    {LCC_COLTYPE_NEWDECIMAL, 0, "7", "7", 0},
+    /* time values can exceed 24 hours */
+    {LCC_COLTYPE_TIME, 0, "100:00:00", "99:59:59", 1},
+    {LCC_COLTYPE_TIME, 0, "-01:00:00", "00:00:00", -1},
+    {LCC_COLTYPE_TIME, 0, "-02:00:00", "-01:00:00", -1},
+    {LCC_COLTYPE_TIME, 0, "12:00:00.5", "12:00:00.4", 1},
+    {LCC_COLTYPE_DOUBLE, 0, "1e10", "9999", 1},
+    {LCC_COLTYPE_DOUBLE, 0, "-0.5", "-0.25", -1},
+    /* dates and binary strings are compared byte by byte */
+    {LCC_COLTYPE_DATETIME, 0, "2024-01-31 10:00:00", "2024-02-01 00:00:00", -1},
+    {LCC_COLTYPE_VARCHAR, 0, "ab", "abc", -1},
+    {LCC_COLTYPE_VARCHAR, 0, "b", "abc", 1},
+    {LCC_COLTYPE_VARCHAR, 0, "\xff", "a", 1},
+    /* NULL sorts first */
+    {LCC_COLTYPE_INT32, 0, NULL, "-1", -1},
+    {LCC_COLTYPE_VARCHAR, 0, "", NULL, 1},
+    {LCC_COLTYPE_NEWDECIMAL, 0, NULL, NULL, 0}
+  };
+  uint32_t i;
+
+  for (i=0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    LCC_COLUMN column;
+    LCC_STRING a, b;
+    int rc;
+
+    memset(&column, 0, sizeof(column));
+    column.type= cases[i].type;
+    column.flags= cases[i].flags;
+    a.str= (char *)cases[i].a;
+    a.len= a.str ? strlen(a.str) : 0;
+    b.str= (char *)cases[i].b;
+    b.len= b.str ? strlen(b.str) : 0;
+
+    rc= sign(lcc_scatter_compare_value(&column, &a, &b));
+    ASSERT_EQ(cases[i].expected, rc, "Case %u (type %u): %s <=> %s: expected %d, got %d", i,
+              cases[i].type, cases[i].a ? cases[i].a : "NULL", cases[i].b ? cases[i].b : "NULL",
+              cases[i].expected, rc);
+    /* the order is antisymmetric */
+    rc= sign(lcc_scatter_compare_value(&column, &b, &a));
+    ASSERT_EQ(-cases[i].expected, rc, "Case %u: reversed comparison returned %d", i, rc);
+  }
+  return OK;
+}
+
+int main()
+{
+  plan(1);
+  ok(!test_compare());
+
+  done_testing();
+}
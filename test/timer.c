@@ -0,0 +1,171 @@
+#include <lcc.h>
+#include <lcc_priv.h>
+#include <lcc_test.h>
+#include <string.h>
+
+#define RESOLUTION 1000
+#define TIMERS 2000
+
+static lcc_timer_wheel wheel;
+static lcc_timer timers[TIMERS];
+/* tick when each timer has to expire */
+static uint64_t due[TIMERS];
+static uint64_t last_tick;
+static uint32_t fired, wrong_tick, wrong_order;
+
+static void expired(lcc_timer *timer)
+{
+  uint64_t tick= *(uint64_t *)timer->data;
+
+  fired++;
+  if (wheel.now != tick)
+  {
+    diag("Timer due at tick %lu expired at tick %lu", (unsigned long)tick,
+         (unsigned long)wheel.now);
+    wrong_tick++;
+  }
+  if (wheel.now < last_tick)
+    wrong_order++;
+  last_tick= wheel.now;
+}
+
+static void reset(uint64_t start)
+{
+  lcc_timer_wheel_init(&wheel, RESOLUTION, start);
+  memset(timers, 0, sizeof(timers));
+  last_tick= 0;
+  fired= wrong_tick= wrong_order= 0;
+}
+
+static void add(uint32_t i, uint64_t expires)
+{
+  timers[i].callback= expired;
+  timers[i].data= &due[i];
+  due[i]= 0;
+  if (expires > wheel.start)
+    due[i]= (expires - wheel.start + RESOLUTION - 1) / RESOLUTION;
+  /* the current tick was already processed */
+  if (due[i] <= wheel.now)
+    due[i]= wheel.now + 1;
+  lcc_timer_add(&wheel, &timers[i], expires);
+}
+
+static int test_insert(void)
+{
+  reset(1000000);
+
+  ASSERT_EQ(UINT64_MAX, lcc_timer_wheel_next(&wheel), "Empty wheel has pending timer");
+  add(0, 1000500);
+  add(1, 1001000);
+  add(2, 1001500);
+  add(3, 1040000);
+  ASSERT_EQ(4, wheel.count, "Expected 4 pending timers, got %u", wheel.count);
+  ASSERT_EQ(1001000, lcc_timer_wheel_next(&wheel), "Wrong time of next expiration");
+
+  /* timers expire not before their time */
+  ASSERT_EQ(0, lcc_timer_wheel_advance(&wheel, 1000999), "Timer expired too early");
+  ASSERT_EQ(2, lcc_timer_wheel_advance(&wheel, 1001000), "Expected 2 expired timers");
+  ASSERT_EQ(0, lcc_timer_wheel_advance(&wheel, 1001500), "Timer expired too early");
+  ASSERT_EQ(1, lcc_timer_wheel_advance(&wheel, 1002000), "Expected 1 expired timer");
+  ASSERT_EQ(1, lcc_timer_wheel_advance(&wheel, 1100000), "Expected 1 expired timer");
+  ASSERT_EQ(0, wheel.count, "Expected no pending timers, got %u", wheel.count);
+  ASSERT_EQ(4, fired, "Expected 4 callbacks, got %u", fired);
+  ASSERT_EQ(0, wrong_tick, "%u timers expired at wrong tick", wrong_tick);
+
+  /* timers in the past expire with the next tick */
+  add(0, 1000000);
+  ASSERT_EQ(1, lcc_timer_wheel_advance(&wheel, 1101000), "Timer in the past didn't expire");
+  ASSERT_EQ(0, wrong_tick, "Timer in the past expired at wrong tick");
+  return OK;
+}
+
+static int test_cancel(void)
+{
+  reset(0);
+
+  add(0, 5000);
+  add(1, 5000);
+  add(2, 5000);
+  add(3, 200000);
+  lcc_timer_cancel(&wheel, &timers[1]);
+  /* canceling twice or canceling an unscheduled timer is a no-op */
+  lcc_timer_cancel(&wheel, &timers[1]);
+  lcc_timer_cancel(&wheel, &timers[4]);
+  ASSERT_EQ(3, wheel.count, "Expected 3 pending timers, got %u", wheel.count);
+
+  /* canceling a timer of a higher level */
+  lcc_timer_cancel(&wheel, &timers[3]);
+  ASSERT_EQ(2, wheel.count, "Expected 2 pending timers, got %u", wheel.count);
+
+  /* rescheduling a pending timer */
+  add(2, 70000);
+  ASSERT_EQ(2, wheel.count, "Expected 2 pending timers, got %u", wheel.count);
+
+  ASSERT_EQ(1, lcc_timer_wheel_advance(&wheel, 10000), "Expected 1 expired timer");
+  ASSERT_EQ(1, lcc_timer_wheel_advance(&wheel, 300000), "Expected 1 expired timer");
+  ASSERT_EQ(2, fired, "Canceled timer expired");
+  ASSERT_EQ(0, wrong_tick, "%u timers expired at wrong tick", wrong_tick);
+  ASSERT_EQ(UINT64_MAX, lcc_timer_wheel_next(&wheel), "Wheel has pending timer");
+  return OK;
+}
+
+static int test_cascade(void)
+{
+  /* ticks around the boundaries of each level */
+  uint64_t ticks[]= {1, 63, 64, 65, 127, 128, 4095, 4096, 4097, 4160,
+                     262143, 262144, 262145, 266241, 1ULL << 23,
+                     (1ULL << 24) - 1};
+  uint32_t i, count= sizeof(ticks) / sizeof(ticks[0]);
+
+  reset(0);
+  for (i=0; i < count; i++)
+    add(i, ticks[i] * RESOLUTION);
+  /* beyond the range of the wheel: expires with the last tick */
+  add(count, (1ULL << 26) * RESOLUTION);
+  due[count]= (1ULL << 24) - 1;
+  ASSERT_EQ(count + 1, wheel.count, "Expected %u pending timers, got %u", count + 1, wheel.count);
+
+  /* advance in steps which don't match the level boundaries */
+  while (wheel.count)
+    lcc_timer_wheel_advance(&wheel, (wheel.now + 999) * RESOLUTION);
+
+  ASSERT_EQ(count + 1, fired, "Expected %u callbacks, got %u", count + 1, fired);
+  ASSERT_EQ(0, wrong_tick, "%u timers expired at wrong tick", wrong_tick);
+  ASSERT_EQ(0, wrong_order, "%u timers expired out of order", wrong_order);
+  return OK;
+}
+
+static int test_order(void)
+{
+  uint64_t seed= 42;
+  uint32_t i;
+
+  reset(0);
+  for (i=0; i < TIMERS; i++)
+  {
+    seed= seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    add(i, (seed >> 33) % (100000ULL * RESOLUTION));
+  }
+
+  while (wheel.count)
+  {
+    seed= seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    lcc_timer_wheel_advance(&wheel, (wheel.now + 1 + (seed >> 33) % 500) * RESOLUTION);
+  }
+
+  ASSERT_EQ(TIMERS, fired, "Expected %u callbacks, got %u", TIMERS, fired);
+  ASSERT_EQ(0, wrong_tick, "%u timers expired at wrong tick", wrong_tick);
+  ASSERT_EQ(0, wrong_order, "%u timers expired out of order", wrong_order);
+  return OK;
+}
+
+int main()
+{
+  plan(4);
+  ok(!test_insert());
+  ok(!test_cancel());
+  ok(!test_cascade());
+  ok(!test_order());
+
+  done_testing();
+}
@@ -0,0 +1,645 @@
+/* lcc-export: exports a table in parallel, split into primary key ranges
+
+   Each range (chunk) is written to its own file:
+     <outdir>/<database>.<table>.<chunk>.csv  or  .bin
+
+   CSV: fields are separated by ',', values containing ',', '"', CR or LF
+   are enclosed in '"', '"' and '\' are doubled, NULL is written as \N.
+   The files can be loaded with
+     LOAD DATA INFILE ... FIELDS TERMINATED BY ',' OPTIONALLY ENCLOSED BY '"'
+
+   Binary: header "LCCEXP01" followed by the number of columns (uint32),
+   then for each value its length (uint32, 0xFFFFFFFF = NULL) and data.
+   All integers are little endian.
+*/
+#include <lcc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define EXPORT_BUFFER_SIZE (1024 * 1024)
+#define EXPORT_QUERY_SIZE 2048
+#define EXPORT_NAME_SIZE 256
+#define EXPORT_MAGIC "LCCEXP01"
+#define EXPORT_NULL_LENGTH 0xFFFFFFFF
+
+typedef enum {
+  EXPORT_CSV= 0,
+  EXPORT_BINARY
+} export_format;
+
+typedef struct {
+  const char *host;
+  uint16_t port;
+  const char *user;
+  const char *password;
+  const char *database;
+  const char *table;
+  const char *key;
+  const char *outdir;
+  uint32_t chunks;
+  uint32_t threads;
+  export_format format;
+  uint8_t lock;
+} export_options;
+
+struct st_export_thread;
+
+typedef struct {
+  export_options *options;
+  struct st_export_thread *workers;
+  uint32_t worker_count;
+  char table[2 * EXPORT_NAME_SIZE + 8];   /* quoted `db`.`table` */
+  char key[EXPORT_NAME_SIZE + 4];         /* quoted key column */
+  int64_t min_key;
+  int64_t max_key;
+  uint64_t width;                         /* keys per chunk */
+  uint32_t chunk_count;
+  uint32_t next_chunk;
+  uint8_t failed;
+  uint64_t rows;
+} export_job;
+
+/* a worker owns its connection for the whole export: the snapshot is
+   the open transaction of the connection, returning the connection to
+   a pool would reset it */
+typedef struct st_export_thread {
+  export_job *job;
+  LCC_HANDLE *conn;
+  pthread_t thread;
+} export_thread;
+
+static void
+export_usage(void)
+{
+  fprintf(stderr,
+          "Usage: lcc-export [options] -D database -t table\n"
+          "  -h host        server host (default localhost)\n"
+          "  -P port        server port\n"
+          "  -u user        user name\n"
+          "  -p password    password\n"
+          "  -k column      integer key column (default: first primary key column)\n"
+          "  -c chunks      number of key ranges (default 16)\n"
+          "  -j threads     number of connections (default 4)\n"
+          "  -f csv|binary  output format (default csv)\n"
+          "  -o directory   output directory (default .)\n"
+          "  -n             don't lock tables while the snapshots are started\n");
+}
+
+static void
+export_error(LCC_HANDLE *handle, const char *what)
+{
+  LCC_ERROR *error= LCC_get_error(handle);
+
+  if (error)
+    fprintf(stderr, "lcc-export: %s: %s (%u)\n", what, error->error, error->error_number);
+  else
+    fprintf(stderr, "lcc-export: %s failed\n", what);
+}
+
+/* quotes an identifier with backticks */
+static int
+export_quote_name(char *buffer, size_t size, const char *name)
+{
+  size_t len= 0;
+
+  if (size < 3)
+    return 1;
+  buffer[len++]= '`';
+  for (; *name; name++)
+  {
+    if (len + 4 > size)
+      return 1;
+    if (*name == '`')
+      buffer[len++]= '`';
+    buffer[len++]= *name;
+  }
+  buffer[len++]= '`';
+  buffer[len]= 0;
+  return 0;
+}
+
+/* quotes a string literal */
+static int
+export_quote_string(char *buffer, size_t size, const char *str)
+{
+  size_t len= 0;
+
+  if (size < 3)
+    return 1;
+  buffer[len++]= '\'';
+  for (; *str; str++)
+  {
+    if (len + 4 > size)
+      return 1;
+    if (*str == '\'' || *str == '\\')
+      buffer[len++]= '\\';
+    buffer[len++]= *str;
+  }
+  buffer[len++]= '\'';
+  buffer[len]= 0;
+  return 0;
+}
+
+static LCC_HANDLE *
+export_connect(export_options *options)
+{
+  LCC_HANDLE *conn;
+
+  if (LCC_init_handle(&conn, LCC_CONNECTION, NULL))
+  {
+    fprintf(stderr, "lcc-export: can't allocate connection\n");
+    return NULL;
+  }
+  if (options->user)
+    LCC_configuration_set(conn, NULL, LCC_OPT_USER, (void *)options->user);
+  if (options->password)
+    LCC_configuration_set(conn, NULL, LCC_OPT_PASSWORD, (void *)options->password);
+  LCC_configuration_set(conn, NULL, LCC_OPT_CURRENT_DB, (void *)options->database);
+
+  if (LCC_connect(conn, options->host, options->port))
+  {
+    export_error(conn, "connect");
+    LCC_close_handle(conn);
+    return NULL;
+  }
+  return conn;
+}
+
+/* executes a statement which doesn't return a result set */
+static int
+export_command(LCC_HANDLE *conn, const char *statement)
+{
+  if (LCC_execute(conn, statement, LCC_NTS))
+  {
+    export_error(conn, statement);
+    return 1;
+  }
+  return 0;
+}
+
+/* executes a query and returns the first row, the result handle
+   must be closed by the caller */
+static int
+export_query_row(LCC_HANDLE *conn, const char *query,
+                 LCC_HANDLE **result, LCC_STRING **row)
+{
+  uint8_t eof= 0;
+
+  *row= NULL;
+  if (LCC_execute(conn, query, LCC_NTS) ||
+      LCC_init_handle(result, LCC_RESULT, conn))
+  {
+    export_error(conn, query);
+    return 1;
+  }
+  if (LCC_result_fetch(*result, &eof))
+  {
+    export_error(conn, query);
+    LCC_close_handle(*result);
+    return 1;
+  }
+  if (!eof)
+    LCC_get_info(*result, RESULT_INFO_ROW, row);
+  return 0;
+}
+
+/* reads the first column of the primary key */
+static int
+export_primary_key(LCC_HANDLE *conn, export_options *options, char *key, size_t size)
+{
+  char query[EXPORT_QUERY_SIZE], db[EXPORT_NAME_SIZE + 4], table[EXPORT_NAME_SIZE + 4];
+  LCC_HANDLE *result;
+  LCC_STRING *row;
+  int rc= 1;
+
+  if (export_quote_string(db, sizeof(db), options->database) ||
+      export_quote_string(table, sizeof(table), options->table))
+    return 1;
+  snprintf(query, sizeof(query),
+           "SELECT COLUMN_NAME FROM information_schema.KEY_COLUMN_USAGE "
+           "WHERE TABLE_SCHEMA=%s AND TABLE_NAME=%s AND CONSTRAINT_NAME='PRIMARY' "
+           "ORDER BY ORDINAL_POSITION LIMIT 1", db, table);
+  if (export_query_row(conn, query, &result, &row))
+    return 1;
+  if (!row || !row[0].str || row[0].len >= size)
+    fprintf(stderr, "lcc-export: table %s has no primary key, use -k\n", options->table);
+  else
+  {
+    memcpy(key, row[0].str, row[0].len);
+    key[row[0].len]= 0;
+    rc= 0;
+  }
+  LCC_close_handle(result);
+  return rc;
+}
+
+/* reads the key range of the table */
+static int
+export_key_range(LCC_HANDLE *conn, export_job *job, uint8_t *empty)
+{
+  char query[EXPORT_QUERY_SIZE];
+  LCC_HANDLE *result;
+  LCC_STRING *row;
+  char value[32];
+  int rc= 0;
+
+  snprintf(query, sizeof(query), "SELECT MIN(%s), MAX(%s) FROM %s",
+           job->key, job->key, job->table);
+  if (export_query_row(conn, query, &result, &row))
+    return 1;
+
+  *empty= (!row || !row[0].str || !row[1].str);
+  if (!*empty)
+  {
+    if (row[0].len >= sizeof(value) || row[1].len >= sizeof(value))
+    {
+      fprintf(stderr, "lcc-export: key column %s is not an integer\n", job->key);
+      rc= 1;
+    }
+    else
+    {
+      char *end;
+
+      memcpy(value, row[0].str, row[0].len);
+      value[row[0].len]= 0;
+      job->min_key= strtoll(value, &end, 10);
+      rc|= (*end != 0);
+      memcpy(value, row[1].str, row[1].len);
+      value[row[1].len]= 0;
+      job->max_key= strtoll(value, &end, 10);
+      rc|= (*end != 0);
+      if (rc)
+        fprintf(stderr, "lcc-export: key column %s is not an integer\n", job->key);
+    }
+  }
+  LCC_close_handle(result);
+  return rc;
+}
+
+/* writes a CSV value: most values are written without copying */
+static void
+export_csv_value(FILE *file, const LCC_STRING *value)
+{
+  const char *pos, *start, *end;
+  uint8_t quote= 0, escape= 0;
+
+  if (!value->str)
+  {
+    fputs("\\N", file);
+    return;
+  }
+
+  end= value->str + value->len;
+  for (pos= value->str; pos < end; pos++)
+  {
+    switch (*pos) {
+    case ',':
+    case '\n':
+    case '\r':
+      quote= 1;
+      break;
+    case '"':
+      quote= escape= 1;
+      break;
+    case '\\':
+      escape= 1;
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (quote)
+    putc('"', file);
+  if (!escape)
+    fwrite(value->str, 1, value->len, file);
+  else
+  {
+    for (start= pos= value->str; pos < end; pos++)
+    {
+      /* write up to and including the character, which will be
+         written again with the next run */
+      if (*pos == '"' || *pos == '\\')
+      {
+        fwrite(start, 1, pos - start + 1, file);
+        start= pos;
+      }
+    }
+    fwrite(start, 1, end - start, file);
+  }
+  if (quote)
+    putc('"', file);
+}
+
+static void
+export_csv_row(FILE *file, const LCC_STRING *row, uint32_t column_count)
+{
+  uint32_t i;
+
+  for (i=0; i < column_count; i++)
+  {
+    if (i)
+      putc(',', file);
+    export_csv_value(file, &row[i]);
+  }
+  putc('\n', file);
+}
+
+static void
+export_uint32(FILE *file, uint32_t value)
+{
+  unsigned char buffer[4];
+
+  buffer[0]= (unsigned char)value;
+  buffer[1]= (unsigned char)(value >> 8);
+  buffer[2]= (unsigned char)(value >> 16);
+  buffer[3]= (unsigned char)(value >> 24);
+  fwrite(buffer, 1, 4, file);
+}
+
+static void
+export_binary_row(FILE *file, const LCC_STRING *row, uint32_t column_count)
+{
+  uint32_t i;
+
+  for (i=0; i < column_count; i++)
+  {
+    if (!row[i].str)
+    {
+      export_uint32(file, EXPORT_NULL_LENGTH);
+      continue;
+    }
+    export_uint32(file, (uint32_t)row[i].len);
+    fwrite(row[i].str, 1, row[i].len, file);
+  }
+}
+
+/**
+ * @brief: exports one key range
+ *
+ * Rows are written from the read buffer of the connection into the
+ * stdio buffer of the worker, no memory is allocated per row.
+ */
+static int
+export_chunk(export_job *job, LCC_HANDLE *conn, uint32_t chunk, char *buffer)
+{
+  export_options *options= job->options;
+  char query[EXPORT_QUERY_SIZE], path[4096];
+  LCC_HANDLE *result;
+  LCC_STRING *row;
+  FILE *file;
+  int64_t low, high;
+  uint32_t column_count= 0;
+  uint64_t rows= 0;
+  uint8_t eof= 0;
+  int rc= 0;
+
+  /* unsigned arithmetic: the range might exceed INT64_MAX */
+  low= (int64_t)((uint64_t)job->min_key + chunk * job->width);
+  high= (chunk == job->chunk_count - 1) ? job->max_key :
+        (int64_t)((uint64_t)low + job->width - 1);
+
+  snprintf(query, sizeof(query), "SELECT * FROM %s WHERE %s BETWEEN %lld AND %lld",
+           job->table, job->key, (long long)low, (long long)high);
+  if (LCC_execute(conn, query, LCC_NTS) ||
+      LCC_init_handle(&result, LCC_RESULT, conn))
+  {
+    export_error(conn, query);
+    return 1;
+  }
+  LCC_get_info(result, RESULT_INFO_COLUMN_COUNT, &column_count);
+
+  snprintf(path, sizeof(path), "%s/%s.%s.%05u.%s", options->outdir, options->database,
+           options->table, chunk, options->format == EXPORT_CSV ? "csv" : "bin");
+  if (!(file= fopen(path, "wb")))
+  {
+    perror(path);
+    LCC_close_handle(result);
+    return 1;
+  }
+  setvbuf(file, buffer, _IOFBF, EXPORT_BUFFER_SIZE);
+
+  if (options->format == EXPORT_BINARY)
+  {
+    fwrite(EXPORT_MAGIC, 1, strlen(EXPORT_MAGIC), file);
+    export_uint32(file, column_count);
+  }
+
+  for (;;)
+  {
+    if (LCC_result_fetch(result, &eof))
+    {
+      export_error(conn, query);
+      rc= 1;
+      break;
+    }
+    if (eof)
+      break;
+    LCC_get_info(result, RESULT_INFO_ROW, &row);
+    if (options->format == EXPORT_CSV)
+      export_csv_row(file, row, column_count);
+    else
+      export_binary_row(file, row, column_count);
+    rows++;
+  }
+
+  if (ferror(file) | fclose(file))
+  {
+    perror(path);
+    rc= 1;
+  }
+  LCC_close_handle(result);
+  __atomic_add_fetch(&job->rows, rows, __ATOMIC_RELAXED);
+  return rc;
+}
+
+static void *
+export_worker(void *arg)
+{
+  export_thread *worker= (export_thread *)arg;
+  export_job *job= worker->job;
+  uint32_t chunk;
+  char *buffer;
+
+  if (!(buffer= (char *)malloc(EXPORT_BUFFER_SIZE)))
+  {
+    __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  while (!__atomic_load_n(&job->failed, __ATOMIC_RELAXED) &&
+         (chunk= __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED)) < job->chunk_count)
+  {
+    if (export_chunk(job, worker->conn, chunk, buffer))
+      __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+  }
+  free(buffer);
+  return NULL;
+}
+
+/**
+ * @brief: opens the worker connections
+ *
+ * All workers start a consistent snapshot while the tables are locked
+ * by the control connection, so they read the same state of the table.
+ */
+static int
+export_open_workers(export_job *job, LCC_HANDLE *control)
+{
+  export_options *options= job->options;
+  uint32_t i;
+  int rc= 0;
+
+  if (!(job->workers= (export_thread *)calloc(options->threads, sizeof(export_thread))))
+    return 1;
+  if (options->lock && export_command(control, "FLUSH TABLES WITH READ LOCK"))
+  {
+    fprintf(stderr, "lcc-export: use -n if the user doesn't have the RELOAD privilege\n");
+    return 1;
+  }
+
+  for (i=0; i < options->threads && !rc; i++)
+  {
+    LCC_HANDLE *conn;
+
+    if (!(conn= export_connect(options)))
+      rc= 1;
+    else if (export_command(conn, "SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ") ||
+             export_command(conn, "START TRANSACTION WITH CONSISTENT SNAPSHOT"))
+    {
+      LCC_close_handle(conn);
+      rc= 1;
+    }
+    else
+    {
+      job->workers[job->worker_count].job= job;
+      job->workers[job->worker_count++].conn= conn;
+    }
+  }
+
+  if (options->lock && export_command(control, "UNLOCK TABLES"))
+    rc= 1;
+  return rc;
+}
+
+int main(int argc, char **argv)
+{
+  export_options options;
+  export_job job;
+  LCC_HANDLE *control;
+  char key[EXPORT_NAME_SIZE], db[EXPORT_NAME_SIZE + 4], table[EXPORT_NAME_SIZE + 4];
+  struct timespec start, end;
+  uint64_t range;
+  uint32_t i;
+  uint8_t empty= 0;
+  int c, rc= 1;
+
+  memset(&options, 0, sizeof(options));
+  options.host= "localhost";
+  options.outdir= ".";
+  options.chunks= 16;
+  options.threads= 4;
+  options.lock= 1;
+
+  while ((c= getopt(argc, argv, "h:P:u:p:D:t:k:c:j:f:o:n")) != -1)
+  {
+    switch (c) {
+    case 'h': options.host= optarg; break;
+    case 'P': options.port= (uint16_t)atoi(optarg); break;
+    case 'u': options.user= optarg; break;
+    case 'p': options.password= optarg; break;
+    case 'D': options.database= optarg; break;
+    case 't': options.table= optarg; break;
+    case 'k': options.key= optarg; break;
+    case 'c': options.chunks= (uint32_t)atoi(optarg); break;
+    case 'j': options.threads= (uint32_t)atoi(optarg); break;
+    case 'o': options.outdir= optarg; break;
+    case 'n': options.lock= 0; break;
+    case 'f':
+      if (!strcmp(optarg, "csv"))
+        options.format= EXPORT_CSV;
+      else if (!strcmp(optarg, "binary"))
+        options.format= EXPORT_BINARY;
+      else
+      {
+        export_usage();
+        return 1;
+      }
+      break;
+    default:
+      export_usage();
+      return 1;
+    }
+  }
+  if (!options.database || !options.table || !options.chunks || !options.threads)
+  {
+    export_usage();
+    return 1;
+  }
+
+  memset(&job, 0, sizeof(job));
+  job.options= &options;
+
+  if (!(control= export_connect(&options)))
+    return 1;
+
+  if (!options.key)
+  {
+    if (export_primary_key(control, &options, key, sizeof(key)))
+      goto end;
+    options.key= key;
+  }
+  if (export_quote_name(db, sizeof(db), options.database) ||
+      export_quote_name(table, sizeof(table), options.table) ||
+      export_quote_name(job.key, sizeof(job.key), options.key))
+  {
+    fprintf(stderr, "lcc-export: name too long\n");
+    goto end;
+  }
+  snprintf(job.table, sizeof(job.table), "%s.%s", db, table);
+
+  if (export_open_workers(&job, control))
+    goto end;
+
+  /* key range within the snapshot */
+  rc= export_key_range(job.workers[0].conn, &job, &empty);
+  if (rc || empty)
+    goto end;
+  rc= 1;
+
+  range= (uint64_t)job.max_key - (uint64_t)job.min_key;
+  job.width= range / options.chunks + 1;
+  job.chunk_count= (uint32_t)(range / job.width + 1);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i=0; i < job.worker_count; i++)
+  {
+    if (pthread_create(&job.workers[i].thread, NULL, export_worker, &job.workers[i]))
+    {
+      job.failed= 1;
+      break;
+    }
+  }
+  while (i--)
+    pthread_join(job.workers[i].thread, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (!job.failed)
+  {
+    fprintf(stderr, "lcc-export: %llu rows in %u chunks exported (%.2f s)\n",
+            (unsigned long long)job.rows, job.chunk_count,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    rc= 0;
+  }
+
+end:
+  for (i=0; i < job.worker_count; i++)
+    LCC_close_handle(job.workers[i].conn);
+  free(job.workers);
+  LCC_close_handle(control);
+  return rc;
+}
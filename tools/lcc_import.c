@@ -0,0 +1,666 @@
+/* lcc-import: loads a CSV or TSV file in parallel over several connections
+
+   The input file is memory mapped and split into batches on record
+   boundaries. Every worker connection loads batches with
+     LOAD DATA LOCAL INFILE ...            (default)
+   or, if local infile is disabled on the server, with multi row
+   INSERT statements (-m insert).
+
+   CSV: fields are separated by ',' and optionally enclosed by '"',
+   '"' is doubled within enclosed fields. TSV: fields are separated
+   by TAB. In both formats '\' escapes the next character, \N is NULL
+   and records are terminated by LF (the format written by lcc-export).
+*/
+#include <lcc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define IMPORT_BATCH_SIZE (16 * 1024 * 1024)
+#define IMPORT_INSERT_BATCH_SIZE (1024 * 1024)
+#define IMPORT_QUERY_SIZE 2048
+#define IMPORT_NAME_SIZE 256
+
+typedef enum {
+  IMPORT_CSV= 0,
+  IMPORT_TSV
+} import_format;
+
+typedef enum {
+  IMPORT_LOAD= 0,
+  IMPORT_INSERT
+} import_mode;
+
+typedef struct {
+  const char *host;
+  uint16_t port;
+  const char *user;
+  const char *password;
+  const char *database;
+  const char *table;
+  const char *file;
+  size_t batch_size;
+  uint32_t threads;
+  import_format format;
+  import_mode mode;
+  uint8_t header;
+  uint8_t no_checks;
+} import_options;
+
+typedef struct {
+  import_options *options;
+  char table[2 * IMPORT_NAME_SIZE + 8];   /* quoted `db`.`table` */
+  char separator;
+  char quote;                             /* 0 if fields aren't enclosed */
+  const char *data;                       /* mapped input file */
+  const char *end;
+  const char *next;                       /* start of the next batch */
+  pthread_mutex_t lock;
+  uint64_t *latencies;                    /* usec per batch */
+  uint32_t max_batches;
+  uint32_t batch_count;
+  uint64_t rows;
+  uint64_t warnings;
+  uint8_t failed;
+} import_job;
+
+typedef struct {
+  import_job *job;
+  LCC_HANDLE *conn;
+  const char *pos;                        /* unsent data of the batch */
+  const char *end;
+  char *statement;                        /* INSERT statement */
+  size_t statement_size;
+} import_worker;
+
+static void
+import_usage(void)
+{
+  fprintf(stderr,
+          "Usage: lcc-import [options] -D database -t table file\n"
+          "  -h host        server host (default localhost)\n"
+          "  -P port        server port\n"
+          "  -u user        user name\n"
+          "  -p password    password\n"
+          "  -j threads     number of connections (default 4)\n"
+          "  -b size        batch size in bytes, K/M/G suffix allowed\n"
+          "                 (default 16M, 1M for -m insert)\n"
+          "  -f csv|tsv     input format (default csv)\n"
+          "  -m load|insert LOAD DATA LOCAL INFILE or INSERT statements (default load)\n"
+          "  -H             skip the first line (header)\n"
+          "  -d             disable unique and foreign key checks\n");
+}
+
+static void
+import_error(LCC_HANDLE *handle, const char *what)
+{
+  LCC_ERROR *error= LCC_get_error(handle);
+
+  if (error)
+    fprintf(stderr, "lcc-import: %s: %s (%u)\n", what, error->error, error->error_number);
+  else
+    fprintf(stderr, "lcc-import: %s failed\n", what);
+}
+
+/* quotes an identifier with backticks */
+static int
+import_quote_name(char *buffer, size_t size, const char *name)
+{
+  size_t len= 0;
+
+  if (size < 3)
+    return 1;
+  buffer[len++]= '`';
+  for (; *name; name++)
+  {
+    if (len + 4 > size)
+      return 1;
+    if (*name == '`')
+      buffer[len++]= '`';
+    buffer[len++]= *name;
+  }
+  buffer[len++]= '`';
+  buffer[len]= 0;
+  return 0;
+}
+
+static size_t
+import_parse_size(const char *str)
+{
+  char *end;
+  size_t size= (size_t)strtoull(str, &end, 10);
+
+  switch (*end) {
+  case 'g': case 'G': size*= 1024; /* fall through */
+  case 'm': case 'M': size*= 1024; /* fall through */
+  case 'k': case 'K': size*= 1024; break;
+  default: break;
+  }
+  return size;
+}
+
+static uint64_t
+import_now_usec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief: returns the end of the first record which ends at or after
+ *         target
+ *
+ * Scanning has to start at a record boundary, since line feeds within
+ * enclosed fields or after an escape character don't end a record.
+ * A block of 16 bytes without quote or escape characters doesn't change
+ * the state, so blocks are classified with SSE2 and only blocks which
+ * contain one of these characters are scanned byte by byte.
+ */
+static const char *
+import_record_end(const char *pos, const char *end, const char *target, char quote)
+{
+  uint8_t quoted= 0;
+#ifdef __SSE2__
+  const __m128i lf= _mm_set1_epi8('\n');
+  const __m128i escape= _mm_set1_epi8('\\');
+  const __m128i enclose= _mm_set1_epi8(quote ? quote : '\\');
+#endif
+
+  while (pos < end)
+  {
+    const char *stop= end;
+
+#ifdef __SSE2__
+    if (end - pos >= 16)
+    {
+      __m128i block= _mm_loadu_si128((const __m128i *)pos);
+      int special= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, escape),
+                                                  _mm_cmpeq_epi8(block, enclose)));
+      if (!special)
+      {
+        int lines= quoted ? 0 : _mm_movemask_epi8(_mm_cmpeq_epi8(block, lf));
+
+        /* line feeds before target don't count */
+        if (target > pos)
+          lines= (target - pos >= 16) ? 0 : lines & ~((1 << (target - pos)) - 1);
+        if (lines)
+          return pos + __builtin_ctz((unsigned int)lines) + 1;
+        pos+= 16;
+        continue;
+      }
+      /* bytes up to and including the first special character */
+      stop= pos + __builtin_ctz((unsigned int)special) + 1;
+    }
+#endif
+    while (pos < stop)
+    {
+      char c= *pos++;
+
+      if (c == '\\')
+        pos++;
+      else if (quote && c == quote)
+        quoted^= 1;
+      else if (c == '\n' && !quoted && pos > target)
+        return pos;
+    }
+  }
+  return end;
+}
+
+/* assigns the next batch to a worker, returns 0 if no data is left */
+static int
+import_next_batch(import_job *job, const char **start, const char **end, uint32_t *batch)
+{
+  int rc= 0;
+
+  pthread_mutex_lock(&job->lock);
+  if (job->next < job->end && !__atomic_load_n(&job->failed, __ATOMIC_RELAXED))
+  {
+    const char *target= (size_t)(job->end - job->next) > job->options->batch_size ?
+                        job->next + job->options->batch_size - 1 : job->end;
+
+    *start= job->next;
+    *end= job->next= import_record_end(job->next, job->end, target, job->quote);
+    *batch= job->batch_count++;
+    rc= 1;
+  }
+  pthread_mutex_unlock(&job->lock);
+  return rc;
+}
+
+/* LOAD DATA LOCAL INFILE callback: copies the batch from the mapped file */
+static int64_t
+import_read(void *user_data, const char *filename, char *buffer, size_t size)
+{
+  import_worker *worker= (import_worker *)user_data;
+  size_t len= (size_t)(worker->end - worker->pos);
+
+  (void)filename;
+  if (len > size)
+    len= size;
+  memcpy(buffer, worker->pos, len);
+  worker->pos+= len;
+  return (int64_t)len;
+}
+
+/* appends a character to a string literal */
+static char *
+import_literal(char *out, char c)
+{
+  switch (c) {
+  case '\0':
+    *out++= '\\';
+    *out++= '0';
+    break;
+  case '\'':
+  case '\\':
+    *out++= '\\';
+    *out++= c;
+    break;
+  default:
+    *out++= c;
+    break;
+  }
+  return out;
+}
+
+/**
+ * @brief: appends a record as row of an INSERT statement
+ *
+ * At most 5 bytes are written per byte of the record including its
+ * line feed: an empty record is written as ('') and a separator.
+ */
+static char *
+import_insert_row(import_job *job, char *out, const char *pos, const char *end)
+{
+  *out++= '(';
+  for (;;)
+  {
+    if (end - pos >= 2 && pos[0] == '\\' && pos[1] == 'N' &&
+        (end - pos == 2 || pos[2] == job->separator))
+    {
+      memcpy(out, "NULL", 4);
+      out+= 4;
+      pos+= 2;
+    }
+    else
+    {
+      uint8_t quoted= 0;
+
+      *out++= '\'';
+      if (job->quote && pos < end && *pos == job->quote)
+      {
+        quoted= 1;
+        pos++;
+      }
+      while (pos < end)
+      {
+        char c= *pos;
+
+        if (c == '\\' && end - pos >= 2)
+        {
+          /* escape sequences of LOAD DATA and SQL literals match */
+          c= pos[1];
+          pos+= 2;
+          if (c && strchr("0btnrZ", c))
+          {
+            *out++= '\\';
+            *out++= c;
+          }
+          else
+            out= import_literal(out, c);
+          continue;
+        }
+        if (quoted && c == job->quote)
+        {
+          pos++;
+          if (pos < end && *pos == job->quote)
+            pos++;
+          else
+          {
+            quoted= 0;
+            continue;
+          }
+        }
+        else if (!quoted && c == job->separator)
+          break;
+        else
+          pos++;
+        out= import_literal(out, c);
+      }
+      *out++= '\'';
+    }
+    if (pos >= end)
+      break;
+    *out++= ',';
+    pos++;
+  }
+  *out++= ')';
+  return out;
+}
+
+/* loads a batch with a multi row INSERT statement */
+static int
+import_insert(import_worker *worker, const char *pos, const char *end)
+{
+  import_job *job= worker->job;
+  size_t size= (size_t)(end - pos) * 5 + IMPORT_QUERY_SIZE;
+  char *out;
+
+  if (size > worker->statement_size)
+  {
+    char *statement;
+
+    if (!(statement= (char *)realloc(worker->statement, size)))
+    {
+      fprintf(stderr, "lcc-import: can't allocate %zu bytes\n", size);
+      return 1;
+    }
+    worker->statement= statement;
+    worker->statement_size= size;
+  }
+
+  out= worker->statement + snprintf(worker->statement, IMPORT_QUERY_SIZE,
+                                    "INSERT INTO %s VALUES ", job->table);
+  while (pos < end)
+  {
+    const char *next= import_record_end(pos, end, pos, job->quote);
+    const char *eol= next[-1] == '\n' ? next - 1 : next;
+
+    if (out[-1] == ')')
+      *out++= ',';
+    out= import_insert_row(job, out, pos, eol);
+    pos= next;
+  }
+
+  if (LCC_execute(worker->conn, worker->statement, (size_t)(out - worker->statement)))
+  {
+    import_error(worker->conn, "INSERT");
+    return 1;
+  }
+  return 0;
+}
+
+/* loads a batch with LOAD DATA LOCAL INFILE */
+static int
+import_load(import_worker *worker, const char *pos, const char *end)
+{
+  import_job *job= worker->job;
+  char query[IMPORT_QUERY_SIZE];
+
+  worker->pos= pos;
+  worker->end= end;
+  snprintf(query, sizeof(query),
+           "LOAD DATA LOCAL INFILE 'lcc-import' INTO TABLE %s "
+           "FIELDS TERMINATED BY '%s' %s ESCAPED BY '\\\\' LINES TERMINATED BY '\\n'",
+           job->table, job->separator == '\t' ? "\\t" : ",",
+           job->quote ? "OPTIONALLY ENCLOSED BY '\"'" : "");
+  if (LCC_execute(worker->conn, query, LCC_NTS))
+  {
+    import_error(worker->conn, "LOAD DATA");
+    return 1;
+  }
+  return 0;
+}
+
+static LCC_HANDLE *
+import_connect(import_options *options)
+{
+  LCC_HANDLE *conn;
+
+  if (LCC_init_handle(&conn, LCC_CONNECTION, NULL))
+  {
+    fprintf(stderr, "lcc-import: can't allocate connection\n");
+    return NULL;
+  }
+  if (options->user)
+    LCC_configuration_set(conn, NULL, LCC_OPT_USER, (void *)options->user);
+  if (options->password)
+    LCC_configuration_set(conn, NULL, LCC_OPT_PASSWORD, (void *)options->password);
+  LCC_configuration_set(conn, NULL, LCC_OPT_CURRENT_DB, (void *)options->database);
+
+  if (LCC_connect(conn, options->host, options->port))
+  {
+    import_error(conn, "connect");
+    LCC_close_handle(conn);
+    return NULL;
+  }
+  if (options->no_checks &&
+      LCC_execute(conn, "SET SESSION unique_checks=0, foreign_key_checks=0", LCC_NTS))
+  {
+    import_error(conn, "SET SESSION");
+    LCC_close_handle(conn);
+    return NULL;
+  }
+  return conn;
+}
+
+static void *
+import_worker_run(void *arg)
+{
+  import_worker *worker= (import_worker *)arg;
+  import_job *job= worker->job;
+  const char *start, *end;
+  uint64_t rows= 0, warnings= 0;
+  uint32_t batch;
+
+  if (job->options->mode == IMPORT_LOAD)
+    LCC_set_option(worker->conn, LCC_OPT_LOCAL_INFILE_CALLBACK, import_read, worker);
+
+  while (import_next_batch(job, &start, &end, &batch))
+  {
+    uint64_t begin= import_now_usec(), affected= 0;
+    uint32_t warning_count= 0;
+    int rc;
+
+    if (job->options->mode == IMPORT_LOAD)
+      rc= import_load(worker, start, end);
+    else
+      rc= import_insert(worker, start, end);
+    if (rc)
+    {
+      __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    job->latencies[batch]= import_now_usec() - begin;
+    LCC_get_info(worker->conn, SERVER_INFO_AFFECTED_ROWS, &affected);
+    LCC_get_info(worker->conn, SERVER_INFO_WARNING_COUNT, &warning_count);
+    rows+= affected;
+    warnings+= warning_count;
+  }
+  __atomic_add_fetch(&job->rows, rows, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&job->warnings, warnings, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static int
+import_compare_latency(const void *a, const void *b)
+{
+  uint64_t x= *(const uint64_t *)a, y= *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+import_report(import_job *job, uint64_t usec)
+{
+  uint64_t *latencies= job->latencies, total= 0;
+  uint32_t i, count= job->batch_count;
+  double seconds= usec / 1e6;
+
+  fprintf(stderr, "lcc-import: %llu rows (%llu warnings) in %u batches loaded "
+          "(%.2f s, %.1f MB/s, %.0f rows/s)\n",
+          (unsigned long long)job->rows, (unsigned long long)job->warnings, count, seconds,
+          seconds > 0 ? (job->end - job->data) / seconds / (1024 * 1024) : 0.0,
+          seconds > 0 ? job->rows / seconds : 0.0);
+  if (!count)
+    return;
+
+  qsort(latencies, count, sizeof(uint64_t), import_compare_latency);
+  for (i=0; i < count; i++)
+    total+= latencies[i];
+  fprintf(stderr, "lcc-import: batch latency (ms): min %.1f avg %.1f p50 %.1f p99 %.1f max %.1f\n",
+          latencies[0] / 1e3, total / 1e3 / count, latencies[count / 2] / 1e3,
+          latencies[(uint32_t)((count - 1) * 0.99)] / 1e3, latencies[count - 1] / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+  import_options options;
+  import_job job;
+  import_worker *workers= NULL;
+  pthread_t *threads= NULL;
+  char db[IMPORT_NAME_SIZE + 4], table[IMPORT_NAME_SIZE + 4];
+  struct stat st;
+  uint64_t start;
+  uint32_t i, started= 0;
+  int c, fd, rc= 1;
+  void *data;
+
+  memset(&options, 0, sizeof(options));
+  options.host= "localhost";
+  options.threads= 4;
+
+  while ((c= getopt(argc, argv, "h:P:u:p:D:t:j:b:f:m:Hd")) != -1)
+  {
+    switch (c) {
+    case 'h': options.host= optarg; break;
+    case 'P': options.port= (uint16_t)atoi(optarg); break;
+    case 'u': options.user= optarg; break;
+    case 'p': options.password= optarg; break;
+    case 'D': options.database= optarg; break;
+    case 't': options.table= optarg; break;
+    case 'j': options.threads= (uint32_t)atoi(optarg); break;
+    case 'b': options.batch_size= import_parse_size(optarg); break;
+    case 'H': options.header= 1; break;
+    case 'd': options.no_checks= 1; break;
+    case 'f':
+      if (!strcmp(optarg, "csv"))
+        options.format= IMPORT_CSV;
+      else if (!strcmp(optarg, "tsv"))
+        options.format= IMPORT_TSV;
+      else
+      {
+        import_usage();
+        return 1;
+      }
+      break;
+    case 'm':
+      if (!strcmp(optarg, "load"))
+        options.mode= IMPORT_LOAD;
+      else if (!strcmp(optarg, "insert"))
+        options.mode= IMPORT_INSERT;
+      else
+      {
+        import_usage();
+        return 1;
+      }
+      break;
+    default:
+      import_usage();
+      return 1;
+    }
+  }
+  if (optind != argc - 1 || !options.database || !options.table || !options.threads)
+  {
+    import_usage();
+    return 1;
+  }
+  options.file= argv[optind];
+  if (!options.batch_size)
+    options.batch_size= options.mode == IMPORT_LOAD ? IMPORT_BATCH_SIZE : IMPORT_INSERT_BATCH_SIZE;
+
+  memset(&job, 0, sizeof(job));
+  job.options= &options;
+  job.separator= options.format == IMPORT_CSV ? ',' : '\t';
+  job.quote= options.format == IMPORT_CSV ? '"' : 0;
+  if (import_quote_name(db, sizeof(db), options.database) ||
+      import_quote_name(table, sizeof(table), options.table))
+  {
+    fprintf(stderr, "lcc-import: name too long\n");
+    return 1;
+  }
+  snprintf(job.table, sizeof(job.table), "%s.%s", db, table);
+
+  if ((fd= open(options.file, O_RDONLY)) < 0 || fstat(fd, &st))
+  {
+    perror(options.file);
+    return 1;
+  }
+  if (!st.st_size)
+  {
+    fprintf(stderr, "lcc-import: %s is empty\n", options.file);
+    close(fd);
+    return 0;
+  }
+  data= mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    perror(options.file);
+    return 1;
+  }
+  madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+  job.data= job.next= (const char *)data;
+  job.end= job.data + st.st_size;
+  if (options.header)
+    job.next= import_record_end(job.data, job.end, job.data, job.quote);
+
+  /* all batches but the last one have at least batch_size bytes */
+  job.max_batches= (uint32_t)((size_t)st.st_size / options.batch_size + 1);
+  pthread_mutex_init(&job.lock, NULL);
+  if (!(job.latencies= (uint64_t *)calloc(job.max_batches, sizeof(uint64_t))) ||
+      !(workers= (import_worker *)calloc(options.threads, sizeof(import_worker))) ||
+      !(threads= (pthread_t *)calloc(options.threads, sizeof(pthread_t))))
+    goto end;
+
+  for (i=0; i < options.threads; i++)
+  {
+    workers[i].job= &job;
+    if (!(workers[i].conn= import_connect(&options)))
+      goto end;
+  }
+
+  start= import_now_usec();
+  for (started=0; started < options.threads; started++)
+  {
+    if (pthread_create(&threads[started], NULL, import_worker_run, &workers[started]))
+    {
+      job.failed= 1;
+      break;
+    }
+  }
+  for (i=0; i < started; i++)
+    pthread_join(threads[i], NULL);
+
+  if (!job.failed)
+  {
+    import_report(&job, import_now_usec() - start);
+    rc= 0;
+  }
+
+end:
+  for (i=0; workers && i < options.threads; i++)
+  {
+    if (workers[i].conn)
+      LCC_close_handle(workers[i].conn);
+    free(workers[i].statement);
+  }
+  free(threads);
+  free(workers);
+  free(job.latencies);
+  pthread_mutex_destroy(&job.lock);
+  munmap(data, (size_t)st.st_size);
+  return rc;
+}